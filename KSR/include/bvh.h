@@ -0,0 +1,99 @@
+/*! \file */
+/*-----------------------------------------------------------------------
+    bvh.h
+
+    Description: Bounding volume hierarchy over the triangles of a Geometry, for ray queries
+    ---------------------------------------------------------------------*/
+
+#pragma once
+
+const int MAX_BVH_DEPTH = 64;           //!< Nodes deeper than this are always leafs, which bounds the traversal stack.
+const int MAX_BVH_LEAF_TRIANGLES = 8;   //!< Nodes with more triangles than this are always split, where they can be.
+
+//! \enum BVHQUERYMODE
+enum BVHQUERYMODE
+{
+    BQM_NEAREST = 0,    /**< Find the hit closest to the ray origin. */
+    BQM_ANY,            /**< Stop at the first hit found. For line of sight tests. */
+    BQM_ALL,            /**< Find every hit. */
+};
+
+//! \struct BVHNode
+/*! Nodes are 32 bytes, so that both children of a node fit in one cache line. */
+struct BVHNode
+{
+    Vector3 min;
+    unsigned int first;     /**< First triangle of a leaf, or the first of the two children of an interior node. */
+    Vector3 max;
+    unsigned int count;     /**< Number of triangles in a leaf. 0 for interior nodes. */
+};
+
+//! \struct BVHTriangle
+struct BVHTriangle
+{
+    Vector3 v0,
+            edge1,          /**< v1 - v0 */
+            edge2;          /**< v2 - v0 */
+
+    unsigned int chunkID,
+                 vertexID0,
+                 vertexID1,
+                 vertexID2;
+
+    DWORD typeFlag;         /**< INTERSECTFLAGS bit of the type of the chunk the triangle is from. */
+};
+
+//! \struct BVHHit
+struct BVHHit
+{
+    unsigned int triangle;  /**< Index of the triangle, see TriangleBVH::GetTriangle(). */
+    float u, v, distance;   /**< As returned by D3DXIntersectTri. */
+};
+
+//! \struct TriangleBVH
+/*! Built with the surface area heuristic and traversed front to back, so that a nearest hit
+    query need only visit the nodes in front of the nearest triangle found so far. */
+struct TriangleBVH
+{
+public:
+    TriangleBVH();
+    ~TriangleBVH();
+
+    //! \brief Builds the tree.
+    /*! \param triangles [in, out] Triangles to build the tree over. They are taken over by the tree, leaving triangles empty. */
+    void Build(std::vector<BVHTriangle> &triangles);
+
+    void Clear();
+
+    //! \brief Intersects a ray with the triangles of the tree.
+    /*! Returns true if anything is hit. For BQM_NEAREST and BQM_ANY, a single hit is added to hits.
+        For BQM_ALL, every hit is added, in no particular order.
+        \param hits [out] Hits are appended to this.
+        \param rayPos Origin of the ray.
+        \param rayDir Direction of the ray. Distances are in multiples of its length.
+        \param typeFlags INTERSECTFLAGS of the chunk types to test.
+        \param mode Query mode.
+        \param maxDistance Only hits nearer than this are found. Bounding it lets BQM_ANY stop at the
+               first hit that matters, and lets every mode skip the nodes beyond it. */
+    bool Intersect(std::vector<BVHHit> &hits, const Vector3 &rayPos, const Vector3 &rayDir, DWORD typeFlags, BVHQUERYMODE mode,
+                   float maxDistance = FLT_MAX) const;
+
+    const BVHTriangle &GetTriangle(const unsigned int index) const { return m_triangles[index]; }
+
+    const unsigned int GetNumTriangles() const { return (unsigned int)m_triangles.size(); }
+    const unsigned int GetNumNodes() const { return (unsigned int)m_nodes.size(); }
+    const DWORD GetNumBytes() const { return (DWORD)(m_nodes.size() * sizeof(BVHNode) + m_triangles.size() * sizeof(BVHTriangle)); }
+
+private:
+    void BuildNode(unsigned int nodeIndex, unsigned int first, unsigned int count, int depth,
+                   const std::vector<Math::AABB> &bounds, const std::vector<Vector3> &centroids);
+
+    std::vector<BVHNode> m_nodes;
+    std::vector<BVHTriangle> m_triangles;
+
+    std::vector<unsigned int> m_order;      /**< Triangle order, only used while building. */
+};
+
+typedef TriangleBVH *PTRIANGLEBVH;
+
+// EOF
@@ -37,6 +37,13 @@ public:
     bool CheckSphereFrustum(const Vector3 &position, const float &radius) const;
     bool CheckBoxFrustum(const Vector3 &min, const Vector3 &max) const;
 
+    //! \brief Tests a box, given by its centre and half extents, against the frustum.
+    /*! See Math::AABBFrustumIntersection(). pPlaneMask starts as Math::FRUSTUM_ALL_PLANES for a box that is not inside another. */
+    Math::INTERSECTIONSTATE CullBox(const Vector3 &centre, const Vector3 &extent, DWORD *pPlaneMask) const;
+
+    //! \brief Tests a batch of boxes against the frustum. See Math::AABBFrustumIntersection().
+    void CullBoxes(const Math::BoxBatch &boxes, DWORD planeMask, DWORD *pPlaneMasks) const;
+
     void Transform(DWORD type, const Vector3 &transform);
 
     void SetTransformMode(DWORD mode);
@@ -87,7 +94,7 @@ private:
     Vector3 m_lastWaypointPos, m_lastWaypointRot;
 
     Matrix m_frustum;
-    Plane m_frustumPlanes[6];
+    Plane m_frustumPlanes[6];    /**< Normalised, facing into the frustum. */
 };
 
 typedef struct Camera *PCAMERA;
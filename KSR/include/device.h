@@ -0,0 +1,101 @@
+/*! \file */
+/*-----------------------------------------------------------------------
+    device.h
+
+    Description: Device and buffer interfaces used by Geometry and Scene
+    ---------------------------------------------------------------------*/
+
+#pragma once
+
+//! \struct DeviceBuffer
+/*! A block of vertex or vertex index data created by a Device. */
+struct DeviceBuffer
+{
+public:
+    virtual ~DeviceBuffer() {}
+
+    //! \brief Locks and retrieves access to the whole buffer.
+    /*! Returns S_OK on success and E_FAIL on failure.
+        \param ppData [out] Pointer to receive the address of the buffer data.
+        \param flags Lock flags, see LOCKFLAGS. */
+    virtual HRESULT Lock(void **ppData, DWORD flags = 0) = 0;
+    virtual HRESULT Unlock() = 0;
+
+    //! Returns the length of the buffer, in bytes.
+    virtual const unsigned int GetLength() const = 0;
+
+    //! Returns the Direct3D vertex buffer behind this buffer, or NULL if there is none.
+    virtual LPDIRECT3DVERTEXBUFFER9 GetD3DVertexBuffer() { return NULL; }
+
+    //! Returns the Direct3D index buffer behind this buffer, or NULL if there is none.
+    virtual LPDIRECT3DINDEXBUFFER9 GetD3DIndexBuffer() { return NULL; }
+};
+
+//! \struct Device
+/*! Creates the buffers that Geometry and OptimisedGeometry keep their vertices and vertex indices in.
+    Geometry and Scene only create buffers through this interface, so a scene built on a NullDevice
+    can be partitioned, culled, ray tested and serialised without a window or a Direct3D device. */
+struct Device
+{
+public:
+    virtual ~Device() {}
+
+    //! \brief Creates a vertex buffer.
+    /*! Returns S_OK on success and E_FAIL on failure.
+        \param length Length of the buffer, in bytes.
+        \param FVF Flexible vertex format of the vertices, or 0 if a vertex declaration is used.
+        \param ppBuffer [out] Address of a pointer to receive the new buffer. The caller deletes it. */
+    virtual HRESULT CreateVertexBuffer(unsigned int length, DWORD FVF, DeviceBuffer **ppBuffer) = 0;
+
+    //! \brief Creates a vertex index buffer.
+    /*! Returns S_OK on success and E_FAIL on failure.
+        \param length Length of the buffer, in bytes.
+        \param indexType Index format, IT_16 or IT_32.
+        \param ppBuffer [out] Address of a pointer to receive the new buffer. The caller deletes it. */
+    virtual HRESULT CreateIndexBuffer(unsigned int length, DWORD indexType, DeviceBuffer **ppBuffer) = 0;
+
+    //! \brief Creates a vertex declaration.
+    /*! Returns S_OK on success and E_FAIL on failure. A device that does not render returns S_OK and NULL.
+        \param pElements [in] Array of vertex elements, ending with D3DDECL_END().
+        \param ppDeclaration [out] Address of a pointer to receive the declaration. */
+    virtual HRESULT CreateVertexDeclaration(const D3DVERTEXELEMENT9 *pElements, LPDIRECT3DVERTEXDECLARATION9 *ppDeclaration) = 0;
+
+    //! Returns the Direct3D device, or NULL for a device that does not render.
+    virtual LPDIRECT3DDEVICE9 GetD3DDevice() = 0;
+};
+
+//! \typedef Device *PDEVICE
+typedef Device *PDEVICE;
+
+//! \struct D3D9Device
+/*! Device that creates managed Direct3D 9 buffers. */
+struct D3D9Device : public Device
+{
+public:
+    D3D9Device(LPDIRECT3DDEVICE9 pDevice = NULL) : m_pD3DDevice(pDevice) {}
+
+    HRESULT CreateVertexBuffer(unsigned int length, DWORD FVF, DeviceBuffer **ppBuffer);
+    HRESULT CreateIndexBuffer(unsigned int length, DWORD indexType, DeviceBuffer **ppBuffer);
+    HRESULT CreateVertexDeclaration(const D3DVERTEXELEMENT9 *pElements, LPDIRECT3DVERTEXDECLARATION9 *ppDeclaration);
+
+    //! Updates the Direct3D device new buffers are created on.
+    void SetD3DDevice(LPDIRECT3DDEVICE9 pDevice) { m_pD3DDevice = pDevice; }
+    LPDIRECT3DDEVICE9 GetD3DDevice() { return m_pD3DDevice; }
+
+private:
+    LPDIRECT3DDEVICE9 m_pD3DDevice;
+};
+
+//! \struct NullDevice
+/*! Device that keeps buffers in system memory and never renders. */
+struct NullDevice : public Device
+{
+public:
+    HRESULT CreateVertexBuffer(unsigned int length, DWORD FVF, DeviceBuffer **ppBuffer);
+    HRESULT CreateIndexBuffer(unsigned int length, DWORD indexType, DeviceBuffer **ppBuffer);
+    HRESULT CreateVertexDeclaration(const D3DVERTEXELEMENT9 *pElements, LPDIRECT3DVERTEXDECLARATION9 *ppDeclaration);
+
+    LPDIRECT3DDEVICE9 GetD3DDevice() { return NULL; }
+};
+
+// EOF
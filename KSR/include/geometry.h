@@ -74,6 +74,7 @@ enum INTERSECTFLAGS
     IF_TRIANGLELIST        = 1 << CT_TRIANGLELIST,
     IF_TRIANGLESTRIP    = 1 << CT_TRIANGLESTRIP,
     IF_ALL                = IF_POLYGON | IF_TRIANGLELIST | IF_TRIANGLESTRIP,
+    IF_ANYHIT            = 1 << 16,    // Accept the first hit found rather than the nearest. For line of sight tests.
 };
 
 enum LOCKFLAGS
@@ -132,6 +133,13 @@ public:
     static bool Greater(const RenderGroup &r1, const RenderGroup &r2);
     static bool Less(const RenderGroup &r1, const RenderGroup &r2);
 
+    //! \brief Packs the state the group is drawn with into m_sortKey.
+    /*! From the most significant bits down, the key holds the order, effect, technique, material, texture,
+        geometry and depth, so that sorting by key draws the groups in order with the fewest state changes.
+        Orders above 65535 sort as 65535. The other fields only affect performance, and are clamped or hashed to fit.
+        \param depth Distance of the group along the view direction, or 0 if unknown. */
+    void SetSortKey(float depth);
+
     Geometry *m_pGeometry;
     OptimisedGeometry *m_pOptimisedGeometry;
     Scene *m_pScene;
@@ -145,6 +153,8 @@ public:
 
     bool m_hasTransform;
     Matrix m_transform;
+
+    ULONGLONG m_sortKey;    /**< Set by SetSortKey(). */
 };
 
 
@@ -155,6 +165,9 @@ public:
     TreeNode(const Vector3 &boundingMin, const Vector3 &boundingMax, TreeNode *parentNode, int uniqueId);
     ~TreeNode();
 
+    //! \brief Copies the bounds of the children into m_pChildBounds, for culling them together. Call once the children are created.
+    void SetChildBounds();
+
     Vector3 m_min, m_max;
 
     int m_numChildren;
@@ -165,6 +178,8 @@ public:
 
     TreeNode *m_pParent;
     TreeNode **m_pChildren;
+
+    Math::BoxBatch *m_pChildBounds;    /**< Bounds of the children, or NULL if SetChildBounds() has not been called. */
 };
 
 
@@ -246,6 +261,9 @@ struct IntersectionResult
     bool operator == (const IntersectionResult &rhs);
     bool operator != (const IntersectionResult &rhs);
 
+    //! \brief Orders results by distance, for std::sort.
+    static bool Nearer(const IntersectionResult &lhs, const IntersectionResult &rhs);
+
     Geometry *m_pGeometry;
     unsigned int m_chunkID,
                  m_vertexID0,
@@ -291,7 +309,10 @@ public:
     typedef std::vector< std::pair< unsigned int, VertexIndexList > > ChunkIndexList;
     typedef std::vector< std::pair< unsigned int, ChunkIndexList > > OrderedChunkIndexLists;
 
-    Geometry(LPDIRECT3DDEVICE9 pDevice, DWORD resourceOwnershipFlags = 0);
+    //! \brief Constructor
+    /*! \param pDevice [in] Pointer to the Device the vertex and vertex index buffers are created on.
+        \param resourceOwnershipFlags Resource ownership flags, see RESOURCEOWNERSHIPFLAGS. */
+    Geometry(PDEVICE pDevice, DWORD resourceOwnershipFlags = 0);
     ~Geometry();
 
     const Chunk &operator [](const unsigned int index) const { return m_pChunks[index]; }
@@ -386,9 +407,39 @@ public:
     HRESULT Serialise(OutputGeometry *pOutputGeometry);
     HRESULT Reassemble(OutputGeometry *pOutputGeometry);
 
-    bool Intersect(IntersectionResult &result, const Vector3 &rayPos, const Vector3 &rayDir, RenderGroup *pGroup, DWORD flags);
+    //! \brief Finds the nearest intersection of a ray with the triangles of this geometry.
+    /*! Returns true if the ray hits anything. The triangles are searched with a TriangleBVH, which
+        is built on the first query and rebuilt after the geometry is changed.
+        \param result [out] The nearest hit, or with IF_ANYHIT in flags, the first hit found.
+        \param rayPos Origin of the ray.
+        \param rayDir Direction of the ray. Distances are in multiples of its length.
+        \param pGroup Unused.
+        \param flags INTERSECTFLAGS.
+        \param maxDistance Only hits nearer than this are found. */
+    bool Intersect(IntersectionResult &result, const Vector3 &rayPos, const Vector3 &rayDir, RenderGroup *pGroup, DWORD flags,
+                   float maxDistance = FLT_MAX);
+
+    //! \brief Finds every intersection of a ray with the triangles of this geometry.
+    /*! Returns true if the ray hits anything. The hits are added to the end of results, nearest first. */
     bool Intersect(std::list<IntersectionResult> &results, const Vector3 &rayPos, const Vector3 &rayDir, RenderGroup *pGroup, DWORD flags);
 
+    //! \brief Finds every intersection of a ray with the triangles of this geometry.
+    /*! Returns true if the ray hits anything. The hits are added to the end of results, nearest first. */
+    bool Intersect(std::vector<IntersectionResult> &results, const Vector3 &rayPos, const Vector3 &rayDir, DWORD flags);
+
+    //! \brief Finds the nearest intersection of each of a number of rays.
+    /*! Returns the number of rays that hit anything. results is resized to numRays, and entry i holds
+        the hit of pRays[i], with m_pGeometry NULL if it missed.
+        \param flags INTERSECTFLAGS. With IF_ANYHIT, the first hit found for each ray is returned rather than the nearest.
+        \param maxDistance Only hits nearer than this are found. */
+    unsigned int IntersectRays(std::vector<IntersectionResult> &results, const Math::Ray *pRays, unsigned int numRays, DWORD flags,
+                               float maxDistance = FLT_MAX);
+
+    //! \brief Builds the TriangleBVH used by ray queries, if it is not already built.
+    /*! Queries build it themselves when they need it, but the build is not thread safe, so call this
+        before querying from more than one thread. Returns false if the geometry is empty or cannot be locked. */
+    bool BuildBVH();
+
     const DWORD GetIndexGenerationFlags() const { return m_indexGenerationFlags; }
     const DWORD GetOwnershipFlags() const { return m_resourceOwnershipFlags; }
     const DWORD GetVertexFormat() const { return m_FVF; };
@@ -427,7 +478,8 @@ public:
     LPDIRECT3DVERTEXBUFFER9 GetVertexBuffer();
     LPDIRECT3DINDEXBUFFER9  GetIndexBuffer();
 
-    LPDIRECT3DDEVICE9 GetD3DDevice() { return m_pDevice; }
+    PDEVICE GetDevice() { return m_pDevice; }
+    LPDIRECT3DDEVICE9 GetD3DDevice() { return m_pDevice->GetD3DDevice(); }
 
 private:
     PSCENE m_pScene;
@@ -460,14 +512,18 @@ private:
 
     LPDIRECT3DVERTEXDECLARATION9 m_pVertexDeclaration;
 
-    LPDIRECT3DVERTEXBUFFER9 m_pVertexBuffer;
-    LPDIRECT3DINDEXBUFFER9 m_pIndexBuffer;
-    LPDIRECT3DDEVICE9 m_pDevice;
+    DeviceBuffer *m_pVertexBuffer;
+    DeviceBuffer *m_pIndexBuffer;
+    PDEVICE m_pDevice;
 
     //Geometry *m_pSharedResources[4];
 
-//private:
-    bool Intersect(std::list<IntersectionResult> &results, const Vector3 &rayPos, const Vector3 &rayDir, RenderGroup *pGroup, DWORD flags, bool findFirst);
+    PTRIANGLEBVH m_pBVH;            /**< Triangles for ray queries. NULL until the first query after a change. */
+
+    void ReleaseBVH();
+    bool IntersectBVH(std::vector<BVHHit> &hits, const Vector3 &rayPos, const Vector3 &rayDir, DWORD flags, BVHQUERYMODE mode,
+                      float maxDistance = FLT_MAX);
+    const IntersectionResult GetIntersectionResult(const BVHHit &hit);
 };
 
 // EOF
\ No newline at end of file
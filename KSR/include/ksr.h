@@ -80,6 +80,8 @@ void DebugPrintf(LPCTSTR fmt, ...);
 #include "memobject.h"
 #include "settings.h"
 #include "camera.h"
+#include "device.h"
+#include "bvh.h"
 #include "geometry.h"
 #include "effect.h"
 #include "visual.h"
@@ -94,6 +96,7 @@ void DebugPrintf(LPCTSTR fmt, ...);
 #include "renderer.h"
 #include "logger.h"
 #include "timer.h"
+#include "workers.h"
 #include "serialiser.h"
 #include "interface.h"
 
@@ -84,6 +84,33 @@ struct AABB
     Vector3 min, max;
 };
 
+struct Ray
+{
+    Ray();
+    Ray(const Vector3 &rayPosition, const Vector3 &rayDirection);
+
+    Vector3 position, direction;
+};
+
+const int MAX_BOX_BATCH = 8;            //!< Number of boxes in a BoxBatch. Enough for the children of an octree node.
+const DWORD FRUSTUM_ALL_PLANES = 0x3f;  //!< Plane mask with each of the six frustum planes set.
+const DWORD FRUSTUM_OUTSIDE = 0x40;     //!< Set in the plane masks returned by AABBFrustumIntersection() for boxes outside the frustum.
+
+//! \struct BoxBatch
+/*! Centres and half extents of up to MAX_BOX_BATCH boxes, kept in separate arrays so that a plane
+    can be tested against every box of the batch in one loop. Unused boxes are left empty at the origin. */
+struct BoxBatch
+{
+    BoxBatch();
+
+    void Set(int index, const Vector3 &boxMin, const Vector3 &boxMax);
+
+    float centreX[MAX_BOX_BATCH], centreY[MAX_BOX_BATCH], centreZ[MAX_BOX_BATCH];
+    float extentX[MAX_BOX_BATCH], extentY[MAX_BOX_BATCH], extentZ[MAX_BOX_BATCH];
+
+    int numBoxes;
+};
+
 struct AABBPlanes
 {
     struct AABBPoly
@@ -320,10 +347,37 @@ bool PointFrustumCollision(const Vector3 &point, const Plane *frustumPlanes);
 bool AABBSphereCollision(const AABB &box, const Sphere &sphere, Vector3 *pPoint);
 bool AABBPolygonCollision(const AABB &box, const Polygon &polygon);
 bool AABBRayCollision(const AABB &box, const Vector3 &position, const Vector3 &direction);
+bool AABBRayIntersection(const AABB &box, const Vector3 &position, const Vector3 &direction, float *pDistance);
 bool AABBAABBCollision(const AABB &box1, const AABB &box2);
 bool AABBPointCollision(const AABB &box, const Vector3 &point);
 bool AABBFrustumCollision(const AABB &box, const Plane *frustumPlanes);
 
+//! \brief Tests a box against the planes of a frustum.
+/*! Returns IS_NONE if the box is outside, IS_B_CONTAINS_A if it is entirely inside and IS_PENETRATION otherwise.
+    \param centre Centre of the box.
+    \param extent Half the size of the box along each axis.
+    \param frustumPlanes [in] The six frustum planes, facing inwards.
+    \param pPlaneMask [in, out] Bits of the planes to test. Planes the box is entirely in front of are cleared,
+                      so the mask can be passed on to the test of anything the box contains. */
+INTERSECTIONSTATE AABBFrustumIntersection(const Vector3 &centre, const Vector3 &extent, const Plane *frustumPlanes, DWORD *pPlaneMask);
+
+//! \brief Tests every box of a batch against the planes of a frustum.
+/*! \param boxes Boxes to test.
+    \param frustumPlanes [in] The six frustum planes, facing inwards.
+    \param planeMask Bits of the planes to test, usually the mask of a box enclosing the whole batch.
+    \param pPlaneMasks [out] MAX_BOX_BATCH masks. For each box, FRUSTUM_OUTSIDE if it is outside the frustum,
+                       otherwise planeMask less the planes the box is entirely in front of. */
+void AABBFrustumIntersection(const BoxBatch &boxes, const Plane *frustumPlanes, DWORD planeMask, DWORD *pPlaneMasks);
+
+//! \brief Finds the axis aligned box enclosing a transformed box.
+/*! Unlike transforming the min and max corners, this is correct for rotations.
+    \param boxMin Minimum corner of the box before the transform.
+    \param boxMax Maximum corner of the box before the transform.
+    \param transform Affine transform.
+    \param pCentre [out] Centre of the transformed box.
+    \param pExtent [out] Half the size of the enclosing box along each axis. */
+void TransformAABB(const Vector3 &boxMin, const Vector3 &boxMax, const Matrix &transform, Vector3 *pCentre, Vector3 *pExtent);
+
 /*inline bool AABBTriangleCollision(const AABB &box, const Vector3 *pVerts)
 {
     return AABBTriangleCollision(AABBPlanes(box), pVerts);
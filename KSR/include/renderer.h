@@ -8,6 +8,14 @@
 
 #pragma once
 
+//! \struct RenderSortItem
+/*! Entry of the draw order of a render list. Groups are sorted through these rather than moved themselves. */
+struct RenderSortItem
+{
+    ULONGLONG key;        /**< RenderGroup::m_sortKey of the group. */
+    unsigned int index;    /**< Index of the group in the render list. */
+};
+
 struct Renderer : public MemObject
 {
 public:
@@ -41,6 +49,7 @@ public:
     HRESULT SetFullscreen(PVIEWPORT pViewport);
 
     LPDIRECT3DDEVICE9 GetD3DDevice() { return D3DDevice; };
+    PDEVICE GetDevice() { return &device; };
     D3DCAPS9 GetD3DCaps() { return D3DCaps; };
 
     DWORD TestDevice();
@@ -50,6 +59,7 @@ private:
     HRESULT CatchLostDevice();
     HRESULT PrepareViewportRender(PVIEWPORT pViewport);
     HRESULT RenderGeometry(std::vector<RenderGroup> &renderList, PVIEWPORT pViewport);
+    void SortRenderList(std::vector<RenderGroup> &renderList, const Matrix &view);
     //HRESULT RenderChunk(Geometry *geometry, Chunk *chunk);
     HRESULT RenderChunk(bool useIndices, unsigned int numVerts, const Chunk *chunk);
     HRESULT PreRender(LPDIRECT3DSWAPCHAIN9 pSwapChain, PVIEWPORT pViewport);
@@ -57,6 +67,7 @@ private:
 
     LPDIRECT3D9          D3D;
     LPDIRECT3DDEVICE9 D3DDevice;
+    D3D9Device          device;
     D3DDISPLAYMODE      D3DDisplayMode;
     D3DDEVTYPE          D3DDeviceType;
     D3DCAPS9          D3DCaps;
@@ -90,6 +101,9 @@ private:
     PVIEWPORT pFullscreenViewport;
 
     std::list<PVIEWPORT> viewports;
+
+    std::vector<RenderSortItem> renderOrder;        /**< Draw order of the last render list, kept to start the next sort from. */
+    std::vector<RenderSortItem> renderSortBuffer;    /**< Scratch space for the radix sort. */
 };
 
 typedef struct Renderer *PRENDERER;
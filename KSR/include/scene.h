@@ -58,7 +58,7 @@ public:
         m_vertexIndexMap.clear();
 
         if (m_pIndexBuffer)
-            m_pIndexBuffer->Release();
+            delete m_pIndexBuffer;
     }
 
     void InsertChunkIndex(unsigned int srcIndex, unsigned int chunkIndex)
@@ -98,18 +98,22 @@ public:
         return m_vertexIndexMap[srcIndex];
     }
 
-    void CreateVertexIndices(LPDIRECT3DDEVICE9 pDevice)
+    void CreateVertexIndices(PDEVICE pDevice)
     {
         if (m_vertexIndexMap.empty() || !pDevice || !m_pSource)
             return;
 
-        D3DFORMAT indexFormat = m_pSource->GetIndexFormat() == IT_32 ? D3DFMT_INDEX32 : D3DFMT_INDEX16;
-        unsigned int indexStride = indexFormat == D3DFMT_INDEX32 ? 4 : 2;
+        if (m_pIndexBuffer)
+        {
+            delete m_pIndexBuffer;
+            m_pIndexBuffer = NULL;
+        }
 
-        pDevice->CreateIndexBuffer(indexStride * m_numVertexIndices, 0, indexFormat, D3DPOOL_MANAGED, &m_pIndexBuffer, NULL);
+        if (FAILED(pDevice->CreateIndexBuffer(m_indexStride * m_numVertexIndices, m_pSource->GetIndexFormat(), &m_pIndexBuffer)))
+            return;
 
         void *pIndicesLocked = NULL;
-        m_pIndexBuffer->Lock(0, 0, (void **)&pIndicesLocked, 0);
+        m_pIndexBuffer->Lock((void **)&pIndicesLocked, 0);
 
         void *pIndicesLockedIndex = pIndicesLocked;
         std::map< unsigned int, std::vector< unsigned int > * >::iterator i = m_vertexIndexMap.begin();
@@ -160,7 +164,7 @@ public:
         return *((unsigned int *)(((char *)m_pChunkIndices) + index * m_indexStride));
     }
 
-    LPDIRECT3DINDEXBUFFER9 GetIndexBuffer() const { return m_pIndexBuffer; }
+    LPDIRECT3DINDEXBUFFER9 GetIndexBuffer() const { return m_pIndexBuffer ? m_pIndexBuffer->GetD3DIndexBuffer() : NULL; }
 
     const unsigned int GetNumChunks() const { return (unsigned int)m_chunks.size(); }
     const unsigned int GetNumChunkIndices() const { return m_numChunkIndices; }
@@ -171,7 +175,7 @@ public:
 
     std::vector<Chunk> m_chunks;
     void *m_pChunkIndices;
-    LPDIRECT3DINDEXBUFFER9 m_pIndexBuffer;
+    DeviceBuffer *m_pIndexBuffer;
 
     // do we need some kind of struct at the chunk level of node chunk map
     std::vector<int> m_newIndices;    //? should we resize an array ourselves each partition?
@@ -205,304 +209,121 @@ private:
     typedef unsigned int ChunkIndex;
 
     typedef std::vector< unsigned int > VertexIndexList;
-    struct _VertexIndexList
-    {
-        _VertexIndexList()
-        { }
 
-        _VertexIndexList(const _VertexIndexList &rhs)
-            : m(rhs.m)
-        { }
-
-        ~_VertexIndexList()
-        { }
-
-        VertexIndexList m;
-
-        const bool IsEmpty() const
-        {
-            return m.empty();
-        }
-
-        void PushBack(const unsigned int val) { m.push_back(val); }
-
-        const size_t Size() const { return m.size(); }
-
-        const unsigned int operator[] (const unsigned int idx) const { return idx >= m.size() ? (size_t)-1 : m[idx]; }
-
-        unsigned int operator[] (const unsigned int idx) { return idx >= m.size() ? (size_t)-1 : m[idx]; }
+    //! One vertex index list of a source chunk. The indices are held by the _NodeChunkMap.
+    struct _ChunkRun
+    {
+        unsigned int source;        /**< Position of pGeometry in the source geometry list. */
+        unsigned int order;         /**< Rendering order of the source chunk. */
+        PGEOMETRY pGeometry;
+        ChunkIndex chunk;           /**< Index of the source chunk in pGeometry. */
+        unsigned int startIndex;    /**< First index of the list in _NodeChunkMap::indices. */
+        unsigned int numIndices;
     };
+    typedef std::vector< _ChunkRun > ChunkRunList;
 
-    typedef std::vector< _VertexIndexList * > IndexSet;
-    struct _IndexSet
+    //! The geometry found within a node. The runs are kept sorted by source, order, geometry and
+    //! chunk, with the lists of a chunk in the order they were made, and all of their indices are
+    //! stored in the one array so that a node costs a fixed number of allocations.
+    struct _NodeChunkMap
     {
-        _IndexSet()
-        { }
-
-        _IndexSet(const _IndexSet &rhs)
-        { }
-
-        IndexSet m;
-
-        ~_IndexSet()
-        {
-            for (IndexSet::iterator i = m.begin(); i != m.end(); i++)
-            {
-                delete *i;
-            }
-        }
+        ChunkRunList runs;
+        VertexIndexList indices;
 
         const bool IsEmpty() const
         {
-            IndexSet::const_iterator i = m.begin();
-            for (; i != m.end(); i++)
-            {
-                if (!(*i)->IsEmpty())
-                    return false;
-            }
-
-            return true;
-        }
-
-        const size_t Size() const { return m.size(); }
-
-        const _VertexIndexList * operator[] (const unsigned int idx) const
-        {
-            if (idx > m.size())
-                return NULL;
-            else
-                return m[idx];
-        }
-
-        _VertexIndexList * operator[] (const unsigned int idx)
-        {
-            if (idx > m.size())
-                return NULL;
-            else
-                return m[idx];
+            return indices.empty();
         }
 
-        const unsigned int Create()
+        void Clear()
         {
-            m.push_back(new _VertexIndexList);
-
-            return (unsigned int)m.size() - 1;
+            runs.clear();
+            indices.clear();
         }
-    };
 
-    typedef std::map< ChunkIndex, _IndexSet * > ChunkIndexList;
-    struct _ChunkIndexList
-    {
-        _ChunkIndexList()
-        { }
-
-        _ChunkIndexList(const _ChunkIndexList &rhs)
-        { }
-
-        ChunkIndexList m;
-
-        ~_ChunkIndexList()
+        //! Starts a new vertex index list for the chunk of run, and returns it.
+        _ChunkRun &CreateRun(const _ChunkRun &run)
         {
-            for (ChunkIndexList::iterator i = m.begin(); i != m.end(); i++)
-            {
-                if (i->second)
-                    delete i->second;
-            }
-        }
+            runs.push_back(run);
+            runs.back().startIndex = (unsigned int)indices.size();
+            runs.back().numIndices = 0;
 
-        const bool IsEmpty() const
-        {
-            ChunkIndexList::const_iterator i = m.begin();
-            for (; i != m.end(); i++)
-            {
-                if (!i->second->IsEmpty())
-                    return false;
-            }
-
-            return true;
+            return runs.back();
         }
 
-        const size_t Size() const { return m.size(); }
-
-        const _IndexSet * operator[] (const ChunkIndex idx) const
+        //! Adds an index to the last run made.
+        void PushBack(const unsigned int val)
         {
-            ChunkIndexList::const_iterator i = m.find(idx);
-            if (i == m.end())
-                return NULL;
-            else
-                return i->second;
+            indices.push_back(val);
+            ++runs.back().numIndices;
         }
 
-        _IndexSet *GetPtr(const ChunkIndex idx)
+        const size_t GetNumBytes() const
         {
-            if (m.find(idx) == m.end())
-            {
-                m[idx] = new _IndexSet;
-            }
-            return m[idx];
+            return runs.capacity() * sizeof(_ChunkRun) + indices.capacity() * sizeof(unsigned int);
         }
     };
 
-    typedef std::map< PGEOMETRY, _ChunkIndexList * > GeometryMap;
-    struct _GeometryMap
+    //! A node whose partitioning has been put off, either for a worker thread or for GenerateLeaf.
+    struct _PartitionTask
     {
-        _GeometryMap()
-        { }
-
-        _GeometryMap(const _GeometryMap &rhs)
-        {
-            GeometryMap::const_iterator i = rhs.m.begin();
-            for (; i != rhs.m.end(); i++)
-            {
-                _ChunkIndexList *pNewCIL = new _ChunkIndexList(*i->second);
-                m[i->first] = pNewCIL;
-            }
-        }
-
-        GeometryMap m;
-
-        ~_GeometryMap()
-        {
-            for (GeometryMap::iterator i = m.begin(); i != m.end(); i++)
-            {
-                if (i->second)
-                    delete i->second;
-            }
-        }
-
-        const bool IsEmpty() const
-        {
-            GeometryMap::const_iterator i = m.begin();
-            for (; i != m.end(); i++)
-            {
-                if (!i->second->IsEmpty())
-                    return false;
-            }
-
-            return true;
-        }
-
-        const size_t Size() const { return m.size(); }
-
-        const _ChunkIndexList *operator[] (const PGEOMETRY idx) const
-        {
-            GeometryMap::const_iterator i = m.find(idx);
-            if (i == m.end())
-                return NULL;
-            else
-                return i->second;
-        }
-
-        _ChunkIndexList *GetPtr(const PGEOMETRY idx)
-        {
-            if (m.find(idx) == m.end())
-            {
-                m[idx] = new _ChunkIndexList;
-            }
-            return m[idx];
-        }
+        TreeNode *pNode;
+        int numSubdivisions;
+        unsigned int numPolygons;
+        _NodeChunkMap *pNodeChunkMap;
     };
+    typedef std::vector< _PartitionTask > PartitionTaskList;
 
-    typedef std::map< unsigned int, _GeometryMap * > OrderedGeometryMap;
-    struct _OrderedGeometryMap
+    //! State of one thread partitioning the world. Leafs are only recorded here; they are
+    //! generated in tree order once every thread has finished, so the result does not depend
+    //! on how the work was shared.
+    struct _PartitionState
     {
-        _OrderedGeometryMap()
+        _PartitionState()
+            : taskDepth(0), pTasks(NULL), maxSubdivisions(0), numChunkMaps(0), numChunkMapBytes(0)
         { }
 
-        _OrderedGeometryMap(const _OrderedGeometryMap &rhs)
-        {
-            OrderedGeometryMap::const_iterator i = rhs.m.begin();
-            for (; i != rhs.m.end(); i++)
-            {
-                _GeometryMap *pNewGM = new _GeometryMap(*i->second);
-                m[i->first] = pNewGM;
-            }
-        }
-
-        OrderedGeometryMap m;
+        int taskDepth;                  /**< Nodes at this depth are put in pTasks rather than partitioned. 0 for none. */
+        PartitionTaskList *pTasks;
+        PartitionTaskList leafs;
+        int maxSubdivisions;
 
-        ~_OrderedGeometryMap()
-        {
-            for (OrderedGeometryMap::iterator i = m.begin(); i != m.end(); i++)
-            {
-                if (i->second)
-                    delete i->second;
-            }
-        }
+        _NodeChunkMap result;           /**< Child geometry is gathered here, then copied to a map of the right size. */
+        _NodeChunkMap remainder[2];     /**< What each child leaves for the next. Reused from node to node. */
 
-        const bool IsEmpty() const
-        {
-            OrderedGeometryMap::const_iterator i = m.begin();
-            for (; i != m.end(); i++)
-            {
-                if (!i->second->IsEmpty())
-                    return false;
-            }
-
-            return true;
-        }
-
-        const size_t Size() const { return m.size(); }
-
-        const _GeometryMap *operator[] (const unsigned int idx) const
-        {
-            OrderedGeometryMap::const_iterator i = m.find(idx);
-            if (i == m.end())
-                return NULL;
-            else
-                return i->second;
-        }
-
-        _GeometryMap *GetPtr(const unsigned int idx)
-        {
-            if (m.find(idx) == m.end())
-            {
-                m[idx] = new _GeometryMap;
-            }
-
-            return m[idx];
-        }
+        unsigned int numChunkMaps;      /**< Number of node chunk maps made. */
+        unsigned int numChunkMapBytes;  /**< Total size of the node chunk maps made. */
     };
 
-    typedef std::vector< _OrderedGeometryMap * > NodeChunkMap;
-    struct _NodeChunkMap
+    //! A worker thread's share of the partition. Tasks are taken from pTasks in turn until none are left.
+    struct _PartitionJob
     {
-        _NodeChunkMap()
-        { }
-
-        _NodeChunkMap(const _NodeChunkMap &rhs)
-        {
-            NodeChunkMap::const_iterator i = rhs.m.begin();
-            for (; i != rhs.m.end(); i++)
-            {
-                _OrderedGeometryMap *pNewOGM = new _OrderedGeometryMap(*(*i));
-                m.push_back(pNewOGM);
-            }
-        }
+        Scene *pScene;
+        PartitionTaskList *pTasks;
+        LONG *pNextTask;
+        _PartitionState state;
+    };
 
-        ~_NodeChunkMap()
-        {
-            for (NodeChunkMap::iterator i = m.begin(); i != m.end(); i++)
-            {
-                if (*i)
-                    delete *i;
-            }
-        }
+    //! A worker thread's share of the PVS. Clusters are taken from pClusters in turn until none are left.
+    //! Each thread only fills in the leafs after the cluster's own, the rest are mirrored once all are done.
+    struct _PVSJob
+    {
+        Scene *pScene;
+        std::vector< byte * > *pClusters;
+        LONG *pNextCluster;
+        LONG *pNumPairsDone;                        /**< Leaf pairs tested so far, by every thread. */
 
-        const bool IsEmpty() const
-        {
-            NodeChunkMap::const_iterator i = m.begin();
-            for (; i != m.end(); i++)
-            {
-                if (!(*i)->IsEmpty())
-                    return false;
-            }
-
-            return true;
-        }
+        ProgressCallbackFunc progressCallbackFunc;  /**< Only set for the job run on the calling thread. */
+        void *pProgressCallbackPayload;
+    };
 
-        NodeChunkMap m;
+    //! Source geometry data, locked for the whole partition so that threads can share it.
+    struct _LockedGeometry
+    {
+        Chunk *pChunks;
+        PVOID pVerts;
     };
+    typedef std::map< PGEOMETRY, _LockedGeometry > LockedGeometryMap;
 
     // datatypes for optimisation
     typedef std::vector< unsigned int > ChunkIndices;
@@ -529,7 +350,12 @@ public:
     //typedef GeometryList::const_iterator ConstGeometryIterator;
     typedef GeometryList::const_iterator ConstGeometryIterator;
 
-    Scene(PSCENESETTINGS pSettings, LPDIRECT3DDEVICE9 pDevice, PRESOURCEMANAGER pResourceManager);
+    //! \brief Constructor
+    /*! \param pSettings [in] Pointer to the scene settings.
+        \param pDevice [in] Pointer to the Device geometry buffers are created on. A NullDevice allows the
+               scene to be partitioned, culled and ray tested without a Direct3D device.
+        \param pResourceManager [in] Pointer to the resource manager holding the scene's effects and visuals. */
+    Scene(PSCENESETTINGS pSettings, PDEVICE pDevice, PRESOURCEMANAGER pResourceManager);
     ~Scene();
 
     HRESULT InsertGeometry(PGEOMETRY pGeometry);
@@ -585,6 +411,11 @@ public:
     /*! Returns S_OK on success and E_FAIL on failure.*/
     HRESULT SubdivideWorld();
 
+    //! Sets the function used to generate the potential visibility set
+    /*! The function is called by SubdivideWorld() when the visibility mode is SS_ENABLED, and defaults to GeneratePVS().
+        It is passed this scene, and must fill the vector with one cluster per leaf, each a bitset with bit n set if
+        leaf n may be visible from the leaf. Clusters are allocated with new[], and the scene takes them over.
+        Returns S_OK on success and E_FAIL on failure.*/
     HRESULT SetPVSGeneratorCallback(PVSGeneratorCallbackFunc pvsGeneratorCallbackFunc);
 
     HRESULT SetProgressCallbackPayload(void *pPayload);
@@ -615,9 +446,31 @@ public:
 
     HRESULT SetProgressCallback(ProgressCallbackFunc progressCallbackFunc, void *pPayload);
 
-    bool Intersect(IntersectionResult &result, const Vector3 &rayPos, const Vector3 &rayDir, DWORD flags);
+    //! \brief Finds the nearest intersection of a ray with the scene geometry.
+    /*! Returns true if the ray hits anything. The geometry is tested in the order the ray enters
+        its bounds, and each is searched with its own TriangleBVH.
+        \param result [out] The nearest hit, or with IF_ANYHIT in flags, the first hit found.
+        \param rayPos Origin of the ray.
+        \param rayDir Direction of the ray. Distances are in multiples of its length.
+        \param flags INTERSECTFLAGS.
+        \param maxDistance Only hits nearer than this are found. With IF_ANYHIT, set it to the distance
+               that matters, such as 1.0f to test the segment from rayPos to rayPos + rayDir. */
+    bool Intersect(IntersectionResult &result, const Vector3 &rayPos, const Vector3 &rayDir, DWORD flags, float maxDistance = FLT_MAX);
+
+    //! \brief Finds every intersection of a ray with the scene geometry.
+    /*! Returns true if the ray hits anything. The hits are added to the end of results, nearest first. */
     bool Intersect(std::list<IntersectionResult> &results, const Vector3 &rayPos, const Vector3 &rayDir, DWORD flags);
 
+    //! \brief Finds every intersection of a ray with the scene geometry.
+    /*! Returns true if the ray hits anything. The hits are added to the end of results, nearest first. */
+    bool Intersect(std::vector<IntersectionResult> &results, const Vector3 &rayPos, const Vector3 &rayDir, DWORD flags);
+
+    //! \brief Finds the nearest intersection of each of a number of rays with the scene geometry.
+    /*! Returns the number of rays that hit anything. results is resized to numRays, and entry i holds
+        the hit of pRays[i], with m_pGeometry NULL if it missed. Only hits nearer than maxDistance are found. */
+    unsigned int IntersectRays(std::vector<IntersectionResult> &results, const Math::Ray *pRays, unsigned int numRays, DWORD flags,
+                               float maxDistance = FLT_MAX);
+
     void SetLightID(unsigned int index, int lightID) { if (index < 8) m_lightIDs[index] = lightID; }
 
     //! Updates Redraw state
@@ -647,6 +500,9 @@ public:
 
     const int GetLightID(unsigned int index) const { return index < 8 ? m_lightIDs[index] : -1; }
 
+    //! The default PVS generator. pData is the Scene.
+    /*! Leafs are taken to be visible from each other if any of a number of sight lines between them is clear
+        of the scene geometry. The leaf pairs are shared between the worker threads. */
     static void GeneratePVS(void *pData, std::vector< byte * > *pResults, ProgressCallbackFunc, void *);
 
 private:
@@ -654,10 +510,17 @@ private:
     void Clear();
     void Init();
 
-    void Partition(TreeNode *node, int numSubdivisions, _NodeChunkMap *pNodeChunkMap, _NodeChunkMap *pRemainderNodeChunkMap, unsigned int numPolygons = 0);
+    void Partition(TreeNode *node, int numSubdivisions, _NodeChunkMap *pNodeChunkMap, unsigned int numPolygons, _PartitionState &state);
+    bool CreateChildNodeChunkMap(TreeNode *pChild, _NodeChunkMap *pNodeChunkMap, _NodeChunkMap *pRemainder,
+                                 _PartitionState &state, _NodeChunkMap **ppResult, unsigned int *pNumPolygons);
+    void RecurseGeneratePartitionLeafs(TreeNode *node, std::map< TreeNode *, _NodeChunkMap * > &leafs);
+    static void PartitionJob(void *pParam);
+    bool LockSourceGeometry();
+    void UnlockSourceGeometry();
     _NodeChunkMap *CreateNodeChunkMap(unsigned int *pNumPolygons);
-    _NodeChunkMap *CreateNodeChunkMap(_NodeChunkMap *pNodeChunkMap, _NodeChunkMap *pRemainder,
-                                      const Math::AABB &bounds, unsigned int *pNumPolygons);
+    _NodeChunkMap *CreateNodeChunkMap(const _NodeChunkMap *pNodeChunkMap, _NodeChunkMap *pRemainder,
+                                      const Math::AABB &bounds, _PartitionState &state, unsigned int *pNumPolygons);
+    static void SortChunkRuns(ChunkRunList &runs);
 
     void GenerateLeaf(TreeNode *pNode, _NodeChunkMap *NodeChunkMap);
     void GenerateLeafs(TreeNode *node, std::map< PGEOMETRY, Chunk * > &srcChunks,
@@ -673,10 +536,16 @@ private:
     bool OptimiseByTexture(const unsigned int chunkIndex, const Chunk &chunk, ChunkIndices &chunkMap);
 
     bool   TestVisibilityLeaf(TreeLeaf *origin, TreeLeaf *target);
+    static void PVSJob(void *pParam);
+    void CompressPVS(const std::vector< byte * > &clusters);
+    static unsigned int CompressPVSCluster(const byte *pCluster, unsigned int numBytes, byte *pCompressed);
+    static void DecompressPVSCluster(const byte *pCompressed, unsigned int compressedLength, unsigned int numBytes, byte *pCluster);
+    int FindLeaf(const Vector3 &point);
     bool   TestVisibility(TreeLeaf *target, Matrix frustum);
     Matrix CreateVisibilityFrustum(TreeLeaf *origin, Vector3 forward, Vector3 up);
 
-    void CreateNodeRenderList(TreeNode *node, std::vector<RenderGroup> &renderList, PVIEWPORT pViewport);
+    void CreateNodeRenderList(TreeNode *node, std::vector<RenderGroup> &renderList, PVIEWPORT pViewport, const byte *pVisibleLeafs = NULL,
+                              DWORD planeMask = Math::FRUSTUM_ALL_PLANES);
     void CreateLeafRenderList(TreeLeaf *leaf, std::vector<RenderGroup> &renderList);
     void CreateEntityRenderList(PENTITY entity, std::vector<RenderGroup> &renderList, PVIEWPORT pViewport);
 
@@ -687,8 +556,7 @@ private:
     void RecurseSphereCollisionPartition(TreeNode *node, Math::Sphere sphere1, Math::Sphere sphere2, std::vector<TreeLeaf *> &leafs, std::vector<TreeLeaf *> &collidingLeafs);
     void RecursePVS(TreeNode *node, TreeLeaf *leaf);
     void RecursePVSSetOccluded(TreeNode *node, int leafIndex, Matrix occlusionFrustum);
-    bool RecurseTestIntersect(TreeNode *node, std::list<IntersectionResult> &results,
-                              const Vector3 &rayPos, const Vector3 &rayDir, DWORD flags, bool findFirst);
+    void GetRayGeometry(std::vector< std::pair<float, PGEOMETRY> > &geometry, const Vector3 &rayPos, const Vector3 &rayDir);
 
 #ifdef _DEBUG
     void DumpNodeChunkMap(const _NodeChunkMap *pNodeChunkMap, const unsigned int index) const;
@@ -699,6 +567,7 @@ private:
 
 private:
     ProgressCallbackFunc m_pFnProgressCallback;
+    PVSGeneratorCallbackFunc m_pFnPVSGeneratorCallback;
     void *m_pProgressCallbackPayload;
     float m_spacePartitionProgress,
           m_optimiseChunksProgress,
@@ -706,7 +575,7 @@ private:
 
     PSCENESETTINGS m_pSettings;
 
-    LPDIRECT3DDEVICE9 m_pD3DDevice;
+    PDEVICE              m_pDevice;
     PRESOURCEMANAGER  m_pResourceManager;
 
     int m_subdivisionsExecuted,
@@ -716,7 +585,8 @@ private:
     int m_numClusters,
         m_bytesPerCluster;
     //byte *PVS;
-    std::vector< byte * > m_PVS;
+    std::vector< byte * > m_PVS;        /**< One cluster per leaf, run length compressed, m_bytesPerCluster bytes each. */
+    std::vector< byte > m_visibleLeafs; /**< The cluster of the camera's leaf, decompressed while creating a render list. */
 
     int m_lightIDs[8];
 
@@ -727,6 +597,7 @@ private:
 
     GeometryList m_sourceGeometry;
     OptimisedGeometryMap m_optimisedGeometry;
+    LockedGeometryMap m_lockedGeometry;
 
     PGEOMETRY m_pSpacePartitionOutline;
 
@@ -116,7 +116,7 @@ public:
 
     OutputTreeNode *nodes;
     OutputTreeLeaf *leafs;
-    byte *PVS;
+    byte *PVS;                  /**< One run length compressed cluster per leaf, each padded to bytesPerPVSCluster. */
 
     unsigned int *pGeometryIDs;
     unsigned int spacePartitionGeometryID;
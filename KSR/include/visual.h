@@ -25,7 +25,7 @@ public:
     //typedef GeometryList::const_iterator ConstGeometryIterator;
     typedef GeometryList::const_iterator ConstGeometryIterator;
 
-    Visual(LPDIRECT3DDEVICE9 pDevice, PRESOURCEMANAGER pResourceManager);
+    Visual(PDEVICE pDevice, PRESOURCEMANAGER pResourceManager);
     ~Visual();
 
     //! \brief Clears this Visual of Geometry and Sprites
@@ -82,7 +82,7 @@ private:
 
     PGEOMETRY m_pOutline;
 
-    LPDIRECT3DDEVICE9 m_pD3DDevice;
+    PDEVICE m_pDevice;
     PRESOURCEMANAGER m_pResourceManager;
 };
 
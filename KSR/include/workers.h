@@ -0,0 +1,28 @@
+/*! \file */
+/*-----------------------------------------------------------------------
+    workers.h
+
+    Description: Fork/join helper used to spread scene builds over the processors
+    ---------------------------------------------------------------------*/
+
+#pragma once
+
+const int MAX_WORKER_THREADS = 32;    //!< Upper limit on the number of workers RunWorkers() will start.
+
+//! \typedef WorkerFunc
+/*! Function run by RunWorkers(). pParam is one of the entries of the ppParams array. */
+typedef void (*WorkerFunc)(void *pParam);
+
+//! \brief Returns the number of workers worth starting on this machine.
+/*! This is the number of processors, clamped to 1 to MAX_WORKER_THREADS. */
+int GetNumWorkers();
+
+//! \brief Calls func once for each entry in ppParams, in parallel, and waits for them all.
+/*! The last entry is run on the calling thread. If a thread cannot be created, its entry
+    is also run on the calling thread, so every entry is always processed.
+    \param func Function to run.
+    \param ppParams [in] Array of numParams parameters, one for each call of func.
+    \param numParams Number of calls to make. */
+void RunWorkers(WorkerFunc func, void **ppParams, int numParams);
+
+// EOF
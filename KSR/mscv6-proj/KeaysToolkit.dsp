@@ -137,10 +137,18 @@ LIB32=link.exe -lib
 # PROP Default_Filter "cpp;c;cxx;rc;def;r;odl;idl;hpj;bat"
 # Begin Source File
 
+SOURCE=.\bvh.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\camera.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\device.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\entity.cpp
 # End Source File
 # Begin Source File
@@ -203,6 +211,10 @@ SOURCE=.\viewport.cpp
 
 SOURCE=.\visual.cpp
 # End Source File
+# Begin Source File
+
+SOURCE=.\workers.cpp
+# End Source File
 # End Group
 # Begin Group "Header Files"
 
@@ -213,10 +225,18 @@ SOURCE=.\base.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\bvh.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\camera.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\device.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\entity.h
 # End Source File
 # Begin Source File
@@ -295,6 +315,10 @@ SOURCE=.\viewport.h
 
 SOURCE=.\visual.h
 # End Source File
+# Begin Source File
+
+SOURCE=.\workers.h
+# End Source File
 # End Group
 # End Target
 # End Project
@@ -0,0 +1,477 @@
+#include "../include/ksr.h"
+
+#include "../include/leakwatcher.h"
+
+#ifdef _DO_MEMORY_DEBUG
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+using namespace KSR;
+
+namespace
+{
+    // Number of buckets the centroids are sorted into along each axis when looking for a split.
+    const int NUM_SAH_BINS = 16;
+
+    float SurfaceArea(const Vector3 &min, const Vector3 &max)
+    {
+        Vector3 d = max - min;
+
+        return d.x * d.y + d.y * d.z + d.z * d.x;
+    }
+
+    void IncludeBox(Vector3 &min, Vector3 &max, const Vector3 &boxMin, const Vector3 &boxMax)
+    {
+        if (boxMin.x < min.x) min.x = boxMin.x;
+        if (boxMin.y < min.y) min.y = boxMin.y;
+        if (boxMin.z < min.z) min.z = boxMin.z;
+
+        if (boxMax.x > max.x) max.x = boxMax.x;
+        if (boxMax.y > max.y) max.y = boxMax.y;
+        if (boxMax.z > max.z) max.z = boxMax.z;
+    }
+
+    float SafeInverse(float value)
+    {
+        if (fabsf(value) > 1e-20f)
+            return 1.0f / value;
+
+        return value < 0.0f ? -1e30f : 1e30f;
+    }
+
+    // Slab test. pEntry is the distance along the ray at which it enters the box.
+    bool RayNodeIntersection(const BVHNode &node, const Vector3 &rayPos, const Vector3 &invDir, float maxDistance, float *pEntry)
+    {
+        float t0 = (node.min.x - rayPos.x) * invDir.x;
+        float t1 = (node.max.x - rayPos.x) * invDir.x;
+
+        float tMin = t0 < t1 ? t0 : t1;
+        float tMax = t0 < t1 ? t1 : t0;
+
+        t0 = (node.min.y - rayPos.y) * invDir.y;
+        t1 = (node.max.y - rayPos.y) * invDir.y;
+
+        if (t0 > t1)
+            std::swap(t0, t1);
+
+        if (t0 > tMin) tMin = t0;
+        if (t1 < tMax) tMax = t1;
+
+        t0 = (node.min.z - rayPos.z) * invDir.z;
+        t1 = (node.max.z - rayPos.z) * invDir.z;
+
+        if (t0 > t1)
+            std::swap(t0, t1);
+
+        if (t0 > tMin) tMin = t0;
+        if (t1 < tMax) tMax = t1;
+
+        // Widen the exit distance by a few ulps, so that rays grazing a corner or edge of the
+        // box are not lost to rounding when the triangle test would accept them
+        tMax *= 1.0000004f;
+
+        if (tMax < 0.0f || tMin > tMax || tMin > maxDistance)
+            return false;
+
+        *pEntry = tMin;
+
+        return true;
+    }
+
+    // Moller-Trumbore, giving the same u, v and distance as D3DXIntersectTri.
+    bool RayTriangleIntersection(const BVHTriangle &tri, const Vector3 &rayPos, const Vector3 &rayDir, float *pU, float *pV, float *pDistance)
+    {
+        Vector3 p;
+        D3DXVec3Cross(&p, &rayDir, &tri.edge2);
+
+        float det = D3DXVec3Dot(&tri.edge1, &p);
+
+        if (fabsf(det) < 1e-12f)
+            return false;
+
+        float invDet = 1.0f / det;
+
+        Vector3 t = rayPos - tri.v0;
+
+        float u = D3DXVec3Dot(&t, &p) * invDet;
+
+        if (u < 0.0f || u > 1.0f)
+            return false;
+
+        Vector3 q;
+        D3DXVec3Cross(&q, &t, &tri.edge1);
+
+        float v = D3DXVec3Dot(&rayDir, &q) * invDet;
+
+        if (v < 0.0f || u + v > 1.0f)
+            return false;
+
+        float distance = D3DXVec3Dot(&tri.edge2, &q) * invDet;
+
+        if (distance < 0.0f)
+            return false;
+
+        *pU = u;
+        *pV = v;
+        *pDistance = distance;
+
+        return true;
+    }
+}
+
+
+//-----------------------------------------------------------------------
+    TriangleBVH::TriangleBVH()
+    //-------------------------------------------------------------------
+    {
+    }
+
+
+//-----------------------------------------------------------------------
+    TriangleBVH::~TriangleBVH()
+    //-------------------------------------------------------------------
+    {
+        Clear();
+    }
+
+
+//-----------------------------------------------------------------------
+    void TriangleBVH::Clear()
+    //-------------------------------------------------------------------
+    {
+        std::vector<BVHNode>().swap(m_nodes);
+        std::vector<BVHTriangle>().swap(m_triangles);
+    }
+
+
+//-----------------------------------------------------------------------
+    void TriangleBVH::Build(std::vector<BVHTriangle> &triangles)
+    //-------------------------------------------------------------------
+    {
+        Clear();
+
+        if (triangles.empty())
+            return;
+
+        unsigned int numTriangles = (unsigned int)triangles.size();
+
+        std::vector<Math::AABB> bounds(numTriangles);
+        std::vector<Vector3> centroids(numTriangles);
+
+        m_order.resize(numTriangles);
+
+        unsigned int t;
+        for (t = 0; t < numTriangles; t++)
+        {
+            const BVHTriangle &tri = triangles[t];
+
+            Vector3 v1 = tri.v0 + tri.edge1;
+            Vector3 v2 = tri.v0 + tri.edge2;
+
+            Math::AABB &box = bounds[t];
+            box.min = box.max = tri.v0;
+
+            IncludeBox(box.min, box.max, v1, v1);
+            IncludeBox(box.min, box.max, v2, v2);
+
+            centroids[t] = (box.min + box.max) * 0.5f;
+            m_order[t] = t;
+        }
+
+        // A binary tree over n triangles has at most 2n - 1 nodes
+        m_nodes.reserve(numTriangles * 2);
+        m_nodes.resize(1);
+
+        BuildNode(0, 0, numTriangles, 0, bounds, centroids);
+
+        // Store the triangles in leaf order
+        m_triangles.resize(numTriangles);
+
+        for (t = 0; t < numTriangles; t++)
+            m_triangles[t] = triangles[m_order[t]];
+
+        triangles.clear();
+        std::vector<unsigned int>().swap(m_order);
+    }
+
+
+//-----------------------------------------------------------------------
+    void TriangleBVH::BuildNode(unsigned int nodeIndex, unsigned int first, unsigned int count, int depth,
+                                const std::vector<Math::AABB> &bounds, const std::vector<Vector3> &centroids)
+    //-------------------------------------------------------------------
+    {
+        Vector3 nodeMin = bounds[m_order[first]].min;
+        Vector3 nodeMax = bounds[m_order[first]].max;
+        Vector3 centroidMin = centroids[m_order[first]];
+        Vector3 centroidMax = centroidMin;
+
+        unsigned int i;
+        for (i = first + 1; i < first + count; i++)
+        {
+            IncludeBox(nodeMin, nodeMax, bounds[m_order[i]].min, bounds[m_order[i]].max);
+            IncludeBox(centroidMin, centroidMax, centroids[m_order[i]], centroids[m_order[i]]);
+        }
+
+        m_nodes[nodeIndex].min = nodeMin;
+        m_nodes[nodeIndex].max = nodeMax;
+        m_nodes[nodeIndex].first = first;
+        m_nodes[nodeIndex].count = count;
+
+        if (count <= 2 || depth >= MAX_BVH_DEPTH)
+            return;
+
+        // Find the cheapest split by the surface area heuristic, binning the triangles by centroid
+            int bestAxis = -1;
+            int bestBin = 0;
+            float bestCost = FLT_MAX;
+
+            int axis;
+            for (axis = 0; axis < 3; axis++)
+            {
+                float extent = centroidMax[axis] - centroidMin[axis];
+
+                if (extent <= 0.0f)
+                    continue;
+
+                float scale = NUM_SAH_BINS / extent;
+
+                unsigned int binCounts[NUM_SAH_BINS];
+                Vector3 binMin[NUM_SAH_BINS], binMax[NUM_SAH_BINS];
+
+                int b;
+                for (b = 0; b < NUM_SAH_BINS; b++)
+                {
+                    binCounts[b] = 0;
+                    binMin[b] = Vector3(FLT_MAX, FLT_MAX, FLT_MAX);
+                    binMax[b] = Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+                }
+
+                for (i = first; i < first + count; i++)
+                {
+                    b = (int)((centroids[m_order[i]][axis] - centroidMin[axis]) * scale);
+
+                    if (b >= NUM_SAH_BINS)
+                        b = NUM_SAH_BINS - 1;
+
+                    ++binCounts[b];
+                    IncludeBox(binMin[b], binMax[b], bounds[m_order[i]].min, bounds[m_order[i]].max);
+                }
+
+                // Sweep from the right, then from the left, to cost each split between bins
+                float rightCosts[NUM_SAH_BINS];
+                unsigned int rightCount = 0;
+                Vector3 rightMin(FLT_MAX, FLT_MAX, FLT_MAX), rightMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+                for (b = NUM_SAH_BINS - 1; b > 0; b--)
+                {
+                    rightCount += binCounts[b];
+                    IncludeBox(rightMin, rightMax, binMin[b], binMax[b]);
+
+                    rightCosts[b] = rightCount ? rightCount * SurfaceArea(rightMin, rightMax) : 0.0f;
+                }
+
+                unsigned int leftCount = 0;
+                Vector3 leftMin(FLT_MAX, FLT_MAX, FLT_MAX), leftMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+                for (b = 0; b < NUM_SAH_BINS - 1; b++)
+                {
+                    leftCount += binCounts[b];
+                    IncludeBox(leftMin, leftMax, binMin[b], binMax[b]);
+
+                    if (leftCount == 0 || leftCount == count)
+                        continue;
+
+                    float cost = leftCount * SurfaceArea(leftMin, leftMax) + rightCosts[b + 1];
+
+                    if (cost < bestCost)
+                    {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestBin = b;
+                    }
+                }
+            }
+
+        // Split, unless a leaf is cheaper and small enough
+            unsigned int leftCount = 0;
+
+            if (bestAxis < 0)
+            {
+                // The centroids all coincide, so just halve the triangles
+                if (count <= (unsigned int)MAX_BVH_LEAF_TRIANGLES)
+                    return;
+
+                leftCount = count / 2;
+            }
+            else
+            {
+                if (bestCost >= count * SurfaceArea(nodeMin, nodeMax) && count <= (unsigned int)MAX_BVH_LEAF_TRIANGLES)
+                    return;
+
+                float scale = NUM_SAH_BINS / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+
+                unsigned int left = first;
+                unsigned int right = first + count;
+
+                while (left < right)
+                {
+                    int b = (int)((centroids[m_order[left]][bestAxis] - centroidMin[bestAxis]) * scale);
+
+                    if (b >= NUM_SAH_BINS)
+                        b = NUM_SAH_BINS - 1;
+
+                    if (b <= bestBin)
+                    {
+                        ++left;
+                    }
+                    else
+                    {
+                        --right;
+                        std::swap(m_order[left], m_order[right]);
+                    }
+                }
+
+                leftCount = left - first;
+            }
+
+            unsigned int child = (unsigned int)m_nodes.size();
+            m_nodes.resize(child + 2);
+
+            m_nodes[nodeIndex].first = child;
+            m_nodes[nodeIndex].count = 0;
+
+            BuildNode(child, first, leftCount, depth + 1, bounds, centroids);
+            BuildNode(child + 1, first + leftCount, count - leftCount, depth + 1, bounds, centroids);
+    }
+
+
+//-----------------------------------------------------------------------
+    bool TriangleBVH::Intersect(std::vector<BVHHit> &hits, const Vector3 &rayPos, const Vector3 &rayDir,
+                                DWORD typeFlags, BVHQUERYMODE mode, float maxDistance) const
+    //-------------------------------------------------------------------
+    {
+        if (m_nodes.empty())
+            return false;
+
+        Vector3 invDir(SafeInverse(rayDir.x), SafeInverse(rayDir.y), SafeInverse(rayDir.z));
+
+        // Only hits nearer than this are of interest. It is left at maxDistance when finding every hit.
+        float nearest = maxDistance;
+
+        BVHHit best;
+        bool found = false;
+
+        float entry = 0.0f;
+
+        if (!RayNodeIntersection(m_nodes[0], rayPos, invDir, nearest, &entry))
+            return false;
+
+        // The far child of each node visited is put off here, with the distance at which the ray enters it
+        unsigned int stack[MAX_BVH_DEPTH + 1];
+        float stackEntry[MAX_BVH_DEPTH + 1];
+        int stackSize = 0;
+
+        unsigned int nodeIndex = 0;
+
+        for (;;)
+        {
+            const BVHNode &node = m_nodes[nodeIndex];
+
+            if (node.count > 0)
+            {
+                for (unsigned int t = node.first; t < node.first + node.count; t++)
+                {
+                    const BVHTriangle &tri = m_triangles[t];
+
+                    if (!(tri.typeFlag & typeFlags))
+                        continue;
+
+                    BVHHit hit;
+                    hit.triangle = t;
+
+                    if (!RayTriangleIntersection(tri, rayPos, rayDir, &hit.u, &hit.v, &hit.distance))
+                        continue;
+
+                    if (hit.distance >= nearest)
+                        continue;
+
+                    found = true;
+
+                    if (mode == BQM_ALL)
+                    {
+                        hits.push_back(hit);
+                    }
+                    else
+                    {
+                        nearest = hit.distance;
+                        best = hit;
+
+                        if (mode == BQM_ANY)
+                        {
+                            hits.push_back(best);
+
+                            return true;
+                        }
+                    }
+                }
+            }
+            else
+            {
+                float entry0 = 0.0f, entry1 = 0.0f;
+
+                bool hit0 = RayNodeIntersection(m_nodes[node.first], rayPos, invDir, nearest, &entry0);
+                bool hit1 = RayNodeIntersection(m_nodes[node.first + 1], rayPos, invDir, nearest, &entry1);
+
+                if (hit0 && hit1)
+                {
+                    if (entry0 <= entry1)
+                    {
+                        stack[stackSize] = node.first + 1;
+                        stackEntry[stackSize] = entry1;
+                        nodeIndex = node.first;
+                    }
+                    else
+                    {
+                        stack[stackSize] = node.first;
+                        stackEntry[stackSize] = entry0;
+                        nodeIndex = node.first + 1;
+                    }
+
+                    ++stackSize;
+                    continue;
+                }
+
+                if (hit0 || hit1)
+                {
+                    nodeIndex = hit0 ? node.first : node.first + 1;
+                    continue;
+                }
+            }
+
+            // Take the nearest node put off, skipping those that are behind the nearest hit
+            bool next = false;
+
+            while (stackSize > 0 && !next)
+            {
+                --stackSize;
+
+                if (stackEntry[stackSize] <= nearest)
+                {
+                    nodeIndex = stack[stackSize];
+                    next = true;
+                }
+            }
+
+            if (!next)
+                break;
+        }
+
+        if (found && mode != BQM_ALL)
+            hits.push_back(best);
+
+        return found;
+    }
+
+// EOF
@@ -341,6 +341,10 @@ using namespace KSR;
                                         m_frustum._24 + m_frustum._23,
                                         m_frustum._34 + m_frustum._33,
                                         m_frustum._44 + m_frustum._43);
+
+        // Normalised so that plane distances are true distances, as the sphere test needs
+        for (int i = 0; i < 6; i++)
+            D3DXPlaneNormalize(&m_frustumPlanes[i], &m_frustumPlanes[i]);
     }
 
 
@@ -356,7 +360,25 @@ using namespace KSR;
     bool Camera::CheckBoxFrustum(const Vector3 &min, const Vector3 &max) const
     //-----------------------------------------------------------------
     {
-        return Math::AABBFrustumCollision(Math::AABB(min, max), m_frustumPlanes);
+        DWORD planeMask = Math::FRUSTUM_ALL_PLANES;
+
+        return CullBox((min + max) * 0.5f, (max - min) * 0.5f, &planeMask) != Math::IS_NONE;
+    }
+
+
+//---------------------------------------------------------------------
+    Math::INTERSECTIONSTATE Camera::CullBox(const Vector3 &centre, const Vector3 &extent, DWORD *pPlaneMask) const
+    //-----------------------------------------------------------------
+    {
+        return Math::AABBFrustumIntersection(centre, extent, m_frustumPlanes, pPlaneMask);
+    }
+
+
+//---------------------------------------------------------------------
+    void Camera::CullBoxes(const Math::BoxBatch &boxes, DWORD planeMask, DWORD *pPlaneMasks) const
+    //-----------------------------------------------------------------
+    {
+        Math::AABBFrustumIntersection(boxes, m_frustumPlanes, planeMask, pPlaneMasks);
     }
 
 
@@ -366,14 +388,11 @@ using namespace KSR;
     {
         for (int i = 0; i < 6; i++)
         {
-            //float d = D3DXVec3Dot(&D3DXVECTOR3(frustumPlanes[i].x, frustumPlanes[i].y, frustumPlanes[i].z), &position);
-            float d = 0;
+            float d = m_frustumPlanes[i].a * position.x + m_frustumPlanes[i].b * position.y +
+                      m_frustumPlanes[i].c * position.z + m_frustumPlanes[i].d;
 
             if (d < -radius)
                 return false;
-
-            if ((float)fabs(d) < radius)
-                return true;
         }
 
         return true;
@@ -0,0 +1,166 @@
+#include "../include/ksr.h"
+
+#include "../include/leakwatcher.h"
+
+#ifdef _DO_MEMORY_DEBUG
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+using namespace KSR;
+
+namespace
+{
+    //! Managed Direct3D 9 vertex buffer.
+    struct D3D9VertexBuffer : public DeviceBuffer
+    {
+    public:
+        D3D9VertexBuffer(LPDIRECT3DVERTEXBUFFER9 pBuffer, unsigned int length) : m_pBuffer(pBuffer), m_length(length) {}
+        ~D3D9VertexBuffer() { m_pBuffer->Release(); }
+
+        HRESULT Lock(void **ppData, DWORD flags) { return m_pBuffer->Lock(0, 0, ppData, flags); }
+        HRESULT Unlock() { return m_pBuffer->Unlock(); }
+
+        const unsigned int GetLength() const { return m_length; }
+
+        LPDIRECT3DVERTEXBUFFER9 GetD3DVertexBuffer() { return m_pBuffer; }
+
+    private:
+        LPDIRECT3DVERTEXBUFFER9 m_pBuffer;
+        unsigned int m_length;
+    };
+
+    //! Managed Direct3D 9 index buffer.
+    struct D3D9IndexBuffer : public DeviceBuffer
+    {
+    public:
+        D3D9IndexBuffer(LPDIRECT3DINDEXBUFFER9 pBuffer, unsigned int length) : m_pBuffer(pBuffer), m_length(length) {}
+        ~D3D9IndexBuffer() { m_pBuffer->Release(); }
+
+        HRESULT Lock(void **ppData, DWORD flags) { return m_pBuffer->Lock(0, 0, ppData, flags); }
+        HRESULT Unlock() { return m_pBuffer->Unlock(); }
+
+        const unsigned int GetLength() const { return m_length; }
+
+        LPDIRECT3DINDEXBUFFER9 GetD3DIndexBuffer() { return m_pBuffer; }
+
+    private:
+        LPDIRECT3DINDEXBUFFER9 m_pBuffer;
+        unsigned int m_length;
+    };
+
+    //! Vertex or index buffer in system memory, used by NullDevice.
+    struct SystemMemoryBuffer : public DeviceBuffer
+    {
+    public:
+        SystemMemoryBuffer(void *pData, unsigned int length) : m_pData(pData), m_length(length) {}
+        ~SystemMemoryBuffer() { free(m_pData); }
+
+        HRESULT Lock(void **ppData, DWORD flags)
+        {
+            if (!ppData)
+                return E_FAIL;
+
+            *ppData = m_pData;
+
+            return S_OK;
+        }
+
+        HRESULT Unlock() { return S_OK; }
+
+        const unsigned int GetLength() const { return m_length; }
+
+    private:
+        void *m_pData;
+        unsigned int m_length;
+    };
+}
+
+
+//-----------------------------------------------------------------------
+    HRESULT D3D9Device::CreateVertexBuffer(unsigned int length, DWORD FVF, DeviceBuffer **ppBuffer)
+    //-------------------------------------------------------------------
+    {
+        if (!m_pD3DDevice || !ppBuffer)
+            return E_FAIL;
+
+        LPDIRECT3DVERTEXBUFFER9 pBuffer = NULL;
+
+        if (FAILED(m_pD3DDevice->CreateVertexBuffer(length, 0, FVF, D3DPOOL_MANAGED, &pBuffer, NULL)))
+            return E_FAIL;
+
+        *ppBuffer = new D3D9VertexBuffer(pBuffer, length);
+
+        return S_OK;
+    }
+
+
+//-----------------------------------------------------------------------
+    HRESULT D3D9Device::CreateIndexBuffer(unsigned int length, DWORD indexType, DeviceBuffer **ppBuffer)
+    //-------------------------------------------------------------------
+    {
+        if (!m_pD3DDevice || !ppBuffer)
+            return E_FAIL;
+
+        LPDIRECT3DINDEXBUFFER9 pBuffer = NULL;
+
+        D3DFORMAT indexD3DFormat = indexType == IT_16 ? D3DFMT_INDEX16 : D3DFMT_INDEX32;
+
+        if (FAILED(m_pD3DDevice->CreateIndexBuffer(length, 0, indexD3DFormat, D3DPOOL_MANAGED, &pBuffer, NULL)))
+            return E_FAIL;
+
+        *ppBuffer = new D3D9IndexBuffer(pBuffer, length);
+
+        return S_OK;
+    }
+
+
+//-----------------------------------------------------------------------
+    HRESULT D3D9Device::CreateVertexDeclaration(const D3DVERTEXELEMENT9 *pElements, LPDIRECT3DVERTEXDECLARATION9 *ppDeclaration)
+    //-------------------------------------------------------------------
+    {
+        if (!m_pD3DDevice)
+            return E_FAIL;
+
+        return m_pD3DDevice->CreateVertexDeclaration(pElements, ppDeclaration);
+    }
+
+
+//-----------------------------------------------------------------------
+    HRESULT NullDevice::CreateVertexBuffer(unsigned int length, DWORD FVF, DeviceBuffer **ppBuffer)
+    //-------------------------------------------------------------------
+    {
+        if (!ppBuffer)
+            return E_FAIL;
+
+        void *pData = malloc(length ? length : 1);
+
+        if (!pData)
+            return E_FAIL;
+
+        *ppBuffer = new SystemMemoryBuffer(pData, length);
+
+        return S_OK;
+    }
+
+
+//-----------------------------------------------------------------------
+    HRESULT NullDevice::CreateIndexBuffer(unsigned int length, DWORD indexType, DeviceBuffer **ppBuffer)
+    //-------------------------------------------------------------------
+    {
+        return CreateVertexBuffer(length, 0, ppBuffer);
+    }
+
+
+//-----------------------------------------------------------------------
+    HRESULT NullDevice::CreateVertexDeclaration(const D3DVERTEXELEMENT9 *pElements, LPDIRECT3DVERTEXDECLARATION9 *ppDeclaration)
+    //-------------------------------------------------------------------
+    {
+        if (ppDeclaration)
+            *ppDeclaration = NULL;
+
+        return S_OK;
+    }
+
+// EOF
@@ -10,14 +10,38 @@ static char THIS_FILE[] = __FILE__;
 
 using namespace KSR;
 
+// Widths of the fields of RenderGroup::m_sortKey, from the most significant down. They add up to 64.
+const int SORT_ORDER_BITS = 16;
+const int SORT_EFFECT_BITS = 8;
+const int SORT_TECHNIQUE_BITS = 4;
+const int SORT_MATERIAL_BITS = 8;
+const int SORT_TEXTURE_BITS = 8;
+const int SORT_GEOMETRY_BITS = 10;
+const int SORT_DEPTH_BITS = 10;
+
 #ifdef _SHOW_KSR_SIZES_
     int RenderGroup::ms_rgCount = 0;
 #endif
 
+//-----------------------------------------------------------------------
+    static ULONGLONG SortKeyField(ULONGLONG key, int bits, int value)
+    // Note: shifts value into the bottom of key. IDs of -1 pack as 0, and values too large for the field are clamped
+    //-------------------------------------------------------------------
+    {
+        DWORD maxValue = (1 << bits) - 1;
+        DWORD field = value < 0 ? 0 : (DWORD)value + 1;
+
+        if (field > maxValue)
+            field = maxValue;
+
+        return (key << bits) | field;
+    }
+
+
 //-----------------------------------------------------------------------
     RenderGroup::RenderGroup(Scene *pScene)
         :    m_pGeometry(NULL), m_pOptimisedGeometry(NULL), m_pScene(pScene), m_startFaceIndex(-1), m_numFaces(0), m_order(0),
-            m_effectID(-1), m_techniqueID(-1), m_materialID(-1), m_hasTransform(false)
+            m_effectID(-1), m_techniqueID(-1), m_materialID(-1), m_hasTransform(false), m_sortKey(0)
     //-------------------------------------------------------------------
     {
         memset(m_lightIDs, -1, sizeof(int) * 8);
@@ -35,7 +59,7 @@ using namespace KSR;
     RenderGroup::RenderGroup(const RenderGroup &rhs)
         :    m_pGeometry(rhs.m_pGeometry), m_pOptimisedGeometry(rhs.m_pOptimisedGeometry), m_pScene(rhs.m_pScene), m_startFaceIndex(rhs.m_startFaceIndex), m_numFaces(rhs.m_numFaces),
             m_order(rhs.m_order), m_effectID(rhs.m_effectID), m_techniqueID(rhs.m_techniqueID), m_materialID(rhs.m_materialID),
-            m_hasTransform(rhs.m_hasTransform), m_transform(rhs.m_transform)
+            m_hasTransform(rhs.m_hasTransform), m_transform(rhs.m_transform), m_sortKey(rhs.m_sortKey)
     //-------------------------------------------------------------------
     {
         memcpy(m_lightIDs, rhs.m_lightIDs, sizeof(int) * 8);
@@ -78,6 +102,8 @@ using namespace KSR;
         m_hasTransform = rhs.m_hasTransform;
         m_transform = rhs.m_transform;
 
+        m_sortKey = rhs.m_sortKey;
+
         return *this;
     }
 
@@ -212,6 +238,53 @@ using namespace KSR;
     }
 
 
+//-----------------------------------------------------------------------
+    void RenderGroup::SetSortKey(float depth)
+    //-------------------------------------------------------------------
+    {
+        // The texture of the first face stands in for the textures of the whole group
+        int texture = -1;
+
+        if (m_numFaces)
+        {
+            if (m_pOptimisedGeometry)
+            {
+                if (m_startFaceIndex < m_pOptimisedGeometry->GetNumChunkIndices())
+                    texture = m_pOptimisedGeometry->GetChunk(m_pOptimisedGeometry->GetChunkIndex(m_startFaceIndex)).idTexture0;
+            }
+            else if (m_pGeometry)
+            {
+                if (m_startFaceIndex < m_pGeometry->GetNumChunkIndices())
+                    texture = m_pGeometry->GetChunk(m_pGeometry->GetChunkIndex(m_startFaceIndex)).idTexture0;
+            }
+        }
+
+        // Only groups of the same geometry need to be together, so the pointer is hashed down to fit
+        UINT_PTR pGeometry = m_pOptimisedGeometry ? (UINT_PTR)m_pOptimisedGeometry : (UINT_PTR)m_pGeometry;
+        DWORD geometry = ((DWORD)(pGeometry >> 4) * 2654435761u) >> (32 - SORT_GEOMETRY_BITS);
+
+        // The bits of a positive float sort in the same order as its value
+        DWORD depthBits = 0;
+
+        if (depth > 0)
+            depthBits = *(DWORD *)&depth >> (31 - SORT_DEPTH_BITS);
+
+        const unsigned int maxOrder = (1 << SORT_ORDER_BITS) - 1;
+
+        ULONGLONG key = m_order > maxOrder ? maxOrder : m_order;
+
+        key = SortKeyField(key, SORT_EFFECT_BITS, m_effectID);
+        key = SortKeyField(key, SORT_TECHNIQUE_BITS, m_techniqueID);
+        key = SortKeyField(key, SORT_MATERIAL_BITS, m_materialID);
+        key = SortKeyField(key, SORT_TEXTURE_BITS, texture);
+
+        key = (key << SORT_GEOMETRY_BITS) | geometry;
+        key = (key << SORT_DEPTH_BITS) | depthBits;
+
+        m_sortKey = key;
+    }
+
+
 //-----------------------------------------------------------------------
     TreeNode::TreeNode()
     //-------------------------------------------------------------------
@@ -226,6 +299,7 @@ using namespace KSR;
 
         m_pParent = NULL;
         m_pChildren = NULL;
+        m_pChildBounds = NULL;
     }
 
 
@@ -244,6 +318,7 @@ using namespace KSR;
 
         m_pParent = parentNode;
         m_pChildren = NULL;
+        m_pChildBounds = NULL;
     }
 
 
@@ -265,6 +340,30 @@ using namespace KSR;
             delete[] m_pChildren;
             m_pChildren = NULL;
         }
+
+        if (m_pChildBounds)
+        {
+            delete m_pChildBounds;
+            m_pChildBounds = NULL;
+        }
+    }
+
+
+//-----------------------------------------------------------------------
+    void TreeNode::SetChildBounds()
+    //-------------------------------------------------------------------
+    {
+        if (!m_pChildren || m_numChildren > Math::MAX_BOX_BATCH)
+            return;
+
+        if (!m_pChildBounds)
+            m_pChildBounds = new Math::BoxBatch;
+
+        for (int i = 0; i < m_numChildren; i++)
+        {
+            if (m_pChildren[i])
+                m_pChildBounds->Set(i, m_pChildren[i]->m_min, m_pChildren[i]->m_max);
+        }
     }
 
 
@@ -356,13 +455,13 @@ using namespace KSR;
 
 
 //-----------------------------------------------------------------------
-    Geometry::Geometry(LPDIRECT3DDEVICE9 pDevice, DWORD resourceOwnershipFlags)
+    Geometry::Geometry(PDEVICE pDevice, DWORD resourceOwnershipFlags)
     //-------------------------------------------------------------------
     :    m_pScene(NULL), m_pDevice(pDevice), m_FVF(0), m_indexType(IT_32), m_vertexLength(0), m_indexLength(0),
         m_indexGenerationFlags(0), m_numChunks(0), m_numVerts(0), m_numChunkIndices(0), m_numVertexIndices(0),
         m_pChunks(NULL), m_pChunkIndices(NULL), m_pVertexDeclaration(NULL),
         m_useVertexDeclarationFormat(false), m_vertexBufferLocked(false), m_indexBufferLocked(false), m_hide(false),
-        m_pVertexBuffer(NULL), m_pIndexBuffer(NULL),
+        m_pVertexBuffer(NULL), m_pIndexBuffer(NULL), m_pBVH(NULL),
         m_min(0, 0, 0), m_max(0, 0, 0)
     //-------------------------------------------------------------------
     {
@@ -397,6 +496,8 @@ using namespace KSR;
     HRESULT Geometry::Clear(DWORD flags)
     //-------------------------------------------------------------------
     {
+        ReleaseBVH();
+
         if (m_pChunks && (flags & GCF_CHUNKS))
         {
             delete m_pChunks;
@@ -409,7 +510,7 @@ using namespace KSR;
 
         if (m_pVertexBuffer && (flags & GCF_VERTICES))
         {
-            m_pVertexBuffer->Release();
+            delete m_pVertexBuffer;
             m_pVertexBuffer = NULL;
 
             FreeUsedMemory(m_numVerts * m_vertexLength, "Geometry::Clear() - Verts");
@@ -429,7 +530,7 @@ using namespace KSR;
 
         if (m_pIndexBuffer && (flags & GCF_VERTEXINDICES))
         {
-            m_pIndexBuffer->Release();
+            delete m_pIndexBuffer;
             m_pIndexBuffer = NULL;
 
             FreeUsedMemory(m_numVertexIndices * m_indexLength, "Geometry::Clear() - Vert Indices");
@@ -537,6 +638,10 @@ using namespace KSR;
     HRESULT Geometry::Lock(void **ppChunks, void **ppVerts, void **ppChunkIndices, void **ppVertexIndices, DWORD flags)
     //-------------------------------------------------------------------
     {
+        // The vertices or indices may be about to change
+        if ((ppVerts || ppVertexIndices) && !(flags & LF_READONLY))
+            ReleaseBVH();
+
         if (ppChunks)
         {
             if (m_numChunks && m_pChunks)
@@ -551,7 +656,7 @@ using namespace KSR;
         {
             if (m_numVerts && m_pVertexBuffer && !m_vertexBufferLocked)
             {
-                if (FAILED(m_pVertexBuffer->Lock(0, 0, ppVerts, flags)))
+                if (FAILED(m_pVertexBuffer->Lock(ppVerts, flags)))
                     return E_FAIL;
 
                 m_vertexBufferLocked = true;
@@ -574,7 +679,7 @@ using namespace KSR;
         {
             if (m_numVertexIndices && m_pIndexBuffer && !m_indexBufferLocked)
             {
-                if (FAILED(m_pIndexBuffer->Lock(0, 0, ppVertexIndices, flags)))
+                if (FAILED(m_pIndexBuffer->Lock(ppVertexIndices, flags)))
                     return E_FAIL;
 
                 m_indexBufferLocked = true;
@@ -703,6 +808,8 @@ using namespace KSR;
                              void *pChunks, void *pVerts, void *pChunkIndices, void *pVertexIndices, DWORD flags)
     //-------------------------------------------------------------------
     {
+        ReleaseBVH();
+
         if (nChunks  && !pChunks  || pChunks  && !nChunks  ||
             nVerts   && !pVerts   || pVerts   && !nVerts   ||
             nVertexIndices && !pVertexIndices || pVertexIndices && !nVertexIndices ||
@@ -728,7 +835,7 @@ using namespace KSR;
 
             if (m_pVertexBuffer)
             {
-                if (FAILED(m_pVertexBuffer->Lock(0, 0, (LPVOID*)&pVertsLocked, 0)))
+                if (FAILED(m_pVertexBuffer->Lock((LPVOID*)&pVertsLocked, 0)))
                     return E_FAIL;
 
                 pVertsBuffered = malloc((m_numVerts + nVerts) * m_vertexLength);
@@ -737,7 +844,8 @@ using namespace KSR;
                 if (FAILED(m_pVertexBuffer->Unlock()))
                     return E_FAIL;
 
-                m_pVertexBuffer->Release();
+                delete m_pVertexBuffer;
+                m_pVertexBuffer = NULL;
             }
             else
             {
@@ -749,14 +857,10 @@ using namespace KSR;
 
             memcpy((char *)pVertsBuffered + m_numVerts * m_vertexLength, pVerts, nVerts * m_vertexLength);
 
-            m_pDevice->CreateVertexBuffer((m_numVerts + nVerts) * m_vertexLength,
-                                          0,
-                                          m_FVF,
-                                          D3DPOOL_MANAGED,
-                                          &m_pVertexBuffer,
-                                          NULL);
+            if (FAILED(m_pDevice->CreateVertexBuffer((m_numVerts + nVerts) * m_vertexLength, m_FVF, &m_pVertexBuffer)))
+                return E_FAIL;
 
-            if (FAILED(m_pVertexBuffer->Lock(0, 0, (LPVOID*)&pVertsLocked, 0)))
+            if (FAILED(m_pVertexBuffer->Lock((LPVOID*)&pVertsLocked, 0)))
                 return E_FAIL;
 
             memcpy(pVertsLocked, pVertsBuffered, (m_numVerts + nVerts) * m_vertexLength);
@@ -799,7 +903,7 @@ using namespace KSR;
 
             if (m_pIndexBuffer)
             {
-                if (FAILED(m_pIndexBuffer->Lock(0, 0, (LPVOID*)&newVertexIndicesLocked, 0)))
+                if (FAILED(m_pIndexBuffer->Lock((LPVOID*)&newVertexIndicesLocked, 0)))
                     return E_FAIL;
 
                 newVertexIndicesBuffered = malloc((m_numVertexIndices + nVertexIndices) * m_indexLength);
@@ -808,7 +912,8 @@ using namespace KSR;
                 if (FAILED(m_pIndexBuffer->Unlock()))
                     return E_FAIL;
 
-                m_pIndexBuffer->Release();
+                delete m_pIndexBuffer;
+                m_pIndexBuffer = NULL;
             }
             else
                 newVertexIndicesBuffered = malloc(nVertexIndices * m_indexLength);
@@ -818,19 +923,10 @@ using namespace KSR;
 
             memcpy((char *)newVertexIndicesBuffered + m_numVertexIndices * m_indexLength, pVertexIndices, nVertexIndices * m_indexLength);
 
-            D3DFORMAT indexD3DFormat = D3DFMT_INDEX32;
-
-            if (m_indexType == IT_16)
-                indexD3DFormat = D3DFMT_INDEX16;
-
-            m_pDevice->CreateIndexBuffer((m_numVertexIndices + nVertexIndices) * m_indexLength,
-                                      0,
-                                      indexD3DFormat,
-                                      D3DPOOL_MANAGED,
-                                      &m_pIndexBuffer,
-                                      NULL);
+            if (FAILED(m_pDevice->CreateIndexBuffer((m_numVertexIndices + nVertexIndices) * m_indexLength, m_indexType, &m_pIndexBuffer)))
+                return E_FAIL;
 
-            if (FAILED(m_pIndexBuffer->Lock(0, 0, (LPVOID*)&newVertexIndicesLocked, 0)))
+            if (FAILED(m_pIndexBuffer->Lock((LPVOID*)&newVertexIndicesLocked, 0)))
                 return E_FAIL;
 
             memcpy(newVertexIndicesLocked, newVertexIndicesBuffered, (m_numVertexIndices + nVertexIndices) * m_indexLength);
@@ -898,161 +994,215 @@ using namespace KSR;
 */
 
 //-----------------------------------------------------------------------
-    bool Geometry::Intersect(std::list<IntersectionResult> &results, const Vector3 &rayPos, const Vector3 &rayDir,
-                             RenderGroup *pGroup, DWORD flags, bool findFirst)
-    //-------------------------------------------------------------------
-    // Note: returns only the first interection found
+    bool Geometry::BuildBVH()
     //-------------------------------------------------------------------
     {
-        if (!m_pVertexBuffer || !m_pIndexBuffer)
+        if (m_pBVH)
+            return true;
+
+        if (!m_numChunks || !m_pChunks || !m_numVerts || !m_pVertexBuffer)
             return false;
 
-        std::vector<IntersectionResult> newResults;
+        // Don't take the buffers from whoever has them locked
+        if (m_vertexBufferLocked || m_indexBufferLocked)
+            return false;
+
+        bool useIndices = m_numVertexIndices && m_pIndexBuffer;
 
         LPVOID pVertsLocked = NULL;
         LPVOID pIndicesLocked = NULL;
 
-        m_pVertexBuffer->Lock(0, 0, &pVertsLocked, D3DLOCK_READONLY);
-        m_pIndexBuffer->Lock(0, 0, &pIndicesLocked, D3DLOCK_READONLY);
+        if (FAILED(Lock(NULL, &pVertsLocked, NULL, useIndices ? &pIndicesLocked : NULL, LF_READONLY)))
+        {
+            Unlock();
+            return false;
+        }
 
-        // todo: currently assumes indexLength == 4
-        unsigned int *pIndices = (unsigned int *)pIndicesLocked;
+        std::vector<BVHTriangle> triangles;
 
-        for (unsigned int c = 0; c < (unsigned int)m_numChunks; c++)
+        for (unsigned int c = 0; c < m_numChunks; c++)
         {
-            Chunk &chunk = m_pChunks[c];
+            const Chunk &chunk = m_pChunks[c];
 
-            if (chunk.type == CT_TRIANGLELIST && flags & IF_TRIANGLELIST)
-            {
-                for (unsigned int n = chunk.startIndex; n < chunk.numIndices; n += 3)
-                {
-                    unsigned int index0 = pIndices[n];
-                    unsigned int index1 = pIndices[n + 1];
-                    unsigned int index2 = pIndices[n + 2];
-
-                    Vector3 v0 = GetVertexPosition(pVertsLocked, index0);
-                    Vector3 v1 = GetVertexPosition(pVertsLocked, index1);
-                    Vector3 v2 = GetVertexPosition(pVertsLocked, index2);
-                    float u = 0.0f;
-                    float v = 0.0f;
-                    float distance = 0.0f;
-
-                    if (D3DXIntersectTri(&v0, &v1, &v2, &rayPos, &rayDir, &u, &v, &distance))
-                    {
-                        IntersectionResult result(this, c, index0, index1, index2, u, v, distance);
+            DWORD typeFlag = 1 << chunk.type;
 
-                        if (findFirst)
-                        {
-                            results.push_back(result);
+            if (!(typeFlag & IF_ALL))
+                continue;
 
-                            return true;
-                        }
-                        else
-                            newResults.push_back(result);
-                    }
-                }
-            }
-            else if (chunk.type == CT_TRIANGLESTRIP && flags & IF_TRIANGLESTRIP)
+            unsigned int numIndices = useIndices ? chunk.numIndices : chunk.numVerts;
+
+            // Triangle lists are taken three indices at a time, strips a vertex at a time, and polygons as fans
+            unsigned int step = chunk.type == CT_TRIANGLELIST ? 3 : 1;
+
+            for (unsigned int n = 2; n < numIndices; n += step)
             {
-                unsigned int index0 = pIndices[0];
-                unsigned int index1 = pIndices[1];
-                unsigned int index2 = pIndices[2];
-
-                Vector3 v0 = GetVertexPosition(pVertsLocked, index0);
-                Vector3 v1 = GetVertexPosition(pVertsLocked, index1);
-                Vector3 v2 = GetVertexPosition(pVertsLocked, index2);
-                float u = 0.0f;
-                float v = 0.0f;
-                float distance = 0.0f;
-
-                if (D3DXIntersectTri(&v0, &v1, &v2, &rayPos, &rayDir, &u, &v, &distance))
-                {
-                    IntersectionResult result(this, c, index0, index1, index2, u, v, distance);
+                unsigned int corners[3] = { n - 2, n - 1, n };
 
-                    if (findFirst)
-                    {
-                        results.push_back(result);
+                if (chunk.type == CT_POLYGON)
+                    corners[0] = 0;
 
-                        return true;
-                    }
-                    else
-                        newResults.push_back(result);
-                }
+                unsigned int ids[3];
 
-                for (unsigned int n = chunk.startIndex + 3; n < chunk.numIndices; n++)
+                for (int i = 0; i < 3; i++)
                 {
-                    index0 = pIndices[n];
-                    index1 = pIndices[n + 1];
-                    index2 = pIndices[n + 2];
-
-                    v0 = GetVertexPosition(pVertsLocked, index0);
-                    v1 = GetVertexPosition(pVertsLocked, index1);
-                    v2 = GetVertexPosition(pVertsLocked, index2);
-                    u = 0.0f;
-                    v = 0.0f;
-                    distance = 0.0f;
-
-                    if (D3DXIntersectTri(&v0, &v1, &v2, &rayPos, &rayDir, &u, &v, &distance))
-                    {
-                        IntersectionResult result(this, c, index0, index1, index2, u, v, distance);
-
-                        if (findFirst)
-                        {
-                            results.push_back(result);
+                    unsigned int index = chunk.startIndex + corners[i];
 
-                            return true;
-                        }
-                        else
-                            newResults.push_back(result);
-                    }
+                    if (!useIndices)
+                        ids[i] = index;
+                    else if (m_indexType == IT_32)
+                        ids[i] = ((unsigned int *)pIndicesLocked)[index];
+                    else
+                        ids[i] = ((unsigned short *)pIndicesLocked)[index];
                 }
-            }
-            else if (chunk.type == CT_POLYGON && flags & IF_POLYGON)
-            {
 
+                if (ids[0] >= m_numVerts || ids[1] >= m_numVerts || ids[2] >= m_numVerts)
+                    continue;
+
+                BVHTriangle tri;
+                tri.v0 = GetVertexPosition(pVertsLocked, ids[0]);
+                tri.edge1 = GetVertexPosition(pVertsLocked, ids[1]) - tri.v0;
+                tri.edge2 = GetVertexPosition(pVertsLocked, ids[2]) - tri.v0;
+                tri.chunkID = c;
+                tri.vertexID0 = ids[0];
+                tri.vertexID1 = ids[1];
+                tri.vertexID2 = ids[2];
+                tri.typeFlag = typeFlag;
+
+                triangles.push_back(tri);
             }
         }
 
-        m_pIndexBuffer->Unlock();
-        m_pVertexBuffer->Unlock();
+        Unlock();
+
+        m_pBVH = new TriangleBVH;
+        m_pBVH->Build(triangles);
+
+        AddUsedMemory(sizeof(TriangleBVH) + m_pBVH->GetNumBytes(), "Geometry::BuildBVH() - BVH");
+
+        return true;
+    }
+
 
-        if (newResults.size() > 0)
+//-----------------------------------------------------------------------
+    void Geometry::ReleaseBVH()
+    //-------------------------------------------------------------------
+    {
+        if (m_pBVH)
         {
-            results.insert(results.end(), newResults.begin(), newResults.end());
+            FreeUsedMemory(sizeof(TriangleBVH) + m_pBVH->GetNumBytes(), "Geometry::ReleaseBVH() - BVH");
 
-            return true;
+            delete m_pBVH;
+            m_pBVH = NULL;
         }
+    }
 
-        return false;
+
+//-----------------------------------------------------------------------
+    bool Geometry::IntersectBVH(std::vector<BVHHit> &hits, const Vector3 &rayPos, const Vector3 &rayDir, DWORD flags, BVHQUERYMODE mode,
+                                float maxDistance)
+    //-------------------------------------------------------------------
+    {
+        if (!BuildBVH())
+            return false;
+
+        return m_pBVH->Intersect(hits, rayPos, rayDir, flags & IF_ALL, mode, maxDistance);
     }
 
 
 //-----------------------------------------------------------------------
-    bool Geometry::Intersect(std::list<IntersectionResult> &results, const Vector3 &rayPos, const Vector3 &rayDir, RenderGroup *pGroup, DWORD flags)
+    const IntersectionResult Geometry::GetIntersectionResult(const BVHHit &hit)
+    //-------------------------------------------------------------------
+    {
+        const BVHTriangle &tri = m_pBVH->GetTriangle(hit.triangle);
+
+        return IntersectionResult(this, tri.chunkID, tri.vertexID0, tri.vertexID1, tri.vertexID2, hit.u, hit.v, hit.distance);
+    }
+
+
+//-----------------------------------------------------------------------
+    bool Geometry::Intersect(std::vector<IntersectionResult> &results, const Vector3 &rayPos, const Vector3 &rayDir, DWORD flags)
     // Note: returns all intersections found with this geometry object
     //-------------------------------------------------------------------
     {
-        bool found = Intersect(results, rayPos, rayDir, pGroup, flags, false);
+        std::vector<BVHHit> hits;
+
+        if (!IntersectBVH(hits, rayPos, rayDir, flags, BQM_ALL))
+            return false;
+
+        size_t first = results.size();
 
-        return found;
+        for (unsigned int h = 0; h < hits.size(); h++)
+            results.push_back(GetIntersectionResult(hits[h]));
+
+        std::sort(results.begin() + first, results.end(), IntersectionResult::Nearer);
+
+        return true;
     }
 
 
 //-----------------------------------------------------------------------
-    bool Geometry::Intersect(IntersectionResult &result, const Vector3 &rayPos, const Vector3 &rayDir, RenderGroup *pGroup, DWORD flags)
-    // Note: returns only the first interection found
+    bool Geometry::Intersect(std::list<IntersectionResult> &results, const Vector3 &rayPos, const Vector3 &rayDir, RenderGroup *pGroup, DWORD flags)
+    // Note: returns all intersections found with this geometry object
     //-------------------------------------------------------------------
     {
-        std::list<IntersectionResult> results;
+        std::vector<IntersectionResult> newResults;
+
+        if (!Intersect(newResults, rayPos, rayDir, flags))
+            return false;
+
+        results.insert(results.end(), newResults.begin(), newResults.end());
+
+        return true;
+    }
+
 
-        bool found = Intersect(results, rayPos, rayDir, pGroup, flags, true);
+//-----------------------------------------------------------------------
+    bool Geometry::Intersect(IntersectionResult &result, const Vector3 &rayPos, const Vector3 &rayDir, RenderGroup *pGroup, DWORD flags,
+                             float maxDistance)
+    // Note: returns the nearest intersection, or the first found with IF_ANYHIT, nearer than maxDistance
+    //-------------------------------------------------------------------
+    {
+        std::vector<BVHHit> hits;
 
-        if (results.size() < 1)
+        if (!IntersectBVH(hits, rayPos, rayDir, flags, (flags & IF_ANYHIT) ? BQM_ANY : BQM_NEAREST, maxDistance))
             return false;
 
-        result = *results.begin();
+        result = GetIntersectionResult(hits[0]);
+
+        return true;
+    }
+
+
+//-----------------------------------------------------------------------
+    unsigned int Geometry::IntersectRays(std::vector<IntersectionResult> &results, const Math::Ray *pRays, unsigned int numRays, DWORD flags,
+                                         float maxDistance)
+    //-------------------------------------------------------------------
+    {
+        results.clear();
+        results.resize(numRays);
+
+        if (!pRays || !BuildBVH())
+            return 0;
+
+        BVHQUERYMODE mode = (flags & IF_ANYHIT) ? BQM_ANY : BQM_NEAREST;
 
-        return found;
+        unsigned int numHits = 0;
+
+        std::vector<BVHHit> hits;
+        hits.reserve(1);
+
+        for (unsigned int r = 0; r < numRays; r++)
+        {
+            hits.clear();
+
+            if (!m_pBVH->Intersect(hits, pRays[r].position, pRays[r].direction, flags & IF_ALL, mode, maxDistance))
+                continue;
+
+            results[r] = GetIntersectionResult(hits[0]);
+            ++numHits;
+        }
+
+        return numHits;
     }
 
 
@@ -1060,6 +1210,8 @@ using namespace KSR;
     HRESULT Geometry::GenerateIndexBuffers(DWORD flags)
     //-------------------------------------------------------------------
     {
+        ReleaseBVH();
+
         DWORD generationFlags = m_indexGenerationFlags | flags;
 
         if (!m_numChunkIndices && !(generationFlags & GF_ALLOWZEROCHUNKINDICES))
@@ -1108,7 +1260,10 @@ using namespace KSR;
                 return E_FAIL;
 
             if (m_pIndexBuffer)
-                m_pIndexBuffer->Release();
+            {
+                delete m_pIndexBuffer;
+                m_pIndexBuffer = NULL;
+            }
 
             m_numVertexIndices = m_numVerts;
 
@@ -1134,21 +1289,12 @@ using namespace KSR;
                     ((unsigned short int*)newVertexIndices)[v] = vertexIndexList[v];
             }
 
-            D3DFORMAT indexD3DFormat = D3DFMT_INDEX32;
-
-            if (m_indexType == IT_16)
-                indexD3DFormat = D3DFMT_INDEX16;
-
-            m_pDevice->CreateIndexBuffer(m_numVertexIndices * m_indexLength,
-                                      0,
-                                      indexD3DFormat,
-                                      D3DPOOL_MANAGED,
-                                      &m_pIndexBuffer,
-                                      NULL);
+            if (FAILED(m_pDevice->CreateIndexBuffer(m_numVertexIndices * m_indexLength, m_indexType, &m_pIndexBuffer)))
+                return E_FAIL;
 
             void *newVertexIndicesLocked = NULL;
 
-            if (FAILED(m_pIndexBuffer->Lock(0, 0, (LPVOID*)&newVertexIndicesLocked, 0)))
+            if (FAILED(m_pIndexBuffer->Lock((LPVOID*)&newVertexIndicesLocked, 0)))
                 return E_FAIL;
 
             memcpy(newVertexIndicesLocked, newVertexIndices, m_numVertexIndices * m_indexLength);
@@ -1198,7 +1344,7 @@ using namespace KSR;
         if (pOutputGeometry->numVertices && m_pVertexBuffer)
         {
             void *pVertsLocked = NULL;
-            m_pVertexBuffer->Lock(0, 0, &pVertsLocked, 0);
+            m_pVertexBuffer->Lock(&pVertsLocked, 0);
 
             pOutputGeometry->vertices = malloc(m_numVerts * m_vertexLength);
             memcpy(pOutputGeometry->vertices, pVertsLocked, m_numVerts * m_vertexLength);
@@ -1215,7 +1361,7 @@ using namespace KSR;
         if (pOutputGeometry->numVertexIndices && m_pIndexBuffer)
         {
             void *pIndicesLocked = NULL;
-            m_pIndexBuffer->Lock(0, 0, &pIndicesLocked, 0);
+            m_pIndexBuffer->Lock(&pIndicesLocked, 0);
 
             pOutputGeometry->vertexIndices = malloc(m_numVertexIndices * m_indexLength);
             memcpy(pOutputGeometry->vertexIndices, pIndicesLocked, m_numVertexIndices * m_indexLength);
@@ -1261,7 +1407,7 @@ using namespace KSR;
     LPDIRECT3DVERTEXBUFFER9 Geometry::GetVertexBuffer()
     //-------------------------------------------------------------------
     {
-        return m_pVertexBuffer;
+        return m_pVertexBuffer ? m_pVertexBuffer->GetD3DVertexBuffer() : NULL;
     }
 
 
@@ -1269,7 +1415,7 @@ using namespace KSR;
     LPDIRECT3DINDEXBUFFER9 Geometry::GetIndexBuffer()
     //-------------------------------------------------------------------
     {
-        return m_pIndexBuffer;
+        return m_pIndexBuffer ? m_pIndexBuffer->GetD3DIndexBuffer() : NULL;
     }
 
 /*
@@ -1542,4 +1688,12 @@ using namespace KSR;
         return m_distance != rhs.m_distance;
     }
 
+
+//-----------------------------------------------------------------------
+    bool IntersectionResult::Nearer(const IntersectionResult &lhs, const IntersectionResult &rhs)
+    //-------------------------------------------------------------------
+    {
+        return lhs.m_distance < rhs.m_distance;
+    }
+
 // EOF
\ No newline at end of file
@@ -142,7 +142,7 @@ void LogDiagnosticContainer(WCHAR *parentName, IDxDiagContainer *pContainer);
         if (!pScene || !m_pRenderer)
             return E_FAIL;
 
-        *pScene = new Scene(pSettings, m_pRenderer->GetD3DDevice(), m_pResourceManager);
+        *pScene = new Scene(pSettings, m_pRenderer->GetDevice(), m_pResourceManager);
 
         if (!(*pScene))
             return E_FAIL;
@@ -162,7 +162,7 @@ void LogDiagnosticContainer(WCHAR *parentName, IDxDiagContainer *pContainer);
         if (!pVisual || !m_pRenderer)
             return E_FAIL;
 
-        *pVisual = new Visual(m_pRenderer->GetD3DDevice(), m_pResourceManager);
+        *pVisual = new Visual(m_pRenderer->GetDevice(), m_pResourceManager);
 
         if (!(*pVisual))
             return E_FAIL;
@@ -468,7 +468,7 @@ void LogDiagnosticContainer(WCHAR *parentName, IDxDiagContainer *pContainer);
         if (!pGeometry || !m_pRenderer)
             return E_FAIL;
 
-        (*pGeometry) = new Geometry(m_pRenderer->GetD3DDevice());
+        (*pGeometry) = new Geometry(m_pRenderer->GetDevice());
 
         return S_OK;
     }
@@ -71,6 +71,55 @@ const Vector3 Math::K_NEG(0,  0, -1);
     }
 
 
+//-----------------------------------------------------------------------
+    Math::Ray::Ray()
+    //-------------------------------------------------------------------
+    {
+        position = Vector3(0, 0, 0);
+        direction = Vector3(0, 0, 1);
+    }
+
+
+//-----------------------------------------------------------------------
+    Math::Ray::Ray(const Vector3 &rayPosition, const Vector3 &rayDirection)
+    //-------------------------------------------------------------------
+    {
+        position = rayPosition;
+        direction = rayDirection;
+    }
+
+
+//-----------------------------------------------------------------------
+    Math::BoxBatch::BoxBatch()
+    //-------------------------------------------------------------------
+    {
+        for (int i = 0; i < MAX_BOX_BATCH; i++)
+        {
+            centreX[i] = centreY[i] = centreZ[i] = 0;
+            extentX[i] = extentY[i] = extentZ[i] = 0;
+        }
+
+        numBoxes = 0;
+    }
+
+
+//-----------------------------------------------------------------------
+    void Math::BoxBatch::Set(int index, const Vector3 &boxMin, const Vector3 &boxMax)
+    //-------------------------------------------------------------------
+    {
+        centreX[index] = (boxMin.x + boxMax.x) * 0.5f;
+        centreY[index] = (boxMin.y + boxMax.y) * 0.5f;
+        centreZ[index] = (boxMin.z + boxMax.z) * 0.5f;
+
+        extentX[index] = (boxMax.x - boxMin.x) * 0.5f;
+        extentY[index] = (boxMax.y - boxMin.y) * 0.5f;
+        extentZ[index] = (boxMax.z - boxMin.z) * 0.5f;
+
+        if (index >= numBoxes)
+            numBoxes = index + 1;
+    }
+
+
 //-----------------------------------------------------------------------
     void Math::AABB::IncludePoint(const Vector3 &point)
     //-------------------------------------------------------------------
@@ -1651,6 +1700,52 @@ const Vector3 Math::K_NEG(0,  0, -1);
     }
 
 
+//-----------------------------------------------------------------------
+    bool Math::AABBRayIntersection(const AABB &box, const Vector3 &position, const Vector3 &direction, float *pDistance)
+    //-------------------------------------------------------------------
+    {
+        // Slab test. pDistance receives the distance along the ray, in multiples of its
+        // direction, at which it enters the box, or 0 if it starts inside.
+        float tMin = 0.0f;
+        float tMax = FLT_MAX;
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (fabsf(direction[axis]) < 1e-20f)
+            {
+                if (position[axis] < box.min[axis] || position[axis] > box.max[axis])
+                    return false;
+
+                continue;
+            }
+
+            float invDir = 1.0f / direction[axis];
+            float t0 = (box.min[axis] - position[axis]) * invDir;
+            float t1 = (box.max[axis] - position[axis]) * invDir;
+
+            if (t0 > t1)
+                std::swap(t0, t1);
+
+            // A few ulps of slack, so that rays grazing the box are not lost to rounding
+            t1 *= 1.0000004f;
+
+            if (t0 > tMin)
+                tMin = t0;
+
+            if (t1 < tMax)
+                tMax = t1;
+
+            if (tMin > tMax)
+                return false;
+        }
+
+        if (pDistance)
+            *pDistance = tMin;
+
+        return true;
+    }
+
+
 // Unfinished
 //-------------------------------------------------------------------
     bool Math::AABBRayCollision(const AABB &box, const Vector3 &position, const Vector3 &direction)
@@ -1775,6 +1870,92 @@ const Vector3 Math::K_NEG(0,  0, -1);
     }
 
 
+//-------------------------------------------------------------------
+    Math::INTERSECTIONSTATE Math::AABBFrustumIntersection(const Vector3 &centre, const Vector3 &extent, const Plane *frustumPlanes, DWORD *pPlaneMask)
+    //---------------------------------------------------------------
+    {
+        DWORD planeMask = *pPlaneMask;
+
+        for (int p = 0; p < 6; p++)
+        {
+            if (!(planeMask & (1 << p)))
+                continue;
+
+            const Plane &plane = frustumPlanes[p];
+
+            // Distance of the centre from the plane, and how far the box reaches towards it
+            float distance = plane.a * centre.x + plane.b * centre.y + plane.c * centre.z + plane.d;
+            float radius = (float)fabs(plane.a) * extent.x + (float)fabs(plane.b) * extent.y + (float)fabs(plane.c) * extent.z;
+
+            if (distance + radius < 0)
+                return IS_NONE;
+
+            if (distance - radius >= 0)
+                planeMask &= ~(1 << p);
+        }
+
+        *pPlaneMask = planeMask;
+
+        return planeMask ? IS_PENETRATION : IS_B_CONTAINS_A;
+    }
+
+
+//-------------------------------------------------------------------
+    void Math::AABBFrustumIntersection(const Math::BoxBatch &boxes, const Plane *frustumPlanes, DWORD planeMask, DWORD *pPlaneMasks)
+    // Note: the loop over the boxes has no branches, so the compiler is free to test several at once
+    //---------------------------------------------------------------
+    {
+        DWORD outside[MAX_BOX_BATCH], inside[MAX_BOX_BATCH];
+
+        int b;
+        for (b = 0; b < MAX_BOX_BATCH; b++)
+            outside[b] = inside[b] = 0;
+
+        for (int p = 0; p < 6; p++)
+        {
+            if (!(planeMask & (1 << p)))
+                continue;
+
+            const float nx = frustumPlanes[p].a, absNx = (float)fabs(nx);
+            const float ny = frustumPlanes[p].b, absNy = (float)fabs(ny);
+            const float nz = frustumPlanes[p].c, absNz = (float)fabs(nz);
+            const float d = frustumPlanes[p].d;
+            const DWORD planeBit = 1 << p;
+
+            for (b = 0; b < MAX_BOX_BATCH; b++)
+            {
+                float distance = nx * boxes.centreX[b] + ny * boxes.centreY[b] + nz * boxes.centreZ[b] + d;
+                float radius = absNx * boxes.extentX[b] + absNy * boxes.extentY[b] + absNz * boxes.extentZ[b];
+
+                outside[b] |= distance + radius < 0 ? FRUSTUM_OUTSIDE : 0;
+                inside[b] |= distance - radius >= 0 ? planeBit : 0;
+            }
+        }
+
+        for (b = 0; b < MAX_BOX_BATCH; b++)
+            pPlaneMasks[b] = outside[b] ? FRUSTUM_OUTSIDE : planeMask & ~inside[b];
+    }
+
+
+//-------------------------------------------------------------------
+    void Math::TransformAABB(const Vector3 &boxMin, const Vector3 &boxMax, const Matrix &transform, Vector3 *pCentre, Vector3 *pExtent)
+    //---------------------------------------------------------------
+    {
+        Vector3 centre = (boxMin + boxMax) * 0.5f;
+        Vector3 extent = (boxMax - boxMin) * 0.5f;
+
+        D3DXVec3TransformCoord(pCentre, &centre, &transform);
+
+        // Each world axis is reached by the transformed box axes in proportion to their components along it
+        for (int i = 0; i < 3; i++)
+        {
+            (*pExtent)[i] = (float)fabs(transform.m[0][i]) * extent.x +
+                            (float)fabs(transform.m[1][i]) * extent.y +
+                            (float)fabs(transform.m[2][i]) * extent.z;
+        }
+    }
+
+
 //-------------------------------------------------------------------
     bool Math::OBBSphereCollision(const Math::OBB &OBB, const Math::Sphere &sphere, Vector3 *pPoint)
     //---------------------------------------------------------------
@@ -555,6 +555,8 @@ using namespace KSR;
                                      &D3DDevice)))
             return E_FAIL;
 
+        device.SetD3DDevice(D3DDevice);
+
         if (pFullscreenViewport)
         {
             LPDIRECT3DSWAPCHAIN9 pSwapChain = NULL;
@@ -1264,8 +1266,6 @@ using namespace KSR;
         if (renderList.size() < 1)
             return S_OK;
 
-        std::sort(renderList.begin(), renderList.end(), RenderGroup::LessOrder);
-
         ViewportSettings &vps = currentViewportSettings;
 
         // Create effect parameters
@@ -1282,6 +1282,8 @@ using namespace KSR;
 
             backgroundColour = Math::ARGBToV4RGBA(vps.bgColour);
 
+        SortRenderList(renderList, view);
+
         PGEOMETRY currentGeometry = NULL;
         POPTIMISEDGEOMETRY currentOptimisedGeometry = NULL;
         int currentEffect = -1;
@@ -1342,9 +1344,10 @@ using namespace KSR;
 #ifdef DEBUG_DUMP
         OutputDebugString("Rendering RenderGroups\n==========================================================\n\n");
 #endif
-        std::vector<RenderGroup>::iterator r = renderList.begin();
-        for (; r != renderList.end(); r++)
+        for (unsigned int o = 0; o < renderOrder.size(); o++)
         {
+            RenderGroup *r = &renderList[renderOrder[o].index];
+
 #ifdef DEBUG_DUMP
             char buf[256];
             sprintf(buf, "RenderGroup:\n\torder = %d\n", r->order);
@@ -1689,6 +1692,143 @@ using namespace KSR;
         return S_OK;
     }
 
+
+//-----------------------------------------------------------------------
+    static bool InsertionSortRenderItems(RenderSortItem *pItems, unsigned int numItems, unsigned int maxMoves)
+    // Note: returns false, leaving the items part sorted, if sorting would take more than maxMoves moves
+    //-------------------------------------------------------------------
+    {
+        unsigned int numMoves = 0;
+
+        for (unsigned int i = 1; i < numItems; i++)
+        {
+            if (pItems[i - 1].key <= pItems[i].key)
+                continue;
+
+            RenderSortItem item = pItems[i];
+
+            unsigned int j = i;
+            for (; j > 0 && pItems[j - 1].key > item.key; j--)
+                pItems[j] = pItems[j - 1];
+
+            pItems[j] = item;
+
+            numMoves += i - j;
+
+            if (numMoves > maxMoves)
+                return false;
+        }
+
+        return true;
+    }
+
+
+//-----------------------------------------------------------------------
+    static void RadixSortRenderItems(std::vector<RenderSortItem> &items, std::vector<RenderSortItem> &buffer)
+    // Note: least significant byte first, so the sort is stable
+    //-------------------------------------------------------------------
+    {
+        unsigned int numItems = (unsigned int)items.size();
+        buffer.resize(numItems);
+
+        // The counts of every byte of the keys are taken in one pass
+        unsigned int counts[8][256];
+        memset(counts, 0, sizeof(counts));
+
+        unsigned int i;
+        int b;
+        for (i = 0; i < numItems; i++)
+        {
+            ULONGLONG key = items[i].key;
+
+            for (b = 0; b < 8; b++)
+                counts[b][(unsigned int)(key >> (b * 8)) & 0xff]++;
+        }
+
+        RenderSortItem *pSource = &items[0];
+        RenderSortItem *pDest = &buffer[0];
+
+        for (b = 0; b < 8; b++)
+        {
+            int shift = b * 8;
+            unsigned int *pCounts = counts[b];
+
+            // Bytes that are the same in every key leave the order as it is
+            if (pCounts[(unsigned int)(pSource[0].key >> shift) & 0xff] == numItems)
+                continue;
+
+            unsigned int offsets[256];
+            unsigned int offset = 0;
+
+            int d;
+            for (d = 0; d < 256; d++)
+            {
+                offsets[d] = offset;
+                offset += pCounts[d];
+            }
+
+            for (i = 0; i < numItems; i++)
+                pDest[offsets[(unsigned int)(pSource[i].key >> shift) & 0xff]++] = pSource[i];
+
+            RenderSortItem *pSwap = pSource;
+            pSource = pDest;
+            pDest = pSwap;
+        }
+
+        if (pSource != &items[0])
+            items.swap(buffer);
+    }
+
+
+//-----------------------------------------------------------------------
+    void Renderer::SortRenderList(std::vector<RenderGroup> &renderList, const Matrix &view)
+    // Note: fills renderOrder with the order to draw renderList in
+    //-------------------------------------------------------------------
+    {
+        unsigned int numGroups = (unsigned int)renderList.size();
+
+        if (!numGroups)
+        {
+            renderOrder.clear();
+            return;
+        }
+
+        unsigned int i;
+        for (i = 0; i < numGroups; i++)
+        {
+            RenderGroup &group = renderList[i];
+
+            // Distance of the group's origin along the view direction, for either handedness
+            float depth = 0;
+
+            if (group.m_hasTransform)
+                depth = (float)fabs(group.m_transform._41 * view._13 + group.m_transform._42 * view._23 + group.m_transform._43 * view._33 + view._43);
+
+            group.SetSortKey(depth);
+        }
+
+        // Scenes build their render lists in the same order every frame, so while the visible set is
+        // unchanged last frame's order needs few, if any, moves. Otherwise it is quicker to start again.
+        if (renderOrder.size() == numGroups)
+        {
+            for (i = 0; i < numGroups; i++)
+                renderOrder[i].key = renderList[renderOrder[i].index].m_sortKey;
+
+            if (InsertionSortRenderItems(&renderOrder[0], numGroups, numGroups))
+                return;
+        }
+
+        renderOrder.resize(numGroups);
+
+        for (i = 0; i < numGroups; i++)
+        {
+            renderOrder[i].key = renderList[i].m_sortKey;
+            renderOrder[i].index = i;
+        }
+
+        RadixSortRenderItems(renderOrder, renderSortBuffer);
+    }
+
 /*
 //-----------------------------------------------------------------------
     HRESULT Renderer::RenderChunk(Geometry *geometry, Chunk *chunk)
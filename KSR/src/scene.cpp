@@ -14,6 +14,33 @@ using namespace KSR;
 
 std::vector< Chunk > *g_pSortingChunks;
 
+// Worlds with fewer polygons than this are partitioned on the calling thread alone.
+const unsigned int MIN_THREADED_PARTITION_POLYGONS = 50000;
+
+// Number of subtrees made for each worker thread, so that threads given sparse parts of the world take on more.
+const int PARTITION_TASKS_PER_WORKER = 4;
+
+// Number of sight lines tried between two leafs before they are taken to be hidden from each other.
+const unsigned int PVS_SAMPLES_PER_LEAF_PAIR = 16;
+
+//-----------------------------------------------------------------------
+    static float RadicalInverse(unsigned int index, unsigned int base)
+    //-------------------------------------------------------------------
+    {
+        // The index-th number of the Halton sequence in the given base
+        float inverseBase = 1.0f / base;
+        float digitWeight = inverseBase;
+        float result = 0.0f;
+
+        for (; index; index /= base)
+        {
+            result += (index % base) * digitWeight;
+            digitWeight *= inverseBase;
+        }
+
+        return result;
+    }
+
 //-----------------------------------------------------------------------
     bool SortByTechniqueID(int lhs, int rhs)
     //-------------------------------------------------------------------
@@ -68,10 +95,10 @@ std::vector< Chunk > *g_pSortingChunks;
 
 
 //-----------------------------------------------------------------------
-    Scene::Scene(PSCENESETTINGS pSettings, PDIRECT3DDEVICE9 pDevice, PRESOURCEMANAGER pResourceManager)
+    Scene::Scene(PSCENESETTINGS pSettings, PDEVICE pDevice, PRESOURCEMANAGER pResourceManager)
     //-------------------------------------------------------------------
-    :    m_pFnProgressCallback(NULL), m_pProgressCallbackPayload(NULL), m_pSpacePartitionOutline(NULL),
-        m_pD3DDevice(pDevice), m_pResourceManager(pResourceManager)
+    :    m_pFnProgressCallback(NULL), m_pFnPVSGeneratorCallback(GeneratePVS), m_pProgressCallbackPayload(NULL), m_pSpacePartitionOutline(NULL),
+        m_pDevice(pDevice), m_pResourceManager(pResourceManager)
     //-------------------------------------------------------------------
     {
         AddUsedMemory(sizeof(Scene), "Scene::Scene()");
@@ -250,6 +277,19 @@ std::vector< Chunk > *g_pSortingChunks;
     }
 
 
+//-----------------------------------------------------------------------
+    HRESULT Scene::SetPVSGeneratorCallback(PVSGeneratorCallbackFunc pvsGeneratorCallbackFunc)
+    //-------------------------------------------------------------------
+    {
+        if (!pvsGeneratorCallbackFunc)
+            return E_FAIL;
+
+        m_pFnPVSGeneratorCallback = pvsGeneratorCallbackFunc;
+
+        return S_OK;
+    }
+
+
 //-----------------------------------------------------------------------
     HRESULT Scene::SetProgressCallbackPayload(void *pPayload)
     //-------------------------------------------------------------------
@@ -530,37 +570,31 @@ std::vector< Chunk > *g_pSortingChunks;
         if (origin == target)
             return true;
 
-        Vector3 upVector;
-
-        if (m_pSettings->spacePartitionAxis == SS_AXIS_X)
-            upVector = Vector3(1, 0, 0);
-        else if (m_pSettings->spacePartitionAxis == SS_AXIS_Y)
-            upVector = Vector3(0, 1, 0);
-        else if (m_pSettings->spacePartitionAxis == SS_AXIS_Z)
-            upVector = Vector3(0, 0, 1);
+        // Neighbouring leafs can always see into each other
+        if (origin->m_min.x <= target->m_max.x && target->m_min.x <= origin->m_max.x &&
+            origin->m_min.y <= target->m_max.y && target->m_min.y <= origin->m_max.y &&
+            origin->m_min.z <= target->m_max.z && target->m_min.z <= origin->m_max.z)
+            return true;
 
-        if (m_pSettings->spacePartitionMode == SS_QUADTREE)
-        {
+        Vector3 originSize = origin->m_max - origin->m_min;
+        Vector3 targetSize = target->m_max - target->m_min;
 
-        }
-        else if (m_pSettings->spacePartitionMode == SS_OCTTREE)
+        // The ends of the sight lines are spread through each leaf with a Halton sequence, which covers
+        // the box more evenly than random points, and gives the same PVS every time.
+        for (unsigned int i = 1; i <= PVS_SAMPLES_PER_LEAF_PAIR; i++)
         {
-            if (TestVisibility(target, CreateVisibilityFrustum(origin, Vector3(1,  0,  0), upVector)))
-                return true;
-
-            if (TestVisibility(target, CreateVisibilityFrustum(origin, Vector3(0,  1,  0), upVector)))
-                return true;
-
-            if (TestVisibility(target, CreateVisibilityFrustum(origin, Vector3(0,  0,  1), upVector)))
-                return true;
+            Vector3 from(origin->m_min.x + originSize.x * RadicalInverse(i, 2),
+                         origin->m_min.y + originSize.y * RadicalInverse(i, 3),
+                         origin->m_min.z + originSize.z * RadicalInverse(i, 5));
 
-            if (TestVisibility(target, CreateVisibilityFrustum(origin, Vector3(-1,  0,  0), upVector)))
-                return true;
+            Vector3 to(target->m_min.x + targetSize.x * RadicalInverse(i, 7),
+                       target->m_min.y + targetSize.y * RadicalInverse(i, 11),
+                       target->m_min.z + targetSize.z * RadicalInverse(i, 13));
 
-            if (TestVisibility(target, CreateVisibilityFrustum(origin, Vector3(0, -1,  0), upVector)))
-                return true;
+            IntersectionResult result;
 
-            if (TestVisibility(target, CreateVisibilityFrustum(origin, Vector3(0,  0, -1), upVector)))
+            // Any hit between the two points blocks the line, so there is no need to find the nearest
+            if (!Intersect(result, from, to - from, IF_ALL | IF_ANYHIT, 1.0f))
                 return true;
         }
 
@@ -577,7 +611,7 @@ std::vector< Chunk > *g_pSortingChunks;
         // Reset Partitioning information
             Reset(true, false);
 
-            m_pSpacePartitionOutline = new Geometry(m_pD3DDevice);
+            m_pSpacePartitionOutline = new Geometry(m_pDevice);
 
         if (m_sourceGeometry.size() < 1)
             return S_OK;
@@ -685,6 +719,10 @@ std::vector< Chunk > *g_pSortingChunks;
             if (m_pFnProgressCallback)
                 m_pFnProgressCallback(PC_SCENE_SPACEPARTITIONING, m_spacePartitionProgress, m_pProgressCallbackPayload);
 
+            INT64 timerFrequency = 0, startTime = 0;
+            QueryPerformanceFrequency((LARGE_INTEGER *)&timerFrequency);
+            QueryPerformanceCounter((LARGE_INTEGER *)&startTime);
+
             // Build a temporary m_pRoot _NodeChunkMap * that contains all the geometry.
             unsigned int numPolygons = 0;
 
@@ -694,9 +732,103 @@ std::vector< Chunk > *g_pSortingChunks;
             {
                 GenerateLeaf(m_pRoot, pRootNodeChunkMap);
             }
-            else
+            else if (pRootNodeChunkMap)
             {
-                Partition(m_pRoot, 0, pRootNodeChunkMap, NULL, numPolygons);
+                _PartitionState state;
+                PartitionTaskList tasks;
+
+                _PartitionJob jobs[MAX_WORKER_THREADS];
+                int numJobs = 0;
+
+                if (pRootNodeChunkMap->IsEmpty())
+                {
+                    _PartitionTask leaf = { m_pRoot, 0, 0, NULL };
+                    state.leafs.push_back(leaf);
+                }
+                else if (LockSourceGeometry())
+                {
+                    // Large worlds are partitioned to a depth with enough subtrees to share between the
+                    // processors, then the worker threads partition the subtrees.
+                    int numWorkers = GetNumWorkers();
+
+                    if (numWorkers > 1 && numPolygons >= MIN_THREADED_PARTITION_POLYGONS)
+                    {
+                        int numChildren = m_pSettings->spacePartitionMode == SS_OCTTREE ? 8 : 4;
+
+                        for (int numTasks = 1; numTasks < numWorkers * PARTITION_TASKS_PER_WORKER; numTasks *= numChildren)
+                            state.taskDepth++;
+
+                        state.pTasks = &tasks;
+                    }
+
+                    Partition(m_pRoot, 0, pRootNodeChunkMap, numPolygons, state);
+
+                    if (!tasks.empty())
+                    {
+                        LONG nextTask = 0;
+                        void *params[MAX_WORKER_THREADS];
+
+                        numJobs = numWorkers < (int)tasks.size() ? numWorkers : (int)tasks.size();
+
+                        for (int j = 0; j < numJobs; j++)
+                        {
+                            jobs[j].pScene = this;
+                            jobs[j].pTasks = &tasks;
+                            jobs[j].pNextTask = &nextTask;
+                            params[j] = &jobs[j];
+                        }
+
+                        RunWorkers(PartitionJob, params, numJobs);
+                    }
+
+                    UnlockSourceGeometry();
+                }
+                else
+                {
+                    Logf("Scene::SubdivideWorld() - Failed to lock the source geometry.");
+                }
+
+                // Generate the leafs in tree order, so that they are the same however the work was shared
+                    std::map< TreeNode *, _NodeChunkMap * > leafs;
+
+                    m_subdivisionsExecuted = state.maxSubdivisions;
+
+                    unsigned int numChunkMaps = state.numChunkMaps + 1;
+                    unsigned int numChunkMapBytes = state.numChunkMapBytes + (unsigned int)pRootNodeChunkMap->GetNumBytes();
+
+                    unsigned int l;
+                    for (l = 0; l < state.leafs.size(); l++)
+                        leafs[state.leafs[l].pNode] = state.leafs[l].pNodeChunkMap;
+
+                    for (int j = 0; j < numJobs; j++)
+                    {
+                        if (jobs[j].state.maxSubdivisions > m_subdivisionsExecuted)
+                            m_subdivisionsExecuted = jobs[j].state.maxSubdivisions;
+
+                        numChunkMaps += jobs[j].state.numChunkMaps;
+                        numChunkMapBytes += jobs[j].state.numChunkMapBytes;
+
+                        for (l = 0; l < jobs[j].state.leafs.size(); l++)
+                            leafs[jobs[j].state.leafs[l].pNode] = jobs[j].state.leafs[l].pNodeChunkMap;
+                    }
+
+                    INT64 partitionTime = 0;
+                    QueryPerformanceCounter((LARGE_INTEGER *)&partitionTime);
+
+                    m_numNodes = 0;
+                    RecurseGeneratePartitionLeafs(m_pRoot, leafs);
+
+                    INT64 endTime = 0;
+                    QueryPerformanceCounter((LARGE_INTEGER *)&endTime);
+
+                    if (timerFrequency > 0)
+                    {
+                        Logf(LL_LOWEST, _T("Scene::SubdivideWorld() - %u polygons, %d nodes, %d leafs, %d jobs: partition %.3fs, leafs %.3fs"),
+                             numPolygons, m_numNodes, (int)m_leafs.size(), numJobs,
+                             (float)(partitionTime - startTime) / timerFrequency, (float)(endTime - partitionTime) / timerFrequency);
+                    }
+
+                    Logf(LL_LOWEST, _T("Scene::SubdivideWorld() - %u node chunk maps, %u KB"), numChunkMaps, numChunkMapBytes / 1024);
             }
 
             delete pRootNodeChunkMap;
@@ -709,7 +841,7 @@ std::vector< Chunk > *g_pSortingChunks;
                     continue;
 
                 og->second->CreateChunkIndices();
-                og->second->CreateVertexIndices(og->first->GetD3DDevice());
+                og->second->CreateVertexIndices(og->first->GetDevice());
 
                 /*std::map< unsigned int, std::vector< unsigned int > * >::iterator v = og->second->m_vertexIndexMap.begin();
                 for (; v != og->second->m_vertexIndexMap.end(); ++v)
@@ -797,9 +929,37 @@ std::vector< Chunk > *g_pSortingChunks;
             }
 
         // Generate PVS Data
-            if (m_pSettings->visibilityMode == SS_ENABLED)
+            if (m_pSettings->visibilityMode == SS_ENABLED && m_pFnPVSGeneratorCallback && !m_leafs.empty())
             {
+                m_pvsProgress = 0;
+
+                if (m_pFnProgressCallback)
+                    m_pFnProgressCallback(PC_SCENE_PVS, m_pvsProgress, m_pProgressCallbackPayload);
+
+                INT64 timerFrequency = 0, startTime = 0;
+                QueryPerformanceFrequency((LARGE_INTEGER *)&timerFrequency);
+                QueryPerformanceCounter((LARGE_INTEGER *)&startTime);
+
+                std::vector< byte * > clusters;
+                m_pFnPVSGeneratorCallback(this, &clusters, m_pFnProgressCallback, m_pProgressCallbackPayload);
+
+                if (clusters.size() == m_leafs.size())
+                    CompressPVS(clusters);
+                else
+                    Logf("Scene::SubdivideWorld() - PVS generator gave %d clusters for %d leafs.", (int)clusters.size(), (int)m_leafs.size());
+
+                std::vector< byte * >::iterator c = clusters.begin();
+                for (; c != clusters.end(); c++)
+                    delete[] *c;
 
+                INT64 endTime = 0;
+                QueryPerformanceCounter((LARGE_INTEGER *)&endTime);
+
+                if (timerFrequency > 0)
+                {
+                    Logf(LL_LOWEST, _T("Scene::SubdivideWorld() - PVS of %d leafs, %d bytes per cluster: %.3fs"),
+                         m_numClusters, m_bytesPerCluster, (float)(endTime - startTime) / timerFrequency);
+                }
             }
 
         // Create Draw Partition
@@ -872,6 +1032,7 @@ pResult (return value) [out] NodeChunkMap contains all geometry within the given
 
         // There is no parent to read from, then use all available geometry.
             bool useIndices = true;
+            unsigned int source = 0;
 
             GeometryList::iterator g = m_sourceGeometry.begin();
             for (; g != m_sourceGeometry.end(); g++)
@@ -884,15 +1045,16 @@ pResult (return value) [out] NodeChunkMap contains all geometry within the given
                 if (pCurGeometry->GetNumVertexIndices() < 1)
                     useIndices = false;
 
-                _OrderedGeometryMap *pOrderedGeometryMap = new _OrderedGeometryMap;
-
                 // Lock
                     if (useIndices)
                     {
                         if (pCurGeometry->GetIndexFormat() == IT_32)
                         {
                             if (FAILED(pCurGeometry->Lock((PVOID*)&chunks, &pVertsLocked, NULL, (PVOID*)&pIndicesLocked)))
+                            {
+                                delete pResult;
                                 return NULL;
+                            }
                         }
                         else if (pCurGeometry->GetIndexFormat() == IT_16)
                         {
@@ -902,7 +1064,11 @@ pResult (return value) [out] NodeChunkMap contains all geometry within the given
                             PVOID pIndicesLockedTemp = NULL;
 
                             if (FAILED(pCurGeometry->Lock((PVOID*)&chunks, &pVertsLocked, NULL, &pIndicesLockedTemp)))
+                            {
+                                delete[] pIndicesLocked;
+                                delete pResult;
                                 return NULL;
+                            }
 
                             for (int i = 0; i < numIndices; i++)
                                 pIndicesLocked[i] = (int)((short int *)pIndicesLockedTemp)[i];
@@ -911,25 +1077,28 @@ pResult (return value) [out] NodeChunkMap contains all geometry within the given
                     else
                     {
                         if (FAILED(pCurGeometry->Lock((PVOID*)&chunks, &pVertsLocked, NULL, NULL)))
+                        {
+                            delete pResult;
                             return NULL;
+                        }
                     }
 
                 // Extract geometry
-                    for (unsigned int i = 0; i < (unsigned int)pCurGeometry->GetNumChunks(); i++)
-                    {
-                        Chunk &chunk = chunks[i];
-
-                        // TODO: Handle failures below
-
-                        _GeometryMap *pGeometryMap = pOrderedGeometryMap->GetPtr(chunk.order);
+                    unsigned int numIndices = 0;
 
-                        _ChunkIndexList *pChunkIndexList = pGeometryMap->GetPtr(pCurGeometry);
+                    unsigned int i;
+                    for (i = 0; i < (unsigned int)pCurGeometry->GetNumChunks(); i++)
+                        numIndices += useIndices ? chunks[i].numIndices : chunks[i].numVerts;
 
-                        //_VertexIndexList *pVertexIndexList = pChunkIndexList->GetPtr(i);
+                    pResult->runs.reserve(pResult->runs.size() + pCurGeometry->GetNumChunks());
+                    pResult->indices.reserve(pResult->indices.size() + numIndices);
 
-                        _IndexSet *pIndexSet = pChunkIndexList->GetPtr(i);
+                    for (i = 0; i < (unsigned int)pCurGeometry->GetNumChunks(); i++)
+                    {
+                        Chunk &chunk = chunks[i];
 
-                        unsigned int vertexIndexListId = pIndexSet->Create();
+                        _ChunkRun run = { source, chunk.order, pCurGeometry, i, 0, 0 };
+                        pResult->CreateRun(run);
 
                         switch (chunk.type)
                         {
@@ -962,21 +1131,19 @@ pResult (return value) [out] NodeChunkMap contains all geometry within the given
                         {
                             for (unsigned int v = 0; v < chunk.numIndices; v++)
                             {
-                                //pVertexIndexList->PushBack(pIndicesLocked[chunk.startIndex + v]);
-                                ((*pIndexSet)[vertexIndexListId])->PushBack(pIndicesLocked[chunk.startIndex + v]);
+                                pResult->PushBack(pIndicesLocked[chunk.startIndex + v]);
                             }
                         }
                         else
                         {
                             for (unsigned int v = 0; v < chunk.numVerts; v++)
                             {
-                                //pVertexIndexList->PushBack(chunk.startIndex + v);
-                                ((*pIndexSet)[vertexIndexListId])->PushBack(chunk.startIndex + v);
+                                pResult->PushBack(chunk.startIndex + v);
                             }
                         }
                     }
 
-                pResult->m.push_back(pOrderedGeometryMap);
+                ++source;
 
                 // Unlock
                     (*g)->Unlock();
@@ -993,19 +1160,22 @@ pResult (return value) [out] NodeChunkMap contains all geometry within the given
             *pNumPolygons = numPolygons;
         }
 
-        if (pResult->m.empty())
+        if (pResult->runs.empty())
         {
             delete pResult;
             return NULL;
         }
 
+        // The chunks were read in geometry order; the partition keeps them sorted from here on.
+        SortChunkRuns(pResult->runs);
+
         return pResult;
     }
 
 
 //-----------------------------------------------------------------------
-    Scene::_NodeChunkMap *Scene::CreateNodeChunkMap(Scene::_NodeChunkMap *pNodeChunkMap, Scene::_NodeChunkMap *pRemainder,
-                                                    const Math::AABB &bounds, unsigned int *pNumPolygons)
+    Scene::_NodeChunkMap *Scene::CreateNodeChunkMap(const Scene::_NodeChunkMap *pNodeChunkMap, Scene::_NodeChunkMap *pRemainder,
+                                                    const Math::AABB &bounds, _PartitionState &state, unsigned int *pNumPolygons)
     //-------------------------------------------------------------------
     {
         typedef bool (* SimpleAABBTriangleIntersectionFuncPtr)(const Math::AABB &, const Vector3 *);
@@ -1029,443 +1199,303 @@ pResult (return value) [out] NodeChunkMap contains all geometry within the given
         }
 
 #ifdef VERBOSE_PARTITIONING
-        DebugPrintf(_T("CreateNodeChunkMap: (%.3f, %.3f, %.3f) - (%.3f, %.3f, %.3f)\n"), bounds.min.x, bounds.min.y, bounds.min.z, bounds.max.x, bounds.max.y, bounds.max.z);
+        DebugPrintf(_T("\nCreateNodeChunkMap()\n\tPartitioning Geometry for node (min = (%.2f, %.2f, %.2f), max = (%.2f, %.2f, %.2f))\n"),
+                   bounds.min.x, bounds.min.y, bounds.min.z, bounds.max.x, bounds.max.y, bounds.max.z);
+
+        DebugPrintf(_T("\tNodeChunkMap runs = %d, indices = %d\n"), pNodeChunkMap->runs.size(), pNodeChunkMap->indices.size());
 #endif
 
-        _NodeChunkMap *pResult = new _NodeChunkMap;
+        // The runs are gathered in state.result, which is reused from node to node, and only the
+        // finished map is copied out. The source runs are sorted, so the result and remainder are too.
+        _NodeChunkMap &result = state.result;
+        result.Clear();
+
+        if (pRemainder)
+            pRemainder->Clear();
 
-        Chunk *chunks = NULL;
-        PVOID pVertsLocked = NULL;
-        int *pIndicesLocked = NULL;
         unsigned int numPolygons = 0;
 
         bool useIndices = true;
 
-#ifdef VERBOSE_PARTITIONING
-        DebugPrintf(_T("\nCreateNodeChunkMap()\n\tPartitioning Geometry for node (min = (%.2f, %.2f, %.2f), max = (%.2f, %.2f, %.2f))\n"),
-                   bounds.min.x, bounds.min.y, bounds.min.z, bounds.max.x, bounds.max.y, bounds.max.z);
+        PGEOMETRY pLockedGeometry = NULL;
+        Chunk *chunks = NULL;
+        PVOID pVertsLocked = NULL;
 
-        DebugPrintf(_T("\tNodeChunkMap size = %d\n"), pNodeChunkMap->m.size());
-#endif
+        const VertexIndexList &srcIndices = pNodeChunkMap->indices;
 
-        NodeChunkMap::const_iterator ncmItr = pNodeChunkMap->m.begin();
-        for (; ncmItr != pNodeChunkMap->m.end(); ncmItr++)
+        ChunkRunList::const_iterator runItr = pNodeChunkMap->runs.begin();
+        for (; runItr != pNodeChunkMap->runs.end(); runItr++)
         {
-            if ((*ncmItr)->m.empty())
-                continue;
-
-            const OrderedGeometryMap &ogm = (*ncmItr)->m;
+            const _ChunkRun &srcRun = *runItr;
+            PGEOMETRY pGeometry = srcRun.pGeometry;
 
+            if (!pGeometry)
+            {
 #ifdef VERBOSE_PARTITIONING
-            DebugPrintf(_T("\t\tOrderedGeometryMap size = %d\n"), ogm.size());
+                DebugPrintf(_T("\tNo Geometry to Partition.\n"));
 #endif
+                continue;
+            }
 
-            OrderedGeometryMap::const_iterator ogmItr = ogm.begin();
-            for (; ogmItr != ogm.end(); ogmItr++)
-            {
-                if (ogmItr->second->m.empty())
-                    continue;
+            if (pGeometry->GetNumVertexIndices() < 1)
+                useIndices = false;
 
-#ifdef VERBOSE_PARTITIONING
-                DebugPrintf(_T("\tSearching OrderedGeometryMap at order = %d\n"), ogmItr->first);
-#endif
-                const GeometryMap &gm = ogmItr->second->m;
+            if (!useIndices || srcRun.numIndices < 1)
+                continue;
+
+            // The source geometry is locked by SubdivideWorld() for the whole partition
+                if (pGeometry != pLockedGeometry)
+                {
+                    LockedGeometryMap::const_iterator locked = m_lockedGeometry.find(pGeometry);
+
+                    if (locked == m_lockedGeometry.end())
+                        return NULL;
+
+                    pLockedGeometry = pGeometry;
+                    chunks = locked->second.pChunks;
+                    pVertsLocked = locked->second.pVerts;
+                }
 
 #ifdef VERBOSE_PARTITIONING
-                DebugPrintf(_T("\t\t\tGeometryMap size = %d\n"), gm.size());
+            DebugPrintf(_T("\t\tSearching Chunk %d (order = %d, indices = %d).\n"), srcRun.chunk, srcRun.order, srcRun.numIndices);
 #endif
 
-                GeometryMap::const_iterator gmItr = gm.begin();
-                for (; gmItr != gm.end(); gmItr++)
+            const Chunk &chunk = chunks[srcRun.chunk];
+            const unsigned int *pSrcIndices = &srcIndices[srcRun.startIndex];
+
+            // Extract geometry with bounds testing
+            switch (chunk.type)
+            {
+            case CT_TRIANGLELIST:
                 {
-                    PGEOMETRY pGeometry = gmItr->first;
+                    bool created = false;
 
-                    if (!pGeometry)
+                    for (unsigned int p = 0; p + 2 < srcRun.numIndices; p += 3)
                     {
-#ifdef VERBOSE_PARTITIONING
-                        DebugPrintf(_T("\tNo Geometry to Partition.\n"), ogmItr->first);
-#endif
-                        continue;
-                    }
+                        Vector3 vertices[3];
 
-                    if (pGeometry->GetNumChunks() < 1 || pGeometry->GetNumVertices() < 1)
-                    {
-#ifdef VERBOSE_PARTITIONING
-                        DebugPrintf(_T("\tNo Geometry to Partition.\n"), ogmItr->first);
-#endif
-                        continue;
-                    }
+                        unsigned int t0 = pSrcIndices[p];
+                        unsigned int t1 = pSrcIndices[p + 1];
+                        unsigned int t2 = pSrcIndices[p + 2];
 
-                    if (pGeometry->GetNumVertexIndices() < 1)
-                        useIndices = false;
+                        vertices[0] = pGeometry->GetVertexPosition(pVertsLocked, t0);
+                        vertices[1] = pGeometry->GetVertexPosition(pVertsLocked, t1);
+                        vertices[2] = pGeometry->GetVertexPosition(pVertsLocked, t2);
 
-                    if (gmItr->second->m.empty())
-                    {
-#ifdef VERBOSE_PARTITIONING
-                        DebugPrintf(_T("\tNo Geometry to Partition.\n"), ogmItr->first);
-#endif
-                        continue;
-                    }
+                        bool intersects = false;
+                        bool contains = false;
 
-                    _OrderedGeometryMap *pOrderedGeometryMap = new _OrderedGeometryMap;
-                    _OrderedGeometryMap *pRemainderOrderedGeometryMap = NULL;
+                        if (Math::AABBContainsTriangle(bounds, vertices))
+                        {
+                            intersects = true;
+                            contains = true;
+                        }
 
-                    if (pRemainder)
-                    {
-                        pRemainderOrderedGeometryMap = new _OrderedGeometryMap;
-                    }
+                        if (!contains && pSimpleAABBTriangleIntersection(bounds, vertices))
+                        {
+                            intersects = true;
+                        }
 
-                    // Lock
-                        if (useIndices)
+                        if (intersects)
                         {
-                            if (pGeometry->GetIndexFormat() == IT_32)
+                            if (!created)
                             {
-                                if (FAILED(pGeometry->Lock((PVOID*)&chunks, &pVertsLocked, NULL, (PVOID*)&pIndicesLocked)))
-                                    return NULL;
+                                result.CreateRun(srcRun);
+                                created = true;
                             }
-                            else if (pGeometry->GetIndexFormat() == IT_16)
-                            {
-                                int numIndices = pGeometry->GetNumVertexIndices();
-                                pIndicesLocked = new int[numIndices];
-
-                                PVOID pIndicesLockedTemp = NULL;
 
-                                if (FAILED(pGeometry->Lock((PVOID*)&chunks, &pVertsLocked, NULL, &pIndicesLockedTemp)))
-                                    return NULL;
+                            result.PushBack(t0);
+                            result.PushBack(t1);
+                            result.PushBack(t2);
 
-                                for (int i = 0; i < numIndices; i++)
-                                    pIndicesLocked[i] = (int)((short int *)pIndicesLockedTemp)[i];
+                            if (contains)
+                            {
+                                continue;
                             }
                         }
-                        else
-                        {
-                            if (FAILED(pGeometry->Lock((PVOID*)&chunks, &pVertsLocked, NULL, NULL)))
-                                return NULL;
-                        }
 
-#ifdef VERBOSE_PARTITIONING
-                        for (int v = 0; v < (int)pGeometry->GetNumVertices(); v++)
+                        // Each triangle left over is a list of its own
+                        if (pRemainder)
                         {
-                            const Vector3 &vertex = pGeometry->GetVertexPosition(pVertsLocked, v);
-                            DebugPrintf("Vertex %d = (%.3f, %.3f, %.3f)\n", v, vertex.x, vertex.y, vertex.z);
+                            pRemainder->CreateRun(srcRun);
+                            pRemainder->PushBack(t0);
+                            pRemainder->PushBack(t1);
+                            pRemainder->PushBack(t2);
                         }
+                    }
+                }
+                break;
 
-                        DebugPrintf("\n");
+            case CT_TRIANGLESTRIP:
+                {
+                    bool inResult = false;
+                    bool inRemainder = false;
 
-                        for (v = 0; v < (int)pGeometry->GetNumVertexIndices(); v++)
-                        {
-                            DebugPrintf("Vertex Index %d = %d\n", v, pIndicesLocked[v]);
-                        }
-#endif
+                    for (unsigned int p = 2; p < srcRun.numIndices; p++)
+                    {
+                        Vector3 vertices[3];
 
-                    // Extract geometry with bounds testing
-                        const ChunkIndexList &cil = gmItr->second->m;
+                        unsigned int t0 = pSrcIndices[p];
+                        unsigned int t1 = pSrcIndices[p - 1];
+                        unsigned int t2 = pSrcIndices[p - 2];
 
-#ifdef VERBOSE_PARTITIONING
-                        DebugPrintf(_T("\t\t\t\tChunkIndexList size = %d\n"), cil.size());
-#endif
+                        vertices[0] = pGeometry->GetVertexPosition(pVertsLocked, t0);
+                        vertices[1] = pGeometry->GetVertexPosition(pVertsLocked, t1);
+                        vertices[2] = pGeometry->GetVertexPosition(pVertsLocked, t2);
 
-                        ChunkIndexList::const_iterator cilItr = cil.begin();
-                        for (; cilItr != cil.end(); cilItr++)
-                        {
-#ifdef VERBOSE_PARTITIONING
-                            DebugPrintf(_T("\t\tSearching Chunk %d.\n"), cilItr->first);
-#endif
-                            Chunk &chunk = chunks[cilItr->first];
+                        bool intersects = false;
+                        bool contains = false;
 
-                            // TODO: handle failure
-                            _GeometryMap *pGeometryMap = pOrderedGeometryMap->GetPtr(chunk.order);
-                            _GeometryMap *pRemainderGeometryMap = NULL;
+                        if (Math::AABBContainsTriangle(bounds, vertices))
+                        {
+                            intersects = true;
+                            contains = true;
+                        }
+                        else if (pSimpleAABBTriangleIntersection(bounds, vertices))
+                        {
+                            intersects = true;
+                        }
 
-                            if (pRemainder)
+                        // A run of triangles that is broken starts a new strip
+                        if (intersects)
+                        {
+                            if (!inResult)
                             {
-                                pRemainderGeometryMap = pRemainderOrderedGeometryMap->GetPtr(chunk.order);
+                                result.CreateRun(srcRun);
+                                result.PushBack(t2);
+                                result.PushBack(t1);
+                                inResult = true;
                             }
 
-                            // TODO: handle failure
-                            _ChunkIndexList *pChunkIndexList = pGeometryMap->GetPtr(pGeometry);
-                            _ChunkIndexList *pRemainderChunkIndexList = NULL;
+                            result.PushBack(t0);
 
-                            if (pRemainder)
+                            if (contains)
+                            {
+                                inRemainder = false;
+                                continue;
+                            }
+                        }
+                        else
+                        {
+                            inResult = false;
+                        }
+
+                        if (pRemainder)
+                        {
+                            if (!inRemainder)
                             {
-                                pRemainderChunkIndexList = pRemainderGeometryMap->GetPtr(pGeometry);
+                                pRemainder->CreateRun(srcRun);
+                                pRemainder->PushBack(t2);
+                                pRemainder->PushBack(t1);
+                                inRemainder = true;
                             }
 
-                            const IndexSet &srcIndexSet = cilItr->second->m;
+                            pRemainder->PushBack(t0);
+                        }
+                    }
+                }
+                break;
+
+            case CT_POINTLIST:
+                {
+                    bool created = false;
+
+                    for (unsigned int p = 0; p < srcRun.numIndices; p++)
+                    {
+                        unsigned int t = pSrcIndices[p];
+
+                        const Vector3 &vertex = pGeometry->GetVertexPosition(pVertsLocked, t);
 
-                            if (srcIndexSet.empty())
+                        if (Math::AABBPointCollision(bounds, vertex))
+                        {
+                            if (!created)
                             {
-                                continue;
+                                result.CreateRun(srcRun);
+                                created = true;
                             }
 
-                            _IndexSet *pIndexSet = pChunkIndexList->GetPtr(cilItr->first);
-                            _IndexSet *pRemainderIndexSet = NULL;
+                            result.PushBack(t);
 
                             if (pRemainder)
                             {
-                                pRemainderIndexSet = pRemainderChunkIndexList->GetPtr(cilItr->first);
+                                pRemainder->CreateRun(srcRun);
+                                pRemainder->PushBack(t);
                             }
+                        }
+                    }
+                }
+                break;
 
-                            if (useIndices)
-                            {
-                                switch (chunk.type)
-                                {
-                                case CT_POLYGON:
-                                    {
-                                        int poo = 0;
-                                    }
-                                    break;
+            case CT_POLYGON:
+            case CT_LINELIST:
+            case CT_LINESTRIP:
+                break;
+            }
+        }
 
-                                case CT_TRIANGLELIST:
-                                    {
-                                        IndexSet::const_iterator isItr = srcIndexSet.begin();
-                                        for (; isItr != srcIndexSet.end(); isItr++)
-                                        {
-                                            _VertexIndexList *pSrcVertexIndexList = *isItr;
+        _NodeChunkMap *pResult = new _NodeChunkMap(result);
 
-                                            unsigned int vertexIndexListId = INT_MAX;
-                                            unsigned int remainderVertexIndexListId = INT_MAX;
+        ++state.numChunkMaps;
+        state.numChunkMapBytes += (unsigned int)pResult->GetNumBytes();
 
-                                            for (unsigned int p = 0; p < pSrcVertexIndexList->m.size(); p += 3)
-                                            {
-                                                Vector3 vertices[3];
-
-                                                unsigned int t0 = pSrcVertexIndexList->m[p];
-                                                unsigned int t1 = pSrcVertexIndexList->m[p + 1];
-                                                unsigned int t2 = pSrcVertexIndexList->m[p + 2];
-
-                                                vertices[0] = pGeometry->GetVertexPosition(pVertsLocked, t0);
-                                                vertices[1] = pGeometry->GetVertexPosition(pVertsLocked, t1);
-                                                vertices[2] = pGeometry->GetVertexPosition(pVertsLocked, t2);
-
-                                                bool intersects = false;
-                                                bool contains = false;
-
-                                                if (Math::AABBContainsTriangle(bounds, vertices))
-                                                {
-                                                    intersects = true;
-                                                    contains = true;
-                                                }
-
-                                                if (!contains && pSimpleAABBTriangleIntersection(bounds, vertices))
-                                                {
-                                                    intersects = true;
-                                                }
-
-                                                if (intersects)
-                                                {
-                                                    if (vertexIndexListId == INT_MAX)
-                                                    {
-                                                        vertexIndexListId = pIndexSet->Create();
-                                                    }
-
-                                                    _VertexIndexList *pVertexIndexList = (*pIndexSet)[vertexIndexListId];
-                                                    pVertexIndexList->PushBack(t0);
-                                                    pVertexIndexList->PushBack(t1);
-                                                    pVertexIndexList->PushBack(t2);
-
-                                                    if (contains)
-                                                    {
-                                                        continue;
-                                                    }
-                                                }
-
-                                                if (pRemainder)
-                                                {
-                                                    if (remainderVertexIndexListId == INT_MAX)
-                                                    {
-                                                        remainderVertexIndexListId = pRemainderIndexSet->Create();
-                                                    }
-
-                                                    _VertexIndexList *pRemainderVertexIndexList = (*pRemainderIndexSet)[pRemainderIndexSet->Create()];
-
-                                                    pRemainderVertexIndexList->PushBack(t0);
-                                                    pRemainderVertexIndexList->PushBack(t1);
-                                                    pRemainderVertexIndexList->PushBack(t2);
-                                                }
-                                            }
-                                        }
-                                    }
-                                    break;
+        if (pNumPolygons)
+            *pNumPolygons = numPolygons;
 
-                                case CT_TRIANGLESTRIP:
-                                    {
-                                        IndexSet::const_iterator isItr = srcIndexSet.begin();
-                                        for (; isItr != srcIndexSet.end(); isItr++)
-                                        {
-                                            _VertexIndexList *pSrcVertexIndexList = *isItr;
+        return pResult;
+    }
 
-                                            unsigned int vertexIndexListId = INT_MAX;
-                                            unsigned int remainderVertexIndexListId = INT_MAX;
 
-                                            for (unsigned int p = 2; p < (*isItr)->m.size(); p++)
-                                            {
-                                                Vector3 vertices[3];
-
-                                                unsigned int t0 = (*isItr)->m[p];
-                                                unsigned int t1 = (*isItr)->m[p - 1];
-                                                unsigned int t2 = (*isItr)->m[p - 2];
-
-                                                vertices[0] = pGeometry->GetVertexPosition(pVertsLocked, t0);
-                                                vertices[1] = pGeometry->GetVertexPosition(pVertsLocked, t1);
-                                                vertices[2] = pGeometry->GetVertexPosition(pVertsLocked, t2);
-
-                                                bool intersects = false;
-                                                bool contains = false;
-
-                                                if (Math::AABBContainsTriangle(bounds, vertices))
-                                                {
-                                                    intersects = true;
-                                                    contains = true;
-                                                }
-                                                else if (!contains && pSimpleAABBTriangleIntersection(bounds, vertices))
-                                                {
-                                                    intersects = true;
-                                                }
-
-                                                if (intersects)
-                                                {
-                                                    if (vertexIndexListId == INT_MAX)
-                                                    {
-                                                        vertexIndexListId = pIndexSet->Create();
-                                                        _VertexIndexList *pVertexIndexList = (*pIndexSet)[vertexIndexListId];
-
-                                                        pVertexIndexList->PushBack(t2);
-                                                        pVertexIndexList->PushBack(t1);
-                                                        pVertexIndexList->PushBack(t0);
-                                                    }
-                                                    else
-                                                    {
-                                                        _VertexIndexList *pVertexIndexList = (*pIndexSet)[vertexIndexListId];
-
-                                                        pVertexIndexList->PushBack(t0);
-                                                    }
-
-                                                    if (contains)
-                                                    {
-                                                        remainderVertexIndexListId = INT_MAX;
-                                                        continue;
-                                                    }
-                                                }
-                                                else
-                                                {
-                                                    vertexIndexListId = INT_MAX;
-                                                }
-
-                                                if (pRemainder)
-                                                {
-                                                    if (remainderVertexIndexListId == INT_MAX)
-                                                    {
-                                                        remainderVertexIndexListId = pRemainderIndexSet->Create();
-                                                        _VertexIndexList *pRemainderVertexIndexList = (*pRemainderIndexSet)[remainderVertexIndexListId];
-
-                                                        pRemainderVertexIndexList->PushBack(t2);
-                                                        pRemainderVertexIndexList->PushBack(t1);
-                                                        pRemainderVertexIndexList->PushBack(t0);
-                                                    }
-                                                    else
-                                                    {
-                                                        _VertexIndexList *pRemainderVertexIndexList = (*pRemainderIndexSet)[remainderVertexIndexListId];
-
-                                                        pRemainderVertexIndexList->PushBack(t0);
-                                                    }
-                                                }
-                                            }
-                                        }
-                                    }
-                                    break;
+//-----------------------------------------------------------------------
+    void Scene::SortChunkRuns(ChunkRunList &runs)
+    //-------------------------------------------------------------------
+    {
+        // Stable LSD radix sort on (source, order), a byte at a time. The runs of each source are
+        // already in chunk order, so this leaves them sorted by source, order, geometry and chunk.
+        if (runs.size() < 2)
+            return;
 
-                                case CT_LINELIST:
-                                    {
-                                        int poo = 0;
-                                    }
-                                    break;
+        ChunkRunList temp(runs.size());
 
-                                case CT_LINESTRIP:
-                                    {
-                                        int poo = 0;
-                                    }
-                                    break;
+        ChunkRunList *pSrc = &runs;
+        ChunkRunList *pDst = &temp;
 
-                                case CT_POINTLIST:
-                                    {
-                                        IndexSet::const_iterator isItr = srcIndexSet.begin();
-                                        for (; isItr != srcIndexSet.end(); isItr++)
-                                        {
-                                            _VertexIndexList *pSrcVertexIndexList = *isItr;
+        for (int pass = 0; pass < 8; pass++)
+        {
+            int shift = (pass & 3) * 8;
+            bool bySource = pass >= 4;
 
-                                            unsigned int vertexIndexListId = INT_MAX;
-                                            unsigned int remainderVertexIndexListId = INT_MAX;
+            unsigned int offsets[256];
+            memset(offsets, 0, sizeof(offsets));
 
-                                            for (unsigned int p = 0; p < pSrcVertexIndexList->m.size(); p++)
-                                            {
-                                                unsigned int t = pSrcVertexIndexList->m[p];
-
-                                                const Vector3 &vertex = pGeometry->GetVertexPosition(pVertsLocked, t);
-
-                                                if (Math::AABBPointCollision(bounds, vertex))
-                                                {
-                                                    if (vertexIndexListId == INT_MAX)
-                                                    {
-                                                        vertexIndexListId = pIndexSet->Create();
-                                                    }
-
-                                                    _VertexIndexList *pVertexIndexList = (*pIndexSet)[vertexIndexListId];
-                                                    pVertexIndexList->PushBack(t);
-
-                                                    if (pRemainder)
-                                                    {
-                                                        if (remainderVertexIndexListId == INT_MAX)
-                                                        {
-                                                            remainderVertexIndexListId = pRemainderIndexSet->Create();
-                                                        }
-
-                                                        _VertexIndexList *pRemainderVertexIndexList = (*pRemainderIndexSet)[pRemainderIndexSet->Create()];
-                                                        pRemainderVertexIndexList->PushBack(t);
-                                                    }
-                                                }
-                                            }
-                                        }
-                                    }
-                                    break;
-                                }
-                            }
-                        }
+            ChunkRunList::const_iterator r = pSrc->begin();
+            for (; r != pSrc->end(); r++)
+                ++offsets[((bySource ? r->source : r->order) >> shift) & 0xff];
 
-                    pResult->m.push_back(pOrderedGeometryMap);
+            // All of the keys share this byte, so the pass would not move anything
+            if (offsets[((bySource ? pSrc->front().source : pSrc->front().order) >> shift) & 0xff] == pSrc->size())
+                continue;
 
-                    if (pRemainder)
-                    {
-                        pRemainder->m.push_back(pRemainderOrderedGeometryMap);
-                    }
-
-                    // Unlock
-                        pGeometry->Unlock();
-
-                        if (useIndices && pGeometry->GetIndexFormat() == IT_16)
-                        {
-                            delete[] pIndicesLocked;
-                            pIndicesLocked = NULL;
-                        }
-                }
+            unsigned int total = 0;
+            for (int b = 0; b < 256; b++)
+            {
+                unsigned int count = offsets[b];
+                offsets[b] = total;
+                total += count;
             }
-        }
 
-        if (pResult->m.empty())
-        {
-            delete pResult;
-            return NULL;
-        }
+            for (r = pSrc->begin(); r != pSrc->end(); r++)
+                (*pDst)[offsets[((bySource ? r->source : r->order) >> shift) & 0xff]++] = *r;
 
-        if (pNumPolygons)
-            *pNumPolygons = numPolygons;
+            std::swap(pSrc, pDst);
+        }
 
-        return pResult;
+        if (pSrc != &runs)
+            runs.swap(temp);
     }
 
 
 //-----------------------------------------------------------------------
-    void Scene::Partition(TreeNode *node, int numSubdivisions, _NodeChunkMap *pNodeChunkMap, _NodeChunkMap *pRemainingNodeChunkMap, unsigned int numPrimitives)
+    void Scene::Partition(TreeNode *node, int numSubdivisions, _NodeChunkMap *pNodeChunkMap, unsigned int numPolygons, _PartitionState &state)
     //-------------------------------------------------------------------
     {
 #ifdef VERBOSE_PARTITIONING
@@ -1473,62 +1503,17 @@ pResult (return value) [out] NodeChunkMap contains all geometry within the given
                 node->m_min.x, node->m_min.y, node->m_min.z, node->m_max.x, node->m_max.y, node->m_max.z);
 #endif
 
-        if (!pNodeChunkMap)
-            return;
-
         Vector3 min = node->m_min;
         Vector3 max = node->m_max;
 
-        if (pNodeChunkMap->IsEmpty())
-        {
-            // There is no geometry for this leaf to attempt to partition, so we can create an
-            // empty leaf and return early. Must take a copy of pNodeChunkMap, so that it is cleared up properly.
-
-#ifdef VERBOSE_PARTITIONING
-            DebugPrintf(_T("\tpNodeChunkMap is empty. Storing empty leaf.\n"));
-#endif
-
-            GenerateLeaf(node, NULL);
-
-            UpdateSpacePartitionProgress(node);
-
-            return;
-        }
-
         // Setup local variables
             int numDivisions = numSubdivisions;
 
-            if (numDivisions > m_subdivisionsExecuted)
-                m_subdivisionsExecuted = numDivisions;
-
-            unsigned int numPolygons = numPrimitives;
-            int numEffectGroups = m_pResourceManager->GetNumEffects();
-
-            Chunk *chunks = NULL;
-            PVOID pVertsLocked = NULL;
-            int *pIndicesLocked = NULL;
+            if (numDivisions > state.maxSubdivisions)
+                state.maxSubdivisions = numDivisions;
 
             node->m_leafIndex = -1;
 
-        // Partition Geometry
-            _NodeChunkMap *pResultingNodeChunkMap = NULL;
-
-            if (node->m_pParent)
-            {
-                if (m_pSettings->optimiseChunks)
-                {
-
-                }
-                else
-                {
-                    pResultingNodeChunkMap = CreateNodeChunkMap(pNodeChunkMap, pRemainingNodeChunkMap, Math::AABB(min, max), &numPolygons);
-                }
-            }
-            else
-            {
-                pResultingNodeChunkMap = pNodeChunkMap;
-            }
-
         // Determine if further subdivision is necessary
             float sizeX = max.x - min.x;
             float sizeY = max.y - min.y;
@@ -1585,17 +1570,29 @@ pResult (return value) [out] NodeChunkMap contains all geometry within the given
 
                 Vector3 mid(0, 0, 0);
 
+                // Bit of the child index that selects the upper half of the node along each axis.
+                int xBit = 1, yBit = 4, zBit = 2;
+
                 if (m_pSettings->spacePartitionMode == SS_QUADTREE)
                 {
                     node->m_pChildren = new TreeNode *[4];
                     node->m_numChildren = 4;
 
                     if (m_pSettings->spacePartitionAxis == SS_AXIS_X)
+                    {
                         mid = min + Vector3(sizeX, sizeY * 0.5f, sizeZ * 0.5f);
+                        xBit = 0; yBit = 1; zBit = 2;
+                    }
                     else if (m_pSettings->spacePartitionAxis == SS_AXIS_Y)
+                    {
                         mid = min + Vector3(sizeX * 0.5f, sizeY, sizeZ * 0.5f);
+                        xBit = 1; yBit = 0; zBit = 2;
+                    }
                     else if (m_pSettings->spacePartitionAxis == SS_AXIS_Z)
+                    {
                         mid = min + Vector3(sizeX * 0.5f, sizeY * 0.5f, sizeZ);
+                        xBit = 1; yBit = 2; zBit = 0;
+                    }
                 }
                 else if (m_pSettings->spacePartitionMode == SS_OCTTREE)
                 {
@@ -1604,191 +1601,194 @@ pResult (return value) [out] NodeChunkMap contains all geometry within the given
                     mid = min + Vector3(sizeX * 0.5f, sizeY * 0.5f, sizeZ * 0.5f);
                 }
 
-                if (m_pSettings->spacePartitionMode == SS_QUADTREE)
+                // Node ids are given out in tree order by RecurseGeneratePartitionLeafs().
+                int i;
+                for (i = 0; i < node->m_numChildren; i++)
                 {
-                    if (m_pSettings->spacePartitionAxis == SS_AXIS_X)
-                    {
-                        // Node 0
-                            node->m_pChildren[0] = new TreeNode(min, mid, node, m_numNodes);
-                            m_numNodes++;
+                    Vector3 childMin((i & xBit) ? mid.x : min.x, (i & yBit) ? mid.y : min.y, (i & zBit) ? mid.z : min.z);
+                    Vector3 childMax((i & xBit) ? max.x : mid.x, (i & yBit) ? max.y : mid.y, (i & zBit) ? max.z : mid.z);
 
-                            _NodeChunkMap *pRemainingNodeChunkMap0 = new _NodeChunkMap;
-                            Partition(node->m_pChildren[0], numDivisions, pResultingNodeChunkMap, pRemainingNodeChunkMap0);
+                    node->m_pChildren[i] = new TreeNode(childMin, childMax, node, 0);
+                }
 
-                        // Node 1
-                            node->m_pChildren[1] = new TreeNode(Vector3(min.x, mid.y, min.z), Vector3(mid.x, max.y, mid.z), node, m_numNodes);
-                            m_numNodes++;
+                node->SetChildBounds();
 
-                            _NodeChunkMap *pRemainingNodeChunkMap1 = new _NodeChunkMap;
-                            Partition(node->m_pChildren[1], numDivisions, pRemainingNodeChunkMap0, pRemainingNodeChunkMap1);
+                // Each child is given whatever the children before it did not entirely contain. The
+                // remainders are passed between the two buffers kept in state.
+                _PartitionTask children[8];
+                bool partitionChild[8];
 
-                        // Node 2
-                            node->m_pChildren[2] = new TreeNode(Vector3(min.x, min.y, mid.z), Vector3(mid.x, mid.y, max.z), node, m_numNodes);
-                            m_numNodes++;
+                _NodeChunkMap *pChildSource = pNodeChunkMap;
 
-                            _NodeChunkMap *pRemainingNodeChunkMap2 = new _NodeChunkMap;
-                            Partition(node->m_pChildren[2], numDivisions, pRemainingNodeChunkMap1, pRemainingNodeChunkMap2);
+                for (i = 0; i < node->m_numChildren; i++)
+                {
+                    _NodeChunkMap *pRemainder = i < node->m_numChildren - 1 ? &state.remainder[i & 1] : NULL;
 
-                        // Node 3
-                            node->m_pChildren[3] = new TreeNode(Vector3(min.x, mid.y, mid.z), Vector3(mid.x, max.y, max.z), node, m_numNodes);
-                            m_numNodes++;
+                    children[i].pNode = node->m_pChildren[i];
+                    children[i].numSubdivisions = numDivisions;
+                    children[i].numPolygons = 0;
 
-                            Partition(node->m_pChildren[3], numDivisions, pRemainingNodeChunkMap2, NULL);
+                    partitionChild[i] = CreateChildNodeChunkMap(children[i].pNode, pChildSource, pRemainder, state,
+                                                                &children[i].pNodeChunkMap, &children[i].numPolygons);
 
-                        delete pRemainingNodeChunkMap0;
-                        delete pRemainingNodeChunkMap1;
-                        delete pRemainingNodeChunkMap2;
-                    }
-                    else if (m_pSettings->spacePartitionAxis == SS_AXIS_Y)
-                    {
-                        // Node 0
-                            node->m_pChildren[0] = new TreeNode(min, mid, node, m_numNodes);
-                            m_numNodes++;
+                    pChildSource = pRemainder;
+                }
 
-                            _NodeChunkMap *pRemainingNodeChunkMap0 = new _NodeChunkMap;
-                            Partition(node->m_pChildren[0], numDivisions, pResultingNodeChunkMap, pRemainingNodeChunkMap0);
+                if (node->m_pParent)
+                    delete pNodeChunkMap;
 
-                        // Node 1
-                            node->m_pChildren[1] = new TreeNode(Vector3(mid.x, min.y, min.z), Vector3(max.x, mid.y, mid.z), node, m_numNodes);
-                            m_numNodes++;
+                for (i = 0; i < node->m_numChildren; i++)
+                {
+                    if (!partitionChild[i])
+                        continue;
 
-                            _NodeChunkMap *pRemainingNodeChunkMap1 = new _NodeChunkMap;
-                            Partition(node->m_pChildren[1], numDivisions, pRemainingNodeChunkMap0, pRemainingNodeChunkMap1);
+                    if (state.pTasks && numDivisions == state.taskDepth)
+                        state.pTasks->push_back(children[i]);
+                    else
+                        Partition(children[i].pNode, numDivisions, children[i].pNodeChunkMap, children[i].numPolygons, state);
+                }
+            }
+            else
+            {
+                // The node is not being partitioned, so place the current geometry in this leaf.
 
-                        // Node 2
-                            node->m_pChildren[2] = new TreeNode(Vector3(min.x, min.y, mid.z), Vector3(mid.x, mid.y, max.z), node, m_numNodes);
-                            m_numNodes++;
+#ifdef VERBOSE_PARTITIONING
+                DebugPrintf(_T("\tNot Subdividing. Creating the leaf.\n"));
+#endif
 
-                            _NodeChunkMap *pRemainingNodeChunkMap2 = new _NodeChunkMap;
-                            Partition(node->m_pChildren[2], numDivisions, pRemainingNodeChunkMap1, pRemainingNodeChunkMap2);
+                _PartitionTask leaf = { node, numDivisions, numPolygons, pNodeChunkMap };
+                state.leafs.push_back(leaf);
+            }
+    }
 
-                        // Node 3
-                            node->m_pChildren[3] = new TreeNode(Vector3(mid.x, min.y, mid.z), Vector3(max.x, mid.y, max.z), node, m_numNodes);
-                            m_numNodes++;
 
-                            Partition(node->m_pChildren[3], numDivisions, pRemainingNodeChunkMap2, NULL);
+//-----------------------------------------------------------------------
+    bool Scene::CreateChildNodeChunkMap(TreeNode *pChild, _NodeChunkMap *pNodeChunkMap, _NodeChunkMap *pRemainder,
+                                        _PartitionState &state, _NodeChunkMap **ppResult, unsigned int *pNumPolygons)
+    //-------------------------------------------------------------------
+    {
+        // Returns true if pChild is to be partitioned, with *ppResult holding the geometry within it.
+        (*ppResult) = NULL;
 
-                        delete pRemainingNodeChunkMap0;
-                        delete pRemainingNodeChunkMap1;
-                        delete pRemainingNodeChunkMap2;
-                    }
-                    else if (m_pSettings->spacePartitionAxis == SS_AXIS_Z)
-                    {
-                        // Node 0
-                            node->m_pChildren[0] = new TreeNode(min, mid, node, m_numNodes);
-                            m_numNodes++;
+        if (pRemainder)
+            pRemainder->Clear();
 
-                            _NodeChunkMap *pRemainingNodeChunkMap0 = new _NodeChunkMap;
-                            Partition(node->m_pChildren[0], numDivisions, pResultingNodeChunkMap, pRemainingNodeChunkMap0);
+        if (!pNodeChunkMap)
+            return false;
 
-                        // Node 1
-                            node->m_pChildren[1] = new TreeNode(Vector3(mid.x, min.y, min.z), Vector3(max.x, mid.y, mid.z), node, m_numNodes);
-                            m_numNodes++;
+        if (pNodeChunkMap->IsEmpty())
+        {
+            // There is no geometry for this leaf to attempt to partition, so store an empty leaf.
 
-                            _NodeChunkMap *pRemainingNodeChunkMap1 = new _NodeChunkMap;
-                            Partition(node->m_pChildren[1], numDivisions, pRemainingNodeChunkMap0, pRemainingNodeChunkMap1);
+#ifdef VERBOSE_PARTITIONING
+            DebugPrintf(_T("\tpNodeChunkMap is empty. Storing empty leaf.\n"));
+#endif
 
-                        // Node 2
-                            node->m_pChildren[2] = new TreeNode(Vector3(min.x, mid.y, min.z), Vector3(mid.x, max.y, mid.z), node, m_numNodes);
-                            m_numNodes++;
+            _PartitionTask leaf = { pChild, 0, 0, NULL };
+            state.leafs.push_back(leaf);
 
-                            _NodeChunkMap *pRemainingNodeChunkMap2 = new _NodeChunkMap;
-                            Partition(node->m_pChildren[2], numDivisions, pRemainingNodeChunkMap1, pRemainingNodeChunkMap2);
+            return false;
+        }
 
-                        // Node 3
-                            node->m_pChildren[3] = new TreeNode(Vector3(mid.x, mid.y, min.z), Vector3(max.x, max.y, mid.z), node, m_numNodes);
-                            m_numNodes++;
+        if (!m_pSettings->optimiseChunks)
+            (*ppResult) = CreateNodeChunkMap(pNodeChunkMap, pRemainder, Math::AABB(pChild->m_min, pChild->m_max), state, pNumPolygons);
 
-                            Partition(node->m_pChildren[3], numDivisions, pRemainingNodeChunkMap2, NULL);
+        return true;
+    }
 
-                        delete pRemainingNodeChunkMap0;
-                        delete pRemainingNodeChunkMap1;
-                        delete pRemainingNodeChunkMap2;
-                    }
-                }
-                else
-                {
-                    // Node 0
-                        node->m_pChildren[0] = new TreeNode(min, mid, node, m_numNodes);
-                        m_numNodes++;
 
-                        _NodeChunkMap *pRemainingNodeChunkMap0 = new _NodeChunkMap;
-                        Partition(node->m_pChildren[0], numDivisions, pResultingNodeChunkMap, pRemainingNodeChunkMap0);
+//-----------------------------------------------------------------------
+    void Scene::PartitionJob(void *pParam)
+    //-------------------------------------------------------------------
+    {
+        _PartitionJob *pJob = (_PartitionJob *)pParam;
+        PartitionTaskList &tasks = *pJob->pTasks;
 
-                    // Node 1
-                        node->m_pChildren[1] = new TreeNode(Vector3(mid.x, min.y, min.z), Vector3(max.x, mid.y, mid.z), node, m_numNodes);
-                        m_numNodes++;
+        // Subtrees are taken one at a time, so a thread that is given small ones takes more of them.
+        for (;;)
+        {
+            LONG t = InterlockedIncrement(pJob->pNextTask) - 1;
 
-                        _NodeChunkMap *pRemainingNodeChunkMap1 = new _NodeChunkMap;
-                        Partition(node->m_pChildren[1], numDivisions, pRemainingNodeChunkMap0, pRemainingNodeChunkMap1);
+            if (t >= (LONG)tasks.size())
+                break;
 
-                    // Node 2
-                        node->m_pChildren[2] = new TreeNode(Vector3(min.x, min.y, mid.z), Vector3(mid.x, mid.y, max.z), node, m_numNodes);
-                        m_numNodes++;
+            _PartitionTask &task = tasks[t];
+            pJob->pScene->Partition(task.pNode, task.numSubdivisions, task.pNodeChunkMap, task.numPolygons, pJob->state);
+        }
+    }
 
-                        _NodeChunkMap *pRemainingNodeChunkMap2 = new _NodeChunkMap;
-                        Partition(node->m_pChildren[2], numDivisions, pRemainingNodeChunkMap1, pRemainingNodeChunkMap2);
 
-                    // Node 3
-                        node->m_pChildren[3] = new TreeNode(Vector3(mid.x, min.y, mid.z), Vector3(max.x, mid.y, max.z), node, m_numNodes);
-                        m_numNodes++;
+//-----------------------------------------------------------------------
+    void Scene::RecurseGeneratePartitionLeafs(TreeNode *node, std::map< TreeNode *, _NodeChunkMap * > &leafs)
+    //-------------------------------------------------------------------
+    {
+        if (!node)
+            return;
 
-                        _NodeChunkMap *pRemainingNodeChunkMap3 = new _NodeChunkMap;
-                        Partition(node->m_pChildren[3], numDivisions, pRemainingNodeChunkMap2, pRemainingNodeChunkMap3);
+        node->m_id = m_numNodes;
+        m_numNodes++;
 
-                    // Node 4
-                        node->m_pChildren[4] = new TreeNode(Vector3(min.x, mid.y, min.z), Vector3(mid.x, max.y, mid.z), node, m_numNodes);
-                        m_numNodes++;
+        std::map< TreeNode *, _NodeChunkMap * >::iterator l = leafs.find(node);
 
-                        _NodeChunkMap *pRemainingNodeChunkMap4 = new _NodeChunkMap;
-                        Partition(node->m_pChildren[4], numDivisions, pRemainingNodeChunkMap3, pRemainingNodeChunkMap4);
+        if (l != leafs.end())
+        {
+            GenerateLeaf(node, l->second);
 
-                    // Node 5
-                        node->m_pChildren[5] = new TreeNode(Vector3(mid.x, mid.y, min.z), Vector3(max.x, max.y, mid.z), node, m_numNodes);
-                        m_numNodes++;
+            UpdateSpacePartitionProgress(node);
 
-                        _NodeChunkMap *pRemainingNodeChunkMap5 = new _NodeChunkMap;
-                        Partition(node->m_pChildren[5], numDivisions, pRemainingNodeChunkMap4, pRemainingNodeChunkMap5);
+            // The root node chunk map belongs to SubdivideWorld()
+            if (node->m_pParent)
+                delete l->second;
 
-                    // Node 6
-                        node->m_pChildren[6] = new TreeNode(Vector3(min.x, mid.y, mid.z), Vector3(mid.x, max.y, max.z), node, m_numNodes);
-                        m_numNodes++;
+            return;
+        }
 
-                        _NodeChunkMap *pRemainingNodeChunkMap6 = new _NodeChunkMap;
-                        Partition(node->m_pChildren[6], numDivisions, pRemainingNodeChunkMap5, pRemainingNodeChunkMap6);
+        for (int i = 0; i < node->m_numChildren; i++)
+            RecurseGeneratePartitionLeafs(node->m_pChildren[i], leafs);
+    }
 
-                    // Node 7
-                        node->m_pChildren[7] = new TreeNode(Vector3(mid.x, mid.y, mid.z), Vector3(max.x, max.y, max.z), node, m_numNodes);
-                        m_numNodes++;
 
-                        Partition(node->m_pChildren[7], numDivisions, pRemainingNodeChunkMap6, NULL);
+//-----------------------------------------------------------------------
+    bool Scene::LockSourceGeometry()
+    //-------------------------------------------------------------------
+    {
+        m_lockedGeometry.clear();
 
-                    delete pRemainingNodeChunkMap0;
-                    delete pRemainingNodeChunkMap1;
-                    delete pRemainingNodeChunkMap2;
-                    delete pRemainingNodeChunkMap3;
-                    delete pRemainingNodeChunkMap4;
-                    delete pRemainingNodeChunkMap5;
-                    delete pRemainingNodeChunkMap6;
-                }
-            }
-            else
-            {
-                // The node is not being partitioned, so place the current geometry in this leaf.
+        GeometryList::iterator g = m_sourceGeometry.begin();
+        for (; g != m_sourceGeometry.end(); g++)
+        {
+            PGEOMETRY pGeometry = *g;
 
-#ifdef VERBOSE_PARTITIONING
-                DebugPrintf(_T("\tNot Subdividing. Creating the leaf.\n"));
-#endif
+            if (pGeometry->GetNumChunks() < 1 || pGeometry->GetNumVertices() < 1)
+                continue;
 
-                GenerateLeaf(node, pResultingNodeChunkMap);
+            if (m_lockedGeometry.find(pGeometry) != m_lockedGeometry.end())
+                continue;
 
-                UpdateSpacePartitionProgress(node);
+            _LockedGeometry locked;
+
+            if (FAILED(pGeometry->Lock((PVOID*)&locked.pChunks, &locked.pVerts, NULL, NULL)))
+            {
+                UnlockSourceGeometry();
+                return false;
             }
 
-        if (node->m_pParent)
-        {
-            delete pResultingNodeChunkMap;
+            m_lockedGeometry[pGeometry] = locked;
         }
+
+        return true;
+    }
+
+
+//-----------------------------------------------------------------------
+    void Scene::UnlockSourceGeometry()
+    //-------------------------------------------------------------------
+    {
+        LockedGeometryMap::iterator l = m_lockedGeometry.begin();
+        for (; l != m_lockedGeometry.end(); ++l)
+            l->first->Unlock();
+
+        m_lockedGeometry.clear();
     }
 
 
@@ -2460,264 +2460,86 @@ pResult (return value) [out] NodeChunkMap contains all geometry within the given
         DebugPrintf(_T("\n"));
 #endif
 
-        NodeChunkMap &ncm = pNodeChunkMap->m;
+        const ChunkRunList &runs = pNodeChunkMap->runs;
+        const VertexIndexList &indices = pNodeChunkMap->indices;
 
-        NodeChunkMap::iterator i = ncm.begin();
-        for (; i != ncm.end(); ++i)
+        unsigned int r = 0;
+        while (r < runs.size())
         {
-            if ((*i)->m.empty())
-                continue;
+            // The runs of a source geometry at one order are rendered by the same groups
+            const _ChunkRun &first = runs[r];
+            PGEOMETRY pGeometry = first.pGeometry;
 
-            //DebugPrintf("NodeChunkMap size() = %d\n", (*i)->m.size());
+            unsigned int end = r + 1;
+            while (end < runs.size() && runs[end].source == first.source && runs[end].order == first.order && runs[end].pGeometry == pGeometry)
+                ++end;
 
-            OrderedGeometryMap &orderedGeomMapRef = (*i)->m;
-            OrderedGeometryMap::iterator j = orderedGeomMapRef.begin();
-            for (; j != orderedGeomMapRef.end(); ++j)
+            if (pGeometry->GetNumChunks() < 1 || pGeometry->GetNumVertices() < 1)
             {
-                GeometryMap &gm = j->second->m;
-
-                //DebugPrintf("\tGeometryMap size() = %d\n", gm);
-
-                GeometryMap::iterator k = gm.begin();
-                for (; k != gm.end(); ++k)
-                {
-                    PGEOMETRY pGeometry = k->first;
-
-                    if (k->second->m.empty() || pGeometry->GetNumChunks() < 1 || pGeometry->GetNumVertices() < 1)
-                        continue;
-
-                    OptimisedGeometryMap::iterator og = m_optimisedGeometry.find(pGeometry);
-                    POPTIMISEDGEOMETRY pOptimisedGeometry = NULL;
-
-                    if (og == m_optimisedGeometry.end())
-                    {
-                        //DebugPrintf("\t\tOptimisedGeometry created.\n");
-                        pOptimisedGeometry = new OptimisedGeometry(pGeometry);
-                        m_optimisedGeometry[pGeometry] = pOptimisedGeometry;
-                    }
-                    else
-                    {
-                        //DebugPrintf("\t\tOptimisedGeometry retrieved.\n");
-                        pOptimisedGeometry = og->second;
-                    }
-
-                    std::vector< std::vector<int> > effectGroups;
-                    effectGroups.resize(numEffectGroups + 1);
-
-                    ChunkIndexList &cil = k->second->m;
-
-                    //DebugPrintf("\t\t\tChunkIndexList size() = %d.\n", cil.size());
-
-                    ChunkIndexList::iterator c = cil.begin();
-                    for (; c != cil.end(); ++c)
-                    {
-                        if (c->second->m.empty())
-                            continue;
-
-                        unsigned int srcChunkIndex = c->first;
-                        const Chunk &srcChunk = pGeometry->GetChunk(srcChunkIndex);
-
-                        //DebugPrintf("\t\t\t\tsrcChunkIndex = %d.\n", srcChunkIndex);
-
-                        IndexSet &is = c->second->m;
-
-                        if (is.empty())
-                            continue;
-
-                        IndexSet::iterator s = is.begin();
-                        for (; s != is.end(); ++s)
-                        {
-                            unsigned int chunkIndex = (unsigned int)pOptimisedGeometry->m_chunks.size();
-                            effectGroups[srcChunk.effect + 1].push_back(chunkIndex);
-
-                            Chunk newChunk(srcChunk);
-                            newChunk.startIndex = pOptimisedGeometry->m_numVertexIndices;
-                            newChunk.numIndices = 0;
-
-                            VertexIndexList &vil = (*s)->m;
-
-                            //DebugPrintf("Creating new chunk of type %s...\n", CHUNKTYPENAMES[newChunk.type]);
-
-                            for (unsigned int p = 0; p < vil.size(); p++)
-                            {
-                                pOptimisedGeometry->InsertVertexIndex(chunkIndex, vil[p]);
-                                ++newChunk.numIndices;
-                            }
-
-                            pOptimisedGeometry->m_chunks.push_back(newChunk);
-                        }
-
-                        //DebugPrintf("\t\t\t\tIndexSet size() = %d.\n", is.size());
-
-                        /*switch (srcChunk.type)
-                        {
-                        case CT_TRIANGLELIST:
-                        case CT_LINELIST:
-                        case CT_POINTLIST:
-                            {
-                                unsigned int chunkIndex = (unsigned int)pOptimisedGeometry->m_chunks.size();
-                                effectGroups[srcChunk.effect + 1].push_back(chunkIndex);
-
-                                Chunk newChunk(srcChunk);
-                                newChunk.startIndex = pOptimisedGeometry->m_numVertexIndices;
-                                newChunk.numIndices = 0;
-
-                                VertexIndexList &vil = (*is.begin())->m;
-
-                                //DebugPrintf("Creating new chunk of type %s...\n", CHUNKTYPENAMES[newChunk.type]);
-
-                                for (unsigned int p = 0; p < vil.size(); p++)
-                                {
-                                    pOptimisedGeometry->InsertVertexIndex(chunkIndex, vil[p]);
-                                    ++newChunk.numIndices;
-                                }
-
-                                pOptimisedGeometry->m_chunks.push_back(newChunk);
-                            }
-                            break;
-
-                        case CT_TRIANGLESTRIP:
-                        case CT_LINESTRIP:
-                        case CT_POLYGON:
-                            {
-                                IndexSet::iterator s = is.begin();
-                                for (; s != is.end(); ++s)
-                                {
-                                    unsigned int chunkIndex = (unsigned int)pOptimisedGeometry->m_chunks.size();
-                                    effectGroups[srcChunk.effect + 1].push_back(chunkIndex);
-
-                                    Chunk newChunk(srcChunk);
-                                    newChunk.startIndex = pOptimisedGeometry->m_numVertexIndices;
-                                    newChunk.numIndices = 0;
-
-                                    VertexIndexList &vil = (*s)->m;
-
-                                    //DebugPrintf("Creating new chunk of type %s...\n", CHUNKTYPENAMES[newChunk.type]);
-
-                                    for (unsigned int p = 0; p < vil.size(); p++)
-                                    {
-                                        pOptimisedGeometry->InsertVertexIndex(chunkIndex, vil[p]);
-                                        ++newChunk.numIndices;
-                                    }
-
-                                    pOptimisedGeometry->m_chunks.push_back(newChunk);
-                                }
-                            }
-                            break;
-                        }*/
-/*
-                        // this isn't quite right; lists (as opposed to strips and polygon) can just use the first element.
-                        IndexSet::iterator s = is.begin();
-                        for (; s != is.end(); ++s)
-                        {
-                            unsigned int chunkIndex = (unsigned int)pOptimisedGeometry->m_chunks.size();
-                            effectGroups[srcChunk.effect + 1].push_back(chunkIndex);
-
-                            Chunk newChunk(srcChunk);
-                            newChunk.startIndex = pOptimisedGeometry->m_numVertexIndices;
-                            newChunk.numIndices = 0;
-
-                            VertexIndexList &vil = (*s)->m;
-
-                            //DebugPrintf("\t\t\t\t\tVertexIndexList size() = %d.\n", vil.size());
-                            //DebugPrintf("\t\t\t\t\t\t");
-
-                            DebugPrintf("Creating new chunk of type %s...\n", CHUNKTYPENAMES[newChunk.type]);
-
-                            switch (newChunk.type)
-                            {
-                            case CT_TRIANGLELIST:
-                            case CT_LINELIST:
-                            case CT_POINTLIST:
-                                {
-                                    for (unsigned int p = 0; p < vil.size(); p++)
-                                    {
-                                        pOptimisedGeometry->InsertVertexIndex(chunkIndex, vil[p]);
-                                        ++newChunk.numIndices;
-                                    }
-                                }
-                                break;
-
-                            case CT_TRIANGLESTRIP:
-                            case CT_LINESTRIP:
-                                {
-                                    for (unsigned int p = 0; p < vil.size(); p++)
-                                    {
-                                        pOptimisedGeometry->InsertVertexIndex(chunkIndex, vil[p]);
-                                        ++newChunk.numIndices;
-                                    }
-                                }
-                                break;
-
-                            case CT_POLYGON:
-                                {
-
-                                }
-                                break;
-                            }
-
-                            if (newChunk.numIndices < 1)
-                                DebugPrintf("new chunk has 0 indices!\n");
+                r = end;
+                continue;
+            }
 
-                            //DebugPrintf("\n", is.size());
+            OptimisedGeometryMap::iterator og = m_optimisedGeometry.find(pGeometry);
+            POPTIMISEDGEOMETRY pOptimisedGeometry = NULL;
 
-                            pOptimisedGeometry->m_chunks.push_back(newChunk);
-                        }*/
-                    }
+            if (og == m_optimisedGeometry.end())
+            {
+                pOptimisedGeometry = new OptimisedGeometry(pGeometry);
+                m_optimisedGeometry[pGeometry] = pOptimisedGeometry;
+            }
+            else
+            {
+                pOptimisedGeometry = og->second;
+            }
 
-                    /*ChunkIndexList &cil = k->second->m;
-                    ChunkIndexList::iterator c = cil.begin();
-                    for (; c != cil.end(); c++)
-                    {
-                        if (c->second->m.empty())
-                            continue;
+            std::vector< std::vector<int> > effectGroups;
+            effectGroups.resize(numEffectGroups + 1);
 
-                        unsigned int srcChunkIndex = c->first;
-                        const Chunk &srcChunk = pGeometry->GetChunk(srcChunkIndex);
+            // Each vertex index list becomes a chunk of its own
+            for (; r < end; ++r)
+            {
+                const _ChunkRun &run = runs[r];
+                const Chunk &srcChunk = pGeometry->GetChunk(run.chunk);
 
-                        unsigned int chunkIndex = (unsigned int)pOptimisedGeometry->m_chunks.size();
-                        effectGroups[srcChunk.effect + 1].push_back(chunkIndex);
+                unsigned int chunkIndex = (unsigned int)pOptimisedGeometry->m_chunks.size();
+                effectGroups[srcChunk.effect + 1].push_back(chunkIndex);
 
-                        Chunk newChunk(srcChunk);
-                        newChunk.startIndex = pOptimisedGeometry->m_numVertexIndices;
-                        newChunk.numIndices = 0;
-                        newChunk.type = CT_TRIANGLELIST;
+                Chunk newChunk(srcChunk);
+                newChunk.startIndex = pOptimisedGeometry->m_numVertexIndices;
+                newChunk.numIndices = 0;
 
-                        VertexIndexList &vil = c->second->m;
-                        VertexIndexList::iterator v = c->second->m.begin();
-                        for (; v != vil.end(); v++)
-                        {
-                            pOptimisedGeometry->InsertVertexIndex(chunkIndex, *v);
-                            ++newChunk.numIndices;
-                        }
+                for (unsigned int p = 0; p < run.numIndices; p++)
+                {
+                    pOptimisedGeometry->InsertVertexIndex(chunkIndex, indices[run.startIndex + p]);
+                    ++newChunk.numIndices;
+                }
 
-                        pOptimisedGeometry->m_chunks.push_back(newChunk);
-                    }*/
+                pOptimisedGeometry->m_chunks.push_back(newChunk);
+            }
 
-                    std::vector< std::vector<int> >::iterator e = effectGroups.begin();
-                    for (int effectId = -1; e != effectGroups.end(); ++e, ++effectId)
-                    {
-                        if (e->empty())
-                            continue;
+            std::vector< std::vector<int> >::iterator e = effectGroups.begin();
+            for (int effectId = -1; e != effectGroups.end(); ++e, ++effectId)
+            {
+                if (e->empty())
+                    continue;
 
-                        RenderGroup *pRenderGroup = new RenderGroup(this);
-                        pRenderGroup->m_order = j->first;
-                        pRenderGroup->m_pGeometry = NULL;
-                        pRenderGroup->m_pOptimisedGeometry = pOptimisedGeometry;
-                        pRenderGroup->m_effectID = effectId;
-                        pRenderGroup->m_techniqueID = -1;
-                        pRenderGroup->m_hasTransform = false;
-                        pRenderGroup->m_materialID = -1;
-                        pRenderGroup->m_startFaceIndex = *e->begin();
-                        pRenderGroup->m_numFaces = e->size();
+                RenderGroup *pRenderGroup = new RenderGroup(this);
+                pRenderGroup->m_order = first.order;
+                pRenderGroup->m_pGeometry = NULL;
+                pRenderGroup->m_pOptimisedGeometry = pOptimisedGeometry;
+                pRenderGroup->m_effectID = effectId;
+                pRenderGroup->m_techniqueID = -1;
+                pRenderGroup->m_hasTransform = false;
+                pRenderGroup->m_materialID = -1;
+                pRenderGroup->m_startFaceIndex = *e->begin();
+                pRenderGroup->m_numFaces = e->size();
 
-                        pLeaf->m_renderList.push_back(pRenderGroup);
+                pLeaf->m_renderList.push_back(pRenderGroup);
 
-                        for (unsigned int m = 0; m < pRenderGroup->m_numFaces; m++)
-                        {
-                            pOptimisedGeometry->InsertChunkIndex(0, effectGroups[effectId + 1][m]);
-                        }
-                    }
+                for (unsigned int m = 0; m < pRenderGroup->m_numFaces; m++)
+                {
+                    pOptimisedGeometry->InsertChunkIndex(0, effectGroups[effectId + 1][m]);
                 }
             }
         }
@@ -3831,15 +3653,17 @@ pResult (return value) [out] NodeChunkMap contains all geometry within the given
             }
         }
 
-        if (1) // (flags & PVS)
+        if (m_numClusters && m_bytesPerCluster && (int)m_PVS.size() == m_numClusters) // (flags & PVS)
         {
-            /*pOutputScene->numPVSClusters = numClusters;
-            pOutputScene->bytesPerPVSCluster = bytesPerCluster;
+            pOutputScene->numPVSClusters = m_numClusters;
+            pOutputScene->bytesPerPVSCluster = m_bytesPerCluster;
 
-            pOutputScene->PVS = new byte[numClusters * bytesPerCluster];
-            memcpy(pOutputScene->PVS, PVS, numClusters * bytesPerCluster);
+            pOutputScene->PVS = new byte[m_numClusters * m_bytesPerCluster];
 
-            pOutputScene->size += numClusters * bytesPerCluster;*/
+            for (int c = 0; c < m_numClusters; c++)
+                memcpy(pOutputScene->PVS + c * m_bytesPerCluster, m_PVS[c], m_bytesPerCluster);
+
+            pOutputScene->size += m_numClusters * m_bytesPerCluster;
         }
 
         return S_OK;
@@ -3935,18 +3759,32 @@ pResult (return value) [out] NodeChunkMap contains all geometry within the given
                         leaf->m_renderList.push_back(group);
                     }
 
-                    m_leafs.push_back(leaf);
+                    m_leafs.push_back(leaf);
+                }
+            }
+        }
+
+        if (/*flags & PVS &&*/ pOutputScene->numPVSClusters && pOutputScene->bytesPerPVSCluster && pOutputScene->PVS)
+        {
+            if (pOutputScene->numPVSClusters == m_leafs.size())
+            {
+                m_numClusters = pOutputScene->numPVSClusters;
+                m_bytesPerCluster = pOutputScene->bytesPerPVSCluster;
+
+                m_PVS.resize(m_numClusters);
+
+                for (int c = 0; c < m_numClusters; c++)
+                {
+                    m_PVS[c] = new byte[m_bytesPerCluster];
+                    memcpy(m_PVS[c], pOutputScene->PVS + c * m_bytesPerCluster, m_bytesPerCluster);
+
+                    AddUsedMemory(m_bytesPerCluster, "Scene::Reassemble() - PVS Cluster");
                 }
             }
-        }
-
-        if (/*flags & PVS &&*/ pOutputScene->numPVSClusters && pOutputScene->bytesPerPVSCluster)
-        {
-            /*numClusters = pOutputScene->numPVSClusters;
-            bytesPerCluster = pOutputScene->bytesPerPVSCluster;
-
-            PVS = new byte[numClusters * bytesPerCluster];
-            memcpy(PVS, pOutputScene->PVS, numClusters * bytesPerCluster);*/
+            else
+            {
+                Logf("Scene::Reassemble() - Ignoring a PVS of %d clusters for %d leafs.", pOutputScene->numPVSClusters, (int)m_leafs.size());
+            }
         }
 
         return S_OK;
@@ -3954,24 +3792,55 @@ pResult (return value) [out] NodeChunkMap contains all geometry within the given
 
 
 //-----------------------------------------------------------------------
-    void Scene::CreateNodeRenderList(TreeNode *node, std::vector<RenderGroup> &renderList, PVIEWPORT pViewport)
+    void Scene::CreateNodeRenderList(TreeNode *node, std::vector<RenderGroup> &renderList, PVIEWPORT pViewport, const byte *pVisibleLeafs,
+                                     DWORD planeMask)
+    // Note: pVisibleLeafs is a decompressed PVS cluster, or NULL to draw every leaf in the frustum
+    // Note: node is already known to be in the frustum, and planeMask holds the frustum planes it crosses
     //-------------------------------------------------------------------
     {
-        if (pViewport)
-        {
-            if (!pViewport->GetCamera()->CheckBoxFrustum(node->m_min, node->m_max))
-                return;
-        }
-
         if (node->m_numChildren)
         {
-            for (int i = 0; i < node->m_numChildren; i++)
-                CreateNodeRenderList(node->m_pChildren[i], renderList, pViewport);
+            // The children are tested together, against only the planes this node crosses.
+            // Children of a node entirely inside the frustum need no testing at all.
+            DWORD childMasks[Math::MAX_BOX_BATCH];
+
+            int i;
+            if (pViewport && planeMask && node->m_pChildBounds)
+            {
+                pViewport->GetCamera()->CullBoxes(*node->m_pChildBounds, planeMask, childMasks);
+            }
+            else
+            {
+                for (i = 0; i < node->m_numChildren; i++)
+                {
+                    childMasks[i] = planeMask;
+
+                    if (pViewport && planeMask)
+                    {
+                        const TreeNode *pChild = node->m_pChildren[i];
+
+                        if (pViewport->GetCamera()->CullBox((pChild->m_min + pChild->m_max) * 0.5f, (pChild->m_max - pChild->m_min) * 0.5f,
+                                                            &childMasks[i]) == Math::IS_NONE)
+                            childMasks[i] = Math::FRUSTUM_OUTSIDE;
+                    }
+                }
+            }
+
+            for (i = 0; i < node->m_numChildren; i++)
+            {
+                if (!(childMasks[i] & Math::FRUSTUM_OUTSIDE))
+                    CreateNodeRenderList(node->m_pChildren[i], renderList, pViewport, pVisibleLeafs, childMasks[i]);
+            }
         }
         else if (!m_leafs.empty())
         {
-            if (node->m_leafIndex > -1)
-                CreateLeafRenderList(m_leafs[node->m_leafIndex], renderList);
+            if (node->m_leafIndex < 0)
+                return;
+
+            if (pVisibleLeafs && !(pVisibleLeafs[node->m_leafIndex / 8] & (1 << (node->m_leafIndex & 7))))
+                return;
+
+            CreateLeafRenderList(m_leafs[node->m_leafIndex], renderList);
         }
     }
 
@@ -3992,14 +3861,15 @@ pResult (return value) [out] NodeChunkMap contains all geometry within the given
             {
                 PVISUAL pVisual = m_pResourceManager->GetVisual(entity->GetVisualID());
 
-                Vector3 visualMin = pVisual->GetMin();
-                Vector3 visualMax = pVisual->GetMax();
                 const Matrix &entityTransform = entity->GetAbsoluteTransformMatrix();
 
-                D3DXVec3TransformCoord(&visualMin, &visualMin, &entityTransform);
-                D3DXVec3TransformCoord(&visualMax, &visualMax, &entityTransform);
+                // The visual's bounds are oriented by the transform, so cull the box that encloses them
+                Vector3 centre, extent;
+                Math::TransformAABB(pVisual->GetMin(), pVisual->GetMax(), entityTransform, &centre, &extent);
 
-                if (pViewport->GetCamera()->CheckBoxFrustum(visualMin, visualMax))
+                DWORD planeMask = Math::FRUSTUM_ALL_PLANES;
+
+                if (pViewport->GetCamera()->CullBox(centre, extent, &planeMask) != Math::IS_NONE)
                 {
                     pVisual->CreateRenderList(renderList, entityTransform, vps.drawVisualBoundingBox);
                 }
@@ -4108,45 +3978,33 @@ pResult (return value) [out] NodeChunkMap contains all geometry within the given
             }
         }
 
-        if (m_pSettings->visibilityMode == SS_ENABLED)
-        {
-            for (unsigned int i = 0; i < m_leafs.size(); i++)
-            {
-                byte *pCluster = m_PVS[i];
+        // Leafs that cannot be seen from the camera's leaf are skipped. A camera outside the world sees everything.
+        const byte *pVisibleLeafs = NULL;
 
-                if (!pCluster)
-                    continue;
+        if (m_pSettings->visibilityMode == SS_ENABLED && m_numClusters && (int)m_PVS.size() == m_numClusters)
+        {
+            int leafIndex = FindLeaf(pViewport->GetCamera()->GetPosition());
 
-                if (Math::AABBPointCollision(Math::AABB(m_leafs[i]->m_min, m_leafs[i]->m_max), pViewport->GetCamera()->GetPosition()))
-                {
-                    for (unsigned int n = 0; n < m_leafs.size(); n++)
-                    {
-                        if (*(pCluster + (n / 8)) & (1 << (n & 7)))
-                        {
-                            Vector3 cMin = m_leafs[n]->m_min;
-                            Vector3 cMax = m_leafs[n]->m_max;
+            if (leafIndex > -1 && leafIndex < m_numClusters)
+            {
+                m_visibleLeafs.resize((m_numClusters + 7) / 8);
+                DecompressPVSCluster(m_PVS[leafIndex], (unsigned int)m_bytesPerCluster, (unsigned int)m_visibleLeafs.size(), &m_visibleLeafs[0]);
 
-                            if (!pViewport->GetCamera()->CheckBoxFrustum(cMin, cMax))
-                                continue;
+                pVisibleLeafs = &m_visibleLeafs[0];
+            }
+        }
 
-                            CreateLeafRenderList(m_leafs[n], renderList);
-                        }
-                    }
+        if (m_activeLeafID == -1)
+        {
+            DWORD planeMask = Math::FRUSTUM_ALL_PLANES;
 
-                    break;
-                }
-            }
+            if (pViewport->GetCamera()->CullBox((m_pRoot->m_min + m_pRoot->m_max) * 0.5f, (m_pRoot->m_max - m_pRoot->m_min) * 0.5f,
+                                                &planeMask) != Math::IS_NONE)
+                CreateNodeRenderList(m_pRoot, renderList, pViewport, pVisibleLeafs, planeMask);
         }
-        else
+        else if (m_activeLeafID < (int)m_leafs.size())
         {
-            if (m_activeLeafID == -1)
-            {
-                CreateNodeRenderList(m_pRoot, renderList, pViewport);
-            }
-            else if (m_activeLeafID < (int)m_leafs.size())
-            {
-                CreateLeafRenderList(m_leafs[m_activeLeafID], renderList);
-            }
+            CreateLeafRenderList(m_leafs[m_activeLeafID], renderList);
         }
 
         CreateEntityRenderList(m_pSceneGraphRoot, renderList, pViewport);
@@ -4666,6 +4524,8 @@ pResult (return value) [out] NodeChunkMap contains all geometry within the given
 
             RecurseInputPartition(node->m_pChildren[i], outputNodes, m_numNodes);
         }
+
+        node->SetChildBounds();
     }
 
 
@@ -4862,62 +4722,43 @@ pResult (return value) [out] NodeChunkMap contains all geometry within the given
 
 
 //-----------------------------------------------------------------------
-    bool Scene::RecurseTestIntersect(TreeNode *node, std::list<IntersectionResult> &results,
-                                     const Vector3 &rayPos, const Vector3 &rayDir, DWORD flags, bool findFirst)
+    void Scene::GetRayGeometry(std::vector< std::pair<float, PGEOMETRY> > &geometry, const Vector3 &rayPos, const Vector3 &rayDir)
     //-------------------------------------------------------------------
     {
-        if (!node)
-            return false;
+        // The geometry the ray passes through, in the order the ray enters it
+        GeometryList::iterator g = m_sourceGeometry.begin();
+        for (; g != m_sourceGeometry.end(); g++)
+        {
+            float distance = 0.0f;
 
-        bool found = false;
+            if (!(*g) || !Math::AABBRayIntersection(Math::AABB((*g)->GetMin(), (*g)->GetMax()), rayPos, rayDir, &distance))
+                continue;
 
-        if (!Math::AABBRayCollision(Math::AABB(node->m_min, node->m_max), rayPos, rayDir))
-            return false;
+            geometry.push_back(std::pair<float, PGEOMETRY>(distance, *g));
+        }
 
-        if (node->m_leafIndex > -1 && node->m_leafIndex < (int)m_leafs.size())
-        {
-            TreeLeaf *pLeaf = m_leafs[node->m_leafIndex];
+        std::sort(geometry.begin(), geometry.end());
+    }
 
-            if (pLeaf)
-            {
-                std::list<RenderGroup *>::iterator i = pLeaf->m_renderList.begin();
-                for (; i != pLeaf->m_renderList.end(); i++)
-                {
-                    if (!(*i) || !(*i)->m_pGeometry)
-                        continue;
 
-                    if (findFirst)
-                    {
-                        IntersectionResult result;
+//-----------------------------------------------------------------------
+    bool Scene::Intersect(std::vector<IntersectionResult> &results, const Vector3 &rayPos, const Vector3 &rayDir, DWORD flags)
+    //-------------------------------------------------------------------
+    {
+        std::vector< std::pair<float, PGEOMETRY> > geometry;
+        GetRayGeometry(geometry, rayPos, rayDir);
 
-                        found = (*i)->m_pGeometry->Intersect(result, rayPos, rayDir, *i, flags);
+        size_t first = results.size();
 
-                        results.push_back(result);
+        for (unsigned int g = 0; g < geometry.size(); g++)
+            geometry[g].second->Intersect(results, rayPos, rayDir, flags);
 
-                        break;
-                    }
-                    else
-                    {
-                        found = (*i)->m_pGeometry->Intersect(results, rayPos, rayDir, *i, flags);
-                    }
-                }
-            }
-        }
-        else
-        {
-            for (unsigned int c = 0; c < (unsigned)node->m_numChildren; c++)
-            {
-                if (node->m_pChildren[c])
-                {
-                    found |= RecurseTestIntersect(node->m_pChildren[c], results, rayPos, rayDir, flags, findFirst);
+        if (results.size() == first)
+            return false;
 
-                    if (found && findFirst)
-                        return found;
-                }
-            }
-        }
+        std::sort(results.begin() + first, results.end(), IntersectionResult::Nearer);
 
-        return found;
+        return true;
     }
 
 
@@ -4925,164 +4766,389 @@ pResult (return value) [out] NodeChunkMap contains all geometry within the given
     bool Scene::Intersect(std::list<IntersectionResult> &results, const Vector3 &rayPos, const Vector3 &rayDir, DWORD flags)
     //-------------------------------------------------------------------
     {
-        if (!m_pRoot)
+        std::vector<IntersectionResult> newResults;
+
+        if (!Intersect(newResults, rayPos, rayDir, flags))
             return false;
 
-        bool found = RecurseTestIntersect(m_pRoot, results, rayPos, rayDir, flags, false);
+        results.insert(results.end(), newResults.begin(), newResults.end());
 
-        return found;
+        return true;
     }
 
 
 //-----------------------------------------------------------------------
-    bool Scene::Intersect(IntersectionResult &result, const Vector3 &rayPos, const Vector3 &rayDir, DWORD flags)
+    bool Scene::Intersect(IntersectionResult &result, const Vector3 &rayPos, const Vector3 &rayDir, DWORD flags, float maxDistance)
     //-------------------------------------------------------------------
     {
-        if (!m_pRoot)
-            return false;
+        std::vector< std::pair<float, PGEOMETRY> > geometry;
+        GetRayGeometry(geometry, rayPos, rayDir);
 
-        std::list<IntersectionResult> results;
+        bool found = false;
 
-        bool found = RecurseTestIntersect(m_pRoot, results, rayPos, rayDir, flags, true);
+        // Shrinks to the nearest hit so far, so each geometry only looks for nearer ones
+        float limit = maxDistance;
 
-        if (results.size() < 1)
-            return false;
+        for (unsigned int g = 0; g < geometry.size(); g++)
+        {
+            // Nothing in geometry entered beyond the limit can be nearer
+            if (geometry[g].first >= limit)
+                break;
+
+            IntersectionResult hit;
+
+            if (!geometry[g].second->Intersect(hit, rayPos, rayDir, NULL, flags, limit))
+                continue;
 
-        result = *results.begin();
+            result = hit;
+            found = true;
+            limit = hit.m_distance;
+
+            // Any hit within maxDistance will do
+            if (flags & IF_ANYHIT)
+                break;
+        }
 
         return found;
     }
 
 
+//-----------------------------------------------------------------------
+    unsigned int Scene::IntersectRays(std::vector<IntersectionResult> &results, const Math::Ray *pRays, unsigned int numRays, DWORD flags,
+                                      float maxDistance)
+    //-------------------------------------------------------------------
+    {
+        results.clear();
+        results.resize(numRays);
+
+        if (!pRays)
+            return 0;
+
+        unsigned int numHits = 0;
+
+        for (unsigned int r = 0; r < numRays; r++)
+        {
+            if (Intersect(results[r], pRays[r].position, pRays[r].direction, flags, maxDistance))
+                ++numHits;
+        }
+
+        return numHits;
+    }
+
+
 //-----------------------------------------------------------------------
     void Scene::GeneratePVS(void *pData, std::vector< byte * > *pResults,
                             ProgressCallbackFunc progressCallbackFunc, void *pProgressCallbackPayload)
     //-------------------------------------------------------------------
     {
-/*
-        if (progressCallbackFunc)
-            progressCallbackFunc(PC_SCENE_PVS, pvsProgress, pProgressCallbackPayload);
+        Scene *pScene = (Scene *)pData;
+
+        if (!pScene || !pResults || pScene->m_leafs.empty())
+            return;
+
+        unsigned int numClusters = (unsigned int)pScene->m_leafs.size();
+        unsigned int bytesPerCluster = (numClusters + 7) / 8;
+
+        pResults->resize(numClusters);
+
+        unsigned int c;
+        for (c = 0; c < numClusters; c++)
+        {
+            (*pResults)[c] = new byte[bytesPerCluster];
+            ZeroMemory((*pResults)[c], bytesPerCluster);
+        }
 
-        numClusters = leafs.size();
-        //numClusters = m_numNodes;
+        // Building the ray query trees is not thread safe, so they are all built before the threads start
+        GeometryList::iterator g = pScene->m_sourceGeometry.begin();
+        for (; g != pScene->m_sourceGeometry.end(); g++)
+        {
+            if (*g)
+                (*g)->BuildBVH();
+        }
+
+        int numJobs = GetNumWorkers();
+
+        if (numJobs > (int)numClusters)
+            numJobs = (int)numClusters;
 
-        bytesPerCluster = (int)ceil((float)numClusters / 8);
-        m_PVS = new byte[numClusters * bytesPerCluster];
-        AddUsedMemory(numClusters * bytesPerCluster, "Scene::SubdivideWorld() - Clusters...");
+        LONG nextCluster = 0;
+        LONG numPairsDone = 0;
 
-        //ZeroMemory(PVS, numClusters * bytesPerCluster);
-        memset(PVS, 0xffffffff, numClusters * bytesPerCluster);
+        _PVSJob jobs[MAX_WORKER_THREADS];
+        void *params[MAX_WORKER_THREADS];
 
-        int x = 0;
-        std::vector<TreeLeaf *>::iterator i;
-        for (i = leafs.begin(); i != leafs.end(); i++, x++)
+        for (int j = 0; j < numJobs; j++)
         {
-            pvsProgress = ((float)x / (leafs.size())) * 100.0f;
+            jobs[j].pScene = pScene;
+            jobs[j].pClusters = pResults;
+            jobs[j].pNextCluster = &nextCluster;
+            jobs[j].pNumPairsDone = &numPairsDone;
+            jobs[j].progressCallbackFunc = NULL;
+            jobs[j].pProgressCallbackPayload = NULL;
+            params[j] = &jobs[j];
+        }
+
+        // The last job is run on the calling thread, so it is the one that reports progress
+        jobs[numJobs - 1].progressCallbackFunc = progressCallbackFunc;
+        jobs[numJobs - 1].pProgressCallbackPayload = pProgressCallbackPayload;
+
+        RunWorkers(PVSJob, params, numJobs);
+
+        // The other threads may have taken the last clusters
+        pScene->m_pvsProgress = 100.0f;
 
-            if (progressCallback)
-                progressCallback(PC_SCENE_PVS, pvsProgress, pProgressCallbackPayload);
+        if (progressCallbackFunc)
+            progressCallbackFunc(PC_SCENE_PVS, pScene->m_pvsProgress, pProgressCallbackPayload);
+
+        // Each cluster only has the leafs from its own on, so copy the rest from the clusters of the earlier leafs
+        for (c = 0; c < numClusters; c++)
+        {
+            const byte *pCluster = (*pResults)[c];
 
-            RecursePVS(m_pRoot, (*i));
+            for (unsigned int n = c + 1; n < numClusters; n++)
+            {
+                if (pCluster[n / 8] & (1 << (n & 7)))
+                    (*pResults)[n][c / 8] |= (1 << (c & 7));
+            }
         }
-*/
-/*
-        int x = 0;
-        std::vector<TreeLeaf *>::iterator i, j;
-        for (i = leafs.begin(); i != leafs.end(); i++, x++)
+    }
+
+
+//-----------------------------------------------------------------------
+    void Scene::PVSJob(void *pParam)
+    //-------------------------------------------------------------------
+    {
+        _PVSJob *pJob = (_PVSJob *)pParam;
+        Scene *pScene = pJob->pScene;
+
+        std::vector< byte * > &clusters = *pJob->pClusters;
+        LONG numClusters = (LONG)clusters.size();
+
+        float numPairs = (float)numClusters * (numClusters + 1) * 0.5f;
+
+        // Clusters are taken one at a time, first to last, so the clusters with the most pairs to test go first.
+        for (;;)
         {
-            int y = 0;
-            for (j = leafs.begin(); j != leafs.end(); j++, y++)
+            LONG c = InterlockedIncrement(pJob->pNextCluster) - 1;
+
+            if (c >= numClusters)
+                break;
+
+            byte *pCluster = clusters[c];
+
+            for (LONG n = c; n < numClusters; n++)
             {
-                DWORD progress = ((float)(x * leafs.size() + y) / (leafs.size() * leafs.size())) * 100.0f;
+                if (pScene->TestVisibilityLeaf(pScene->m_leafs[c], pScene->m_leafs[n]))
+                    pCluster[n / 8] |= (1 << (n & 7));
+            }
 
-                if (progressCallback)
-                    progressCallback(PC_SCENE_PVS, progress);
+            LONG numPairsDone = InterlockedExchangeAdd(pJob->pNumPairsDone, numClusters - c) + numClusters - c;
 
-                if (TestVisibilityLeaf((*i), (*j)))
-                    PVS[x * bytesPerCluster + (y / 8)] |= (1 << (y & 7));
+            if (pJob->progressCallbackFunc)
+            {
+                pScene->m_pvsProgress = (numPairsDone / numPairs) * 100.0f;
+                pJob->progressCallbackFunc(PC_SCENE_PVS, pScene->m_pvsProgress, pJob->pProgressCallbackPayload);
             }
         }
-*/
     }
 
-#ifdef _DEBUG
+
 //-----------------------------------------------------------------------
-    void Scene::DumpNodeChunkMap(const _NodeChunkMap *pNodeChunkMap, const unsigned int index) const
+    void Scene::CompressPVS(const std::vector< byte * > &clusters)
     //-------------------------------------------------------------------
     {
-        if (!pNodeChunkMap)
-            return;
+        unsigned int numClusters = (unsigned int)clusters.size();
+        unsigned int numBytes = (numClusters + 7) / 8;
+
+        unsigned int c;
+        for (c = 0; c < numClusters; c++)
+        {
+            if (!clusters[c])
+            {
+                Logf("Scene::CompressPVS() - Cluster %d is missing, the PVS will not be used.", c);
+                return;
+            }
+        }
+
+        // Every cluster is given as many bytes as the largest needs, so that they can be found by index
+        // without a table of offsets. At worst a cluster doubles in size, when no run is longer than a byte.
+        std::vector< byte > compressed(numBytes * 2);
+        unsigned int maxLength = 1;
+
+        for (c = 0; c < numClusters; c++)
+        {
+            unsigned int length = CompressPVSCluster(clusters[c], numBytes, &compressed[0]);
+
+            if (length > maxLength)
+                maxLength = length;
+        }
+
+        m_numClusters = (int)numClusters;
+        m_bytesPerCluster = (int)maxLength;
 
-        const NodeChunkMap &ncm = pNodeChunkMap->m;
-        NodeChunkMap::const_iterator ncmItr = ncm.begin();
+        m_PVS.resize(numClusters);
 
-        DebugPrintf(_T("\tNodeChunkMap [%3d] : size = %d\n"), index, ncm.size());
+        for (c = 0; c < numClusters; c++)
+        {
+            m_PVS[c] = new byte[m_bytesPerCluster];
+            ZeroMemory(m_PVS[c], m_bytesPerCluster);
+
+            CompressPVSCluster(clusters[c], numBytes, m_PVS[c]);
+
+            AddUsedMemory(m_bytesPerCluster, "Scene::CompressPVS() - PVS Cluster");
+        }
+    }
+
+
+//-----------------------------------------------------------------------
+    unsigned int Scene::CompressPVSCluster(const byte *pCluster, unsigned int numBytes, byte *pCompressed)
+    // Note: returns the compressed length, which is at most 2 * numBytes
+    //-------------------------------------------------------------------
+    {
+        // Runs of bytes with no leafs or every leaf visible are written as the byte followed by the
+        // length of the run, as leafs tend to see, or not see, whole parts of the world. Other bytes are
+        // kept as they are.
+        unsigned int length = 0;
 
-        unsigned int ogmIndex = 0;
-        for (; ncmItr != ncm.end(); ++ncmItr, ++ogmIndex)
+        for (unsigned int i = 0; i < numBytes;)
         {
-            const OrderedGeometryMap &ogm = (*ncmItr)->m;
-            OrderedGeometryMap::const_iterator ogmItr = ogm.begin();
+            byte value = pCluster[i];
+
+            if (value != 0x00 && value != 0xff)
+            {
+                pCompressed[length++] = pCluster[i++];
+                continue;
+            }
+
+            unsigned int run = 0;
+
+            while (i < numBytes && pCluster[i] == value && run < 255)
+            {
+                i++;
+                run++;
+            }
+
+            pCompressed[length++] = value;
+            pCompressed[length++] = (byte)run;
+        }
+
+        return length;
+    }
+
 
-            DebugPrintf(_T("\t\tOrderedGeometryMap [%3d] : size = %d\n"), ogmIndex, ogm.size());
+//-----------------------------------------------------------------------
+    void Scene::DecompressPVSCluster(const byte *pCompressed, unsigned int compressedLength, unsigned int numBytes, byte *pCluster)
+    // Note: reads no more than compressedLength bytes, however damaged the data
+    //-------------------------------------------------------------------
+    {
+        const byte *pEnd = pCompressed + compressedLength;
+        unsigned int i = 0;
+
+        while (i < numBytes && pCompressed < pEnd)
+        {
+            byte value = *pCompressed;
 
-            unsigned int gmIndex = 0;
-            for (; ogmItr != ogm.end(); ++ogmItr, ++gmIndex)
+            if (value != 0x00 && value != 0xff)
             {
-                const unsigned int order = ogmItr->first;
-                const GeometryMap &gm = ogmItr->second->m;
+                pCluster[i++] = *pCompressed++;
+                continue;
+            }
+
+            // A run is the byte and its length, so one cut off by the end is damaged
+            if (pEnd - pCompressed < 2)
+                break;
+
+            unsigned int run = pCompressed[1];
+            pCompressed += 2;
+
+            // A run of 0 is never written, so is only found in damaged data. Stop at it rather than loop.
+            if (!run || run > numBytes - i)
+                run = numBytes - i;
+
+            memset(pCluster + i, value, run);
+            i += run;
+        }
+
+        // Data that ends early is damaged too. The rest is left visible, so that nothing is wrongly hidden.
+        if (i < numBytes)
+            memset(pCluster + i, 0xff, numBytes - i);
+    }
+
 
-                GeometryMap::const_iterator gmItr = gm.begin();
+//-----------------------------------------------------------------------
+    int Scene::FindLeaf(const Vector3 &point)
+    // Note: returns the index of the leaf containing point, or -1 if it is outside the world
+    //-------------------------------------------------------------------
+    {
+        TreeNode *node = m_pRoot;
+
+        if (!node || !Math::AABBPointCollision(Math::AABB(node->m_min, node->m_max), point))
+            return -1;
 
-                DebugPrintf(_T("\t\t\tGeometryMap [%3d] : order = %d, size = %d\n"), gmIndex, order, gm.size());
+        while (node->m_numChildren)
+        {
+            TreeNode *pChild = NULL;
 
-                unsigned int cilIndex = 0;
-                for (; gmItr != gm.end(); ++gmItr, ++cilIndex)
+            for (int i = 0; i < node->m_numChildren; i++)
+            {
+                if (node->m_pChildren[i] && Math::AABBPointCollision(Math::AABB(node->m_pChildren[i]->m_min, node->m_pChildren[i]->m_max), point))
                 {
-                    const PGEOMETRY pGM = gmItr->first;
-                    const ChunkIndexList &cil = gmItr->second->m;
-                    ChunkIndexList::const_iterator cilItr = cil.begin();
+                    pChild = node->m_pChildren[i];
+                    break;
+                }
+            }
 
-                    DebugPrintf(_T("\t\t\t\tChunkIndexList [%3d] : PGEOMETRY = 0x%8.8x, size = %d\n"), cilIndex, DWORD(pGM), cil.size());
+            if (!pChild)
+                return -1;
 
-                    unsigned int isIndex = 0;
-                    for (; cilItr != cil.end(); ++cilItr, ++isIndex)
-                    {
-                        const ChunkIndex chunkIndex = cilItr->first;
-                        const IndexSet &is = cilItr->second->m;
-                        IndexSet::const_iterator isItr = is.begin();
+            node = pChild;
+        }
 
-                        DebugPrintf(_T("\t\t\t\t\tIndexSet [%3d] : ChunkIndex = %d, size = %d\n"), isIndex, chunkIndex, is.size());
+        return node->m_leafIndex;
+    }
 
-                        unsigned int vilIndex = 0;
-                        for (; isItr != is.end(); ++isItr)
-                        {
-                            const VertexIndexList &vil = (*isItr)->m;
-                            VertexIndexList::const_iterator vilItr = vil.begin();
 
-                            DebugPrintf(_T("\t\t\t\t\t\tVertexIndexList [%3d] : size = %d\n"), vilIndex, vil.size());
+#ifdef _DEBUG
+//-----------------------------------------------------------------------
+    void Scene::DumpNodeChunkMap(const _NodeChunkMap *pNodeChunkMap, const unsigned int index) const
+    //-------------------------------------------------------------------
+    {
+        if (!pNodeChunkMap)
+            return;
 
-                            unsigned int indexCount = 0;
-                            for (; vilItr != vil.end(); ++vilItr)
-                            {
-                                if (indexCount == 0)
-                                {
-                                    DebugPrintf(_T("\t\t\t\t\t\t\t"));
-                                }
+        const ChunkRunList &runs = pNodeChunkMap->runs;
+        ChunkRunList::const_iterator runItr = runs.begin();
 
-                                DebugPrintf(_T("%d, "), *vilItr);
+        DebugPrintf(_T("\tNodeChunkMap [%3d] : runs = %d, indices = %d\n"), index, runs.size(), pNodeChunkMap->indices.size());
 
-                                ++indexCount;
-                                if (indexCount >= 10)
-                                {
-                                    DebugPrintf(_T("\n"));
-                                    indexCount = 0;
-                                }
-                            }
-                        }
-                    }
+        unsigned int runIndex = 0;
+        for (; runItr != runs.end(); ++runItr, ++runIndex)
+        {
+            DebugPrintf(_T("\t\tRun [%3d] : source = %d, order = %d, PGEOMETRY = 0x%8.8x, ChunkIndex = %d, size = %d\n"),
+                        runIndex, runItr->source, runItr->order, DWORD(runItr->pGeometry), runItr->chunk, runItr->numIndices);
+
+            unsigned int indexCount = 0;
+            for (unsigned int i = 0; i < runItr->numIndices; i++)
+            {
+                if (indexCount == 0)
+                {
+                    DebugPrintf(_T("\t\t\t"));
+                }
+
+                DebugPrintf(_T("%d, "), pNodeChunkMap->indices[runItr->startIndex + i]);
+
+                ++indexCount;
+                if (indexCount >= 10)
+                {
+                    DebugPrintf(_T("\n"));
+                    indexCount = 0;
                 }
             }
+
+            if (indexCount > 0)
+            {
+                DebugPrintf(_T("\n"));
+            }
         }
     }
 
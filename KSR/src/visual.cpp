@@ -11,9 +11,9 @@ static char THIS_FILE[] = __FILE__;
 using namespace KSR;
 
 //-----------------------------------------------------------------------
-    Visual::Visual(PDIRECT3DDEVICE9 pDevice, PRESOURCEMANAGER pResourceManager)
+    Visual::Visual(PDEVICE pDevice, PRESOURCEMANAGER pResourceManager)
     //-------------------------------------------------------------------
-    :    m_pD3DDevice(pDevice), m_pResourceManager(pResourceManager)
+    :    m_pDevice(pDevice), m_pResourceManager(pResourceManager)
     //-------------------------------------------------------------------
     {
         AddUsedMemory(sizeof(Visual), "Visual::Visual()");
@@ -22,7 +22,7 @@ using namespace KSR;
         m_renderList.clear();
         m_sprites.clear();
 
-        m_pOutline = new Geometry(m_pD3DDevice);
+        m_pOutline = new Geometry(m_pDevice);
         AddUsedMemory(sizeof(Geometry), "Visual::Visual() - Geometry");
     }
 
@@ -68,7 +68,10 @@ using namespace KSR;
     HRESULT Visual::InsertSprite(Vector2 min, Vector2 max, bool fixedX, bool fixedY, bool fixedZ, int textureId)
     //-------------------------------------------------------------------
     {
-        if (textureId < 0)
+        // Sprites are only ever drawn, so they have no buffers on a device that does not render.
+        LPDIRECT3DDEVICE9 pD3DDevice = m_pDevice->GetD3DDevice();
+
+        if (textureId < 0 || !pD3DDevice)
             return E_FAIL;
 
         VisualSprite *sprite = new VisualSprite;
@@ -78,12 +81,12 @@ using namespace KSR;
         sprite->m_fixedY = fixedY;
         sprite->m_fixedZ = fixedZ;
 
-        m_pD3DDevice->CreateVertexBuffer(4 * sizeof(VERTEX_DIFFUSE_TEX1),
-                                         0,
-                                         FVF_DIFFUSE_TEX1,
-                                         D3DPOOL_MANAGED,
-                                         &sprite->m_pVertexBuffer,
-                                         NULL);
+        pD3DDevice->CreateVertexBuffer(4 * sizeof(VERTEX_DIFFUSE_TEX1),
+                                       0,
+                                       FVF_DIFFUSE_TEX1,
+                                       D3DPOOL_MANAGED,
+                                       &sprite->m_pVertexBuffer,
+                                       NULL);
 
         VERTEX_DIFFUSE_TEX1 *pVerts = NULL;
         if (FAILED(sprite->m_pVertexBuffer->Lock(0, 0, (PVOID*)&pVerts, 0)))
@@ -0,0 +1,92 @@
+#include "../include/ksr.h"
+
+#include "../include/leakwatcher.h"
+
+#ifdef _DO_MEMORY_DEBUG
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+using namespace KSR;
+
+namespace
+{
+    struct WorkerStart
+    {
+        WorkerFunc func;
+        void *pParam;
+    };
+
+    DWORD WINAPI WorkerProc(LPVOID pStart)
+    {
+        WorkerStart *pWorkerStart = (WorkerStart *)pStart;
+        pWorkerStart->func(pWorkerStart->pParam);
+
+        return 0;
+    }
+}
+
+
+//-----------------------------------------------------------------------
+    int KSR::GetNumWorkers()
+    //-------------------------------------------------------------------
+    {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+
+        int numCPUs = (int)info.dwNumberOfProcessors;
+
+        if (numCPUs < 1)
+            numCPUs = 1;
+
+        if (numCPUs > MAX_WORKER_THREADS)
+            numCPUs = MAX_WORKER_THREADS;
+
+        return numCPUs;
+    }
+
+
+//-----------------------------------------------------------------------
+    void KSR::RunWorkers(WorkerFunc func, void **ppParams, int numParams)
+    //-------------------------------------------------------------------
+    {
+        if (numParams < 1)
+            return;
+
+        WorkerStart starts[MAX_WORKER_THREADS];
+        HANDLE threads[MAX_WORKER_THREADS];
+
+        // Anything past the thread limit is run here, after the others are started
+        int numThreads = numParams - 1;
+
+        if (numThreads > MAX_WORKER_THREADS)
+            numThreads = MAX_WORKER_THREADS;
+
+        int i;
+        for (i = 0; i < numThreads; i++)
+        {
+            starts[i].func = func;
+            starts[i].pParam = ppParams[i];
+
+            DWORD threadId;
+            threads[i] = CreateThread(NULL, 0, WorkerProc, (LPVOID)&starts[i], 0, &threadId);
+
+            if (!threads[i])
+                func(ppParams[i]);
+        }
+
+        for (i = numThreads; i < numParams; i++)
+            func(ppParams[i]);
+
+        for (i = 0; i < numThreads; i++)
+        {
+            if (!threads[i])
+                continue;
+
+            WaitForSingleObject(threads[i], INFINITE);
+            CloseHandle(threads[i]);
+        }
+    }
+
+// EOF
@@ -64,10 +64,71 @@ namespace types
     \brief Maximum length of the name for the kerb.
     \note the buffer for the name should be MAX_KERB_NAME_SIZE+1 to allow for NULL termination.
  */
-extern KEAYS_KERB_EXPORTS_API const int MAX_KERB_NAME_SIZE;
+const int MAX_KERB_NAME_SIZE = 16;
+
+/*!
+    \brief The number of points a KerbPoints holds without allocating.
+ */
+const int KERB_INLINE_POINTS = 32;
+
+//-----------------------------------------------------------------------------
+//#region Kerb points declaration
+/*!
+    \brief A list of kerb points, stored in the object itself for up to KERB_INLINE_POINTS.
+    It has the part of the std::vector interface the kerbs use, with pointers for iterators.
+    Only longer profiles go to the heap, so copying a typical kerb does not allocate.
+ */
+class KEAYS_KERB_EXPORTS_API KerbPoints
+{
+public:
+    typedef keays::types::VectorD2 *iterator;
+    typedef const keays::types::VectorD2 *const_iterator;
+
+    KerbPoints();
+    KerbPoints( const KerbPoints &orig );
+    ~KerbPoints();
+
+    const KerbPoints &operator=( const KerbPoints &rhs );
+
+    //! \brief Exchange the contents with other, without copying points that are on the heap.
+    void Swap( KerbPoints &other );
+
+    const size_t size() const { return m_size; }
+    const bool empty() const { return m_size == 0; }
+    const size_t capacity() const { return m_capacity; }
+
+    iterator begin() { return Points(); }
+    iterator end() { return Points() + m_size; }
+    const_iterator begin() const { return Points(); }
+    const_iterator end() const { return Points() + m_size; }
+
+    keays::types::VectorD2 &operator[]( const size_t index ) { return Points()[index]; }
+    const keays::types::VectorD2 &operator[]( const size_t index ) const { return Points()[index]; }
+    //! \brief As operator[], but throws std::out_of_range if index is past the end.
+    keays::types::VectorD2 &at( const size_t index );
+    const keays::types::VectorD2 &at( const size_t index ) const;
+
+    void reserve( const size_t count );
+    void resize( const size_t count );
+    void clear() { m_size = 0; }
+    void push_back( const keays::types::VectorD2 &pt );
+    void pop_back() { if( m_size ) m_size--; }
+    //! \brief Remove the point at pos, returning the position of the point after it.
+    iterator erase( iterator pos );
+
+private:
+    keays::types::VectorD2 *Points() { return m_pHeap ? m_pHeap : (keays::types::VectorD2 *)m_inline; }
+    const keays::types::VectorD2 *Points() const { return m_pHeap ? m_pHeap : (const keays::types::VectorD2 *)m_inline; }
+
+    double                    m_inline[2 * KERB_INLINE_POINTS];    // raw so that constructing does not touch it
+    keays::types::VectorD2    *m_pHeap;        // NULL while the points fit inline
+    size_t                    m_size;
+    size_t                    m_capacity;
+};
+//#endregion
 
 //! define a point list
-typedef Polyline2D KerbPtsList;//std::list<VectorD2> KerbPtsList;
+typedef KerbPoints KerbPtsList;//Polyline2D KerbPtsList;//std::list<VectorD2> KerbPtsList;
 
 //-----------------------------------------------------------------------------
 /*//#region Local Axes Declaration - moved to keays_types
@@ -139,6 +200,12 @@ public:
 
     const int DuplicateKerb( const Kerb &src );
 
+    /*!
+        \brief Exchange the contents of two kerbs.
+        Cheaper than copying when a kerb is being moved, such as into a container.
+     */
+    void Swap( Kerb &other );
+
     /*!
         \brief Add a point to the Kerb
         The point is added to the end
@@ -162,7 +229,9 @@ public:
     const int GetNumber() const;
     void SetNumber( const int kerbNum );
 
-    const std::string &GetName() const;
+    //! \brief The name, NULL terminated.
+    const char *GetName() const;
+    //! \brief Set the name, truncated to MAX_KERB_NAME_SIZE characters.
     void SetName( const char *name );
     void SetName( const std::string &name );
 
@@ -201,6 +270,26 @@ public:
      */
     const keays::types::Polyline2D *GetPoints( Polyline2D *pPoints, const Kerb::eKerbProfile profile,
                                             const bool isLeftSide, keays::math::RectD *pRect = NULL ) const;
+    /*!
+        \brief Get the points in 2D world co-ordinates into a caller supplied array.
+        The bottom runs from the bottom start to the bottom end special points and the top from
+        the top end back to the top start, following the winding.  A left side profile is mirrored
+        and reversed.
+
+        \param    pPoints [Out] - an array to receive the points.
+        \param  maxPoints [In]  - the size of the pPoints array, at least NumProfilePoints( profile ).
+        \param    profile [In]  - the part of the outline to get.
+        \param isLeftSide [In]  - a boolean flag indicating if the kerb is on the left side.
+        \param      pRect [Out] - a pointer to a RectD to receive the extents of the points, may be NULL.
+
+        \return the number of points written, 0 if there are none, the extents are not calculated
+                or they do not fit.
+     */
+    const size_t GetPoints( keays::types::VectorD2 *pPoints, const size_t maxPoints,
+                            const Kerb::eKerbProfile profile, const bool isLeftSide,
+                            keays::math::RectD *pRect = NULL ) const;
+    //! \brief The number of points GetPoints() gets for a profile.
+    const size_t NumProfilePoints( const Kerb::eKerbProfile profile ) const;
     /*!
         \brief Get the points in screen co-ordinates
      */
@@ -226,10 +315,10 @@ protected:
 
 //private:
     int                m_kerbNum;
-    std::string        *m_pName;
-    KerbPtsList        *m_pPts;
+    char            m_name[MAX_KERB_NAME_SIZE + 1];    // NULL terminated
+    KerbPtsList        m_pts;
     keays::math::RectD
-                    *m_pExtents;
+                    m_extents;        // valid when m_needsRecalc is false
     bool            m_needsRecalc;
 //    keays::Version    *m_pVersion;    //TODO: STOP USING CRAP PLAIN TEXT FORMATS THEN WRITE AN XML PARSER
 
@@ -267,25 +356,115 @@ typedef std::vector<Kerb> KerbList;                    // a vector because we do
 
 //-----------------------------------------------------------------------------
 //#region KerbFile class declaration
+/*!
+    \brief Size of the name field in a kerb library, MAX_KERB_NAME_SIZE plus the NULL and padding.
+ */
+const int KERB_LIB_NAME_SIZE = 20;
+
+/*!
+    \brief A kerb library directory entry.
+    This is the layout used both in memory and in the directory of a binary kerb library file.
+ */
+struct tKerbEntry
+{
+    int             m_id;
+    char            m_name[KERB_LIB_NAME_SIZE];    //!< NULL terminated
+    unsigned int    m_firstPoint;        //!< Index of the first x, y pair in the point pool.
+    unsigned int    m_numPoints;
+    unsigned int    m_flags;            //!< KE_MAPPED if the points are in the opened library file, 0 on disk.
+};
+
+struct tKerbLibMap;
+
+/*!
+    \brief A library of kerb profiles.
+
+    The profiles are kept in a directory of tKerbEntry records and a flat pool of points, with
+    open addressing hash tables to find them by id or name.  A Kerb is only built when one is
+    asked for.
+
+    A library saved with Save() is a binary file: a header, the directory and then the points.
+    Open() maps the file into memory and reads just the directory, so the points of a kerb are
+    read from the file the first time that kerb is fetched.
+ */
 class KEAYS_KERB_EXPORTS_API KerbFile
 {
 public:
+    enum { KE_MAPPED = 0x0001 };
+
     KerbFile();
+    //! \brief Construct and Open() a binary library.
     KerbFile( const char *kerbFileName );
     ~KerbFile();
 
+    /*!
+        \brief Open a binary kerb library, replacing the current contents.
+        \return false if the file could not be mapped or is not a kerb library.
+     */
+    bool Open( const char *fileName );
+
+    /*!
+        \brief Read every kerb from a text kerb file, as written by Kerb::Write(), adding them with AddKerb().
+        \return the number of kerbs added.
+     */
+    int ImportText( const char *fileName );
+
+    /*!
+        \brief Write the library as a binary kerb library.
+        Points no longer used by a kerb are left out.  The library may be saved over the file it
+        was opened from.
+     */
+    bool Save( const char *fileName );
+
+    //! \brief Remove every kerb and close any opened library.
+    void Clear();
+
+    /*!
+        \brief Add a kerb to the end of the library.
+
+        \param      newKerb [In]  - the kerb to add, it must have a number of 1 or more.
+        \param allowReplace [In]  - if true a kerb with the same number is replaced, in place.
+        \param replacedKerb [Out] - if not NULL receives the kerb that was replaced.
+
+        \return the index of the kerb, or -1 if it was not added.
+     */
     int AddKerb( const Kerb &newKerb, bool allowReplace = false, Kerb *replacedKerb = NULL );
     bool RemoveKerbByID( const int id, Kerb *pKerb = NULL );
     bool RemoveKerbByIndex( const int index, Kerb *pKerb = NULL );
 
+    /*!
+        \brief Fetch a kerb.
+        \return pKerb, or NULL if there is no such kerb or pKerb is NULL.
+     */
     const Kerb *GetKerbByID( const int id, Kerb *pKerb ) const;
     const Kerb *GetKerbByIndex( const int index, Kerb *pKerb ) const;
+    const Kerb *GetKerbByName( const char *name, Kerb *pKerb ) const;
 
-    const size_t NumKerbs() const { return m_pKerbs->size(); }
-private:
-    KerbList *m_pKerbs;
-    IdIndexMap *m_pKerbsID;
+    //! \brief Get the index of a kerb, -1 if there is none.  If names are repeated the first is found.
+    const int FindIndexByID( const int id ) const;
+    const int FindIndexByName( const char *name ) const;
 
+    const size_t NumKerbs() const { return m_pEntries->size(); }
+
+    //! \brief Get a directory entry, for the number, name and size of a kerb without fetching it.
+    const tKerbEntry &GetEntry( const int index ) const { return (*m_pEntries)[index]; }
+
+private:
+    KerbFile( const KerbFile & );
+    const KerbFile &operator=( const KerbFile & );
+
+    const double *EntryPoints( const tKerbEntry &entry ) const;
+    void MakeKerb( const tKerbEntry &entry, Kerb *pKerb ) const;
+    void SetEntry( tKerbEntry &entry, const Kerb &kerb );
+    void IndexEntry( const int index );
+    void RebuildIndexes();
+    void CloseMap( bool keepPoints );
+
+    std::vector<tKerbEntry>    *m_pEntries;        // the directory, in index order
+    std::vector<double>        *m_pPoints;            // x, y pairs of kerbs not in the opened library
+    std::vector<int>        *m_pIdHash;            // entry indexes by id, -1 for an empty slot
+    std::vector<int>        *m_pNameHash;        // entry indexes by name
+    tKerbLibMap                *m_pMap;            // the opened library, NULL if none
 };
 //#endregion
 
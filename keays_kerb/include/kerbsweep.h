@@ -0,0 +1,153 @@
+/*!
+    \file kerbsweep.h
+    \brief Sweeping kerb profiles along alignments into indexed triangle meshes.
+    Part of the keays::types namespace, with the rest of keays_kerb.
+
+    A KerbSweep works out the frame at each station of an alignment once: the station position
+    and the horizontal direction the profile is offset in.  At a corner the direction bisects the
+    two legs and is lengthened so the profile keeps its true width along both of them (a mitre).
+    Any number of Kerbs can then be swept along the same alignment, each into a single KerbMesh
+    with one vertex per profile point per station, shared by every triangle that uses it.
+
+    \date October 2026.
+ */
+#pragma once
+
+#include <vector>
+
+#include "keays_kerb.h"
+
+namespace keays
+{
+namespace types
+{
+
+/*!
+    \brief The longest a mitre may be, as a multiple of the profile offset.
+    Corners sharper than this (about 151 degrees of turn) are clipped to it.
+ */
+extern KEAYS_KERB_EXPORTS_API const double KERB_MITRE_LIMIT;
+
+//-----------------------------------------------------------------------------
+//#region Kerb mesh declaration
+/*!
+    \brief An indexed triangle mesh produced by KerbSweep::Sweep().
+
+    Vertices are stored station by station, so profile point j at station i is vertex
+    i * m_profileSize + j.  Triangles face outwards from an anticlockwise profile.
+ */
+struct KEAYS_KERB_EXPORTS_API KerbMesh
+{
+    KerbMesh();
+    KerbMesh( const KerbMesh &orig );
+    ~KerbMesh();
+
+    const KerbMesh &operator=( const KerbMesh &rhs );
+
+    //! Remove all vertices and triangles.
+    void Clear();
+
+    const size_t NumVertices() const { return m_pVertices->size(); }
+    const size_t NumTriangles() const { return m_pIndices->size() / 3; }
+
+    /*!
+        \brief Write the mesh to a binary file.
+        The number of vertices and indices are written as unsigned ints, then the vertices as
+        x, y, z doubles and then the indices.
+
+        \return the number of items written, as Kerb3D::WriteFile().
+     */
+    size_t WriteFile( FILE *file ) const;
+
+    keays::types::Polyline3D    *m_pVertices;
+    std::vector<unsigned int>    *m_pIndices;        //!< Three per triangle.
+    size_t                        m_numStations;
+    size_t                        m_profileSize;        //!< The number of vertices at each station.
+};
+//#endregion
+
+//-----------------------------------------------------------------------------
+//#region Kerb sweep declaration
+/*!
+    \brief The stations of an alignment, ready to have kerb profiles swept along them.
+ */
+class KEAYS_KERB_EXPORTS_API KerbSweep
+{
+public:
+    KerbSweep();
+    KerbSweep( const KerbSweep &orig );
+    ~KerbSweep();
+
+    const KerbSweep &operator=( const KerbSweep &rhs );
+
+    /*!
+        \brief Work out the station frames for an alignment.
+        Repeated points are dropped.  A closed alignment may or may not repeat its first point
+        at the end; either way the last leg is swept back to the first station.
+
+        \param alignment [In] - a constant reference to the keays::types::Polyline3D to sweep along.
+        \param  isClosed [In] - a boolean flag indicating if the alignment is closed.
+
+        \return false if there are fewer than 2 distinct points.
+     */
+    const bool SetAlignment( const keays::types::Polyline3D &alignment, const bool isClosed = false );
+
+    const size_t NumStations() const { return m_pOrigins->size(); }
+    const bool IsClosed() const { return m_isClosed; }
+
+    /*!
+        \brief Get the frame at a station.
+
+        \param station [In]  - the index of the station.
+        \param pOrigin [Out] - a pointer to receive the station position, may be NULL.
+        \param pOffset [Out] - a pointer to receive the direction a profile offset of 1 is
+                               placed in, including any mitre, may be NULL.
+
+        \return false if station is out of range.
+     */
+    const bool GetFrame( const size_t station, keays::types::VectorD3 *pOrigin,
+                         keays::types::VectorD3 *pOffset ) const;
+
+    /*!
+        \brief Sweep a kerb profile along the alignment.
+        The profile is treated as a closed outline, so the ends of the mesh are left open.  The
+        stations are split between threads, each filling in its own part of the mesh.
+
+        \param       kerb [In]  - a constant reference to the Kerb to sweep.
+        \param isLeftSide [In]  - a boolean flag indicating if the kerb is on the left of the alignment.
+        \param      pMesh [Out] - a pointer to a KerbMesh to receive the result.
+        \param numThreads [In]  - the number of threads to use, 0 for one per processor.
+
+        \return false if no alignment has been set or the kerb has fewer than 2 points.
+     */
+    const bool Sweep( const Kerb &kerb, const bool isLeftSide, KerbMesh *pMesh,
+                      const int numThreads = 0 ) const;
+
+    /*!
+        \brief Get where one of a kerb's special points lies at every station.
+        With SP_BOTTOM_END this gives the outside bottom of the kerb, the usual place to tie it
+        in to a surface from, for instance with keays::triangle::Triangles::TieIn().
+
+        \param        kerb [In]  - a constant reference to the Kerb, its extents must be calculated.
+        \param  isLeftSide [In]  - a boolean flag indicating if the kerb is on the left of the alignment.
+        \param       point [In]  - the special point to get.
+        \param     pPoints [Out] - a pointer to a Polyline3D to receive the point at each station.
+        \param pDirections [Out] - a pointer to a Polyline3D to receive the unit horizontal direction
+                                   away from the alignment at each station, may be NULL.
+
+        \return false if no alignment has been set or the kerb does not have the special point.
+     */
+    const bool GetSpecialPoints( const Kerb &kerb, const bool isLeftSide, const Kerb::eSpecialPoints point,
+                                 keays::types::Polyline3D *pPoints,
+                                 keays::types::Polyline3D *pDirections = NULL ) const;
+
+private:
+    keays::types::Polyline3D    *m_pOrigins;
+    keays::types::Polyline3D    *m_pOffsets;
+    bool                        m_isClosed;
+};
+//#endregion
+
+};    // namespace types
+
+}; // namespace keays
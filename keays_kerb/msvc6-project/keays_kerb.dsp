@@ -106,6 +106,10 @@ PostBuild_Cmds=copy ..\build\Debug\keays_kerbD.dll ..\bin\keays_kerbD.dll	copy .
 
 SOURCE=..\src\keays_kerb.cpp
 # End Source File
+# Begin Source File
+
+SOURCE=..\src\kerbsweep.cpp
+# End Source File
 # End Group
 # Begin Group "Header Files"
 
@@ -114,6 +118,10 @@ SOURCE=..\src\keays_kerb.cpp
 
 SOURCE=..\include\keays_kerb.h
 # End Source File
+# Begin Source File
+
+SOURCE=..\include\kerbsweep.h
+# End Source File
 # End Group
 # Begin Group "Resource Files"
 
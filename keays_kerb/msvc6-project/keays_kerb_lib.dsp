@@ -89,6 +89,10 @@ LIB32=link.exe -lib
 
 SOURCE=..\src\keays_kerb.cpp
 # End Source File
+# Begin Source File
+
+SOURCE=..\src\kerbsweep.cpp
+# End Source File
 # End Group
 # Begin Group "Header Files"
 
@@ -97,6 +101,10 @@ SOURCE=..\src\keays_kerb.cpp
 
 SOURCE=..\include\keays_kerb.h
 # End Source File
+# Begin Source File
+
+SOURCE=..\include\kerbsweep.h
+# End Source File
 # End Group
 # End Target
 # End Project
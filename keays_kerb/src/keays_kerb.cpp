@@ -3,6 +3,8 @@
 #pragma warning(disable:4786)
 
 #include <exception>
+#include <stdexcept>
+#include <algorithm>
 #include <windows.h>
 
 #include "..\include\keays_kerb.h"
@@ -15,8 +17,6 @@ namespace keays
 namespace types
 {
 
-const int MAX_KERB_NAME_SIZE = 16;
-
 const keays::Version G_CURRENT_KERB_VERSION( 1, 0, 0, 0 );
 
 //-----------------------------------------------------------------------------
@@ -107,7 +107,7 @@ const bool WriteKerbToFile( FILE *file, const Kerb &kerb )
         return false;
 
     // write the information
-    fprintf( file, "%5d%5d %16.16s\n", kerbNum, numPts, kerb.GetName().c_str() );
+    fprintf( file, "%5d%5d %16.16s\n", kerbNum, numPts, kerb.GetName() );
     for( int j = 0; j < numPts; j++ )
     {
         // write the points
@@ -133,7 +133,7 @@ const bool WriteKerbToString( std::string &result, const Kerb &kerb )
 
     // write the information
     char buf[64];
-    _snprintf( buf, 64, "%5d%5d %16.16s\n", kerbNum, numPts, kerb.GetName().c_str() );
+    _snprintf( buf, 64, "%5d%5d %16.16s\n", kerbNum, numPts, kerb.GetName() );
     result = buf;
     for( int j = 0; j < numPts; j++ )
     {
@@ -341,32 +341,166 @@ size_t Kerb3D::WriteFile( FILE *file ) const
 }
 //#endregion
 
+//-----------------------------------------------------------------------------
+//#region Kerb points implementation
+KerbPoints::KerbPoints()
+{    //#region
+    m_pHeap = NULL;
+    m_size = 0;
+    m_capacity = KERB_INLINE_POINTS;
+    //#endregion
+}
+
+KerbPoints::KerbPoints( const KerbPoints &orig )
+{    //#region
+    m_pHeap = NULL;
+    m_size = 0;
+    m_capacity = KERB_INLINE_POINTS;
+
+    *this = orig;
+    //#endregion
+}
+
+KerbPoints::~KerbPoints()
+{    //#region
+    delete [] m_pHeap;        m_pHeap = NULL;
+    //#endregion
+}
+
+const KerbPoints &KerbPoints::operator=( const KerbPoints &rhs )
+{    //#region
+    if( this == &rhs )
+        return *this;
+
+    m_size = 0;
+    reserve( rhs.m_size );
+    if( rhs.m_size )
+        memcpy( Points(), rhs.Points(), rhs.m_size * sizeof( keays::types::VectorD2 ) );
+    m_size = rhs.m_size;
+
+    return *this;
+    //#endregion
+}
+
+void KerbPoints::Swap( KerbPoints &other )
+{    //#region
+    if( this == &other )
+        return;
+
+    // only the points held inline have to be exchanged, heap blocks just change hands
+    double temp[2 * KERB_INLINE_POINTS];
+    size_t numInline = ( m_pHeap ? 0 : m_size );
+    size_t numOtherInline = ( other.m_pHeap ? 0 : other.m_size );
+
+    memcpy( temp, m_inline, numInline * sizeof( keays::types::VectorD2 ) );
+    memcpy( m_inline, other.m_inline, numOtherInline * sizeof( keays::types::VectorD2 ) );
+    memcpy( other.m_inline, temp, numInline * sizeof( keays::types::VectorD2 ) );
+
+    std::swap( m_pHeap, other.m_pHeap );
+    std::swap( m_size, other.m_size );
+    std::swap( m_capacity, other.m_capacity );
+    //#endregion
+}
+
+keays::types::VectorD2 &KerbPoints::at( const size_t index )
+{    //#region
+    if( index >= m_size )
+        throw std::out_of_range( "KerbPoints::at - index out of range" );
+
+    return Points()[index];
+    //#endregion
+}
+
+const keays::types::VectorD2 &KerbPoints::at( const size_t index ) const
+{    //#region
+    if( index >= m_size )
+        throw std::out_of_range( "KerbPoints::at - index out of range" );
+
+    return Points()[index];
+    //#endregion
+}
+
+void KerbPoints::reserve( const size_t count )
+{    //#region
+    if( count <= m_capacity )
+        return;
+
+    size_t capacity = m_capacity * 2;
+    if( capacity < count )
+        capacity = count;
+
+    keays::types::VectorD2 *pHeap = new keays::types::VectorD2[capacity];
+    if( m_size )
+        memcpy( pHeap, Points(), m_size * sizeof( keays::types::VectorD2 ) );
+
+    delete [] m_pHeap;
+    m_pHeap = pHeap;
+    m_capacity = capacity;
+    //#endregion
+}
+
+void KerbPoints::resize( const size_t count )
+{    //#region
+    reserve( count );
+
+    keays::types::VectorD2 *pPts = Points();
+    for( size_t i = m_size; i < count; i++ )
+        pPts[i] = keays::types::VectorD2( 0, 0 );
+
+    m_size = count;
+    //#endregion
+}
+
+void KerbPoints::push_back( const keays::types::VectorD2 &pt )
+{    //#region
+    if( m_size == m_capacity )
+    {
+        // pt may be one of our own points
+        keays::types::VectorD2 copy = pt;
+        reserve( m_size + 1 );
+        Points()[m_size++] = copy;
+        return;
+    }
+
+    Points()[m_size++] = pt;
+    //#endregion
+}
+
+KerbPoints::iterator KerbPoints::erase( iterator pos )
+{    //#region
+    iterator last = end();
+    if( pos + 1 < last )
+        memmove( pos, pos + 1, ( last - pos - 1 ) * sizeof( keays::types::VectorD2 ) );
+    m_size--;
+
+    return pos;
+    //#endregion
+}
+//#endregion
+
 //-----------------------------------------------------------------------------
 //#region Base Kerb class implementation
 // This is the constructor of a class that has been exported.
 // see keays_kerb.h for the class definition
 Kerb::Kerb( bool createBasePoints /*=true*/ )
 {    //#region
-    m_pPts = new KerbPtsList;
-    m_pExtents = new keays::math::RectD;
-    m_pName = new std::string;
 //    m_pVersion = new keays::Version( G_CURRENT_KERB_VERSION );
 
-    m_pPts->clear();
-    m_pName->erase();
     m_kerbNum = -1;
+    m_name[0] = '\0';
     m_needsRecalc = true;
+    m_topStart = m_topEnd = m_bottomStart = m_bottomEnd = 0;
 
     m_allowEndPoints = createBasePoints;
     if( m_allowEndPoints )
     {
-        m_pPts->push_back( keays::types::VectorD2( 0, 0 ) ); // the first and last points must be 0,0
-        m_pPts->push_back( keays::types::VectorD2( 0, 0 ) );
+        m_pts.push_back( keays::types::VectorD2( 0, 0 ) ); // the first and last points must be 0,0
+        m_pts.push_back( keays::types::VectorD2( 0, 0 ) );
 
 #ifdef _DEBUG
         char buf[512];
         memset( buf, 0, 512 );
-        _snprintf( buf, 511, "Kerb::Kerb( %s ) - numPoints = %d\n", (m_allowEndPoints ? "true" : "false"), m_pPts->size() );
+        _snprintf( buf, 511, "Kerb::Kerb( %s ) - numPoints = %d\n", (m_allowEndPoints ? "true" : "false"), m_pts.size() );
         OutputDebugString( buf );
 #endif
     }
@@ -375,11 +509,9 @@ Kerb::Kerb( bool createBasePoints /*=true*/ )
 
 Kerb::Kerb( const Kerb &orig )
 {    //#region
+#ifdef _DEBUG
     OutputDebugString( "Kerb:: Kerb( const kerb & )\n" );
-    // create
-    m_pExtents = new keays::math::RectD;
-    m_pPts = new KerbPtsList;
-    m_pName = new std::string;
+#endif
 //    m_pVersion = new keays::Version;
 
     // and copy
@@ -389,30 +521,35 @@ Kerb::Kerb( const Kerb &orig )
 
 const int Kerb::DuplicateKerb( const Kerb &src )
 {    //#region
+#ifdef _DEBUG
     OutputDebugString( "Kerb:: DuplicateKerb(...)\n" );
+#endif
 
     //(*m_pVersion) = src.Version();
     m_kerbNum = src.GetNumber();
-    (*m_pName) = src.GetName();
-    m_pPts->clear();
+    SetName( src.m_name );
+    m_pts = src.GetPointsRef();
     m_allowEndPoints = src.m_allowEndPoints;
 
-    KerbPtsList::const_iterator itr;
-    const KerbPtsList &otherPts = src.GetPointsRef();
-    for( itr = otherPts.begin(); itr != otherPts.end(); itr++ )
+    // a calculated kerb has already been wound and cleaned up, so take its results
+    if( src.m_needsRecalc )
     {
-        m_pPts->push_back( *itr );
+        RecalcExtents();
+    } else
+    {
+        m_extents = src.m_extents;
+        memcpy( m_specialPts, src.m_specialPts, sizeof( m_specialPts ) );
+        m_needsRecalc = false;
     }
 
-    RecalcExtents();
-
     return 0;
     //#endregion
 }
 
 const Kerb &Kerb::operator=( const Kerb &rhs )
 {    //#region
-    DuplicateKerb( rhs );
+    if( this != &rhs )
+        DuplicateKerb( rhs );
 
     return *this;
     //#endregion
@@ -420,28 +557,45 @@ const Kerb &Kerb::operator=( const Kerb &rhs )
 
 const KerbPtsList &Kerb::GetPointsRef() const
 {    //#region
-    return *m_pPts;
+    return m_pts;
     //#endregion
 }
 
 Kerb::~Kerb()
 {    //#region
-    delete m_pPts;                m_pPts = NULL;
-    delete m_pExtents;            m_pExtents = NULL;
-    delete m_pName;                m_pName = NULL;
 //    delete m_pVersion;            m_pVersion = NULL;
     //#endregion
 }
 
+void Kerb::Swap( Kerb &other )
+{    //#region
+    char name[MAX_KERB_NAME_SIZE + 1];
+
+    std::swap( m_kerbNum, other.m_kerbNum );
+    memcpy( name, m_name, sizeof( m_name ) );
+    memcpy( m_name, other.m_name, sizeof( m_name ) );
+    memcpy( other.m_name, name, sizeof( m_name ) );
+    m_pts.Swap( other.m_pts );
+    std::swap( m_extents, other.m_extents );
+    std::swap( m_needsRecalc, other.m_needsRecalc );
+    std::swap( m_allowEndPoints, other.m_allowEndPoints );
+    for( int i = 0; i < 4; i++ )
+        std::swap( m_specialPts[i], other.m_specialPts[i] );
+    std::swap( m_lineColour, other.m_lineColour );
+    std::swap( m_fillColour, other.m_fillColour );
+    std::swap( m_filled, other.m_filled );
+    //#endregion
+}
+
 void Kerb::AddPoint( const keays::types::VectorD2 &pt )
 {    //#region
-    if( m_pPts->size() < 1 )
+    if( m_pts.size() < 1 )
     {
-//        *m_pOuterPointItr = m_pPts->begin();
+//        *m_pOuterPointItr = m_pts.begin();
     }
 
     // the recalc takes care of the outer point if it is not the first point
-    m_pPts->push_back( pt );
+    m_pts.push_back( pt );
 
     m_needsRecalc = true;
     //#endregion
@@ -452,7 +606,7 @@ const bool Kerb::GetPoint( const int index, keays::types::VectorD2 &pt ) const
     if( ( index < 0 ) || ( index >= (int)GetNumPoints() ) )
         return false;
 
-    pt = (*m_pPts)[ index ];
+    pt = m_pts[ index ];
 
     return true;
     //#endregion
@@ -468,7 +622,7 @@ const bool Kerb::RemovePoint( const int index, keays::types::VectorD2 *pPt )
     // we need to move the data for each point after up by one index,
     // this would be alot faster if we use a list, but the convienience
     // of random access is much more useful
-    int last = (int)m_pPts->size() - 1;
+    int last = (int)m_pts.size() - 1;
     if( last != index )
     {
         // we are not removing the last point so we need to adjust
@@ -476,10 +630,10 @@ const bool Kerb::RemovePoint( const int index, keays::types::VectorD2 *pPt )
         //last--; // stop 1 before the last
         for( i = index, j = i+1; i < last; i++, j++ )
         {
-            (*m_pPts)[i] = (*m_pPts)[j];
+            m_pts[i] = m_pts[j];
         }
     }
-    m_pPts->pop_back();
+    m_pts.pop_back();
 
     m_needsRecalc = true;
 
@@ -495,16 +649,16 @@ bool Kerb::InsertPointBefore( const int index, const keays::types::VectorD2 &pt
         return false;
 
     // duplicate the last point
-    int last = (int)m_pPts->size()-1;
-    m_pPts->push_back( m_pPts->at( last ) );
+    int last = (int)m_pts.size()-1;
+    m_pts.push_back( m_pts.at( last ) );
 
     // starting from the end and working backwards
     int i, j;
     for( i = last, j = i-1; i > index; j--, i-- )
     {
-        (*m_pPts)[i] = (*m_pPts)[j];
+        m_pts[i] = m_pts[j];
     }
-    (*m_pPts)[index] = pt;
+    m_pts[index] = pt;
 
     m_needsRecalc = true;
 
@@ -521,9 +675,9 @@ bool Kerb::InsertPointAfter( const int index, const keays::types::VectorD2 &pt )
 
     m_needsRecalc = true;
 
-    int last = (int)m_pPts->size()-1; // the index of the last point
+    int last = (int)m_pts.size()-1; // the index of the last point
     // duplicate...
-    m_pPts->push_back( m_pPts->at( last ) );
+    m_pts.push_back( m_pts.at( last ) );
     if( index >= last )
     {
         // we are adding to the end
@@ -537,10 +691,10 @@ bool Kerb::InsertPointAfter( const int index, const keays::types::VectorD2 &pt )
         int i, j;
         for( i = last, j = i-1; i >= index+1; i--, j-- )
         {
-            (*m_pPts)[i] = (*m_pPts)[j];
+            m_pts[i] = m_pts[j];
         }
     }
-    (*m_pPts)[index+1] = pt;
+    m_pts[index+1] = pt;
 
     return true;
     //#endregion
@@ -552,9 +706,9 @@ const bool Kerb::ReplacePoint( const int index, const keays::types::VectorD2 &re
         return false;
 
     if( pRemovedPt )
-        *pRemovedPt = (*m_pPts)[index];
+        *pRemovedPt = m_pts[index];
 
-    (*m_pPts)[index] = replacementPt;
+    m_pts[index] = replacementPt;
 
     m_needsRecalc = true;
 
@@ -574,27 +728,28 @@ void Kerb::SetNumber( const int kerbNum )
     //#endregion
 }
 
-const std::string &Kerb::GetName() const
+const char *Kerb::GetName() const
 {    //#region
-    return (*m_pName);
+    return m_name;
     //#endregion
 }
 
 void Kerb::SetName( const char *name )
 {    //#region
-    m_pName->assign( name );
+    strncpy( m_name, name, MAX_KERB_NAME_SIZE );
+    m_name[MAX_KERB_NAME_SIZE] = '\0';
     //#endregion
 }
 
 void Kerb::SetName( const std::string &name )
 {    //#region
-    (*m_pName) = name;
+    SetName( name.c_str() );
     //#endregion
 }
 
 const size_t Kerb::GetNumPoints() const
 {    //#region
-    return m_pPts->size();
+    return m_pts.size();
     //#endregion
 }
 
@@ -604,8 +759,8 @@ const double Kerb::TotalWidth() const
         return 0.0;
 //        RecalcExtents();
 
-    if( m_pPts->size() )
-        return m_pExtents->GetWidth();
+    if( m_pts.size() )
+        return m_extents.GetWidth();
     else
         return 0.0;
     //#endregion
@@ -617,8 +772,8 @@ const double Kerb::TotalHeight() const
         return 0.0;
 //        RecalcExtents();
 
-    if( m_pPts->size() )
-        return m_pExtents->GetHeight();
+    if( m_pts.size() )
+        return m_extents.GetHeight();
     else
         return 0.0;
     //#endregion
@@ -631,8 +786,8 @@ const double Kerb::GetInsideWidth() const
         return 0.0;
 //        RecalcExtents();
 
-    if( m_pPts->size() )
-        return m_pExtents->m_left;
+    if( m_pts.size() )
+        return m_extents.m_left;
     else
         return 0.0;
     //#endregion
@@ -643,8 +798,8 @@ const double Kerb::GetOutsideWidth() const
         return 0.0;
 //        RecalcExtents();
 
-    if( m_pPts->size() )
-        return m_pExtents->m_right;
+    if( m_pts.size() )
+        return m_extents.m_right;
     else
         return 0.0;
     //#endregion
@@ -655,8 +810,8 @@ const double Kerb::GetHeight() const
         return 0.0;
 //        RecalcExtents();
 
-    if( m_pPts->size() )
-        return m_pExtents->m_top;
+    if( m_pts.size() )
+        return m_extents.m_top;
     else
         return 0.0;
     //#endregion
@@ -667,8 +822,8 @@ const double Kerb::GetDepth() const
         return 0.0;
 //        RecalcExtents();
 
-    if( m_pPts->size() )
-        return m_pExtents->m_bottom;
+    if( m_pts.size() )
+        return m_extents.m_bottom;
     else
         return 0.0;
     //#endregion
@@ -706,9 +861,9 @@ const int Kerb::GetScreenPoints( const RECT &screenRect, POINT *pts, const int p
 #endif
 
 //    width = rectD.GetWidth();
-    width = m_pExtents->GetWidth();
+    width = m_extents.GetWidth();
 //    height = rectD.GetHeight();
-    height = m_pExtents->GetHeight();
+    height = m_extents.GetHeight();
     ptCount = 0;
     scnWidth = screenRect.right - screenRect.left;
     scnHeight = screenRect.bottom - screenRect.top;
@@ -747,21 +902,21 @@ const int Kerb::GetScreenPoints( const RECT &screenRect, POINT *pts, const int p
 //    scnHOffset = ScreenSizeFromWorld( hRatio, rectD.GetLeft() );
     if( side == keays::math::SIDE_LEFT )
     {
-        scnHOffset = ScreenSizeFromWorld( hRatio, m_pExtents->GetRight() ) * -1;
+        scnHOffset = ScreenSizeFromWorld( hRatio, m_extents.GetRight() ) * -1;
     } else
     {
-        scnHOffset = ScreenSizeFromWorld( hRatio, m_pExtents->GetLeft() );
+        scnHOffset = ScreenSizeFromWorld( hRatio, m_extents.GetLeft() );
     }
 
 //    scnVOffset = ScreenSizeFromWorld( vRatio, rectD.GetTop() );
-    scnVOffset = ScreenSizeFromWorld( vRatio, m_pExtents->GetTop() );
+    scnVOffset = ScreenSizeFromWorld( vRatio, m_extents.GetTop() );
 
     if( pHRatio ) *pHRatio = hRatio;
     if( pVRatio ) *pVRatio = vRatio;
 
     ptCount = 0;
 #if 0
-    for( itr = m_pPts->begin(), ptIdx = 0; itr != m_pPts->end(), ptIdx < ptsSize;
+    for( itr = m_pts.begin(), ptIdx = 0; itr != m_pts.end(), ptIdx < ptsSize;
          itr++, ptIdx++ )
     {
         // process the points
@@ -808,17 +963,12 @@ const keays::types::Polyline2D *
 Kerb::GetPoints( keays::types::Polyline2D *pPoints, const Kerb::eKerbProfile profile,
                  const bool isLeftSide, keays::math::RectD *pRect /*= NULL*/ ) const
 {    //#region
-#ifdef _DEBUG
-    char buf[ 256 ];
-#endif
-
     if( !pPoints )
     {
         OutputDebugString( "Kerb::GetPoints(...) - Returning NULL, NULL pointer passed as destination\n" );
         return NULL;
     }
-    size_t numPoints = m_pPts->size();
-    if( numPoints < 1 )
+    if( m_pts.size() < 1 )
     {
         OutputDebugString( "Kerb::GetPoints(...) - Returning NULL, no points to get\n" );
         return NULL;
@@ -829,149 +979,106 @@ Kerb::GetPoints( keays::types::Polyline2D *pPoints, const Kerb::eKerbProfile pro
         return NULL;
     }
 
-    pPoints->clear();
-    if( pRect )
-        pRect->MakeInvalid();
-    size_t i;
-
-//    TOP SURFACE WHEN DOING RIGHT SIDE IS FROM
-    int interval = 1;
-    int start = 0;
-    int end = 0;
-
-    std::list<keays::types::VectorD2> ptsList;
+    pPoints->resize( NumProfilePoints( profile ) );
+    if( pPoints->empty() )
+    {
+        if( pRect )
+            pRect->MakeInvalid();
+        return pPoints;
+    }
 
-    if( profile == KP_BOTTOM )
-    {    //#region
+    GetPoints( &(*pPoints)[0], pPoints->size(), profile, isLeftSide, pRect );
 
-        //#endregion
-    } else if( profile == KP_TOP )
-    {    //#region
+    return pPoints;
+    //#endregion
+}
 
-        //#endregion
-    } else    // the full outline
-    {    //#region
-        for( i = 0; i < numPoints; i++ )
-        {
-#ifdef _DEBUG
-            _snprintf( buf, 256, "Gen Points for all: pt( %d/%d ) [%7.3f, %7.3f]\n",
-                                i, numPoints, (*m_pPts)[i].x, (*m_pPts)[i].y );
-            OutputDebugString( buf );
-#endif
-            ptsList.push_back( (*m_pPts)[i] );
-        }
-        //#endregion
-    }
-/* //#region old version
-        //RecalcExtents();
-    if( ( m_outerPointIndex < 0 ) || ( m_outerPointIndex >= numPoints ) )
-    {
-        OutputDebugString( "Kerb::GetPoints(...) - Returning NULL, outer point out of range\n" );
-        //RecalcExtents();
-        return NULL;
-    }
+const size_t Kerb::GetPoints( keays::types::VectorD2 *pPoints, const size_t maxPoints,
+                              const Kerb::eKerbProfile profile, const bool isLeftSide,
+                              keays::math::RectD *pRect /*= NULL*/ ) const
+{    //#region
+    if( pRect )
+        pRect->MakeInvalid();
+    if( !pPoints || m_needsRecalc )
+        return 0;
 
+    size_t numPoints = m_pts.size();
+    size_t count = NumProfilePoints( profile );
+    if( count < 1 || count > maxPoints )
+        return 0;
 
-    //    NOTE: I am using (*m_pPts)[] since it is much faster but not as safe as using an
-    //    iterator or the at() function, the safety checks should be taken care of at the start.
+    // following the winding, the bottom runs from the inside out and the top back again
+    size_t start = 0;
     if( profile == KP_BOTTOM )
-    {    //#region
-//        ptsList.push_back( m_basePoint ); // add the base point to the start of the list
-        for( i = 0; i <= m_outerPointIndex; i++ )
-        {
-#ifdef _DEBUG
-            _snprintf( buf, 256, "Gen Points on bottom: pt( %d/%d ) [%7.3f, %7.3f]\n",
-                                i, m_outerPointIndex, (*m_pPts)[i].x, (*m_pPts)[i].y );
-            OutputDebugString( buf );
-#endif
-            ptsList.push_back( (*m_pPts)[i] );
-        }
-        //#endregion
-    } else if( profile == KP_TOP )
-    {    //#region
-        for( i = m_outerPointIndex; i < numPoints; i++ )
-        {
-#ifdef _DEBUG
-            _snprintf( buf, 256, "Gen Points on top: pt( %d/%d ) [%7.3f, %7.3f]\n",
-                                i, numPoints - m_outerPointIndex, (*m_pPts)[i].x, (*m_pPts)[i].y );
-            OutputDebugString( buf );
-#endif
-            ptsList.push_back( (*m_pPts)[i] );
-        }
-        //ptsList.push_back( m_basePoint ); // add the base point to the end of the list
-        //#endregion
-    } else
-    {    //#region
-        //ptsList.push_back( m_basePoint ); // add the base point to the start of the list
-        for( i = 0; i < numPoints; i++ )
-        {
-#ifdef _DEBUG
-            _snprintf( buf, 256, "Gen Points for all: pt( %d/%d ) [%7.3f, %7.3f]\n",
-                                i, numPoints, (*m_pPts)[i].x, (*m_pPts)[i].y );
-            OutputDebugString( buf );
-#endif
-            ptsList.push_back( (*m_pPts)[i] );
-        }
-        //ptsList.push_back( m_basePoint ); // add the base point to the end of the list
-        //#endregion
-    }
-//#endregion    //*/
+        start = m_bottomStart;
+    else if( profile == KP_TOP )
+        start = m_topEnd;
 
-    // we reverse the order if we are doing the left side
-    if( isLeftSide )
+    const keays::types::VectorD2 *pPts = m_pts.begin();
+    for( size_t i = 0; i < count; i++ )
     {
-        ptsList.reverse();
-    }
-
-    std::list<keays::types::VectorD2>::iterator itr;
-    for( itr = ptsList.begin(); itr != ptsList.end(); itr++ )
-    {
-        keays::types::VectorD2 pt = (*itr);
+        // we reverse the order and mirror the points if we are doing the left side
+        keays::types::VectorD2 pt = pPts[( start + ( isLeftSide ? count - 1 - i : i ) ) % numPoints];
         if( isLeftSide )
             pt.x = pt.x * -1;
         if( pRect )
             pRect->IncludePoint( pt );
-        pPoints->push_back( pt );
+        pPoints[i] = pt;
     }
 
-    return pPoints;
+    return count;
+    //#endregion
+}
+
+const size_t Kerb::NumProfilePoints( const Kerb::eKerbProfile profile ) const
+{    //#region
+    size_t numPoints = m_pts.size();
+    if( profile == KP_FULL || numPoints < 1 )
+        return numPoints;
+
+    size_t start = ( profile == KP_BOTTOM ? m_bottomStart : m_topEnd );
+    size_t end = ( profile == KP_BOTTOM ? m_bottomEnd : m_topStart );
+    if( start >= numPoints || end >= numPoints )
+        return 0;
+
+    return ( end + numPoints - start ) % numPoints + 1;
     //#endregion
 }
 
 void Kerb::RecalcExtents()
 {    //#region
     int i = 0, j = 0;
-    m_pExtents->MakeInvalid();
-    m_pExtents->IncludePoint( 0, 0 );
+    m_extents.MakeInvalid();
+    m_extents.IncludePoint( 0, 0 );
     m_needsRecalc = false;
-    if( m_pPts->size() < 1 )
+    if( m_pts.size() < 1 )
         return;
 
     KerbPtsList::const_iterator itr;
-    for( itr = m_pPts->begin(); itr != m_pPts->end(); itr++ )
+    for( itr = m_pts.begin(); itr != m_pts.end(); itr++ )
     {
-        m_pExtents->IncludePoint( *itr );
+        m_extents.IncludePoint( *itr );
     }
 
-    if( CalcPolygonArea( *m_pPts ) < 0.0 )
+    if( CalcPolygonArea( m_pts.begin(), (int)m_pts.size() ) < 0.0 )
     {
-        int numPts = (int)m_pPts->size();
+        int numPts = (int)m_pts.size();
         int lastPtIdx = numPts - 1;
 
         // it needs to have winding reversed
         for( i = 0, j = lastPtIdx; ( i < numPts/2 ) && ( i < j ); i++, j-- )
         {
             VectorD2 pt;
-            pt = (*m_pPts)[i];
-            (*m_pPts)[i] = (*m_pPts)[j];
-            (*m_pPts)[j] = pt;
+            pt = m_pts[i];
+            m_pts[i] = m_pts[j];
+            m_pts[j] = pt;
         }
     }
     RemoveDuplicates();
 
     VectorD2 minPt, maxPt;
     minPt = maxPt = VectorD2( 0, 0 );
-    for( i = 0, itr = m_pPts->begin(); itr != m_pPts->end(); itr++, i++    )
+    for( i = 0, itr = m_pts.begin(); itr != m_pts.end(); itr++, i++    )
     {
         const VectorD2 &pt = (*itr);
 
@@ -991,20 +1098,22 @@ void Kerb::RecalcExtents()
 
 void Kerb::RemoveDuplicates()
 {    //#region
-    if( m_pPts->size() > 2 )
+    if( m_pts.size() > 2 )
     {
         KerbPtsList::iterator pt, nextPt;
-        pt = m_pPts->begin();
+        pt = m_pts.begin();
         nextPt = pt; nextPt++;
 
-        for( ; pt != m_pPts->end() && nextPt != m_pPts->end(); pt++, nextPt++ )
+        for( ; pt != m_pts.end() && nextPt != m_pts.end(); pt++, nextPt++ )
         {
-            while( ( pt->x == nextPt->x ) && ( pt->y == nextPt->y ) && ( pt != m_pPts->end() ) && ( nextPt != m_pPts->end() ) )
+            while( ( nextPt != m_pts.end() ) && ( pt->x == nextPt->x ) && ( pt->y == nextPt->y ) )
             {
-                nextPt = m_pPts->erase( nextPt );
+                nextPt = m_pts.erase( nextPt );
                 //nextPt = pt;
                 //nextPt++;
             }
+            if( nextPt == m_pts.end() )
+                break;
         }
     }
 
@@ -1017,7 +1126,7 @@ void Kerb::RecalcOuterPoint()
     KerbPtsList::iterator itr;
 
     // reset to the base point
-    if( m_pPts->size() < 1 )
+    if( m_pts.size() < 1 )
     {
         return;
     } else
@@ -1030,7 +1139,7 @@ void Kerb::RecalcOuterPoint()
         then it is is the outermost of those points
      */
     int i;
-    for( i = 0, itr = m_pPts->begin(); itr != m_pPts->end(); itr++, i++ )
+    for( i = 0, itr = m_pts.begin(); itr != m_pts.end(); itr++, i++ )
     {
     }
     //#endregion
@@ -1057,12 +1166,12 @@ const bool Kerb::Write( FILE *outFile ) const
 
     // write the information
     fprintf( outFile, "%5d%5d %16.16s %d %d %d %d %08x %08x\n",
-             kerbNum, numPts, GetName().c_str(),
+             kerbNum, numPts, GetName(),
              m_topStart, m_topEnd, m_bottomStart, m_bottomEnd,
              m_lineColour, m_fillColour );
     KerbPtsList::const_iterator itr;
     keays::types::VectorD2 lastPoint( INVALID_ANGLE, INVALID_ANGLE );
-    for( itr = m_pPts->begin(); itr != m_pPts->end(); itr++ )
+    for( itr = m_pts.begin(); itr != m_pts.end(); itr++ )
     {
         // write the points
         const keays::types::VectorD2 &pt = (*itr);
@@ -1112,18 +1221,19 @@ const bool Kerb::Read( FILE *inFile )
 //    if( kerbNum < 1 )
 //        return false;
 
-    m_pPts->clear();
+    m_pts.clear();
 
     SetNumber( kerbNum );
     SetName( kerbName );
 
-    std::list<keays::types::VectorD2> points, allPoints;
     // we now have the data to read
 //    if( !fgets( buf, 256, inFile ) )
 //        return false;
     double x, y;
     keays::types::VectorD2 pt;
 
+    if( numPoints > 0 )
+        m_pts.reserve( numPoints );
     for( int i = 0; i < numPoints; i++ )
     {
         if( !fgets( buf, 256, inFile ) )
@@ -1135,8 +1245,9 @@ const bool Kerb::Read( FILE *inFile )
 
         pt.x = x;
         pt.y = y;
-        points.push_back( pt );
+        m_pts.push_back( pt );
     }
+    m_needsRecalc = true;
 /*
     if( !fgets( buf, 256, inFile ) )
         return false;
@@ -1149,17 +1260,11 @@ const bool Kerb::Read( FILE *inFile )
 //*/
 
     // the files should store rightside designs, so we need to reverse the points
-    double area = keays::math::CalcPolygonArea( points );
+    double area = keays::math::CalcPolygonArea( m_pts.begin(), (int)m_pts.size() );
     if( area < 0 )
     {
         // reverse them order
-        points.reverse();
-    }
-
-    std::list<keays::types::VectorD2>::iterator itr;
-    for( itr = points.begin(); itr != points.end(); itr++ )
-    {
-        AddPoint( *itr );
+        std::reverse( m_pts.begin(), m_pts.end() );
     }
 
     RecalcExtents();
@@ -1171,7 +1276,7 @@ const bool Kerb::Read( FILE *inFile )
 //enum eSpecialPoints { SP_TOP_START, SP_TOP_END, SP_BOTTOM_START, SP_BOTTOM_END };
 bool Kerb::SpecialPointIndex( const eSpecialPoints pt, unsigned int index )
 {
-    if( ( index < 0 ) || ( index >= m_pPts->size() ) )
+    if( ( index < 0 ) || ( index >= m_pts.size() ) )
         return false;
     m_specialPts[pt] = index;
     return true;
@@ -1181,7 +1286,7 @@ bool Kerb::SpecialPointIndex( const unsigned int tsIdx, const unsigned int teIdx
                         const unsigned int bsIdx, const unsigned int beIdx )
 {
     bool result = true;
-    const size_t numPts = m_pPts->size();
+    const size_t numPts = m_pts.size();
     if( ( tsIdx < 0 ) || ( tsIdx >= numPts ) )
         result &= false;
     else
@@ -1207,7 +1312,7 @@ bool Kerb::SpecialPointIndex( const unsigned int tsIdx, const unsigned int teIdx
 
 const unsigned int Kerb::SpecialPointIndex( const eSpecialPoints pt ) const
 {
-    return ( pt >= SP_TOP_START && pt < SP_BOTTOM_END ? m_specialPts[pt] : -1 );
+    return ( pt >= SP_TOP_START && pt <= SP_BOTTOM_END ? m_specialPts[pt] : -1 );
 }
 
 void Kerb::SpecialPointIndex( unsigned int *pTsIdx, unsigned int *pTeIdx,
@@ -1227,132 +1332,503 @@ void Kerb::SpecialPointIndex( unsigned int *pTsIdx, unsigned int *pTeIdx,
 
 //------------------------------------------------------------------------
 //#region Kerb File Implementation
+static const char KERB_LIB_MAGIC[8] = { 'K', 'E', 'R', 'B', 'L', 'I', 'B', '\0' };
+static const unsigned int KERB_LIB_VERSION = 1;
+
+/*
+    The start of a binary kerb library.  The directory of tKerbEntry records and the
+    points, as x, y pairs of doubles, follow at the offsets given.
+ */
+struct tKerbLibHeader
+{
+    char            m_magic[8];
+    unsigned int    m_version;
+    unsigned int    m_numKerbs;
+    unsigned int    m_numPoints;
+    unsigned int    m_directoryOffset;
+    unsigned int    m_pointsOffset;
+    unsigned int    m_reserved;
+};
+
+// an opened library file
+struct tKerbLibMap
+{
+    HANDLE            m_hFile;
+    HANDLE            m_hMapping;
+    const char        *m_pView;
+    const double    *m_pPoints;
+    std::string        m_fileName;
+};
+
+inline unsigned int HashKerbId( const int id )
+{
+    unsigned int h = (unsigned int)id * 2654435761u;
+    return h ^ ( h >> 15 );
+}
+
+inline unsigned int HashKerbName( const char *name )
+{
+    unsigned int h = 2166136261u;
+    for( int i = 0; i < KERB_LIB_NAME_SIZE && name[i]; i++ )
+    {
+        h ^= (unsigned char)name[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
 KerbFile::KerbFile()
 {    //#region
-    m_pKerbs = new KerbList;
-    m_pKerbsID = new IdIndexMap;
+    m_pEntries = new std::vector<tKerbEntry>;
+    m_pPoints = new std::vector<double>;
+    m_pIdHash = new std::vector<int>;
+    m_pNameHash = new std::vector<int>;
+    m_pMap = NULL;
     //#endregion
 }
+
 KerbFile::KerbFile( const char *kerbFileName )
-{
-    m_pKerbs = new KerbList;
-    m_pKerbsID = new IdIndexMap;
+{    //#region
+    m_pEntries = new std::vector<tKerbEntry>;
+    m_pPoints = new std::vector<double>;
+    m_pIdHash = new std::vector<int>;
+    m_pNameHash = new std::vector<int>;
+    m_pMap = NULL;
+
+    Open( kerbFileName );
+    //#endregion
 }
+
 KerbFile::~KerbFile()
-{
-    delete m_pKerbs;
-    m_pKerbs = NULL;
+{    //#region
+    CloseMap( false );
+
+    delete m_pEntries;        m_pEntries = NULL;
+    delete m_pPoints;        m_pPoints = NULL;
+    delete m_pIdHash;        m_pIdHash = NULL;
+    delete m_pNameHash;        m_pNameHash = NULL;
+    //#endregion
+}
 
-    delete m_pKerbsID;
-    m_pKerbsID = NULL;
+void KerbFile::Clear()
+{    //#region
+    CloseMap( false );
 
+    m_pEntries->clear();
+    m_pPoints->clear();
+    m_pIdHash->clear();
+    m_pNameHash->clear();
+    //#endregion
 }
 
-int KerbFile::AddKerb( const Kerb &newKerb, bool allowReplace /*= false*/, Kerb *replacedKerb /*= NULL*/ )
-{
 /*
-    if( m_pKerbsID->find( newKerb.GetNumber() ) == m_pKerbsID->end() )
+    Unmap the opened library.  If keepPoints is set the points of its kerbs are
+    copied into the pool first, otherwise the kerbs must be thrown away.
+ */
+void KerbFile::CloseMap( bool keepPoints )
+{    //#region
+    if( !m_pMap )
+        return;
+
+    if( keepPoints )
     {
-        if( !allowReplace )
-            return -1;
-        // remove it
-    }
+        std::vector<tKerbEntry>::iterator itr;
+        for( itr = m_pEntries->begin(); itr != m_pEntries->end(); itr++ )
+        {
+            if( !( itr->m_flags & KE_MAPPED ) )
+                continue;
 
-    // we add it to the vector...
-    m_pKerbs->push_back( newKerb );
-    int index = (int)m_pKerbs->size()-1;
+            const double *pXY = m_pMap->m_pPoints + 2 * itr->m_firstPoint;
+            itr->m_firstPoint = (unsigned int)( m_pPoints->size() / 2 );
+            m_pPoints->insert( m_pPoints->end(), pXY, pXY + 2 * itr->m_numPoints );
+            itr->m_flags &= ~KE_MAPPED;
+        }
+    }
 
-    // ...and set set up the mapping
-    std::pair<int, int> idIndexPair( newKerb.GetNumber(), index );
-    m_pKerbsID->insert( idIndexPair );
+    UnmapViewOfFile( m_pMap->m_pView );
+    CloseHandle( m_pMap->m_hMapping );
+    CloseHandle( m_pMap->m_hFile );
 
-    return index;
-//*/
-    return 0;
+    delete m_pMap;
+    m_pMap = NULL;
+    //#endregion
 }
 
-bool KerbFile::RemoveKerbByID( const int id, Kerb *pKerb /*= NULL*/ )
-{
-    bool found = false;
-/*
+bool KerbFile::Open( const char *fileName )
+{    //#region
+    Clear();
+
+    if( !fileName )
+        return false;
+
+    HANDLE hFile = CreateFileA( fileName, GENERIC_READ, FILE_SHARE_READ, NULL,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+    if( hFile == INVALID_HANDLE_VALUE )
+        return false;
+
+    DWORD size = GetFileSize( hFile, NULL );
+    if( size == 0xFFFFFFFF || size < sizeof( tKerbLibHeader ) )
+    {
+        CloseHandle( hFile );
+        return false;
+    }
+
+    HANDLE hMapping = CreateFileMappingA( hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+    if( !hMapping )
+    {
+        CloseHandle( hFile );
+        return false;
+    }
+
+    const char *pView = (const char *)MapViewOfFile( hMapping, FILE_MAP_READ, 0, 0, 0 );
+    if( !pView )
+    {
+        CloseHandle( hMapping );
+        CloseHandle( hFile );
+        return false;
+    }
+
+    m_pMap = new tKerbLibMap;
+    m_pMap->m_hFile = hFile;
+    m_pMap->m_hMapping = hMapping;
+    m_pMap->m_pView = pView;
+    m_pMap->m_fileName = fileName;
+
+    // check everything lies inside the file before trusting it
+    const tKerbLibHeader &header = *(const tKerbLibHeader *)pView;
+    if( memcmp( header.m_magic, KERB_LIB_MAGIC, sizeof( KERB_LIB_MAGIC ) ) != 0 ||
+        header.m_version != KERB_LIB_VERSION ||
+        header.m_directoryOffset > size ||
+        header.m_numKerbs > ( size - header.m_directoryOffset ) / sizeof( tKerbEntry ) ||
+        header.m_pointsOffset % sizeof( double ) != 0 ||
+        header.m_pointsOffset > size ||
+        header.m_numPoints > ( size - header.m_pointsOffset ) / ( 2 * sizeof( double ) ) )
+    {
+        CloseMap( false );
+        return false;
+    }
 
-    KerbListItr itr;
-    for( itr = m_pKerbs->begin(); itr != m_pKerbs->end(); itr++ )
+    m_pMap->m_pPoints = (const double *)( pView + header.m_pointsOffset );
+
+    const tKerbEntry *pDirectory = (const tKerbEntry *)( pView + header.m_directoryOffset );
+    m_pEntries->reserve( header.m_numKerbs );
+    for( unsigned int i = 0; i < header.m_numKerbs; i++ )
     {
-        Kerb &k = (*itr);
-        // test if we've found it
-        if( k.GetNumber() == id )
+        tKerbEntry entry = pDirectory[i];
+        if( entry.m_firstPoint > header.m_numPoints ||
+            entry.m_numPoints > header.m_numPoints - entry.m_firstPoint )
         {
-            // mark, and copy if required
-            found = true;
-            if( pKerb )
-                *pKerb = k;
-
-            // remove from the map...
-            IdIndexMapItr mItr = m_pKerbsID->find( k.GetNumber() );
-            if( mItr != m_pKerbsID->end() )
-                m_pKerbsID->erase( mItr );
-            // ... and the vector
-            m_pKerbs->erase( itr );
-            break;
+            Clear();
+            return false;
         }
+
+        entry.m_name[KERB_LIB_NAME_SIZE - 1] = '\0';
+        entry.m_flags = KE_MAPPED;
+        m_pEntries->push_back( entry );
     }
-//*/
-    return found;
+
+    RebuildIndexes();
+
+    return true;
+    //#endregion
 }
 
-bool KerbFile::RemoveKerbByIndex( const int index, Kerb *pKerb /*= NULL*/ )
-{
-/*
-    if( index >= (int)m_pKerbs->size() )
-        return false;
+int KerbFile::ImportText( const char *fileName )
+{    //#region
+    FILE *file = fopen( fileName, "r" );
+    if( !file )
+        return 0;
 
     int count = 0;
+    Kerb kerb( false );
+    while( kerb.Read( file ) )
+    {
+        if( AddKerb( kerb, true ) >= 0 )
+            count++;
+    }
+
+    fclose( file );
+
+    return count;
+    //#endregion
+}
+
+bool KerbFile::Save( const char *fileName )
+{    //#region
+    if( !fileName )
+        return false;
 
-    KerbListItr itr;
-    for( itr = m_pKerbs->begin(); itr != m_pKerbs->end(); itr++ )
+    // the opened library can't be written over while it is mapped
+    if( m_pMap && _stricmp( m_pMap->m_fileName.c_str(), fileName ) == 0 )
+        CloseMap( true );
+
+    FILE *file = fopen( fileName, "wb" );
+    if( !file )
+        return false;
+
+    std::vector<tKerbEntry>::const_iterator itr;
+    unsigned int numPoints = 0;
+    for( itr = m_pEntries->begin(); itr != m_pEntries->end(); itr++ )
+        numPoints += itr->m_numPoints;
+
+    tKerbLibHeader header;
+    memset( &header, 0, sizeof( header ) );
+    memcpy( header.m_magic, KERB_LIB_MAGIC, sizeof( KERB_LIB_MAGIC ) );
+    header.m_version = KERB_LIB_VERSION;
+    header.m_numKerbs = (unsigned int)m_pEntries->size();
+    header.m_numPoints = numPoints;
+    header.m_directoryOffset = sizeof( header );
+    header.m_pointsOffset = header.m_directoryOffset + header.m_numKerbs * sizeof( tKerbEntry );
+    header.m_pointsOffset = ( header.m_pointsOffset + sizeof( double ) - 1 ) & ~( sizeof( double ) - 1 );
+
+    bool ok = fwrite( &header, sizeof( header ), 1, file ) == 1;
+
+    // the directory, numbering the points as they are about to be written
+    unsigned int firstPoint = 0;
+    for( itr = m_pEntries->begin(); itr != m_pEntries->end() && ok; itr++ )
     {
-        // test if we've found it
-        if( count == index )
-        {
-            Kerb &k = (*itr);
-            // copy if required
-            if( pKerb )
-                *pKerb = k;
-
-            // remove from the map...
-            IdIndexMapItr mItr = m_pKerbsID->find( k.GetNumber() );
-            if( mItr != m_pKerbsID->end() )
-                m_pKerbsID->erase( mItr );
-            // ... and the vector
-            m_pKerbs->erase( itr );
+        tKerbEntry entry = *itr;
+        entry.m_firstPoint = firstPoint;
+        entry.m_flags = 0;
+        firstPoint += entry.m_numPoints;
+        ok = fwrite( &entry, sizeof( entry ), 1, file ) == 1;
+    }
+
+    static const char padding[sizeof( double )] = { 0 };
+    size_t padSize = header.m_pointsOffset - header.m_directoryOffset - header.m_numKerbs * sizeof( tKerbEntry );
+    if( ok && padSize > 0 )
+        ok = fwrite( padding, 1, padSize, file ) == padSize;
+
+    for( itr = m_pEntries->begin(); itr != m_pEntries->end() && ok; itr++ )
+    {
+        if( itr->m_numPoints > 0 )
+            ok = fwrite( EntryPoints( *itr ), 2 * sizeof( double ), itr->m_numPoints, file ) == itr->m_numPoints;
+    }
+
+    if( fclose( file ) != 0 )
+        ok = false;
+
+    if( !ok )
+        remove( fileName );
+
+    return ok;
+    //#endregion
+}
+
+const double *KerbFile::EntryPoints( const tKerbEntry &entry ) const
+{    //#region
+    if( entry.m_numPoints == 0 )
+        return NULL;
+
+    if( entry.m_flags & KE_MAPPED )
+        return m_pMap->m_pPoints + 2 * entry.m_firstPoint;
+
+    return &(*m_pPoints)[2 * entry.m_firstPoint];
+    //#endregion
+}
+
+void KerbFile::MakeKerb( const tKerbEntry &entry, Kerb *pKerb ) const
+{    //#region
+    Kerb kerb( false );
+    const double *pXY = EntryPoints( entry );
+
+    kerb.SetNumber( entry.m_id );
+    kerb.SetName( entry.m_name );
+    for( unsigned int i = 0; i < entry.m_numPoints; i++ )
+        kerb.AddPoint( VectorD2( pXY[2 * i], pXY[2 * i + 1] ) );
+    kerb.RecalcExtents();
+
+    *pKerb = kerb;
+    //#endregion
+}
+
+// the points are added to the pool, any the entry used before are left unused until Save()
+void KerbFile::SetEntry( tKerbEntry &entry, const Kerb &kerb )
+{    //#region
+    const KerbPtsList &pts = kerb.GetPointsRef();
+
+    entry.m_id = kerb.GetNumber();
+    memset( entry.m_name, 0, KERB_LIB_NAME_SIZE );
+    strncpy( entry.m_name, kerb.GetName(), KERB_LIB_NAME_SIZE - 1 );
+    entry.m_firstPoint = (unsigned int)( m_pPoints->size() / 2 );
+    entry.m_numPoints = (unsigned int)pts.size();
+    entry.m_flags = 0;
+
+    m_pPoints->reserve( m_pPoints->size() + 2 * pts.size() );
+    KerbPtsList::const_iterator itr;
+    for( itr = pts.begin(); itr != pts.end(); itr++ )
+    {
+        m_pPoints->push_back( itr->x );
+        m_pPoints->push_back( itr->y );
+    }
+    //#endregion
+}
+
+/*
+    Add an entry to the hash tables, unless an earlier entry already has its id or
+    name.  The tables are linear probed and kept no more than half full.
+ */
+void KerbFile::IndexEntry( const int index )
+{    //#region
+    const tKerbEntry &entry = (*m_pEntries)[index];
+    unsigned int mask = (unsigned int)m_pIdHash->size() - 1;
+    unsigned int slot;
+
+    for( slot = HashKerbId( entry.m_id ) & mask; (*m_pIdHash)[slot] >= 0; slot = ( slot + 1 ) & mask )
+    {
+        if( (*m_pEntries)[(*m_pIdHash)[slot]].m_id == entry.m_id )
             break;
-        }
     }
-//*/
+    if( (*m_pIdHash)[slot] < 0 )
+        (*m_pIdHash)[slot] = index;
+
+    if( entry.m_name[0] == '\0' )
+        return;
+
+    for( slot = HashKerbName( entry.m_name ) & mask; (*m_pNameHash)[slot] >= 0; slot = ( slot + 1 ) & mask )
+    {
+        if( strncmp( (*m_pEntries)[(*m_pNameHash)[slot]].m_name, entry.m_name, KERB_LIB_NAME_SIZE ) == 0 )
+            break;
+    }
+    if( (*m_pNameHash)[slot] < 0 )
+        (*m_pNameHash)[slot] = index;
+    //#endregion
+}
+
+void KerbFile::RebuildIndexes()
+{    //#region
+    size_t size = 16;
+    while( size < 2 * m_pEntries->size() )
+        size *= 2;
+
+    m_pIdHash->assign( size, -1 );
+    m_pNameHash->assign( size, -1 );
+
+    for( int i = 0; i < (int)m_pEntries->size(); i++ )
+        IndexEntry( i );
+    //#endregion
+}
+
+int KerbFile::AddKerb( const Kerb &newKerb, bool allowReplace /*= false*/, Kerb *replacedKerb /*= NULL*/ )
+{    //#region
+    if( newKerb.GetNumber() < 1 )
+        return -1;
+
+    int index = FindIndexByID( newKerb.GetNumber() );
+    if( index >= 0 )
+    {
+        if( !allowReplace )
+            return -1;
+
+        tKerbEntry &entry = (*m_pEntries)[index];
+        if( replacedKerb )
+            MakeKerb( entry, replacedKerb );
+        SetEntry( entry, newKerb );
+
+        // the name may have changed
+        RebuildIndexes();
+        return index;
+    }
+
+    tKerbEntry entry;
+    SetEntry( entry, newKerb );
+    m_pEntries->push_back( entry );
+    index = (int)m_pEntries->size() - 1;
+
+    if( 2 * m_pEntries->size() > m_pIdHash->size() )
+        RebuildIndexes();
+    else
+        IndexEntry( index );
+
+    return index;
+    //#endregion
+}
+
+bool KerbFile::RemoveKerbByID( const int id, Kerb *pKerb /*= NULL*/ )
+{    //#region
+    int index = FindIndexByID( id );
+    if( index < 0 )
+        return false;
+
+    return RemoveKerbByIndex( index, pKerb );
+    //#endregion
+}
+
+bool KerbFile::RemoveKerbByIndex( const int index, Kerb *pKerb /*= NULL*/ )
+{    //#region
+    if( index < 0 || index >= (int)m_pEntries->size() )
+        return false;
+
+    if( pKerb )
+        MakeKerb( (*m_pEntries)[index], pKerb );
+
+    // the indexes after it all move down one
+    m_pEntries->erase( m_pEntries->begin() + index );
+    RebuildIndexes();
 
     return true;
+    //#endregion
+}
+
+const int KerbFile::FindIndexByID( const int id ) const
+{    //#region
+    if( m_pIdHash->empty() )
+        return -1;
+
+    unsigned int mask = (unsigned int)m_pIdHash->size() - 1;
+    int index;
+
+    for( unsigned int slot = HashKerbId( id ) & mask; ( index = (*m_pIdHash)[slot] ) >= 0; slot = ( slot + 1 ) & mask )
+    {
+        if( (*m_pEntries)[index].m_id == id )
+            return index;
+    }
+
+    return -1;
+    //#endregion
+}
+
+const int KerbFile::FindIndexByName( const char *name ) const
+{    //#region
+    if( !name || name[0] == '\0' || m_pNameHash->empty() )
+        return -1;
+    if( strlen( name ) >= (size_t)KERB_LIB_NAME_SIZE )
+        return -1;
+
+    unsigned int mask = (unsigned int)m_pNameHash->size() - 1;
+    int index;
+
+    for( unsigned int slot = HashKerbName( name ) & mask; ( index = (*m_pNameHash)[slot] ) >= 0; slot = ( slot + 1 ) & mask )
+    {
+        if( strncmp( (*m_pEntries)[index].m_name, name, KERB_LIB_NAME_SIZE ) == 0 )
+            return index;
+    }
+
+    return -1;
+    //#endregion
 }
 
 const Kerb *KerbFile::GetKerbByID( const int id, Kerb *pKerb ) const
-{
-/*
-    if( !pKerb )
-        return NULL;
+{    //#region
+    return GetKerbByIndex( FindIndexByID( id ), pKerb );
+    //#endregion
+}
 
-    // we have an id, so use the map
-    IdIndexMapItr itr;
-    itr = m_pKerbsID->find( id );
-    if( itr == m_pKerbsID->end() )
+const Kerb *KerbFile::GetKerbByIndex( const int index, Kerb *pKerb ) const
+{    //#region
+    if( !pKerb || index < 0 || index >= (int)m_pEntries->size() )
         return NULL;
 
+    MakeKerb( (*m_pEntries)[index], pKerb );
 
-//*/
     return pKerb;
+    //#endregion
 }
-const Kerb *KerbFile::GetKerbByIndex( const int index, Kerb *pKerb ) const
-{
-    return NULL;
+
+const Kerb *KerbFile::GetKerbByName( const char *name, Kerb *pKerb ) const
+{    //#region
+    return GetKerbByIndex( FindIndexByName( name ), pKerb );
+    //#endregion
 }
 //#endregion
 
@@ -0,0 +1,448 @@
+// kerbsweep.cpp : Sweeping kerb profiles along alignments, see kerbsweep.h
+//
+#pragma warning(disable:4786)
+
+#include <limits.h>
+#include <windows.h>
+
+#include "..\include\kerbsweep.h"
+
+using namespace keays::math;
+
+namespace keays
+{
+
+namespace types
+{
+
+const double KERB_MITRE_LIMIT = 4.0;
+
+static const int MAX_SWEEP_THREADS = 32;
+static const size_t MIN_SWEEP_STATIONS = 1024;    // don't bother starting a thread for fewer than this
+
+//-----------------------------------------------------------------------------
+//#region Kerb mesh implementation
+KerbMesh::KerbMesh()
+{    //#region
+    m_pVertices = new keays::types::Polyline3D;
+    m_pIndices = new std::vector<unsigned int>;
+    m_numStations = 0;
+    m_profileSize = 0;
+    //#endregion
+}
+
+KerbMesh::KerbMesh( const KerbMesh &orig )
+{    //#region
+    m_pVertices = new keays::types::Polyline3D( *orig.m_pVertices );
+    m_pIndices = new std::vector<unsigned int>( *orig.m_pIndices );
+    m_numStations = orig.m_numStations;
+    m_profileSize = orig.m_profileSize;
+    //#endregion
+}
+
+KerbMesh::~KerbMesh()
+{    //#region
+    delete m_pVertices;        m_pVertices = NULL;
+    delete m_pIndices;        m_pIndices = NULL;
+    //#endregion
+}
+
+const KerbMesh &KerbMesh::operator=( const KerbMesh &rhs )
+{    //#region
+    if( this == &rhs )
+        return *this;
+
+    *m_pVertices = *rhs.m_pVertices;
+    *m_pIndices = *rhs.m_pIndices;
+    m_numStations = rhs.m_numStations;
+    m_profileSize = rhs.m_profileSize;
+
+    return *this;
+    //#endregion
+}
+
+void KerbMesh::Clear()
+{    //#region
+    m_pVertices->clear();
+    m_pIndices->clear();
+    m_numStations = 0;
+    m_profileSize = 0;
+    //#endregion
+}
+
+size_t KerbMesh::WriteFile( FILE *file ) const
+{    //#region
+    size_t items = 0;
+
+    if( !file )
+        return 0;
+
+    unsigned int count = (unsigned int)m_pVertices->size();
+    items += fwrite( &count, sizeof( count ), 1, file );
+    count = (unsigned int)m_pIndices->size();
+    items += fwrite( &count, sizeof( count ), 1, file );
+
+    Polyline3D::const_iterator itr;
+    for( itr = m_pVertices->begin(); itr != m_pVertices->end(); itr++ )
+    {
+        double xyz[3] = { itr->x, itr->y, itr->z };
+        items += fwrite( xyz, sizeof( double ), 3, file );
+    }
+
+    if( !m_pIndices->empty() )
+        items += fwrite( &(*m_pIndices)[0], sizeof( unsigned int ), m_pIndices->size(), file );
+
+    return items;
+    //#endregion
+}
+//#endregion
+
+//-----------------------------------------------------------------------------
+//#region Kerb sweep implementation
+KerbSweep::KerbSweep()
+{    //#region
+    m_pOrigins = new keays::types::Polyline3D;
+    m_pOffsets = new keays::types::Polyline3D;
+    m_isClosed = false;
+    //#endregion
+}
+
+KerbSweep::KerbSweep( const KerbSweep &orig )
+{    //#region
+    m_pOrigins = new keays::types::Polyline3D( *orig.m_pOrigins );
+    m_pOffsets = new keays::types::Polyline3D( *orig.m_pOffsets );
+    m_isClosed = orig.m_isClosed;
+    //#endregion
+}
+
+KerbSweep::~KerbSweep()
+{    //#region
+    delete m_pOrigins;        m_pOrigins = NULL;
+    delete m_pOffsets;        m_pOffsets = NULL;
+    //#endregion
+}
+
+const KerbSweep &KerbSweep::operator=( const KerbSweep &rhs )
+{    //#region
+    if( this == &rhs )
+        return *this;
+
+    *m_pOrigins = *rhs.m_pOrigins;
+    *m_pOffsets = *rhs.m_pOffsets;
+    m_isClosed = rhs.m_isClosed;
+
+    return *this;
+    //#endregion
+}
+
+const bool KerbSweep::SetAlignment( const keays::types::Polyline3D &alignment, const bool isClosed /*= false*/ )
+{    //#region
+    m_pOrigins->clear();
+    m_pOffsets->clear();
+    m_isClosed = false;
+
+    Polyline3D::const_iterator itr;
+    for( itr = alignment.begin(); itr != alignment.end(); itr++ )
+    {
+        if( m_pOrigins->empty() || !( *itr == m_pOrigins->back() ) )
+            m_pOrigins->push_back( *itr );
+    }
+
+    if( isClosed && m_pOrigins->size() > 1 && m_pOrigins->back() == m_pOrigins->front() )
+        m_pOrigins->pop_back();
+
+    size_t numStations = m_pOrigins->size();
+    if( numStations < 2 )
+    {
+        m_pOrigins->clear();
+        return false;
+    }
+
+    m_isClosed = isClosed && numStations > 2;
+
+    // GeneratePerpendicularVectors expects a closed polyline to end on its first point
+    Polyline3D ring( *m_pOrigins );
+    if( m_isClosed )
+        ring.push_back( ring.front() );
+
+    Polyline3D perps;
+    if( !GeneratePerpendicularVectors( ring, &perps, true, m_isClosed ) )
+    {
+        m_pOrigins->clear();
+        return false;
+    }
+
+    // the perpendicular of each leg, zero if the leg is vertical
+    size_t numLegs = ring.size() - 1;
+    size_t i;
+    Polyline3D legPerps( numLegs );
+    for( i = 0; i < numLegs; i++ )
+    {
+        const VectorD3 &pt = ring[i + 1];
+        const VectorD3 &prevPt = ring[i];
+        if( keays::types::Float::EqualTo( Dist2D( prevPt, pt ), 0.0 ) )
+            continue;
+
+        VectorD3 leg( ( pt.XY() - prevPt.XY() ).VD3( 0 ).GetNormalised() );
+        legPerps[i].Set( leg.y, -leg.x, 0 );
+    }
+
+    // the leg coming into a station, which for a closed alignment starts with the last one
+    VectorD3 incoming;
+    bool haveIncoming = false;
+    if( m_isClosed )
+    {
+        for( i = numLegs; i > 0 && !haveIncoming; i-- )
+        {
+            if( !( legPerps[i - 1] == VectorD3() ) )
+            {
+                incoming = legPerps[i - 1];
+                haveIncoming = true;
+            }
+        }
+    }
+
+    m_pOffsets->resize( numStations );
+    for( i = 0; i < numStations; i++ )
+    {
+        if( i > 0 && !( legPerps[i - 1] == VectorD3() ) )
+        {
+            incoming = legPerps[i - 1];
+            haveIncoming = true;
+        }
+
+        // the averaged perpendicular bisects the corner, lengthen it so the
+        // profile keeps its width measured square to either leg
+        const VectorD3 &dir = perps[i];
+        double scale = 1.0;
+        if( haveIncoming )
+        {
+            double cosHalf = dir.x * incoming.x + dir.y * incoming.y;
+            scale = ( cosHalf * KERB_MITRE_LIMIT > 1.0 ) ? 1.0 / cosHalf : KERB_MITRE_LIMIT;
+        }
+
+        (*m_pOffsets)[i].Set( dir.x * scale, dir.y * scale, 0 );
+    }
+
+    return true;
+    //#endregion
+}
+
+const bool KerbSweep::GetFrame( const size_t station, keays::types::VectorD3 *pOrigin,
+                                keays::types::VectorD3 *pOffset ) const
+{    //#region
+    if( station >= m_pOrigins->size() )
+        return false;
+
+    if( pOrigin )
+        *pOrigin = (*m_pOrigins)[station];
+    if( pOffset )
+        *pOffset = (*m_pOffsets)[station];
+
+    return true;
+    //#endregion
+}
+
+/*
+    One thread's share of a sweep: the vertices of stations [first, last) and the
+    triangles of the legs starting at them.
+ */
+struct tSweepJob
+{
+    const keays::types::Polyline3D    *pOrigins;
+    const keays::types::Polyline3D    *pOffsets;
+    const keays::types::Polyline2D    *pProfile;
+    size_t                            numLegs;
+    size_t                            numEdges;
+    size_t                            first;
+    size_t                            last;
+    KerbMesh                        *pMesh;
+};
+
+static void SweepStations( const tSweepJob &job )
+{    //#region
+    const Polyline2D &profile = *job.pProfile;
+    size_t numStations = job.pOrigins->size();
+    size_t profileSize = profile.size();
+    size_t i, j;
+
+    for( i = job.first; i < job.last; i++ )
+    {
+        const VectorD3 &origin = (*job.pOrigins)[i];
+        const VectorD3 &offset = (*job.pOffsets)[i];
+        VectorD3 *pVertex = &(*job.pMesh->m_pVertices)[i * profileSize];
+
+        for( j = 0; j < profileSize; j++ )
+        {
+            const VectorD2 &pt = profile[j];
+            pVertex[j].Set( origin.x + offset.x * pt.x, origin.y + offset.y * pt.x, origin.z + pt.y );
+        }
+
+        if( i >= job.numLegs )
+            continue;
+
+        unsigned int here = (unsigned int)( i * profileSize );
+        unsigned int next = (unsigned int)( ( ( i + 1 ) % numStations ) * profileSize );
+        unsigned int *pIndex = &(*job.pMesh->m_pIndices)[i * job.numEdges * 6];
+
+        for( j = 0; j < job.numEdges; j++ )
+        {
+            unsigned int j1 = (unsigned int)( ( j + 1 ) % profileSize );
+
+            *pIndex++ = here + (unsigned int)j;
+            *pIndex++ = next + (unsigned int)j;
+            *pIndex++ = here + j1;
+
+            *pIndex++ = here + j1;
+            *pIndex++ = next + (unsigned int)j;
+            *pIndex++ = next + j1;
+        }
+    }
+    //#endregion
+}
+
+static DWORD WINAPI SweepThread( LPVOID pParam )
+{    //#region
+    SweepStations( *(const tSweepJob *)pParam );
+    return 0;
+    //#endregion
+}
+
+const bool KerbSweep::Sweep( const Kerb &kerb, const bool isLeftSide, KerbMesh *pMesh,
+                             const int numThreads /*= 0*/ ) const
+{    //#region
+    if( !pMesh )
+        return false;
+
+    pMesh->Clear();
+
+    size_t numStations = m_pOrigins->size();
+    if( numStations < 2 )
+        return false;
+
+    Polyline2D profile;
+    if( !kerb.GetPoints( &profile, Kerb::KP_FULL, isLeftSide, NULL ) )
+        return false;
+
+    if( profile.size() > 2 && profile.back() == profile.front() )
+        profile.pop_back();
+
+    size_t profileSize = profile.size();
+    if( profileSize < 2 )
+        return false;
+
+    if( numStations > UINT_MAX / profileSize )
+        return false;
+
+    // a two point profile is a single edge rather than an outline
+    size_t numEdges = ( profileSize > 2 ) ? profileSize : 1;
+    size_t numLegs = m_isClosed ? numStations : numStations - 1;
+
+    pMesh->m_pVertices->resize( numStations * profileSize );
+    pMesh->m_pIndices->resize( numLegs * numEdges * 6 );
+    pMesh->m_numStations = numStations;
+    pMesh->m_profileSize = profileSize;
+
+    int threads = numThreads;
+    if( threads <= 0 )
+    {
+        SYSTEM_INFO info;
+        GetSystemInfo( &info );
+        threads = (int)info.dwNumberOfProcessors;
+    }
+    if( threads > MAX_SWEEP_THREADS )
+        threads = MAX_SWEEP_THREADS;
+    if( (size_t)threads > numStations / MIN_SWEEP_STATIONS )
+        threads = (int)( numStations / MIN_SWEEP_STATIONS );
+    if( threads < 1 )
+        threads = 1;
+
+    tSweepJob jobs[MAX_SWEEP_THREADS];
+    HANDLE handles[MAX_SWEEP_THREADS];
+    int numHandles = 0;
+    int t;
+
+    for( t = 0; t < threads; t++ )
+    {
+        jobs[t].pOrigins = m_pOrigins;
+        jobs[t].pOffsets = m_pOffsets;
+        jobs[t].pProfile = &profile;
+        jobs[t].numLegs = numLegs;
+        jobs[t].numEdges = numEdges;
+        jobs[t].first = ( numStations * t ) / threads;
+        jobs[t].last = ( numStations * ( t + 1 ) ) / threads;
+        jobs[t].pMesh = pMesh;
+    }
+
+    // the last share is done on this thread, as is any share a thread can't be started for
+    for( t = 0; t < threads - 1; t++ )
+    {
+        HANDLE hThread = CreateThread( NULL, 0, SweepThread, &jobs[t], 0, NULL );
+        if( hThread )
+            handles[numHandles++] = hThread;
+        else
+            SweepStations( jobs[t] );
+    }
+
+    SweepStations( jobs[threads - 1] );
+
+    if( numHandles > 0 )
+    {
+        WaitForMultipleObjects( numHandles, handles, TRUE, INFINITE );
+        for( t = 0; t < numHandles; t++ )
+            CloseHandle( handles[t] );
+    }
+
+    return true;
+    //#endregion
+}
+
+const bool KerbSweep::GetSpecialPoints( const Kerb &kerb, const bool isLeftSide, const Kerb::eSpecialPoints point,
+                                        keays::types::Polyline3D *pPoints,
+                                        keays::types::Polyline3D *pDirections /*= NULL*/ ) const
+{    //#region
+    if( !pPoints )
+        return false;
+
+    pPoints->clear();
+    if( pDirections )
+        pDirections->clear();
+
+    size_t numStations = m_pOrigins->size();
+    if( numStations < 2 )
+        return false;
+
+    VectorD2 pt;
+    if( !kerb.GetPoint( (int)kerb.SpecialPointIndex( point ), pt ) )
+        return false;
+
+    // the offsets point to the right, the same way a right side profile is laid out
+    double side = isLeftSide ? -1.0 : 1.0;
+    pt.x *= side;
+
+    pPoints->resize( numStations );
+    if( pDirections )
+        pDirections->resize( numStations );
+
+    for( size_t i = 0; i < numStations; i++ )
+    {
+        const VectorD3 &origin = (*m_pOrigins)[i];
+        const VectorD3 &offset = (*m_pOffsets)[i];
+
+        (*pPoints)[i].Set( origin.x + offset.x * pt.x, origin.y + offset.y * pt.x, origin.z + pt.y );
+
+        if( pDirections )
+        {
+            double length = sqrt( offset.x * offset.x + offset.y * offset.y );
+            (*pDirections)[i].Set( side * offset.x / length, side * offset.y / length, 0.0 );
+        }
+    }
+
+    return true;
+    //#endregion
+}
+//#endregion
+
+};    // namespace types
+
+}; // namespace keays
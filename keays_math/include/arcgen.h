@@ -0,0 +1,219 @@
+/*!
+    \file arcgen.h
+    \brief    Fast arc point generation.
+    Arc generators that step around the circle with a rotation recurrence rather than
+    calling sin/cos for every point.  Part of the keays::math namespace.
+
+    Each step rotates the previous (cos, sin) pair by the fixed interval angle, which
+    costs four multiplies and two adds.  Rounding error from the recurrence grows roughly
+    linearly with the number of steps, so the stepper re-anchors itself with an exact
+    sin/cos every ARC_REANCHOR_INTERVAL steps.  With the default interval the positional
+    error stays in the order of 1e-14 of the radius, far below the 0.0001 Float tolerance used
+    everywhere else.
+
+    \date October 2026.
+ */
+#pragma once
+
+#include <vector>
+
+#include "geometry.h"
+
+namespace keays
+{
+namespace math
+{
+
+//! Number of recurrence steps taken before the stepper recalculates sin/cos exactly.
+const int ARC_REANCHOR_INTERVAL = 32;
+
+/*!
+    \brief Steps a unit vector around a circle by a fixed angle.
+    Generates cos/sin of \f$\theta_0 + i\delta\f$ for i = 0, 1, 2 ... using the complex rotation
+    \f$(c, s) \leftarrow (c\cos\delta - s\sin\delta, s\cos\delta + c\sin\delta)\f$, re-anchored
+    with an exact evaluation every ARC_REANCHOR_INTERVAL steps.
+ */
+class ArcStepper
+{
+public:
+    /*!
+        \brief Constructor.
+        \param startAngleRad [In] - The angle of the first step in radians.
+        \param       stepRad [In] - The signed angle between steps in radians (negative steps clockwise).
+     */
+    ArcStepper(const double &startAngleRad, const double &stepRad)
+    {
+        Reset(startAngleRad, stepRad);
+    }
+
+    /*!
+        \brief Restart the stepper at a new angle.
+        \param startAngleRad [In] - The angle of the first step in radians.
+        \param       stepRad [In] - The signed angle between steps in radians.
+     */
+    void Reset(const double &startAngleRad, const double &stepRad)
+    {
+        m_startAngle = startAngleRad;
+        m_step = stepRad;
+        m_stepCos = cos(stepRad);
+        m_stepSin = sin(stepRad);
+        m_cos = cos(startAngleRad);
+        m_sin = sin(startAngleRad);
+        m_index = 0;
+    }
+
+    //! Advance to the next angle.
+    void Next()
+    {
+        ++m_index;
+        if (m_index % ARC_REANCHOR_INTERVAL == 0)
+        {
+            double ang = m_startAngle + m_index * m_step;
+            m_cos = cos(ang);
+            m_sin = sin(ang);
+        } else
+        {
+            double c = m_cos;
+            m_cos = c * m_stepCos - m_sin * m_stepSin;
+            m_sin = m_sin * m_stepCos + c * m_stepSin;
+        }
+    }
+
+    //! The cosine of the current angle.
+    const double &Cos() const { return m_cos; }
+    //! The sine of the current angle.
+    const double &Sin() const { return m_sin; }
+    //! The number of steps taken since the last Reset().
+    int Index() const { return m_index; }
+    //! The current angle in radians.
+    double Angle() const { return m_startAngle + m_index * m_step; }
+
+    //! The position of the current angle on a circle.
+    const keays::types::VectorD3 Pos(const keays::types::VectorD3 &center, const double &radius) const
+    {
+        return keays::types::VectorD3(center.x + radius * m_cos, center.y + radius * m_sin, center.z);
+    }
+
+private:
+    double m_startAngle,
+           m_step,
+           m_stepCos,
+           m_stepSin,
+           m_cos,
+           m_sin;
+    int m_index;
+};
+
+/*!
+    \brief Description of a single arc for batch generation.
+    The sweep is signed, positive sweeps are generated counter clockwise.
+ */
+struct tArcSpec
+{
+    tArcSpec() : m_radius(0.0), m_startAngleRad(0.0), m_sweepRad(0.0), m_numSegments(0) {}
+    tArcSpec(const keays::types::VectorD3 &center, const double &radius, const double &startAngleRad,
+             const double &sweepRad, const int numSegments)
+             : m_center(center), m_radius(radius), m_startAngleRad(startAngleRad),
+               m_sweepRad(sweepRad), m_numSegments(numSegments) {}
+
+    keays::types::VectorD3 m_center;    //!< The center of the arc.
+    double m_radius;                    //!< The radius of the arc.
+    double m_startAngleRad;             //!< The angle of the first point in radians.
+    double m_sweepRad;                  //!< The signed angle swept by the arc in radians.
+    int m_numSegments;                  //!< The number of chords used to approximate the arc.
+};
+
+/*!
+    \brief Calculate the number of chords needed to generate an arc at a given interval.
+
+    \param    sweepRad [In] - A constant reference to a <b>double</b> specifying the (signed) angle swept by the arc.
+    \param intervalRad [In] - A constant reference to a <b>double</b> specifying the maximum interval angle.
+
+    \return The number of segments, at least 1.  Returns 0 if the interval is not positive.
+ */
+KEAYS_MATH_EXPORTS_API int
+NumArcSegments(const double &sweepRad, const double &intervalRad);
+
+/*!
+    \brief Generate an arc of evenly spaced points using the rotation recurrence.
+    The points are appended to the result, which is grown once to its final size.
+
+    \param        center [In]  - A constant reference to a keays::types::VectorD3 specifying the center position.
+    \param        radius [In]  - A constant reference to a <b>double</b> specifying the radius.
+    \param startAngleRad [In]  - A constant reference to a <b>double</b> specifying the start angle in radians.
+    \param      sweepRad [In]  - A constant reference to a <b>double</b> specifying the signed sweep, negative for clockwise.
+    \param   numSegments [In]  - An <b>int</b> specifying the number of chords.
+    \param           pts [I/O] - A reference to a keays::types::Polyline3D the points are appended to.
+    \param genStartPoint [In]  - A <b>bool</b> indicating if the first point should be generated.
+    \param   genEndPoint [In]  - A <b>bool</b> indicating if the last point should be generated.
+
+    \return True if successful, false if the radius is zero or numSegments is less than 1.
+ */
+KEAYS_MATH_EXPORTS_API bool
+GenArcPointsFast(const keays::types::VectorD3 &center, const double &radius, const double &startAngleRad,
+                 const double &sweepRad, const int numSegments, keays::types::Polyline3D &pts,
+                 const bool genStartPoint = true, const bool genEndPoint = true);
+
+/*!
+    \brief Generate many arcs into a single polyline.
+    The output is sized once for all of the arcs, which avoids the repeated reallocation of
+    calling GenArcPointsRad in a loop.  Arcs with a zero radius or no segments are skipped
+    (their offset range is empty).
+
+    \param         pArcs [In]  - A pointer to an array of tArcSpec elements describing the arcs.
+    \param       numArcs [In]  - An <b>int</b> indicating the number of arcs in the array.
+    \param           pts [I/O] - A reference to a keays::types::Polyline3D the points are appended to.
+    \param      pOffsets [Out] - An optional pointer to a vector that receives numArcs + 1 offsets into pts,
+                                 arc i occupies [ (*pOffsets)[i], (*pOffsets)[i + 1] ).
+    \param genStartPoint [In]  - A <b>bool</b> indicating if the first point of each arc should be generated.
+    \param   genEndPoint [In]  - A <b>bool</b> indicating if the last point of each arc should be generated.
+
+    \return True if successful.
+ */
+KEAYS_MATH_EXPORTS_API bool
+GenArcPointsBatch(const tArcSpec *pArcs, const int numArcs, keays::types::Polyline3D &pts,
+                  std::vector<int> *pOffsets = NULL, const bool genStartPoint = true,
+                  const bool genEndPoint = true);
+
+/*!
+    \brief Compile time check for GenArcPointsFixed.
+    Only the true case is defined, so a non-positive segment count fails to compile with this name in the error.
+ */
+template <bool> struct ArcSegmentsMustBePositive;
+template <> struct ArcSegmentsMustBePositive<true> {};
+
+/*!
+    \brief Generate an arc with a segment count fixed at compile time.
+    Writes NUM_SEGMENTS + 1 points (start and end inclusive) to the caller supplied buffer.
+    Intended for the small, fixed resolution arcs used at offset corners and kerb returns where
+    the loop can be fully unrolled by the compiler.
+
+    \param        center [In]  - A constant reference to a keays::types::VectorD3 specifying the center position.
+    \param        radius [In]  - A constant reference to a <b>double</b> specifying the radius.
+    \param startAngleRad [In]  - A constant reference to a <b>double</b> specifying the start angle in radians.
+    \param      sweepRad [In]  - A constant reference to a <b>double</b> specifying the signed sweep, negative for clockwise.
+    \param          pOut [Out] - A pointer to an array of at least NUM_SEGMENTS + 1 keays::types::VectorD3 elements.
+ */
+template <int NUM_SEGMENTS>
+inline void GenArcPointsFixed(const keays::types::VectorD3 &center, const double &radius, const double &startAngleRad,
+                              const double &sweepRad, keays::types::VectorD3 *pOut)
+{
+    (void)sizeof(ArcSegmentsMustBePositive<(NUM_SEGMENTS > 0)>);
+
+    ArcStepper step(startAngleRad, sweepRad / NUM_SEGMENTS);
+    for (int i = 0; i < NUM_SEGMENTS; i++)
+    {
+        pOut[i] = step.Pos(center, radius);
+        step.Next();
+    }
+
+    // the end point is always exact so consecutive arcs join without a gap
+    double endAng = startAngleRad + sweepRad;
+    pOut[NUM_SEGMENTS] = keays::types::VectorD3(center.x + radius * cos(endAng),
+                                                center.y + radius * sin(endAng), center.z);
+}
+
+}    // namespace math
+}    // namespace keays
+
+// eof
@@ -15,6 +15,7 @@
 
 #include "mathhelp.h"        // our math library
 #include <keays_types.h>    // keays types library
+#include <keays_float.h>    // inline tolerance comparisons
 
 //#include <stdarg.h>
 
@@ -2310,22 +2311,22 @@ struct KEAYS_MATH_EXPORTS_API PerpTestData
 
     bool operator<(const PerpTestData &rhs)
     {
-        return keays::types::Float::Less(m_distance, rhs.m_distance, ms_tolerance);
+        return keays::types::Float::Fast::Less(m_distance, rhs.m_distance, ms_tolerance);
     }
 
     bool operator>(const PerpTestData &rhs)
     {
-        return keays::types::Float::Greater(m_distance, rhs.m_distance, ms_tolerance);
+        return keays::types::Float::Fast::Greater(m_distance, rhs.m_distance, ms_tolerance);
     }
 
     bool operator<=(const PerpTestData &rhs)
     {
-        return keays::types::Float::LessOrEqual(m_distance, rhs.m_distance, ms_tolerance);
+        return keays::types::Float::Fast::LessOrEqual(m_distance, rhs.m_distance, ms_tolerance);
     }
 
     bool operator>=(const PerpTestData &rhs)
     {
-        return keays::types::Float::GreaterOrEqual(m_distance, rhs.m_distance, ms_tolerance);
+        return keays::types::Float::Fast::GreaterOrEqual(m_distance, rhs.m_distance, ms_tolerance);
     }
 
     int m_segmentStartIndex;        //!< the index in the polyline that precedes the segment that this point lies upon.
@@ -15,3 +15,6 @@
 
 #include "mathhelp.h"    // mathhelp.h that is part of keays_math
 #include "geometry.h"    // geometry functions
+#include "arcgen.h"      // fast arc generation
+#include "preparedpolygon.h" // prepared polygon containment
+#include "valignment.h"  // compiled vertical alignments
@@ -0,0 +1,169 @@
+/*!
+    \file preparedpolygon.h
+    \brief    Pre-processed polygons for repeated containment and area queries.
+    Part of the keays::math namespace.
+
+    A PreparedPolygon takes an outer boundary and any number of holes and builds a set of
+    horizontal slabs, each holding only the edges that cross it.  A containment test then
+    only counts ray crossings against the edges in the point's slab instead of the whole
+    boundary, which makes assigning large point sets to boundary polygons practical.
+
+    \date October 2026.
+ */
+#pragma once
+
+#include <vector>
+#include <list>
+
+#include "geometry.h"
+
+namespace keays
+{
+namespace math
+{
+
+/*!
+    \brief A polygon (with optional holes) prepared for fast point in polygon tests.
+    Containment uses the even-odd rule across all rings, so holes do not need any particular
+    winding.  Rings are closed implicitly, a duplicate closing point is harmless.
+ */
+class KEAYS_MATH_EXPORTS_API PreparedPolygon
+{
+public:
+    //! Construct an empty polygon, nothing is inside it.
+    PreparedPolygon();
+
+    /*!
+        \param outer [In] - A constant reference to a Polyline2D describing the outer boundary.
+     */
+    PreparedPolygon(const keays::types::Polyline2D &outer);
+
+    /*!
+        \overload
+        \param outer [In] - A constant reference to a std::list of keays::types::VectorD2 describing the outer boundary.
+     */
+    PreparedPolygon(const std::list<keays::types::VectorD2> &outer);
+
+    /*!
+        \overload
+        \param     pOuter [In] - A constant pointer to an array of keays::types::VectorD2 describing the outer boundary.
+        \param  numPoints [In] - An <b>int</b> specifying the number of points in the array.
+     */
+    PreparedPolygon(const keays::types::VectorD2 *pOuter, const int numPoints);
+
+    /*!
+        \brief The Copy Constructor - duplicates an existing PreparedPolygon.
+        \param old [In] - A constant reference to an existing PreparedPolygon object.
+     */
+    PreparedPolygon(const PreparedPolygon &old);
+
+    ~PreparedPolygon();
+
+    const PreparedPolygon &operator=(const PreparedPolygon &rhs);
+
+    //! Remove all rings.
+    void Clear();
+
+    /*!
+        \brief Replace the outer boundary, any existing holes are removed.
+
+        \param outer [In] - A constant reference to a Polyline2D describing the outer boundary.
+
+        \return true if the boundary has at least 3 points.
+     */
+    bool SetOuter(const keays::types::Polyline2D &outer);
+    //! \overload
+    bool SetOuter(const std::list<keays::types::VectorD2> &outer);
+    //! \overload
+    bool SetOuter(const keays::types::VectorD2 *pOuter, const int numPoints);
+
+    /*!
+        \brief Add a hole to the polygon.
+
+        \param hole [In] - A constant reference to a Polyline2D describing the hole.
+
+        \return true if the hole has at least 3 points and an outer boundary has been set.
+     */
+    bool AddHole(const keays::types::Polyline2D &hole);
+    //! \overload
+    bool AddHole(const std::list<keays::types::VectorD2> &hole);
+    //! \overload
+    bool AddHole(const keays::types::VectorD2 *pHole, const int numPoints);
+
+    //! \brief Test if the polygon has an outer boundary.
+    bool IsValid() const { return m_numRings > 0; }
+
+    //! \brief Get the number of rings (outer boundary plus holes).
+    int GetNumRings() const { return m_numRings; }
+
+    //! \brief Get the number of edges across all rings.
+    int GetNumEdges() const { return m_numEdges; }
+
+    //! \brief Get the bounding rectangle of the outer boundary.
+    const RectD &GetExtents() const { return m_extents; }
+
+    /*!
+        \brief Get the signed area.
+        The sign follows the winding of the outer boundary (-ve if it is wound CW), holes always
+        reduce the magnitude regardless of their own winding.
+     */
+    double GetSignedArea() const { return m_signedArea; }
+
+    //! \brief Get the area of the outer boundary less the area of the holes.
+    double GetArea() const { return m_signedArea < 0.0 ? -m_signedArea : m_signedArea; }
+
+    /*!
+        \brief Test if a point is inside the polygon.
+
+        \param x [In] - A constant reference to a <b>double</b> with the x value of the point.
+        \param y [In] - A constant reference to a <b>double</b> with the y value of the point.
+
+        \return true if the point is inside the polygon and not inside a hole.
+     */
+    bool Contains(const double &x, const double &y) const;
+
+    //! \overload
+    bool Contains(const keays::types::VectorD2 &pt) const { return Contains(pt.x, pt.y); }
+
+    /*!
+        \brief Test an array of points for containment.
+        Uses SSE2 to count crossings two edges at a time where available.
+
+        \param       pPts [In]  - A constant pointer to an array of keays::types::VectorD2 points to test.
+        \param  numPoints [In]  - An <b>int</b> specifying the number of points in the array.
+        \param      pMask [Out] - A pointer to an array of at least numPoints bytes, set to 1 for each point
+                                  inside and 0 otherwise.
+
+        \return The number of points inside the polygon.
+     */
+    int Contains(const keays::types::VectorD2 *pPts, const int numPoints, unsigned char *pMask) const;
+
+    /*!
+        \overload
+        \param  pts [In]  - A constant reference to the Polyline2D of points to test.
+        \param mask [Out] - A reference to a vector resized to pts.size() and filled as for the array version.
+     */
+    int Contains(const keays::types::Polyline2D &pts, std::vector<unsigned char> &mask) const;
+
+private:
+    void AddRing(const keays::types::VectorD2 *pPts, const int numPoints, const bool isOuter);
+    void BuildSlabs();
+    int CountCrossings(const double &x, const double &y) const;
+
+    std::vector<double> *m_pEdges;      //!< x0, y0, x1, y1 for every non horizontal edge.
+    std::vector<double> *m_pSlabData;   //!< Edge pairs per slab, laid out as yLo[2] yHi[2] a[2] b[2].
+    std::vector<int> *m_pSlabStart;     //!< Index of each slab's first edge pair, numSlabs + 1 entries.
+
+    RectD m_extents;
+    double m_signedArea;
+    double m_slabBase,
+           m_slabScale;
+    int m_numSlabs,
+        m_numRings,
+        m_numEdges;
+};
+
+}    // namespace math
+}    // namespace keays
+
+// eof
@@ -0,0 +1,165 @@
+/*!
+    \file valignment.h
+    \brief    Compiled vertical alignments for fast height evaluation by chainage.
+    Part of the keays::math namespace.
+
+    A VerticalAlignment is built once from a list of PVIs (points of vertical intersection with
+    an optional symmetric parabolic curve length) or from a tGradeSegmentList, and compiled into
+    a sorted array of polynomial pieces.  Each piece evaluates as
+    \f$h = c_0 + c_1 t + c_2 t^2\f$ with \f$t\f$ the distance past the start of the piece, so a
+    single height is a binary search and a few multiplies, and a run of ascending chainages is a
+    single merge walk.
+
+    \date October 2026.
+ */
+#pragma once
+
+#include <vector>
+
+#include "geometry.h"
+
+namespace keays
+{
+namespace math
+{
+
+//! \brief A point of vertical intersection.
+struct tPVI
+{
+    tPVI(const double &chainage = 0.0, const double &height = 0.0, const double &curveLength = 0.0)
+        : m_chainage(chainage), m_height(height), m_curveLength(curveLength) {}
+
+    bool operator<(const tPVI &rhs) const { return m_chainage < rhs.m_chainage; }
+
+    double m_chainage;      //!< The chainage of the intersection point.
+    double m_height;        //!< The height at the intersection point.
+    double m_curveLength;   //!< The length of the vertical curve centred on the point, 0 for a sharp grade change.
+};
+
+//! \brief A compiled piece of a vertical alignment, \f$h = c_0 + c_1 t + c_2 t^2\f$ with \f$t = chainage - start\f$.
+struct tVAPiece
+{
+    double m_start;     //!< The chainage the piece starts at.
+    double m_c0,        //!< The height at the start of the piece.
+           m_c1,        //!< The grade at the start of the piece.
+           m_c2;        //!< Half the rate of change of grade, 0 for a tangent.
+
+    //! Height at a distance past the start of the piece.
+    double Height(const double &t) const { return m_c0 + t * (m_c1 + t * m_c2); }
+    //! Grade at a distance past the start of the piece.
+    double Grade(const double &t) const { return m_c1 + 2.0 * t * m_c2; }
+};
+
+/*!
+    \brief A vertical alignment compiled for O(log n) height lookup.
+    Add PVIs with AddPVI() then call Compile(), or compile directly from a tGradeSegmentList.
+    Heights before the first PVI and after the last follow the end tangents.
+ */
+class KEAYS_MATH_EXPORTS_API VerticalAlignment
+{
+public:
+    VerticalAlignment();
+    VerticalAlignment(const VerticalAlignment &old);
+    ~VerticalAlignment();
+
+    const VerticalAlignment &operator=(const VerticalAlignment &rhs);
+
+    //! Remove all PVIs and compiled pieces.
+    void Clear();
+
+    /*!
+        \brief Add a point of vertical intersection, keeping the list sorted by chainage.
+        The alignment must be recompiled before the new point is used.
+
+        \param    chainage [In] - A constant reference to a <b>double</b> specifying the chainage of the point.
+        \param      height [In] - A constant reference to a <b>double</b> specifying the height of the point.
+        \param curveLength [In] - A constant reference to a <b>double</b> specifying the length of the vertical curve, 0 for none.
+
+        \return false if the curve length is negative.
+     */
+    bool AddPVI(const double &chainage, const double &height, const double &curveLength = 0.0);
+
+    //! \brief Get the number of PVIs added.
+    int GetNumPVIs() const { return (int)m_pPVIs->size(); }
+
+    /*!
+        \brief Compile the PVIs into tangent and curve pieces.
+        Curve lengths on the first and last PVIs are ignored.
+
+        \return S_VC_SUCCESS, E_VC_TOO_FEW_POINTS if there are fewer than 2 PVIs, or E_VC_CURVE_LENGTH
+                if adjacent curves overlap.
+     */
+    const int Compile();
+
+    /*!
+        \brief Compile the heights given by a tGradeSegmentList.
+        The result evaluates identically to tGradeSegmentList::DeltaH(), including segments only
+        contributing over \f$(m\_distance, m\_distance + m\_width]\f$.  Any PVIs are discarded.
+
+        \param grades [In] - A constant reference to the tGradeSegmentList to compile.
+
+        \return true if successful.
+     */
+    bool Compile(const tGradeSegmentList &grades);
+
+    //! \brief Test if the alignment has been compiled.
+    bool IsCompiled() const { return !m_pPieces->empty(); }
+
+    //! \brief Get the number of compiled pieces.
+    int GetNumPieces() const { return (int)m_pPieces->size(); }
+
+    //! \brief Get a compiled piece.
+    const tVAPiece &GetPiece(const int index) const { return (*m_pPieces)[index]; }
+
+    /*!
+        \brief Get the height at a chainage.
+
+        \param chainage [In] - A constant reference to a <b>double</b> specifying the chainage.
+
+        \return The height, or 0.0 if the alignment has not been compiled.
+     */
+    double HeightAt(const double &chainage) const;
+
+    /*!
+        \brief Get the grade at a chainage.
+
+        \param chainage [In] - A constant reference to a <b>double</b> specifying the chainage.
+
+        \return The grade (rise over run), or 0.0 if the alignment has not been compiled.
+     */
+    double GradeAt(const double &chainage) const;
+
+    /*!
+        \brief Evaluate the height at many chainages.
+        Ascending chainages are evaluated with a single merge walk over the pieces, an out of order
+        chainage restarts the walk with a binary search so unsorted input is still correct.
+
+        \param   pChainages [In]  - A constant pointer to an array of chainages, ideally ascending.
+        \param numChainages [In]  - An <b>int</b> specifying the number of chainages.
+        \param     pHeights [Out] - A pointer to an array of at least numChainages doubles to receive the heights.
+
+        \return true if successful.
+     */
+    bool HeightsAt(const double *pChainages, const int numChainages, double *pHeights) const;
+
+    /*!
+        \overload
+        \param chainages [In]  - A constant reference to a vector of chainages, ideally ascending.
+        \param   heights [Out] - A reference to a vector resized and filled with the heights.
+     */
+    bool HeightsAt(const std::vector<double> &chainages, std::vector<double> &heights) const;
+
+private:
+    int FindPiece(const double &chainage) const;
+    const tVAPiece &PieceFor(const double &chainage, double *pT) const;
+
+    std::vector<tPVI> *m_pPVIs;
+    std::vector<tVAPiece> *m_pPieces;
+    bool m_rightClosed;     //!< Pieces cover (start, next] rather than [start, next), used for grade segment lists.
+    bool m_holdStart;       //!< Chainages before the first piece take its start height rather than extrapolating.
+};
+
+}    // namespace math
+}    // namespace keays
+
+// eof
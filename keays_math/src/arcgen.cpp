@@ -0,0 +1,149 @@
+/*
+ * Filename: arcgen.cpp
+ * Date: October 2026
+ *
+ * Contains implementations of the fast arc generators in the arcgen.h file.
+ *
+ * Part of the keays::maths namespace
+ */
+
+#include <assert.h>
+
+#include "..\include\arcgen.h"
+
+#pragma warning(disable : 4786) // ignore the long name warning associated with stl stuff
+
+#include <LeakWatcher.h>
+
+#ifdef _DO_MEMORY_DEBUG
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+namespace keays
+{
+namespace math
+{
+namespace kt = keays::types;
+
+// Functions local to this file
+//--------------------------------------------------------------
+// Writes the points of a single arc to pOut, returns the number of points written.
+static int FillArc(const kt::VectorD3 &center, const double &radius, const double &startAngleRad,
+                   const double &sweepRad, const int numSegments, const bool genStartPoint,
+                   const bool genEndPoint, kt::VectorD3 *pOut)
+{
+    kt::VectorD3 *pPt = pOut;
+    ArcStepper step(startAngleRad, sweepRad / numSegments);
+
+    if (genStartPoint)
+        *pPt++ = step.Pos(center, radius);
+
+    for (int i = 1; i < numSegments; i++)
+    {
+        step.Next();
+        *pPt++ = step.Pos(center, radius);
+    }
+
+    if (genEndPoint)
+    {
+        // evaluate the end point exactly so arcs join their tangents without a gap
+        double endAng = startAngleRad + sweepRad;
+        *pPt++ = kt::VectorD3(center.x + radius * cos(endAng), center.y + radius * sin(endAng), center.z);
+    }
+
+    return (int)(pPt - pOut);
+}
+
+//--------------------------------------------------------------
+// Number of points FillArc will write.
+static int NumArcPoints(const int numSegments, const bool genStartPoint, const bool genEndPoint)
+{
+    return numSegments - 1 + (genStartPoint ? 1 : 0) + (genEndPoint ? 1 : 0);
+}
+
+//--------------------------------------------------------------
+KEAYS_MATH_EXPORTS_API int
+NumArcSegments(const double &sweepRad, const double &intervalRad)
+{
+    if (intervalRad <= 0.0)
+        return 0;
+
+    double numSegs = ceil(fabs(sweepRad) / intervalRad - 0.00001);
+    return numSegs < 1.0 ? 1 : (int)numSegs;
+}
+
+//--------------------------------------------------------------
+KEAYS_MATH_EXPORTS_API bool
+GenArcPointsFast(const kt::VectorD3 &center, const double &radius, const double &startAngleRad,
+                 const double &sweepRad, const int numSegments, kt::Polyline3D &pts,
+                 const bool genStartPoint /*= true*/, const bool genEndPoint /*= true*/)
+{
+    if (radius == 0.0 || numSegments < 1)
+        return false;
+
+    int numPts = NumArcPoints(numSegments, genStartPoint, genEndPoint);
+    if (numPts <= 0)
+        return true;
+
+    size_t base = pts.size();
+    pts.resize(base + numPts);
+
+    int numWritten = FillArc(center, radius, startAngleRad, sweepRad, numSegments,
+                             genStartPoint, genEndPoint, &(pts[base]));
+    assert(numWritten == numPts);
+
+    return true;
+}
+
+//--------------------------------------------------------------
+KEAYS_MATH_EXPORTS_API bool
+GenArcPointsBatch(const tArcSpec *pArcs, const int numArcs, kt::Polyline3D &pts,
+                  std::vector<int> *pOffsets /*= NULL*/, const bool genStartPoint /*= true*/,
+                  const bool genEndPoint /*= true*/)
+{
+    int i;
+
+    if (!pArcs || numArcs < 0)
+        return false;
+
+    // size the output once for every arc
+    size_t total = 0;
+    for (i = 0; i < numArcs; i++)
+    {
+        if (pArcs[i].m_radius == 0.0 || pArcs[i].m_numSegments < 1)
+            continue;
+        total += NumArcPoints(pArcs[i].m_numSegments, genStartPoint, genEndPoint);
+    }
+
+    size_t pos = pts.size();
+    pts.resize(pos + total);
+
+    if (pOffsets)
+    {
+        pOffsets->resize(numArcs + 1);
+        (*pOffsets)[0] = (int)pos;
+    }
+
+    for (i = 0; i < numArcs; i++)
+    {
+        const tArcSpec &arc = pArcs[i];
+        if (arc.m_radius != 0.0 && arc.m_numSegments >= 1 &&
+            NumArcPoints(arc.m_numSegments, genStartPoint, genEndPoint) > 0)
+        {
+            pos += FillArc(arc.m_center, arc.m_radius, arc.m_startAngleRad, arc.m_sweepRad,
+                           arc.m_numSegments, genStartPoint, genEndPoint, &(pts[pos]));
+        }
+
+        if (pOffsets)
+            (*pOffsets)[i + 1] = (int)pos;
+    }
+
+    assert(pos == pts.size());
+
+    return true;
+}
+
+}    // namespace math
+}    // namespace keays
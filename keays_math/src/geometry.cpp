@@ -12,6 +12,8 @@
 #include <assert.h>
 
 #include "..\include\geometry.h"
+#include "..\include\arcgen.h"
+#include <keays_float.h>
 #include <float.h>
 #ifdef _DEBUG
 //#include <string>
@@ -509,6 +511,11 @@ GenArcPointsRadCWEx(const keays::types::VectorD3 &center, const double &radius,
     double firstAng = startAng - intervalRad;
     double curAng, nextAng;
 
+    // size an empty result once rather than growing it a point at a time; when appending to the
+    // caller's points, push_back's own growth is left alone so that repeated calls stay linear
+    if (pts.empty() && intervalRad > 0.0)
+        pts.reserve((size_t)((aStartAngle - aEndAngle) / intervalRad) + (iAngs ? numImportantAngles : 0) + 3);
+
     if (genStartPoint || isCircle)
     {
         pt = GenPolarPosRad(center, radius, aStartAngle);
@@ -526,13 +533,14 @@ GenArcPointsRadCWEx(const keays::types::VectorD3 &center, const double &radius,
         pts.push_back(pt);
     }
 
+    // step the interval points with the rotation recurrence instead of a sin/cos per point
+    ArcStepper step(firstAng, -intervalRad);
     curAng = firstAng;
     while (curAng > aEndAngle)
     {
         nextAng = curAng - intervalRad;
 
-        pt = GenPolarPosRad(center, radius, curAng);
-        pts.push_back(pt);
+        pts.push_back(step.Pos(center, radius));
 
         while ((iAngIdx < numImportantAngles) && (iAngs[iAngIdx] > nextAng))
         {
@@ -545,6 +553,7 @@ GenArcPointsRadCWEx(const keays::types::VectorD3 &center, const double &radius,
         }
 
         curAng -= intervalRad;
+        step.Next();
     }
 
     if (genEndPoint || isCircle)
@@ -619,6 +628,11 @@ GenArcPointsRadCCWEx(const keays::types::VectorD3 &center, const double &radius,
     double firstAng = startAng + intervalRad;
     double curAng, nextAng;
 
+    // size an empty result once rather than growing it a point at a time; when appending to the
+    // caller's points, push_back's own growth is left alone so that repeated calls stay linear
+    if (pts.empty() && intervalRad > 0.0)
+        pts.reserve((size_t)((aEndAngle - aStartAngle) / intervalRad) + (iAngs ? numImportantAngles : 0) + 3);
+
     if (genStartPoint || isCircle)
     {
         pt = GenPolarPosRad(center, radius, aStartAngle);
@@ -636,13 +650,14 @@ GenArcPointsRadCCWEx(const keays::types::VectorD3 &center, const double &radius,
         pts.push_back(pt);
     }
 
+    // step the interval points with the rotation recurrence instead of a sin/cos per point
+    ArcStepper step(firstAng, intervalRad);
     curAng = firstAng;
     while (curAng < aEndAngle)
     {
         nextAng = curAng + intervalRad;
 
-        pt = GenPolarPosRad(center, radius, curAng);
-        pts.push_back(pt);
+        pts.push_back(step.Pos(center, radius));
 
         while ((iAngIdx < numImportantAngles) && (iAngs[iAngIdx] < nextAng))
         {
@@ -659,6 +674,7 @@ GenArcPointsRadCCWEx(const keays::types::VectorD3 &center, const double &radius,
         }
 
         curAng += intervalRad;
+        step.Next();
     }
 
     if (genEndPoint || isCircle)
@@ -2942,7 +2958,7 @@ PointOnSegment(const keays::types::VectorD2 &pt1, const keays::types::VectorD2 &
     keays::types::VectorD2 pt1ToTestPt((testPt - pt1).GetNormalised());
     keays::types::VectorD2 testPtToPt2((pt2 - testPt).GetNormalised());
 
-    return keays::types::Float::GreaterOrEqual(pt1ToTestPt.Dot(testPtToPt2), 0.0, tolerance);
+    return keays::types::Float::Fast::GreaterOrEqual(pt1ToTestPt.Dot(testPtToPt2), 0.0, tolerance);
 }
 
 //-----------------------------------------------------------------------------
@@ -2954,7 +2970,7 @@ PointOnSegment(const keays::types::VectorD3 &pt1, const keays::types::VectorD3 &
     keays::types::VectorD3 pt1ToTestPt((testPt - pt1).GetNormalised());
     keays::types::VectorD3 testPtToPt2((pt2 - testPt).GetNormalised());
 
-    return keays::types::Float::GreaterOrEqual(pt1ToTestPt.Dot(testPtToPt2), 0.0, tolerance);
+    return keays::types::Float::Fast::GreaterOrEqual(pt1ToTestPt.Dot(testPtToPt2), 0.0, tolerance);
 }
 
 //--------------------------------------------------------------
@@ -2982,7 +2998,7 @@ LineCrossesTriangle(const keays::types::VectorD3 &triPt1, const keays::types::Ve
     int startEdge = -1;
     int endEdge = -1;
 
-    if(keays::types::Float::EqualTo(line.GetLength2D(), 0.0))
+    if(keays::types::Float::Fast::EqualTo(line.GetLength2D(), 0.0))
     {
         WriteDebugLog(_T("    MATH: %5d: Line has 0 length in the XY plane\n"), __LINE__);
         return E_FAILURE;
@@ -3179,7 +3195,7 @@ LineCrossesTriangle(const keays::types::VectorD3 &triPt1, const keays::types::Ve
                          __LINE__,
                          backBearing, RTD(backBearing), DEG_CHAR,
                          resBearing, RTD(resBearing), DEG_CHAR);
-        if(keays::types::Float::EqualTo(resBearing , backBearing, tolerance))
+        if(keays::types::Float::Fast::EqualTo(resBearing , backBearing, tolerance))
         {
             WriteDebugLog(_T("    MATH: %5d: LineCrossesTriangle - Swap Points\n"), __LINE__);
             // we need to swap them
@@ -4889,13 +4905,15 @@ GetNearestPoint(const keays::types::Polyline3D &testPolyline, const keays::types
             keays::types::VectorD2 b = (end.XY() - resultPoint).GetNormalised();
             keays::types::VectorD2 c = (testPoint - start.XY()).GetNormalised();
 
-            if (a == b)
+            // a == b, inlined: the same test at the same tolerance as VectorD2::operator==
+            const double dirTolerance = keays::types::VectorD2::ms_tolerance;
+            if (keays::types::Float::Fast::EqualTo(a.x, b.x, dirTolerance) && keays::types::Float::Fast::EqualTo(a.y, b.y, dirTolerance))
             {
                 keays::types::VectorD3 resultVec = resultPoint.VD3(start.z) - start;
 
                 double segmentLength = Dist2D(end.XY(), start.XY());
 
-                if (segmentLength == 0.0)
+                if (keays::types::Float::Fast::EqualTo(segmentLength, 0.0, tolerance))
                     continue;
 
                 double startPointLength = Dist2D(resultPoint, start.XY());
@@ -4927,7 +4945,7 @@ GetNearestPoint(const keays::types::Polyline3D &testPolyline, const keays::types
 
                             double segmentLength = Dist2D(end.XY(), start.XY());
 
-                            if (segmentLength == 0.0)
+                            if (keays::types::Float::Fast::EqualTo(segmentLength, 0.0, tolerance))
                                 continue;
 
                             double startPointLength = -Dist2D(resultPoint, start.XY());
@@ -4955,7 +4973,7 @@ GetNearestPoint(const keays::types::Polyline3D &testPolyline, const keays::types
 
                             double segmentLength = Dist2D(end.XY(), start.XY());
 
-                            if (segmentLength == 0.0)
+                            if (keays::types::Float::Fast::EqualTo(segmentLength, 0.0, tolerance))
                                 continue;
 
                             double startPointLength = Dist2D(resultPoint, start.XY());
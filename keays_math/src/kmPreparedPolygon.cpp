@@ -0,0 +1,380 @@
+/*
+ * Filename: kmPreparedPolygon.cpp
+ * Date: October 2026
+ *
+ * Contains the implementation of the PreparedPolygon class in the preparedpolygon.h file.
+ *
+ * Part of the keays::maths namespace
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "..\include\preparedpolygon.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define KM_PREPARED_POLYGON_SSE2
+#include <emmintrin.h>
+#endif
+
+#include <LeakWatcher.h>
+
+#ifdef _DO_MEMORY_DEBUG
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+#pragma warning(disable : 4786) // ignore the long name warning associated with stl stuff
+
+namespace keays
+{
+namespace math
+{
+namespace kt = keays::types;
+
+// doubles per edge in m_pEdges and per edge pair in m_pSlabData
+static const int EDGE_STRIDE = 4;
+static const int PAIR_STRIDE = 8;
+
+// upper limit on the number of slabs, past this the slab table costs more than it saves
+static const int MAX_SLABS = 4096;
+
+//-----------------------------------------------------------------------------
+PreparedPolygon::PreparedPolygon()
+    : m_pEdges(new std::vector<double>), m_pSlabData(new std::vector<double>), m_pSlabStart(new std::vector<int>),
+      m_signedArea(0.0), m_slabBase(0.0), m_slabScale(0.0), m_numSlabs(0), m_numRings(0), m_numEdges(0) {}
+
+//-----------------------------------------------------------------------------
+PreparedPolygon::PreparedPolygon(const kt::Polyline2D &outer)
+    : m_pEdges(new std::vector<double>), m_pSlabData(new std::vector<double>), m_pSlabStart(new std::vector<int>),
+      m_signedArea(0.0), m_slabBase(0.0), m_slabScale(0.0), m_numSlabs(0), m_numRings(0), m_numEdges(0)
+{
+    SetOuter(outer);
+}
+
+//-----------------------------------------------------------------------------
+PreparedPolygon::PreparedPolygon(const std::list<kt::VectorD2> &outer)
+    : m_pEdges(new std::vector<double>), m_pSlabData(new std::vector<double>), m_pSlabStart(new std::vector<int>),
+      m_signedArea(0.0), m_slabBase(0.0), m_slabScale(0.0), m_numSlabs(0), m_numRings(0), m_numEdges(0)
+{
+    SetOuter(outer);
+}
+
+//-----------------------------------------------------------------------------
+PreparedPolygon::PreparedPolygon(const kt::VectorD2 *pOuter, const int numPoints)
+    : m_pEdges(new std::vector<double>), m_pSlabData(new std::vector<double>), m_pSlabStart(new std::vector<int>),
+      m_signedArea(0.0), m_slabBase(0.0), m_slabScale(0.0), m_numSlabs(0), m_numRings(0), m_numEdges(0)
+{
+    SetOuter(pOuter, numPoints);
+}
+
+//-----------------------------------------------------------------------------
+PreparedPolygon::PreparedPolygon(const PreparedPolygon &old)
+    : m_pEdges(new std::vector<double>(*old.m_pEdges)), m_pSlabData(new std::vector<double>(*old.m_pSlabData)),
+      m_pSlabStart(new std::vector<int>(*old.m_pSlabStart)), m_extents(old.m_extents),
+      m_signedArea(old.m_signedArea), m_slabBase(old.m_slabBase), m_slabScale(old.m_slabScale),
+      m_numSlabs(old.m_numSlabs), m_numRings(old.m_numRings), m_numEdges(old.m_numEdges) {}
+
+//-----------------------------------------------------------------------------
+PreparedPolygon::~PreparedPolygon()
+{
+    delete m_pEdges;
+    delete m_pSlabData;
+    delete m_pSlabStart;
+}
+
+//-----------------------------------------------------------------------------
+const PreparedPolygon &PreparedPolygon::operator=(const PreparedPolygon &rhs)
+{
+    if (this == &rhs)
+        return *this;
+
+    *m_pEdges = *rhs.m_pEdges;
+    *m_pSlabData = *rhs.m_pSlabData;
+    *m_pSlabStart = *rhs.m_pSlabStart;
+    m_extents = rhs.m_extents;
+    m_signedArea = rhs.m_signedArea;
+    m_slabBase = rhs.m_slabBase;
+    m_slabScale = rhs.m_slabScale;
+    m_numSlabs = rhs.m_numSlabs;
+    m_numRings = rhs.m_numRings;
+    m_numEdges = rhs.m_numEdges;
+
+    return *this;
+}
+
+//-----------------------------------------------------------------------------
+void PreparedPolygon::Clear()
+{
+    m_pEdges->clear();
+    m_pSlabData->clear();
+    m_pSlabStart->clear();
+    m_extents.MakeInvalid();
+    m_signedArea = 0.0;
+    m_slabBase = m_slabScale = 0.0;
+    m_numSlabs = m_numRings = m_numEdges = 0;
+}
+
+//-----------------------------------------------------------------------------
+bool PreparedPolygon::SetOuter(const kt::Polyline2D &outer)
+{
+    return SetOuter(outer.empty() ? NULL : &(outer[0]), (int)outer.size());
+}
+
+//-----------------------------------------------------------------------------
+bool PreparedPolygon::SetOuter(const std::list<kt::VectorD2> &outer)
+{
+    kt::Polyline2D pts(outer.begin(), outer.end());
+    return SetOuter(pts);
+}
+
+//-----------------------------------------------------------------------------
+bool PreparedPolygon::SetOuter(const kt::VectorD2 *pOuter, const int numPoints)
+{
+    Clear();
+
+    if (!pOuter || numPoints < 3)
+        return false;
+
+    AddRing(pOuter, numPoints, true);
+    BuildSlabs();
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+bool PreparedPolygon::AddHole(const kt::Polyline2D &hole)
+{
+    return AddHole(hole.empty() ? NULL : &(hole[0]), (int)hole.size());
+}
+
+//-----------------------------------------------------------------------------
+bool PreparedPolygon::AddHole(const std::list<kt::VectorD2> &hole)
+{
+    kt::Polyline2D pts(hole.begin(), hole.end());
+    return AddHole(pts);
+}
+
+//-----------------------------------------------------------------------------
+bool PreparedPolygon::AddHole(const kt::VectorD2 *pHole, const int numPoints)
+{
+    if (!IsValid() || !pHole || numPoints < 3)
+        return false;
+
+    AddRing(pHole, numPoints, false);
+    BuildSlabs();
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+void PreparedPolygon::AddRing(const kt::VectorD2 *pPts, const int numPoints, const bool isOuter)
+{
+    double area = CalcPolygonArea(pPts, numPoints, true);
+
+    if (isOuter)
+    {
+        m_signedArea = area;
+        for (int i = 0; i < numPoints; i++)
+            m_extents.IncludePoint(pPts[i]);
+    } else
+    {
+        // holes always take away from the outer area, whatever way they are wound
+        double holeArea = area < 0.0 ? -area : area;
+        m_signedArea += m_signedArea < 0.0 ? holeArea : -holeArea;
+    }
+
+    m_pEdges->reserve(m_pEdges->size() + numPoints * EDGE_STRIDE);
+    for (int i = 0; i < numPoints; i++)
+    {
+        const kt::VectorD2 &p0 = pPts[i];
+        const kt::VectorD2 &p1 = pPts[(i + 1) % numPoints];
+
+        // horizontal edges never cross a horizontal ray, skipping them also drops a duplicate closing point
+        if (p0.y == p1.y)
+            continue;
+
+        m_pEdges->push_back(p0.x);
+        m_pEdges->push_back(p0.y);
+        m_pEdges->push_back(p1.x);
+        m_pEdges->push_back(p1.y);
+        m_numEdges++;
+    }
+
+    m_numRings++;
+}
+
+//-----------------------------------------------------------------------------
+void PreparedPolygon::BuildSlabs()
+{
+    int i, s;
+
+    m_pSlabData->clear();
+    m_pSlabStart->clear();
+
+    m_numSlabs = m_numEdges / 2;
+    if (m_numSlabs < 1)
+        m_numSlabs = 1;
+    if (m_numSlabs > MAX_SLABS)
+        m_numSlabs = MAX_SLABS;
+
+    double height = m_extents.m_top - m_extents.m_bottom;
+    m_slabBase = m_extents.m_bottom;
+    m_slabScale = height > 0.0 ? m_numSlabs / height : 0.0;
+
+    // first pass, count the edges in each slab
+    std::vector<int> counts(m_numSlabs, 0);
+    std::vector<int> firstSlab(m_numEdges), lastSlab(m_numEdges);
+    const double *pEdge = m_numEdges ? &((*m_pEdges)[0]) : NULL;
+    for (i = 0; i < m_numEdges; i++, pEdge += EDGE_STRIDE)
+    {
+        double yLo = pEdge[1] < pEdge[3] ? pEdge[1] : pEdge[3];
+        double yHi = pEdge[1] < pEdge[3] ? pEdge[3] : pEdge[1];
+
+        int s0 = (int)((yLo - m_slabBase) * m_slabScale);
+        int s1 = (int)((yHi - m_slabBase) * m_slabScale);
+        firstSlab[i] = s0 < 0 ? 0 : (s0 >= m_numSlabs ? m_numSlabs - 1 : s0);
+        lastSlab[i] = s1 < 0 ? 0 : (s1 >= m_numSlabs ? m_numSlabs - 1 : s1);
+
+        for (s = firstSlab[i]; s <= lastSlab[i]; s++)
+            counts[s]++;
+    }
+
+    // slabs are stored as whole edge pairs so the SSE2 loop never has a tail
+    m_pSlabStart->resize(m_numSlabs + 1);
+    (*m_pSlabStart)[0] = 0;
+    for (s = 0; s < m_numSlabs; s++)
+        (*m_pSlabStart)[s + 1] = (*m_pSlabStart)[s] + (counts[s] + 1) / 2;
+
+    // padding entries have yLo > yHi so they can never register a crossing
+    int numPairs = (*m_pSlabStart)[m_numSlabs];
+    m_pSlabData->resize(numPairs * PAIR_STRIDE, 0.0);
+    for (i = 0; i < numPairs; i++)
+    {
+        (*m_pSlabData)[i * PAIR_STRIDE + 0] = 1.0;
+        (*m_pSlabData)[i * PAIR_STRIDE + 1] = 1.0;
+    }
+
+    // second pass, fill in x = a + b*y for each edge in each slab it touches
+    std::vector<int> fill(m_numSlabs, 0);
+    pEdge = m_numEdges ? &((*m_pEdges)[0]) : NULL;
+    for (i = 0; i < m_numEdges; i++, pEdge += EDGE_STRIDE)
+    {
+        double x0 = pEdge[0], y0 = pEdge[1], x1 = pEdge[2], y1 = pEdge[3];
+        double b = (x1 - x0) / (y1 - y0);
+        double a = x0 - b * y0;
+        double yLo = y0 < y1 ? y0 : y1;
+        double yHi = y0 < y1 ? y1 : y0;
+
+        for (s = firstSlab[i]; s <= lastSlab[i]; s++)
+        {
+            int slot = fill[s]++;
+            double *pPair = &((*m_pSlabData)[((*m_pSlabStart)[s] + slot / 2) * PAIR_STRIDE]);
+            int lane = slot & 1;
+            pPair[0 + lane] = yLo;
+            pPair[2 + lane] = yHi;
+            pPair[4 + lane] = a;
+            pPair[6 + lane] = b;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+int PreparedPolygon::CountCrossings(const double &x, const double &y) const
+{
+    int s = (int)((y - m_slabBase) * m_slabScale);
+    if (s < 0)
+        s = 0;
+    else if (s >= m_numSlabs)
+        s = m_numSlabs - 1;
+
+    int first = (*m_pSlabStart)[s];
+    int last = (*m_pSlabStart)[s + 1];
+    if (first == last)
+        return 0;
+
+    const double *pPair = &((*m_pSlabData)[first * PAIR_STRIDE]);
+    int crossings = 0;
+
+#ifdef KM_PREPARED_POLYGON_SSE2
+    __m128d px = _mm_set1_pd(x);
+    __m128d py = _mm_set1_pd(y);
+    for (int p = first; p < last; p++, pPair += PAIR_STRIDE)
+    {
+        __m128d hit = _mm_and_pd(_mm_cmpge_pd(py, _mm_loadu_pd(pPair)), _mm_cmplt_pd(py, _mm_loadu_pd(pPair + 2)));
+        __m128d xCross = _mm_add_pd(_mm_loadu_pd(pPair + 4), _mm_mul_pd(_mm_loadu_pd(pPair + 6), py));
+        int bits = _mm_movemask_pd(_mm_and_pd(hit, _mm_cmplt_pd(px, xCross)));
+        crossings += (bits & 1) + (bits >> 1);
+    }
+#else
+    for (int p = first; p < last; p++, pPair += PAIR_STRIDE)
+    {
+        for (int lane = 0; lane < 2; lane++)
+        {
+            if (y >= pPair[lane] && y < pPair[2 + lane] && x < pPair[4 + lane] + pPair[6 + lane] * y)
+                crossings++;
+        }
+    }
+#endif
+
+    return crossings;
+}
+
+//-----------------------------------------------------------------------------
+bool PreparedPolygon::Contains(const double &x, const double &y) const
+{
+    if (!m_numEdges)
+        return false;
+
+    if (x < m_extents.m_left || x > m_extents.m_right || y < m_extents.m_bottom || y > m_extents.m_top)
+        return false;
+
+    return (CountCrossings(x, y) & 1) != 0;
+}
+
+//-----------------------------------------------------------------------------
+int PreparedPolygon::Contains(const kt::VectorD2 *pPts, const int numPoints, unsigned char *pMask) const
+{
+    int i, numInside = 0;
+
+    if (!pPts || !pMask || numPoints <= 0)
+        return 0;
+
+    if (!m_numEdges)
+    {
+        memset(pMask, 0, numPoints);
+        return 0;
+    }
+
+    const double left = m_extents.m_left, right = m_extents.m_right;
+    const double bottom = m_extents.m_bottom, top = m_extents.m_top;
+
+    for (i = 0; i < numPoints; i++)
+    {
+        const kt::VectorD2 &pt = pPts[i];
+        if (pt.x < left || pt.x > right || pt.y < bottom || pt.y > top)
+        {
+            pMask[i] = 0;
+            continue;
+        }
+
+        pMask[i] = (unsigned char)(CountCrossings(pt.x, pt.y) & 1);
+        numInside += pMask[i];
+    }
+
+    return numInside;
+}
+
+//-----------------------------------------------------------------------------
+int PreparedPolygon::Contains(const kt::Polyline2D &pts, std::vector<unsigned char> &mask) const
+{
+    mask.resize(pts.size());
+    if (pts.empty())
+        return 0;
+
+    return Contains(&(pts[0]), (int)pts.size(), &(mask[0]));
+}
+
+}    // namespace math
+}    // namespace keays
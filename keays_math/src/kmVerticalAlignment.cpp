@@ -0,0 +1,330 @@
+/*
+ * Filename: kmVerticalAlignment.cpp
+ * Date: October 2026
+ *
+ * Contains the implementation of the VerticalAlignment class in the valignment.h file.
+ *
+ * Part of the keays::maths namespace
+ */
+
+#include <assert.h>
+#include <algorithm>
+
+#include "..\include\valignment.h"
+
+#include <LeakWatcher.h>
+
+#ifdef _DO_MEMORY_DEBUG
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+#pragma warning(disable : 4786) // ignore the long name warning associated with stl stuff
+
+namespace keays
+{
+namespace math
+{
+
+//-----------------------------------------------------------------------------
+VerticalAlignment::VerticalAlignment()
+    : m_pPVIs(new std::vector<tPVI>), m_pPieces(new std::vector<tVAPiece>),
+      m_rightClosed(false), m_holdStart(false) {}
+
+//-----------------------------------------------------------------------------
+VerticalAlignment::VerticalAlignment(const VerticalAlignment &old)
+    : m_pPVIs(new std::vector<tPVI>(*old.m_pPVIs)), m_pPieces(new std::vector<tVAPiece>(*old.m_pPieces)),
+      m_rightClosed(old.m_rightClosed), m_holdStart(old.m_holdStart) {}
+
+//-----------------------------------------------------------------------------
+VerticalAlignment::~VerticalAlignment()
+{
+    delete m_pPVIs;
+    delete m_pPieces;
+}
+
+//-----------------------------------------------------------------------------
+const VerticalAlignment &VerticalAlignment::operator=(const VerticalAlignment &rhs)
+{
+    if (this == &rhs)
+        return *this;
+
+    *m_pPVIs = *rhs.m_pPVIs;
+    *m_pPieces = *rhs.m_pPieces;
+    m_rightClosed = rhs.m_rightClosed;
+    m_holdStart = rhs.m_holdStart;
+
+    return *this;
+}
+
+//-----------------------------------------------------------------------------
+void VerticalAlignment::Clear()
+{
+    m_pPVIs->clear();
+    m_pPieces->clear();
+    m_rightClosed = false;
+    m_holdStart = false;
+}
+
+//-----------------------------------------------------------------------------
+bool VerticalAlignment::AddPVI(const double &chainage, const double &height, const double &curveLength /*= 0.0*/)
+{
+    if (curveLength < 0.0)
+        return false;
+
+    tPVI pvi(chainage, height, curveLength);
+    m_pPVIs->insert(std::upper_bound(m_pPVIs->begin(), m_pPVIs->end(), pvi), pvi);
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+const int VerticalAlignment::Compile()
+{
+    const std::vector<tPVI> &pvis = *m_pPVIs;
+    int i, numPVIs = (int)pvis.size();
+
+    m_pPieces->clear();
+    m_rightClosed = false;
+    m_holdStart = false;
+
+    if (numPVIs < 2)
+        return E_VC_TOO_FEW_POINTS;
+
+    // tangent grades between each pair of PVIs, coincident PVIs leave the grade undefined
+    std::vector<double> grades(numPVIs - 1);
+    for (i = 0; i < numPVIs - 1; i++)
+    {
+        double run = pvis[i + 1].m_chainage - pvis[i].m_chainage;
+        if (run <= 0.0)
+            return E_VC_TOO_FEW_POINTS;
+        grades[i] = (pvis[i + 1].m_height - pvis[i].m_height) / run;
+    }
+
+    m_pPieces->reserve(numPVIs * 2);
+
+    tVAPiece piece;
+    double tangentStart = pvis[0].m_chainage;
+    for (i = 1; i < numPVIs - 1; i++)
+    {
+        const tPVI &pvi = pvis[i];
+        double halfLen = pvi.m_curveLength * 0.5;
+        double nextHalfLen = (i + 1 < numPVIs - 1) ? pvis[i + 1].m_curveLength * 0.5 : 0.0;
+        double bvc = pvi.m_chainage - halfLen;
+        double evc = pvi.m_chainage + halfLen;
+
+        if ((bvc < tangentStart) || (evc > pvis[i + 1].m_chainage - nextHalfLen))
+        {
+            m_pPieces->clear();
+            return E_VC_CURVE_LENGTH;
+        }
+
+        // the incoming tangent, from the end of the last curve to the start of this one.  The first
+        // is kept even when a curve starts on the first PVI, as chainages before the alignment
+        // extrapolate along it rather than along the curve
+        if ((bvc > tangentStart) || (i == 1))
+        {
+            piece.m_start = tangentStart;
+            piece.m_c0 = pvis[i - 1].m_height + grades[i - 1] * (tangentStart - pvis[i - 1].m_chainage);
+            piece.m_c1 = grades[i - 1];
+            piece.m_c2 = 0.0;
+            m_pPieces->push_back(piece);
+        }
+
+        if (halfLen > 0.0)
+        {
+            // symmetric parabola, grade changes linearly from g1 to g2 over the curve length
+            piece.m_start = bvc;
+            piece.m_c0 = pvi.m_height - grades[i - 1] * halfLen;
+            piece.m_c1 = grades[i - 1];
+            piece.m_c2 = (grades[i] - grades[i - 1]) / (4.0 * halfLen);
+            m_pPieces->push_back(piece);
+        }
+
+        tangentStart = evc;
+    }
+
+    // the final tangent runs on past the last PVI
+    piece.m_start = tangentStart;
+    piece.m_c0 = pvis[numPVIs - 2].m_height + grades[numPVIs - 2] * (tangentStart - pvis[numPVIs - 2].m_chainage);
+    piece.m_c1 = grades[numPVIs - 2];
+    piece.m_c2 = 0.0;
+    m_pPieces->push_back(piece);
+
+    return S_VC_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+bool VerticalAlignment::Compile(const tGradeSegmentList &grades)
+{
+    std::list<tGradeSegment>::const_iterator it;
+    size_t i;
+
+    Clear();
+
+    if (!grades.m_pSegments)
+        return false;
+
+    // every segment start and end is a break in the piecewise linear sum
+    std::vector<double> breaks;
+    for (it = grades.m_pSegments->begin(); it != grades.m_pSegments->end(); it++)
+    {
+        if ((*it).m_width <= 0.0)
+            continue;
+        breaks.push_back((*it).m_distance);
+        breaks.push_back((*it).m_distance + (*it).m_width);
+    }
+
+    // tGradeSegment::DeltaH is zero outside (distance, distance + width], so the pieces are closed
+    // on the right and nothing is extrapolated before the first break
+    m_rightClosed = true;
+    m_holdStart = true;
+
+    tVAPiece piece;
+    if (breaks.empty())
+    {
+        piece.m_start = 0.0;
+        piece.m_c0 = piece.m_c1 = piece.m_c2 = 0.0;
+        m_pPieces->push_back(piece);
+        return true;
+    }
+
+    std::sort(breaks.begin(), breaks.end());
+    breaks.erase(std::unique(breaks.begin(), breaks.end()), breaks.end());
+
+    m_pPieces->reserve(breaks.size());
+    for (i = 0; i < breaks.size(); i++)
+    {
+        piece.m_start = breaks[i];
+        piece.m_c0 = piece.m_c1 = piece.m_c2 = 0.0;
+
+        // past the last break every segment has ended
+        if (i + 1 < breaks.size())
+        {
+            for (it = grades.m_pSegments->begin(); it != grades.m_pSegments->end(); it++)
+            {
+                const tGradeSegment &seg = *it;
+                if (seg.m_width <= 0.0)
+                    continue;
+                if ((seg.m_distance <= breaks[i]) && (seg.m_distance + seg.m_width >= breaks[i + 1]))
+                {
+                    piece.m_c0 += (breaks[i] - seg.m_distance) * seg.m_grade;
+                    piece.m_c1 += seg.m_grade;
+                }
+            }
+        }
+
+        m_pPieces->push_back(piece);
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+int VerticalAlignment::FindPiece(const double &chainage) const
+{
+    const std::vector<tVAPiece> &pieces = *m_pPieces;
+    int lo = 0, hi = (int)pieces.size();
+
+    // find the first piece starting after the chainage (at or after for right closed pieces)
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        bool after = m_rightClosed ? (pieces[mid].m_start >= chainage) : (pieces[mid].m_start > chainage);
+        if (after)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+
+    return lo > 0 ? lo - 1 : 0;
+}
+
+//-----------------------------------------------------------------------------
+const tVAPiece &VerticalAlignment::PieceFor(const double &chainage, double *pT) const
+{
+    const tVAPiece &piece = (*m_pPieces)[FindPiece(chainage)];
+
+    *pT = chainage - piece.m_start;
+    if (m_holdStart && *pT < 0.0)
+        *pT = 0.0;
+
+    return piece;
+}
+
+//-----------------------------------------------------------------------------
+double VerticalAlignment::HeightAt(const double &chainage) const
+{
+    if (m_pPieces->empty())
+        return 0.0;
+
+    double t;
+    const tVAPiece &piece = PieceFor(chainage, &t);
+    return piece.Height(t);
+}
+
+//-----------------------------------------------------------------------------
+double VerticalAlignment::GradeAt(const double &chainage) const
+{
+    if (m_pPieces->empty())
+        return 0.0;
+
+    double t;
+    const tVAPiece &piece = PieceFor(chainage, &t);
+    if (m_holdStart && chainage < piece.m_start)
+        return 0.0;
+    return piece.Grade(t);
+}
+
+//-----------------------------------------------------------------------------
+bool VerticalAlignment::HeightsAt(const double *pChainages, const int numChainages, double *pHeights) const
+{
+    if (!pChainages || !pHeights || numChainages < 0)
+        return false;
+
+    if (m_pPieces->empty())
+        return false;
+
+    const std::vector<tVAPiece> &pieces = *m_pPieces;
+    const int numPieces = (int)pieces.size();
+    int idx = 0;
+
+    for (int i = 0; i < numChainages; i++)
+    {
+        const double &ch = pChainages[i];
+
+        if (i == 0 || ch < pChainages[i - 1])
+        {
+            idx = FindPiece(ch);
+        } else if (m_rightClosed)
+        {
+            while ((idx + 1 < numPieces) && (pieces[idx + 1].m_start < ch))
+                idx++;
+        } else
+        {
+            while ((idx + 1 < numPieces) && (pieces[idx + 1].m_start <= ch))
+                idx++;
+        }
+
+        double t = ch - pieces[idx].m_start;
+        if (m_holdStart && t < 0.0)
+            t = 0.0;
+        pHeights[i] = pieces[idx].Height(t);
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+bool VerticalAlignment::HeightsAt(const std::vector<double> &chainages, std::vector<double> &heights) const
+{
+    heights.resize(chainages.size());
+    if (chainages.empty())
+        return !m_pPieces->empty();
+
+    return HeightsAt(&(chainages[0]), (int)chainages.size(), &(heights[0]));
+}
+
+}    // namespace math
+}    // namespace keays
@@ -253,6 +253,25 @@ typedef vector::const_iterator    const_iterator;
  */
 Point * GetPoint( const Point * pCopyMe = NULL );
 
+/**
+ * \brief A run of consecutive records of one string, as a view into a Data object.
+ *
+ * Nothing is copied, so a span is only valid until the records are next edited.
+ */
+struct tStringSpan
+{
+    unsigned int    stringNo;
+    unsigned long    offset;        /**< Index of the first record */
+    unsigned long    count;        /**< Number of records */
+    Point * const    *points;    /**< points[0] to points[count - 1] are the records */
+};
+
+class PointIndex;
+class PlotCodeIndex;
+class PointStats;
+class StringRuns;
+class EditBatch;
+
 /**
  * \brief A collection of Point structures.
  *
@@ -306,6 +325,14 @@ public:
 
     void Append( Point * s );
 
+    /*
+     * Append all of points, in order, with a single reallocation of the
+     * record vector. Ids are given out in the same order as calling
+     * Append() for each point, so a load always produces the same ids.
+     * Like Append() this does not modify m_bHasChanged.
+     */
+    void Append( const vector & points );
+
     bool Clear ();    // erase everything & Free memory !
 
     bool Insert ( iterator, vector *toInsert, bool bFixId = true );
@@ -315,20 +342,32 @@ public:
      */
     void Replace ( int i, Point * s );
 
+    /**
+     * \brief Apply every edit in batch with a single pass over the records.
+     *
+     * Inserted points are given ids in record order, the string counts are
+     * recalculated once at the end and the batch is left empty.
+     * \param pUndo If not NULL this receives the edits that reverse the batch,
+     *              so Apply( *pUndo ) straight afterwards restores the records.
+     *              Deleted points are moved into it rather than freed.
+     * \return false if the batch was empty.
+     */
+    bool Apply( EditBatch & batch, EditBatch * pUndo = NULL );
+
     /* Set all the contour/feature bits of the string at row to be
        equals to value (or invert if value == 'I') */
     void FixSelectedStrings(int row, char value, bool contour);
 
     /*
-     * Check the file to see if it is in a valid state, ie:
-     * 1) There are no blank lines remaining from an insert etc
-     * 2) All points on a line are continuous
-     * ??
+     * Put the file in a valid state, ie:
+     * 1) All points on a line are continuous
+     * 2) The points of a line are in point number order
+     * The records are sorted by string number, single points first, then by
+     * point number. Records that are equal in both keep their order.
      */
     bool MakeValidState();
 
     void SetMaxStringNum( unsigned long i ) { m_MaxStringNum = i; }
-    void SetNumStrings( int num ) { numStrings = num; }
     void SetChanged( bool b) { m_bHasChanged = b; }
 
     // Methods to modify individual data members
@@ -336,17 +375,17 @@ public:
      * Note that these are dumb methods, i.e. don't consider if part of string etc
      */
     void SetStringNo( unsigned long i, unsigned long stringNo )
-        { assert( i < data.size() ) ; ( data.at(i) )->stringNo = stringNo; }
+        { assert( i < data.size() ) ; IndexRemove( data.at(i) ); ( data.at(i) )->stringNo = stringNo; IndexAdd( data.at(i) ); m_bRunsValid = false; }
     void SetPointNo( unsigned long i, unsigned long pointNo )
         { assert( i < data.size() ) ; ( data.at(i) )->pointNo = pointNo; }
     void SetX( unsigned long i, double x )
-        { assert( i < data.size() ) ; ( data.at(i) )->x = x; }
+        { assert( i < data.size() ) ; IndexRemove( data.at(i) ); ( data.at(i) )->x = x; IndexAdd( data.at(i) ); }
     void SetY( unsigned long i, double y )
-        { assert( i < data.size() ) ; ( data.at(i) )->y = y; }
+        { assert( i < data.size() ) ; IndexRemove( data.at(i) ); ( data.at(i) )->y = y; IndexAdd( data.at(i) ); }
     void SetZ( unsigned long i, double z )
-        { assert( i < data.size() ) ; ( data.at(i) )->z = z; }
+        { assert( i < data.size() ) ; IndexRemove( data.at(i) ); ( data.at(i) )->z = z; IndexAdd( data.at(i) ); }
     void SetPlotCode( unsigned long i, char code [cPLOT_CODE_LENGTH] )
-        { assert( i < data.size() ) ; memcpy( data.at(i)->plotCode, code, cPLOT_CODE_LENGTH ); }
+        { assert( i < data.size() ) ; IndexRemove( data.at(i) ); memcpy( data.at(i)->plotCode, code, cPLOT_CODE_LENGTH ); IndexAdd( data.at(i) ); }
     void SetPlotNotes( unsigned long i, char notes [cNOTE_LENGTH] )
         { assert( i < data.size() ) ; memcpy( data.at(i)->notes, notes, cNOTE_LENGTH ); }
 
@@ -376,12 +415,12 @@ public:
     /**
      * \brief Behaves exactly like an insert() on an STL vector
      */
-    void insert ( iterator it, Point * s ) { data.insert( it, s ); }
+    void insert ( iterator it, Point * s ) { data.insert( it, s ); IndexAdd( s ); m_bRunsValid = false; }
 
     /**
      * \brief Behaves exactly like an erase() on an STL vector
      */
-    void erase ( iterator it ) { data.erase( it ); }
+    void erase ( iterator it ) { IndexRemove( *it ); data.erase( it ); m_bRunsValid = false; }
 
     /**
      * \brief Behaves exactly like a begin() on an STL vector
@@ -423,8 +462,13 @@ public:
 
     unsigned int GetRecordCount () { return data.size(); }
     vector * GetDataRef ( ) { return &data; }
-    unsigned int GetNumPoints() { return numPoints; };
-    unsigned int GetNumStrings() { return numStrings; };
+    unsigned int GetNumPoints();
+    unsigned int GetNumStrings();    // the number of distinct string numbers
+
+    /*
+     * Return the number of records with string number stringNo
+     */
+    unsigned long GetStringPointCount( unsigned int stringNo );
     unsigned long GetMaxStringNum() { return m_MaxStringNum; }
 
     /*
@@ -440,6 +484,22 @@ public:
      */
     vector * GetLine ( int lineNum, unsigned long & foundAt );
 
+    /*
+     * Get string stringNo without copying it. A valid string is a single run
+     * of records; if it has been split up GetString() returns the first run
+     * and GetStringRuns() all of them, in record order. GetStrings() returns
+     * every run of every string in record order.
+     *
+     * The runs are found from an index that is kept up to date by every edit
+     * made through this class, and rebuilt when first needed after an edit
+     * that moves records. Call RebuildStringRuns() after changing string
+     * numbers or moving records through Get(), at() or GetDataRef().
+     */
+    bool GetString( unsigned int stringNo, tStringSpan & span );
+    void GetStringRuns( unsigned int stringNo, std::vector<tStringSpan> & spans );
+    void GetStrings( std::vector<tStringSpan> & spans );
+    void RebuildStringRuns();
+
     /*
      * Give the string defined by stringNumber a new set of IDs so that it is
      * contiguous
@@ -452,6 +512,23 @@ public:
      */
     std::vector<std::string> GetUniquePlotCodes ( );
 
+    /*
+     * Return the number of records with plot code code.
+     */
+    unsigned long GetPlotCodeCount( const std::string & code );
+
+    /*
+     * Return the records whose plot code is any of codes, in id order.
+     */
+    vector FindByPlotCodes( const std::vector<std::string> & codes );
+
+    /*
+     * The plot code dictionary is kept up to date by every edit made through
+     * this class. Call this after changing plot codes through Get(), at() or
+     * GetDataRef().
+     */
+    void RebuildPlotCodes();
+
     /*
      * Guaranteed to return a point. Will find the closest point to the position
      * x, y, z
@@ -485,7 +562,61 @@ public:
     /*int FindLine( int x, int y, int maxX, int maxY, double minX,
                          double minY, double deltaX, double deltaY );
     */
+    /*
+     * The extents of every record, or of the records with string number
+     * stringNo. These are kept up to date by every edit made through this
+     * class, so are only recalculated after a record on the edge is removed.
+     * An empty cube is returned if there are no records.
+     */
     keays::math::Cube FindMinMax();
+    keays::math::Cube FindStringMinMax( unsigned int stringNo );
+
+    /*
+     * Recalculate the extents and counts after changing positions or string
+     * numbers through Get(), at() or GetDataRef().
+     */
+    void RebuildStats();
+
+    /*
+     * Spatial queries. These work whether or not the index is enabled, but
+     * without it they scan every record. The index only covers edits made
+     * through this class; if points are moved through Get(), at() or
+     * GetDataRef() call RebuildIndex() afterwards.
+     */
+
+    /**
+     * \brief Turn the plan spatial index on or off.
+     *
+     * Turning it on builds it straight away from the current records.
+     * \param numWorkers The number of threads to build with, 0 to use one per processor.
+     */
+    void EnableIndex( bool bEnable, int numWorkers = 0 );
+    bool IsIndexed() { return NULL != m_pIndex; }
+
+    /**
+     * \brief Rebuild the index from scratch, if it is enabled.
+     */
+    void RebuildIndex( int numWorkers = 0 );
+
+    /**
+     * \brief Return the k points closest to x, y in plan, closest first.
+     */
+    vector FindNearest( double x, double y, int k = 1 );
+
+    /**
+     * \brief Return all points within radius of x, y in plan.
+     */
+    vector FindInRadius( double x, double y, double radius );
+
+    /**
+     * \brief Return all points inside (or on the edge of) rect.
+     */
+    vector FindInRect( const keays::math::RectD & rect );
+
+    /**
+     * \brief Return all points within tolerance of x, y and z in every axis.
+     */
+    vector FindCoincident( double x, double y, double z, double tolerance );
 
     /*
      * True if the file has changed since it was last loaded from disk/saved
@@ -511,13 +642,21 @@ public:
 private:
     bool        CheckFlags( int flags );
 
+    // keep the indexes in step with the records
+    void        IndexAdd( Point * s );
+    void        IndexRemove( Point * s );
+    void        IndexAdd( const vector & points );
+    void        IndexRemove( const vector & points );
+    void        UpdateRuns();
+
+    // not copyable, the index would be shared
+    Data( const Data & );
+    const Data & operator=( const Data & );
+
 protected:
 
     vector                data;            // vector to store all the Points
 
-    // numRecs can != numPoints when there are invalid points in the model
-    long                numPoints;        // number of strings in the model
-    long                numStrings;        // number of valid points in the model
     std::string            m_Title;        // title of this file
     std::string            m_Company;        // company name
 
@@ -525,6 +664,12 @@ protected:
 
     unsigned long    m_CurrentId;    // the next created point will have this id
     unsigned long    m_MaxStringNum; // current maximum string number
+
+    PointIndex        *m_pIndex;        // plan index of the records, NULL if disabled
+    PlotCodeIndex    *m_pPlotCodes;    // dictionary of the plot codes in use
+    PointStats        *m_pStats;        // extents and counts of the records
+    StringRuns        *m_pRuns;        // where each string is in data
+    bool            m_bRunsValid;    // false once records have moved since m_pRuns was built
 };
 
 } // namespace stringfile
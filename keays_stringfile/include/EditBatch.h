@@ -0,0 +1,136 @@
+/*
+ * Filename: EditBatch.h
+ * Date: October 2026
+ *
+ * A set of edits to a Data object that are recorded first and applied
+ * together by Data::Apply().
+ *
+ * Every insert or delete made directly on Data shifts the rest of the record
+ * vector, so a script that makes thousands of them costs O(n) each. An
+ * EditBatch instead collects the inserts, deletes and replacements and
+ * Data::Apply() builds the new record vector in a single pass, giving out
+ * ids and recounting the strings once at the end.
+ *
+ * Record numbers passed to an EditBatch always refer to the records as they
+ * were before the batch is applied, so the order edits are added in doesn't
+ * matter (except that inserts at the same line keep their order).
+ *
+ * It belongs to the keays::stringfile namespace
+ */
+
+#ifndef _EDIT_BATCH_H
+#define _EDIT_BATCH_H
+
+#pragma warning (disable: 4786)
+
+// Includes
+#include <vector>        // std::vector
+
+#include <Data.h>        // keays::stringfile::Point
+
+namespace keays
+{
+namespace stringfile
+{
+
+/**
+ * \brief A list of edits to apply to a Data object in one pass.
+ *
+ * The batch owns the points passed to Insert() until it is applied, and
+ * frees them if it is destroyed without being applied.
+ */
+class EditBatch
+{
+public:
+    EditBatch();
+    ~EditBatch();
+
+    /**
+     * \brief Insert a point before record line.
+     *
+     * A line at or past the end of the data appends.
+     * \param p A point allocated with GetPoint(). The batch takes ownership.
+     * \param bFixId If true the point is given a new id when it is applied,
+     *               otherwise it keeps the id it has.
+     */
+    void Insert( unsigned long line, Point * p, bool bFixId = true );
+
+    /**
+     * \brief Insert points, in order, before record line.
+     */
+    void Insert( unsigned long line, const vector & points, bool bFixId = true );
+
+    /**
+     * \brief Delete count records starting at line.
+     *
+     * Deleting a record more than once is harmless.
+     */
+    void Delete( unsigned long line, unsigned long count = 1 );
+
+    /**
+     * \brief Delete every record with string number stringNo.
+     */
+    void DeleteString( unsigned int stringNo );
+
+    /**
+     * \brief Overwrite record line with the contents of p.
+     *
+     * Everything except the id is copied. If the same line is replaced more
+     * than once the last replacement wins. Replacing a deleted record does nothing.
+     */
+    void Replace( unsigned long line, const Point & p );
+
+    /**
+     * \brief True if there are no edits in the batch.
+     */
+    bool IsEmpty() const;
+
+    /**
+     * \brief Throw away every edit, freeing the points waiting to be inserted.
+     */
+    void Clear();
+
+private:
+    friend class Data;
+
+    struct tInsert
+    {
+        unsigned long    line;
+        unsigned long    order;        // keeps inserts at the same line in the order they were added
+        Point            *p;
+        bool            bFixId;
+
+        bool operator<( const tInsert & rhs ) const
+            { return line < rhs.line || ( line == rhs.line && order < rhs.order ); }
+    };
+
+    struct tDelete
+    {
+        unsigned long    line;
+        unsigned long    count;
+    };
+
+    struct tReplace
+    {
+        unsigned long    line;
+        unsigned long    order;        // so the last replacement of a line wins
+        Point            value;
+
+        bool operator<( const tReplace & rhs ) const
+            { return line < rhs.line || ( line == rhs.line && order < rhs.order ); }
+    };
+
+    // not copyable, the points waiting to be inserted are owned
+    EditBatch( const EditBatch & );
+    const EditBatch & operator=( const EditBatch & );
+
+    std::vector<tInsert>        m_inserts;
+    std::vector<tDelete>        m_deletes;
+    std::vector<unsigned int>    m_deleteStrings;
+    std::vector<tReplace>        m_replaces;
+};
+
+} // namespace stringfile
+} // namespace keays
+
+#endif
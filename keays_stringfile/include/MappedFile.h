@@ -0,0 +1,85 @@
+/*
+ * Filename: MappedFile.h
+ * Date: October 2026
+ *
+ * Read only access to the whole of a file as a single block of memory. The
+ * file is memory mapped where possible, otherwise it is read into memory in
+ * large blocks. Either way the loaders get a plain pointer and a length and
+ * never go through the C runtime a byte at a time.
+ *
+ * It belongs to the keays::stringfile namespace
+ */
+
+#ifndef _MAPPED_FILE_H
+#define _MAPPED_FILE_H
+
+// Includes
+#include <stddef.h>        // size_t
+#include <string>        // std::string
+
+namespace keays
+{
+namespace stringfile
+{
+
+const size_t cMAPPED_FILE_BLOCK_SIZE    =    4 * 1024 * 1024;    /**< Read size used when the file can't be mapped */
+
+/**
+ * \brief A read only view of an entire file.
+ */
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    /**
+     * \brief Open and map filename, closing any file already open.
+     *
+     * An empty file opens successfully with GetData() returning NULL and GetSize() 0.
+     * \return false if the file can't be opened or read.
+     */
+    bool Open( const std::string & filename );
+
+    /**
+     * \brief Unmap and close the file. Safe to call if nothing is open.
+     */
+    void Close();
+
+    bool IsOpen() const { return m_bOpen; }
+
+    /**
+     * \brief The file contents. Valid until Close() or the next Open().
+     */
+    const char * GetData() const { return m_pData; }
+
+    size_t GetSize() const { return m_size; }
+
+    /**
+     * \brief True if the contents are a memory mapping rather than a copy.
+     */
+    bool IsMapped() const { return m_bMapped; }
+
+private:
+    // not copyable, the mapping can only be released once
+    MappedFile( const MappedFile & );
+    const MappedFile & operator=( const MappedFile & );
+
+    bool ReadBlocks( const std::string & filename );
+
+    const char    *m_pData;        // start of the contents
+    size_t        m_size;            // length of the contents in bytes
+    bool        m_bOpen;        // true if Open() succeeded
+    bool        m_bMapped;        // true if m_pData is a mapping, false if it is m_pBuffer
+    char        *m_pBuffer;        // malloc'ed copy used when mapping fails
+
+#ifdef _WIN32
+    void        *m_hFile;        // HANDLE of the open file
+    void        *m_hMapping;    // HANDLE of the file mapping
+#endif
+};
+
+} // namespace stringfile
+} // namespace keays
+
+#endif
@@ -0,0 +1,139 @@
+/*
+ * Filename: PlotCodeIndex.h
+ * Date: October 2026
+ *
+ * A dictionary of the plot codes used in a Data object, with the list of
+ * points that use each code.
+ *
+ * Each four character plot code is packed into a single 32 bit key, so
+ * comparing codes is one integer compare instead of a four byte string
+ * compare. Every distinct key gets an entry holding its points sorted by id,
+ * which makes listing the codes, counting them and selecting the records with
+ * a set of codes proportional to the number of codes or matching records
+ * rather than the size of the file.
+ *
+ * It belongs to the keays::stringfile namespace
+ */
+
+#ifndef _PLOT_CODE_INDEX_H
+#define _PLOT_CODE_INDEX_H
+
+#pragma warning (disable: 4786)
+
+// Includes
+#include <vector>        // std::vector
+#include <string>        // std::string
+#include <map>            // std::map
+
+#include <Data.h>        // keays::stringfile::Point
+
+namespace keays
+{
+namespace stringfile
+{
+
+typedef unsigned int tPlotKey;    /**< A plot code packed into 32 bits */
+
+/**
+ * \brief The plot codes of a collection of points.
+ *
+ * The index does not own the points. Points must be removed from the index
+ * before they are freed or their plot code or id changed, and added again
+ * afterwards.
+ */
+class PlotCodeIndex
+{
+public:
+    PlotCodeIndex();
+    ~PlotCodeIndex();
+
+    /**
+     * \brief Pack a plot code into a key.
+     *
+     * Like the rest of the library the code ends at the first NUL, so
+     * anything after it doesn't affect the key.
+     */
+    static tPlotKey MakeKey( const char code[cPLOT_CODE_LENGTH] );
+    static tPlotKey MakeKey( const std::string & code );
+
+    /**
+     * \brief Unpack a key into the plot code string it was made from.
+     */
+    static std::string KeyToString( tPlotKey key );
+
+    /**
+     * \brief Replace the contents of the index with points, in one pass.
+     */
+    void Build( const vector & points );
+
+    /**
+     * \brief Remove everything from the index.
+     */
+    void Clear();
+
+    /**
+     * \brief Add a single point.
+     */
+    void Insert( Point * p );
+
+    /**
+     * \brief Remove a point, which must have the same plot code and id as when it was added.
+     * \return false if the point wasn't found.
+     */
+    bool Remove( Point * p );
+
+    /**
+     * \brief Add a number of points, touching each code's list once.
+     */
+    void Insert( const vector & points );
+
+    /**
+     * \brief Remove a number of points, touching each code's list once.
+     *
+     * Removing k points one at a time costs a shift of the list for each;
+     * this filters every list involved in one pass instead.
+     */
+    void Remove( const vector & points );
+
+    /**
+     * \brief The number of distinct plot codes in use.
+     */
+    unsigned int GetNumCodes() const { return m_numInUse; }
+
+    /**
+     * \brief Get the distinct plot codes in use, in the order they were first seen.
+     */
+    void GetCodes( std::vector<std::string> & codes ) const;
+
+    /**
+     * \brief The number of points with plot code key.
+     */
+    unsigned long GetCount( tPlotKey key ) const;
+
+    /**
+     * \brief Find the points whose plot code is any of keys.
+     *
+     * \param result Receives the points, in id order.
+     */
+    void Find( const std::vector<tPlotKey> & keys, vector & result ) const;
+
+private:
+    struct tCode
+    {
+        tPlotKey    key;
+        vector        points;        // sorted by id
+    };
+
+    // not copyable
+    PlotCodeIndex( const PlotCodeIndex & );
+    const PlotCodeIndex & operator=( const PlotCodeIndex & );
+
+    std::vector<tCode>                m_codes;        // in the order they were first seen
+    std::map<tPlotKey, unsigned int>    m_lookup;        // key to position in m_codes
+    unsigned int                    m_numInUse;        // codes with at least one point
+};
+
+} // namespace stringfile
+} // namespace keays
+
+#endif
@@ -0,0 +1,138 @@
+/*
+ * Filename: PointIndex.h
+ * Date: October 2026
+ *
+ * A plan (x/y) spatial index over the Points in a Data object, used for
+ * picking, window selection and duplicate detection without scanning every
+ * record.
+ *
+ * The index is a uniform grid sized so each cell holds a few points on
+ * average. A grid rather than a tree is used because every edit to the Data
+ * object has to be reflected in the index, and adding or removing a point
+ * from a grid cell is constant time. Each entry keeps a copy of the point's
+ * x and y next to the pointer so queries don't have to follow the pointer
+ * until a point is known to match.
+ *
+ * It belongs to the keays::stringfile namespace
+ */
+
+#ifndef _POINT_INDEX_H
+#define _POINT_INDEX_H
+
+#pragma warning (disable: 4786)
+
+// Includes
+#include <vector>        // std::vector
+
+#include <Data.h>        // keays::stringfile::Point
+
+namespace keays
+{
+namespace stringfile
+{
+
+const int cINDEX_POINTS_PER_CELL    =    4;    /**< Average number of points per cell the grid is sized for */
+
+/**
+ * \brief A uniform grid of Point pointers.
+ *
+ * The index does not own the points. Points must be removed from the index
+ * before they are freed or their x or y changed, and added again afterwards.
+ */
+class PointIndex
+{
+public:
+    PointIndex();
+    ~PointIndex();
+
+    /**
+     * \brief Replace the contents of the index with points.
+     *
+     * The grid is sized to the extents of the points, with a margin so that
+     * nearby points added later don't force a rebuild.
+     * \param points The points to index.
+     * \param numWorkers The number of threads to build with, 0 to use one per processor.
+     */
+    void Build( const vector & points, int numWorkers = 0 );
+
+    /**
+     * \brief Remove everything from the index.
+     */
+    void Clear();
+
+    /**
+     * \brief Add a single point.
+     *
+     * A point outside the grid is still added (to the nearest edge cell) and
+     * window and radius queries stay correct, but NeedsRebuild() becomes true
+     * as nearest point searches assume every point lies inside the grid.
+     */
+    void Insert( Point * p );
+
+    /**
+     * \brief Remove a point, which must have the same x and y as when it was added.
+     * \return false if the point wasn't found.
+     */
+    bool Remove( Point * p );
+
+    /**
+     * \brief True if points have been added outside the grid since it was built.
+     */
+    bool NeedsRebuild() const { return m_numOutside > 0; }
+
+    unsigned long GetNumPoints() const { return m_numPoints; }
+
+    /**
+     * \brief Find the k points closest to x, y in plan.
+     *
+     * \param result Receives the points, closest first. Fewer than k are returned
+     *               if there are fewer than k points in the index.
+     */
+    void FindNearest( double x, double y, int k, vector & result ) const;
+
+    /**
+     * \brief Find all points within radius of x, y in plan.
+     *
+     * \param result Receives the points, in no particular order.
+     */
+    void FindInRadius( double x, double y, double radius, vector & result ) const;
+
+    /**
+     * \brief Find all points inside (or on the edge of) a window.
+     *
+     * \param result Receives the points, in no particular order.
+     */
+    void FindInRect( double minX, double minY, double maxX, double maxY,
+                     vector & result ) const;
+
+private:
+    struct tEntry
+    {
+        double    x, y;        // copy of the point's position when it was added
+        Point    *p;
+    };
+    typedef std::vector<tEntry>    tCell;
+
+    int CellX( double x ) const;
+    int CellY( double y ) const;
+    bool IsInside( double x, double y ) const;
+
+    // not copyable
+    PointIndex( const PointIndex & );
+    const PointIndex & operator=( const PointIndex & );
+
+    std::vector<tCell>    m_cells;        // m_numX * m_numY cells, row by row
+    double                m_minX;            // lower left corner of the grid
+    double                m_minY;
+    double                m_cellSize;        // width and height of a cell
+    double                m_invCellSize;
+    int                    m_numX;            // number of columns
+    int                    m_numY;            // number of rows
+    unsigned long        m_numPoints;
+    unsigned long        m_numOutside;    // points added outside the grid since the last Build()
+};
+
+} // namespace stringfile
+} // namespace keays
+
+#endif
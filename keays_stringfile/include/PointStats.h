@@ -0,0 +1,129 @@
+/*
+ * Filename: PointStats.h
+ * Date: October 2026
+ *
+ * The extents and counts of the Points in a Data object, kept up to date as
+ * points are added and removed rather than recalculated on every request.
+ *
+ * Adding a point can only grow the extents, so it is cheap. Removing a point
+ * only matters if it was on the edge of the extents, in which case they are
+ * marked out of date and recalculated the next time they are asked for. The
+ * same is done for the extents of each string.
+ *
+ * It belongs to the keays::stringfile namespace
+ */
+
+#ifndef _POINT_STATS_H
+#define _POINT_STATS_H
+
+#pragma warning (disable: 4786)
+
+// Includes
+#include <map>            // std::map
+
+#include <Data.h>        // keays::stringfile::Point
+
+namespace keays
+{
+namespace stringfile
+{
+
+/**
+ * \brief Extents and counts of a collection of points, overall and per string.
+ *
+ * Points must be removed before their position or string number is changed,
+ * and added again afterwards. The extents are recalculated from the points
+ * passed to the getters, which must be the same points that were added.
+ */
+class PointStats
+{
+public:
+    PointStats();
+    ~PointStats();
+
+    /**
+     * \brief Replace the contents with the statistics of points.
+     * \param numWorkers The number of threads to scan with, 0 to use one per processor.
+     */
+    void Build( const vector & points, int numWorkers = 0 );
+
+    /**
+     * \brief Forget everything.
+     */
+    void Clear();
+
+    /**
+     * \brief Add a single point.
+     */
+    void Insert( const Point * p );
+
+    /**
+     * \brief Remove a point, which must have the same position and string number as when it was added.
+     */
+    void Remove( const Point * p );
+
+    /**
+     * \brief The number of points.
+     */
+    unsigned long GetNumPoints() const { return m_numPoints; }
+
+    /**
+     * \brief The number of distinct (non zero) string numbers.
+     */
+    unsigned long GetNumStrings() const { return m_strings.size(); }
+
+    /**
+     * \brief The number of points with string number stringNo.
+     */
+    unsigned long GetStringCount( unsigned int stringNo ) const;
+
+    /**
+     * \brief Get the extents of every point.
+     * \return false if there are no points.
+     */
+    bool GetExtents( const vector & points, keays::math::Cube & extents );
+
+    /**
+     * \brief Get the extents of the string stringNo.
+     * \return false if there is no such string.
+     */
+    bool GetStringExtents( unsigned int stringNo, const vector & points,
+                           keays::math::Cube & extents );
+
+private:
+    struct tBounds
+    {
+        double    minX, minY, minZ;
+        double    maxX, maxY, maxZ;
+
+        void Reset();
+        void Include( const Point * p );
+        bool OnEdge( const Point * p ) const;
+    };
+
+    struct tString
+    {
+        unsigned long    count;
+        tBounds            bounds;
+        bool            bDirty;        // a point on the edge has been removed
+    };
+
+    typedef std::map<unsigned int, tString>    tStringMap;
+
+    void Rescan( const vector & points );
+
+    // not copyable
+    PointStats( const PointStats & );
+    const PointStats & operator=( const PointStats & );
+
+    unsigned long    m_numPoints;
+    tBounds            m_bounds;
+    bool            m_bDirty;            // a point on the edge has been removed
+    tStringMap        m_strings;            // only strings with at least one point
+    unsigned long    m_numDirtyStrings;
+};
+
+} // namespace stringfile
+} // namespace keays
+
+#endif
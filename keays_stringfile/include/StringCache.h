@@ -0,0 +1,89 @@
+/*
+ * Filename: StringCache.h
+ * Date: October 2026
+ *
+ * A binary snapshot of a Data object, written next to the string file it was
+ * loaded from. Loading a snapshot needs no text parsing at all: the file is
+ * mapped into memory and the records are filled straight from its columns.
+ *
+ * The snapshot is stored by column rather than by record:
+ *        - x, y and z as arrays of doubles
+ *        - stringNo and pointNo as arrays of 32 bit integers
+ *        - plot codes as an index into a dictionary of the distinct codes
+ *        - the four plot flags packed into one 32 bit value per record
+ *        - the notes as one fixed width blob
+ *
+ * Each snapshot records the size, modification time and a hash of the start
+ * and end of its source file. If any of them no longer match the snapshot is
+ * stale and is ignored, and Read() falls back to the text loader.
+ *
+ * It belongs to the keays::stringfile namespace
+ */
+
+#ifndef _STRING_CACHE_H
+#define _STRING_CACHE_H
+
+// Includes
+#include <string>        // std::string
+
+#include <Data.h>        // keays::stringfile::Data
+
+namespace keays
+{
+namespace stringfile
+{
+
+/**
+ * \brief Reads and writes binary snapshots of Data objects.
+ */
+class StringCache
+{
+public:
+    /**
+     * \brief Load sourceFilename, from its snapshot if there is an up to date one.
+     *
+     * Otherwise the file is loaded with the TR text loader and, if writeCache
+     * is true, a new snapshot is written for next time. Failing to write the
+     * snapshot does not fail the load.
+     * \return false if the file couldn't be loaded either way.
+     */
+    static bool Read ( const std::string & sourceFilename,
+                       keays::stringfile::Data * stringData,
+                       bool writeCache = true );
+
+    /**
+     * \brief Load the snapshot for sourceFilename, appending the records to stringData.
+     *
+     * The title, company and maximum string number are set as the text loader would set them
+     * and the data is marked as unchanged.
+     * \return false if there is no snapshot, it is stale or it is damaged. stringData
+     *         is untouched in that case.
+     */
+    static bool Load ( const std::string & sourceFilename,
+                       keays::stringfile::Data * stringData );
+
+    /**
+     * \brief Write a snapshot of stringData, keyed to the current state of sourceFilename.
+     *
+     * Call this straight after loading or saving sourceFilename, so the snapshot
+     * matches what is on disk.
+     * \return false if the source can't be found or the snapshot can't be written.
+     */
+    static bool Save ( const std::string & sourceFilename,
+                       keays::stringfile::Data * stringData );
+
+    /**
+     * \brief Return true if sourceFilename has a snapshot that matches it.
+     */
+    static bool IsCurrent( const std::string & sourceFilename );
+
+    /**
+     * \brief The name of the snapshot file used for sourceFilename.
+     */
+    static std::string GetCacheFilename( const std::string & sourceFilename );
+};
+
+} // namespace stringfile
+} // namespace keays
+
+#endif
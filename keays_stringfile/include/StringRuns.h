@@ -0,0 +1,108 @@
+/*
+ * Filename: StringRuns.h
+ * Date: October 2026
+ *
+ * An index of where each string lies in the record vector of a Data object.
+ *
+ * A run is a stretch of consecutive records with the same (non zero) string
+ * number. In a valid file every string is one run, but a string may be split
+ * into several runs, for instance by single points in the middle of it. The
+ * index holds every run in record order, and for each string number the
+ * chain of its runs, so a string can be found without scanning the records.
+ *
+ * It belongs to the keays::stringfile namespace
+ */
+
+#ifndef _STRING_RUNS_H
+#define _STRING_RUNS_H
+
+#pragma warning (disable: 4786)
+
+// Includes
+#include <vector>        // std::vector
+#include <map>            // std::map
+
+#include <Data.h>        // keays::stringfile::tStringSpan
+
+namespace keays
+{
+namespace stringfile
+{
+
+/**
+ * \brief The runs of string records in a vector of points.
+ */
+class StringRuns
+{
+public:
+    StringRuns();
+    ~StringRuns();
+
+    /**
+     * \brief Replace the contents with the runs in points.
+     */
+    void Build( const vector & points );
+
+    /**
+     * \brief Forget everything.
+     */
+    void Clear();
+
+    /**
+     * \brief Account for p having been added to the end of the records, at index.
+     */
+    void Append( const Point * p, unsigned long index );
+
+    /**
+     * \brief The number of runs.
+     */
+    unsigned long GetNumRuns() const { return m_runs.size(); }
+
+    /**
+     * \brief Get the first run of string stringNo.
+     * \return false if there is no such string.
+     */
+    bool GetFirst( unsigned int stringNo, vector & points, tStringSpan & span ) const;
+
+    /**
+     * \brief Get every run of string stringNo, in record order.
+     */
+    void GetAll( unsigned int stringNo, vector & points, std::vector<tStringSpan> & spans ) const;
+
+    /**
+     * \brief Get every run of every string, in record order.
+     */
+    void GetAll( vector & points, std::vector<tStringSpan> & spans ) const;
+
+private:
+    struct tRun
+    {
+        unsigned int    stringNo;
+        unsigned long    offset;        // index of the first record
+        unsigned long    count;
+        long            next;        // the next run of the same string, -1 for none
+    };
+
+    struct tChain
+    {
+        long    first;            // the first and last runs of the string
+        long    last;
+    };
+
+    typedef std::map<unsigned int, tChain>    tChainMap;
+
+    void AddRun( unsigned int stringNo, unsigned long offset );
+    static void MakeSpan( const tRun & run, vector & points, tStringSpan & span );
+
+    // not copyable
+    StringRuns( const StringRuns & );
+    const StringRuns & operator=( const StringRuns & );
+
+    std::vector<tRun>    m_runs;            // in record order
+    tChainMap            m_chains;        // string number to its runs
+};
+
+} // namespace stringfile
+} // namespace keays
+
+#endif
@@ -0,0 +1,120 @@
+/*
+ * Filename: StringStream.h
+ * Date: October 2026
+ *
+ * Reads a TR string file record by record and hands the points and strings
+ * to a caller supplied sink in batches, without building a Data object.
+ *
+ * Memory use is bounded by the read buffer and the batch size no matter how
+ * large the file is, so a survey can be fed straight into a triangulation,
+ * extents or statistics calculation.
+ *
+ * It belongs to the keays::stringfile namespace
+ */
+
+#ifndef _STRING_STREAM_H
+#define _STRING_STREAM_H
+
+#pragma warning (disable: 4786)
+
+// Includes
+#include <string>        // std::string
+
+#include <Data.h>        // keays::stringfile::Point
+
+namespace keays
+{
+namespace stringfile
+{
+
+const size_t cSTREAM_BATCH_SIZE        =    4096;    /**< Default maximum number of points passed to the sink at once */
+
+/**
+ * \brief How a point or string takes part in contouring, decoded from its plot flags.
+ */
+enum eContourRole
+{
+    eCR_EXCLUDED    = 0,    /**< Not contoured. 'N' for a point, 'U' for a string */
+    eCR_INCLUDED,            /**< Contoured. 'Y' for a point, 'S' for a string, which is used as a breakline */
+    eCR_BOUNDARY,            /**< The string is the outer boundary of the surface ('B') */
+    eCR_INTERNAL            /**< The string is an internal polygon, a hole in the surface ('I') */
+};
+
+/**
+ * \brief Decode the contour flag of a point.
+ *
+ * Single points (string number 0) use contourPlot, points on a string use contourString.
+ */
+eContourRole GetContourRole( const Point & point );
+
+/**
+ * \brief True if the point (or the string it is on) is plotted in feature mode.
+ */
+bool IsFeature( const Point & point );
+
+/**
+ * \brief A piece of a string passed to a StringSink.
+ *
+ * A string longer than the batch size is passed in several pieces. Each
+ * piece after the first starts with the last point of the one before, so
+ * every segment of the string is in exactly one piece.
+ */
+struct tStreamString
+{
+    unsigned int    stringNo;    /**< The string number */
+    eContourRole    contour;    /**< Decoded from the first point of the string */
+    bool            feature;    /**< Decoded from the first point of the string */
+    const Point        *points;    /**< The points in this piece, in file order */
+    size_t            count;        /**< The number of points in this piece */
+    bool            bFirst;        /**< True if this is the first piece of the string */
+    bool            bLast;        /**< True if this is the last piece of the string */
+};
+
+/**
+ * \brief Receives the contents of a string file from StringStream.
+ *
+ * The points passed are only valid for the duration of the call. Single
+ * points and strings are each passed in file order, but a batch of single
+ * points may be passed after strings that followed them in the file.
+ */
+class StringSink
+{
+public:
+    virtual ~StringSink() {}
+
+    /**
+     * \brief A batch of single points, i.e. those with string number 0.
+     * \return false to stop reading.
+     */
+    virtual bool OnPoints( const Point * points, size_t count ) = 0;
+
+    /**
+     * \brief A string, or a piece of one.
+     * \return false to stop reading.
+     */
+    virtual bool OnString( const tStreamString & string ) = 0;
+};
+
+/**
+ * \brief Streams string files into a StringSink.
+ */
+class StringStream
+{
+public:
+    /**
+     * \brief Read a TR file, passing its contents to sink as it goes.
+     *
+     * A string is the run of records with the same string number, single
+     * points in between don't end it. If records of a string are separated by
+     * another string they are passed as two strings with the same number.
+     * \param batchSize The most points passed to the sink in one call (at least 2).
+     * \return false if the file can't be read or the sink stopped the read.
+     */
+    static bool Read( const std::string & filename, StringSink & sink,
+                      size_t batchSize = cSTREAM_BATCH_SIZE );
+};
+
+} // namespace stringfile
+} // namespace keays
+
+#endif
@@ -1,4 +1,117 @@
 /*
- * Someone who cares about a none wxTRFile loader can implement one here!
+ * Filename: TRFile.h
+ * Date: October 2026
  *
- */
\ No newline at end of file
+ * This file provides the header definition of a toolkit independent class
+ * that can load & save between a TR (Text Resource) file and a Data object in
+ * memory. It does not depend on wxWindows so can be used from console and batch
+ * programs on any platform.
+ *
+ * The file is mapped into memory in one go, split on record boundaries and the
+ * fixed width records are parsed in parallel. Records are then appended to the
+ * Data object in file order, so the ids given to each point are the same as a
+ * single threaded load.
+ *
+ * Saving works the other way around. The records are formatted in parallel,
+ * each worker into its own buffer, and the buffers are written in order with
+ * one write each while the workers format the next lot.
+ *
+ * It belongs to the keays::stringfile namespace
+ */
+
+#ifndef _TRFILE_H
+#define _TRFILE_H
+
+// Includes
+#include <stddef.h>        // size_t
+#include <string>        // std::string
+
+#include <File.h>        // keays::stringfile::File
+
+namespace keays
+{
+namespace stringfile
+{
+
+const int cTR_RECORD_LENGTH        =    72;    /**< Length of a written record, including the \r\n */
+const int cTR_MAX_RECORD_LENGTH    =    80;    /**< Size of buffer PointToString() needs */
+
+class TRFile : public StringFile
+{
+public:
+    /* Implementation of StringFile interface */
+    static bool Read ( const std::string & filename,
+                       keays::stringfile::Data * stringData,
+                       bool progress, bool userAbort );
+
+    static bool Save ( const std::string & filename,
+                       keays::stringfile::Data * stringData,
+                       bool progress, bool userAbort );
+
+    static bool CanLoadExt( const std::string & extension );
+    /* End Implementation of StringFile interface */
+
+    /**
+     * \brief Write stringData to filename. Save() is the same as Write( filename, stringData ).
+     *
+     * \param bAtomic If true the file is written under a temporary name, flushed
+     *                to the disk and then renamed over filename, so filename is
+     *                always either the old file or the complete new one. Note
+     *                the new file gets default permissions rather than those
+     *                of the file it replaces.
+     * \param numWorkers The number of threads to format with, 0 to use one per processor.
+     * \return false if the file could not be written, in which case the file
+     *         that was being written is removed.
+     */
+    static bool Write ( const std::string & filename,
+                        keays::stringfile::Data * stringData,
+                        bool bAtomic = false, int numWorkers = 0 );
+
+    /**
+     * \brief Parse the contents of a TR file already in memory.
+     *
+     * The first line is the header and is skipped. Parsed records are appended
+     * to stringData, and its maximum string number is set from the records read. The title, company and changed flag are left
+     * for the caller.
+     *
+     * \param pBuffer The file contents.
+     * \param length The number of bytes in pBuffer.
+     * \param stringData The Data object to append to.
+     * \param numWorkers The number of threads to parse with, 0 to use one per processor.
+     * \return false if stringData is NULL.
+     */
+    static bool ReadBuffer ( const char * pBuffer, size_t length,
+                             keays::stringfile::Data * stringData,
+                             int numWorkers = 0 );
+
+    /**
+     * \brief Return a pointer to the first record, just past the header line.
+     */
+    static const char * SkipHeader( const char * pBuffer, const char * pEnd );
+
+    /**
+     * \brief Parse a single record into point.
+     *
+     * \param pLine The start of the record.
+     * \param lineLen The length of the record, not including the line end.
+     * \param point Filled from the record. Fields missing from a short record are zeroed.
+     */
+    static void ParseRecord( const char * pLine, int lineLen,
+                             keays::stringfile::Point & point );
+
+    /**
+     * \brief Format point as a TR record, including the line end.
+     *
+     * Newlines in the plot code and notes are written as spaces.
+     * \param point The point to format.
+     * \param pBuffer Receives the record. Must hold at least cTR_MAX_RECORD_LENGTH chars.
+     * \return The number of chars written (not NULL terminated), or -1 if a
+     *         number can't be written in its field without losing information.
+     */
+    static int PointToString( const keays::stringfile::Point & point, char * pBuffer );
+};
+
+} // namespace stringfile
+} // namespace keays
+
+#endif
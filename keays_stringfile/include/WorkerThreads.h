@@ -0,0 +1,52 @@
+/*
+ * Filename: WorkerThreads.h
+ * Date: October 2026
+ *
+ * A minimal fork/join helper used to split the loading, saving and indexing
+ * of large string files over the available processors. Uses the Win32 thread
+ * API on Windows and pthreads elsewhere so the non-wx library can still be
+ * used from headless batch jobs.
+ *
+ * It belongs to the keays::stringfile namespace
+ */
+
+#ifndef _WORKER_THREADS_H
+#define _WORKER_THREADS_H
+
+namespace keays
+{
+namespace stringfile
+{
+
+const int cMAX_WORKER_THREADS    =    32;    /**< Upper limit on the number of workers RunWorkers() will start */
+
+/**
+ * Signature of a function run by RunWorkers(). pParam is one of the values
+ * from the ppParams array.
+ */
+typedef void (*tWorkerFunc)( void * pParam );
+
+/**
+ * \brief Return the number of workers worth starting on this machine.
+ *
+ * This is the number of processors, clamped to [1, cMAX_WORKER_THREADS].
+ */
+int GetNumWorkers();
+
+/**
+ * \brief Call func once for each entry in ppParams, in parallel, and wait for them all.
+ *
+ * The last entry is run on the calling thread. If a thread cannot be created its
+ * work is also run on the calling thread, so every entry is always processed and
+ * callers never need to handle a partial failure.
+ *
+ * \param func The function to run.
+ * \param ppParams Array of numParams parameters, one per call of func.
+ * \param numParams The number of calls to make.
+ */
+void RunWorkers( tWorkerFunc func, void ** ppParams, int numParams );
+
+} // namespace stringfile
+} // namespace keays
+
+#endif
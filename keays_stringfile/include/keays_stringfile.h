@@ -11,7 +11,10 @@
 #define _KEAYS_STRINGFILE_H
 
 #include <Data.h>
+#include <EditBatch.h>
 #include <File.h>
+#include <StringCache.h>
+#include <StringStream.h>
 
 #ifdef __WXMSW__
 
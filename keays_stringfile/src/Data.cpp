@@ -10,6 +10,7 @@
 
 #include <vector>
 #include <string>
+#include <algorithm>
 #include <math.h>
 
 // Keays base libraries
@@ -17,6 +18,11 @@
 #include <keays_types.h>  // Keays Types Library
 
 #include <Data.h>
+#include <PointIndex.h>
+#include <PlotCodeIndex.h>
+#include <PointStats.h>
+#include <StringRuns.h>
+#include <EditBatch.h>
 
 
 #include <LeakWatcher.h>
@@ -57,15 +63,22 @@ Point * GetPoint( const Point * copyMe )
 
 Data::Data()
 {
-    numStrings = 0;
-    numPoints = 0;
     m_CurrentId = 0;
     m_MaxStringNum = 0;
+    m_pIndex = NULL;
+    m_pPlotCodes = new PlotCodeIndex();
+    m_pStats = new PointStats();
+    m_pRuns = new StringRuns();
+    m_bRunsValid = true;
 }
 
 Data::~Data()
 {
     Clear();
+    delete m_pIndex;
+    delete m_pPlotCodes;
+    delete m_pStats;
+    delete m_pRuns;
 }
 
 /*
@@ -117,6 +130,9 @@ const Point * Data::GetFromId( unsigned int id, iterator * hintIt )
  */
 void Data::Replace ( int index, Point * s )
 {
+    IndexRemove( data[index] );
+    if ( data[index]->stringNo != s->stringNo ) m_bRunsValid = false;
+
     memcpy(data[index]->notes, s->notes, cNOTE_LENGTH);
     memcpy(data[index]->plotCode, s->plotCode, cPLOT_CODE_LENGTH);
     data[index]->pointNo = s->pointNo;
@@ -126,7 +142,146 @@ void Data::Replace ( int index, Point * s )
     data[index]->z = s->z;
     data[index]->id = s->id;
 
+    IndexAdd( data[index] );
+
+    m_bHasChanged = true;
+}
+
+/*
+ * Build the new record vector by walking the old one once, taking the
+ * deletes, replacements and inserts in record order as it goes.
+ */
+bool Data::Apply( EditBatch & batch, EditBatch * pUndo )
+{
+    unsigned long n = data.size();
+    unsigned long numDeleted = 0;
+    unsigned long numEdits;
+    unsigned long i, j;
+    size_t ii = 0, ri = 0;
+
+    if ( batch.IsEmpty() ) return false;
+    if ( pUndo ) pUndo->Clear();
+
+    std::sort( batch.m_inserts.begin(), batch.m_inserts.end() );
+    std::sort( batch.m_replaces.begin(), batch.m_replaces.end() );
+    std::sort( batch.m_deleteStrings.begin(), batch.m_deleteStrings.end() );
+
+    std::vector<char> deleted( n, 0 );
+    std::vector<EditBatch::tDelete>::const_iterator dIt;
+    for ( dIt = batch.m_deletes.begin(); dIt != batch.m_deletes.end(); dIt++ )
+    {
+        unsigned long last = dIt->line + dIt->count;
+        if ( last > n || last < dIt->line ) last = n;
+        for ( j = dIt->line; j < last; j++ )
+        {
+            numDeleted += !deleted[j];
+            deleted[j] = 1;
+        }
+    }
+
+    if ( !batch.m_deleteStrings.empty() )
+    {
+        for ( i = 0; i < n; i++ )
+        {
+            if ( !deleted[i] && std::binary_search( batch.m_deleteStrings.begin(),
+                                                   batch.m_deleteStrings.end(), data[i]->stringNo ) )
+            {
+                deleted[i] = 1;
+                numDeleted++;
+            }
+        }
+    }
+
+    // a big batch is quicker to index from scratch afterwards
+    numEdits = batch.m_inserts.size() + batch.m_replaces.size() + numDeleted;
+    bool bRebuildIndex = numEdits > n / 64;
+    PointIndex *pIndex = m_pIndex;
+    PlotCodeIndex *pPlotCodes = m_pPlotCodes;
+    PointStats *pStats = m_pStats;
+    if ( bRebuildIndex )
+    {
+        // stops IndexAdd/IndexRemove below
+        m_pIndex = NULL;
+        m_pPlotCodes = NULL;
+        m_pStats = NULL;
+    }
+
+    vector newData;
+    newData.reserve( n - numDeleted + batch.m_inserts.size() );
+
+    for ( i = 0; i <= n; i++ )
+    {
+        // the inserts before record i, or everything left once past the end
+        while ( ii < batch.m_inserts.size() && ( batch.m_inserts[ii].line <= i || i == n ) )
+        {
+            Point *p = batch.m_inserts[ii].p;
+
+            if ( batch.m_inserts[ii].bFixId )
+            {
+                p->id = m_CurrentId;
+                m_CurrentId++;
+            }
+
+            if ( pUndo ) pUndo->Delete( newData.size() );
+            newData.push_back( p );
+            IndexAdd( p );
+            ii++;
+        }
+
+        if ( i == n ) break;
+
+        Point *s = data[i];
+
+        const Point *pValue = NULL;
+        while ( ri < batch.m_replaces.size() && batch.m_replaces[ri].line == i )
+        {
+            pValue = &batch.m_replaces[ri].value;
+            ri++;
+        }
+
+        if ( deleted[i] )
+        {
+            IndexRemove( s );
+            if ( pUndo ) pUndo->Insert( newData.size(), s, false );
+            else free( s );
+            continue;
+        }
+
+        if ( pValue )
+        {
+            unsigned long id = s->id;
+
+            if ( pUndo ) pUndo->Replace( newData.size(), *s );
+            IndexRemove( s );
+            *s = *pValue;
+            s->id = id;
+            IndexAdd( s );
+        }
+
+        newData.push_back( s );
+    }
+
+    // the points inserted now belong to the data
+    batch.m_inserts.clear();
+    batch.Clear();
+
+    data.swap( newData );
+    m_bRunsValid = false;
+
+    if ( bRebuildIndex )
+    {
+        m_pIndex = pIndex;
+        m_pPlotCodes = pPlotCodes;
+        m_pStats = pStats;
+        if ( m_pIndex ) m_pIndex->Build( data );
+        m_pPlotCodes->Build( data );
+        m_pStats->Build( data );
+    }
+
+    FixMaxStringNum();
+
     m_bHasChanged = true;
+    return true;
 }
 
 void Data::FixMaxStringNum ()
@@ -160,10 +315,8 @@ vector * Data::Delete ( int startLine, int count )
     endIt = &(data.at(startLine + count - 1));
     endIt++; // 1 beyond
 
-    for ( it = startIt; it != endIt; it++ )
-    {
-        deleted->push_back( *it );
-    }
+    deleted->assign( startIt, endIt );
+    IndexRemove( *deleted );
     /*
     for ( it = startIt; it !=endIt; it++ ) {
         free(*it);
@@ -171,8 +324,8 @@ vector * Data::Delete ( int startLine, int count )
     */
 
     data.erase(startIt, endIt);
+    m_bRunsValid = false;
 
-    numPoints = numPoints - count;
     m_bHasChanged = true;
     return deleted;
 }
@@ -183,7 +336,36 @@ Point * Data::Delete ( Point *s, unsigned long *oIndex )
     Point * delPoint = NULL;
     unsigned long index = 0;
 
-    numPoints--;
+    if ( m_pIndex )
+    {
+        // only the records at exactly this position need to be looked at
+        vector found = FindCoincident( s->x, s->y, s->z, 0.0 );
+
+        if ( found.empty() ) return NULL;
+
+        if ( found.size() == 1 )
+        {
+            it = std::find( data.begin(), data.end(), found[0] );
+        }
+        else
+        {
+            // several at the same position, so delete the first one as a scan would
+            std::set<Point *> candidates( found.begin(), found.end() );
+            for ( it = data.begin(); it != data.end(); it++ )
+                if ( candidates.count( *it ) ) break;
+        }
+
+        if ( it == data.end() ) return NULL;
+
+        delPoint = *it;
+        IndexRemove( delPoint );
+        *oIndex = it - data.begin();
+        data.erase(it);
+        m_bRunsValid = false;
+        m_bHasChanged = true;
+        return delPoint;
+    }
+
     for ( it = data.begin(); it != data.end(); it++ )
     {
         if ( (*it)->x == s->x &&
@@ -191,7 +373,9 @@ Point * Data::Delete ( Point *s, unsigned long *oIndex )
              (*it)->z == s->z )
         {
             delPoint = *it;
+            IndexRemove( delPoint );
             data.erase(it);
+            m_bRunsValid = false;
             m_bHasChanged = true;
             *oIndex = index;
             return delPoint;;
@@ -204,31 +388,36 @@ Point * Data::Delete ( Point *s, unsigned long *oIndex )
 
 }
 
-// BROKEN - how can this possibly work?
+/*
+ * Delete every record of the string, closing up the gaps in one pass
+ */
 bool Data::Delete ( int stringNo )
 {
     iterator it;
-    bool found = false;
-
-    numStrings--;
+    iterator keepIt = data.begin();
+    vector removed;
 
     for ( it = data.begin(); it != data.end(); it++ )
     {
-        if ( (*it)->stringNo == stringNo ) {
-            found = true;
-            free(*it);
-            data.erase(it);
+        if ( (*it)->stringNo == (unsigned int)stringNo ) {
+            removed.push_back( *it );
         } else {
-            if ( found )
-            {
-                m_bHasChanged = true;
-                return true;
-            }
+            *keepIt = *it;
+            keepIt++;
         }
-        numPoints--;
-
     }
-    return false;
+
+    if ( removed.empty() ) return false;
+
+    data.erase( keepIt, data.end() );
+
+    IndexRemove( removed );
+    for ( it = removed.begin(); it != removed.end(); it++ )
+        free(*it);
+
+    m_bRunsValid = false;
+    m_bHasChanged = true;
+    return true;
 }
 
 /*
@@ -239,7 +428,46 @@ void Data::Append( Point * s )
     s->id = m_CurrentId;
     m_CurrentId++;
     data.push_back( s );
-    numPoints++;
+
+    IndexAdd( s );
+    if ( m_bRunsValid ) m_pRuns->Append( s, data.size() - 1 );
+}
+
+void Data::Append( const vector & points )
+{
+    const_iterator it;
+
+    data.reserve( data.size() + points.size() );
+
+    for ( it = points.begin(); it != points.end(); it++ )
+    {
+        (*it)->id = m_CurrentId;
+        m_CurrentId++;
+        data.push_back( *it );
+        if ( m_bRunsValid ) m_pRuns->Append( *it, data.size() - 1 );
+    }
+
+    // a bulk build is much quicker than adding a whole file one at a time
+    if ( m_pIndex )
+    {
+        if ( 0 == m_pIndex->GetNumPoints() )
+            m_pIndex->Build( data );
+        else
+            for ( it = points.begin(); it != points.end(); it++ )
+                m_pIndex->Insert( *it );
+    }
+
+    if ( 0 == m_pPlotCodes->GetNumCodes() )
+        m_pPlotCodes->Build( data );
+    else
+        for ( it = points.begin(); it != points.end(); it++ )
+            m_pPlotCodes->Insert( *it );
+
+    if ( 0 == m_pStats->GetNumPoints() )
+        m_pStats->Build( data );
+    else
+        for ( it = points.begin(); it != points.end(); it++ )
+            m_pStats->Insert( *it );
 }
 
 //bool Data::Insert ( int line, StringRecord d )
@@ -271,10 +499,12 @@ vector * Data::Insert ( int line, int number )
         m_CurrentId++;
         tmpVec.push_back(tmp);
         insertVector->push_back( tmp );
-        numPoints++;
     }
 
+    IndexAdd( tmpVec );
+
     data.insert(it, tmpVec.begin(), tmpVec.end());
+    m_bRunsValid = false;
 
     m_bHasChanged = true;
     return insertVector;
@@ -299,8 +529,10 @@ bool Data::Insert ( iterator it, vector *pToInsert, bool bFixId )
         }
     }
 
-    numPoints = numPoints + pToInsert->size();
+    IndexAdd( *pToInsert );
+
     data.insert( it, pToInsert->begin(), pToInsert->end() );
+    m_bRunsValid = false;
 
     m_bHasChanged = true;
 
@@ -317,10 +549,14 @@ bool Data::Clear ( )
         free(*it);
     }
     data.clear();
-    numPoints = 0;
-    numStrings = 0;
     m_CurrentId = 0;
 
+    if ( m_pIndex ) m_pIndex->Clear();
+    m_pPlotCodes->Clear();
+    m_pStats->Clear();
+    m_pRuns->Clear();
+    m_bRunsValid = true;
+
     m_bHasChanged = false;
     return true;
 }
@@ -349,29 +585,36 @@ void Data::Dump ()
 std::vector<std::string> Data::GetUniquePlotCodes ( )
 {
     std::vector<std::string> strings;
-    iterator it;
-    std::vector<std::string>::iterator it2;
-    bool add = true;
-    char plotCode[cPLOT_CODE_LENGTH+1];
 
-    for ( it = data.begin(); it != data.end(); it++ )
-    {
-        memset( plotCode, 0, cPLOT_CODE_LENGTH+1 );
-        strncpy(plotCode, (*it)->plotCode, cPLOT_CODE_LENGTH);
-        for ( it2 = strings.begin(); it2 != strings.end(); it2++ )
-        {
-            if ( (*it2) == plotCode )
-            {
-                add = false;
-                break;
-            }
-        }
-        if (add) strings.push_back(plotCode);
-        add = true;
-    }
+    m_pPlotCodes->GetCodes( strings );
+
     return strings;
 }
 
+unsigned long Data::GetPlotCodeCount( const std::string & code )
+{
+    return m_pPlotCodes->GetCount( PlotCodeIndex::MakeKey( code ) );
+}
+
+vector Data::FindByPlotCodes( const std::vector<std::string> & codes )
+{
+    std::vector<tPlotKey> keys;
+    std::vector<std::string>::const_iterator it;
+    vector result;
+
+    for ( it = codes.begin(); it != codes.end(); it++ )
+        keys.push_back( PlotCodeIndex::MakeKey( *it ) );
+
+    m_pPlotCodes->Find( keys, result );
+
+    return result;
+}
+
+void Data::RebuildPlotCodes()
+{
+    m_pPlotCodes->Build( data );
+}
+
 unsigned long Data::FindClosestPoint( float x, float y, float z,
                                           int flags )
 {
@@ -1279,42 +1522,41 @@ void Data::FixSelectedStrings(int row, char value, bool contour)
 keays::math::Cube Data::FindMinMax()
 {
     keays::math::Cube minMax;
-    iterator it = data.begin();
 
-    if ( data.size() == 0 )
-    {
+    if ( !m_pStats->GetExtents( data, minMax ) )
         memset( &minMax, 0, sizeof(keays::math::Cube) );
-        return minMax;
-    }
 
-    double x, y, z;
+    return minMax;
+}
 
-    x = (*it)->x;
-    y = (*it)->y;
-    z = (*it)->z;
+keays::math::Cube Data::FindStringMinMax( unsigned int stringNo )
+{
+    keays::math::Cube minMax;
 
-    minMax = keays::math::Cube( x,x,y,y,z,z );
-    //minMax.SetX( = minMax.minX = x;
-    //minMax.maxY = minMax.minY = y;
-    //minMax.maxZ = minMax.minZ = z;
+    if ( !m_pStats->GetStringExtents( stringNo, data, minMax ) )
+        memset( &minMax, 0, sizeof(keays::math::Cube) );
 
-    /* Loop throught the whole model.... */
-    for ( ; it != data.end(); it++ )
-    {
-        x = (*it)->x;
-        y = (*it)->y;
-        z = (*it)->z;
+    return minMax;
+}
 
-        if ( x < minMax.GetLeft() ) minMax.Left( x );
-        if ( y < minMax.GetBottom() ) minMax.Bottom( y );
-        if ( z < minMax.Base() ) minMax.Base( z );
+unsigned int Data::GetNumPoints()
+{
+    return m_pStats->GetNumPoints();
+}
 
-        if ( x > minMax.GetRight() ) minMax.Right( x );
-        if ( y > minMax.GetTop() ) minMax.Top( y );
-        if ( z > minMax.Roof() ) minMax.Roof( z );
-    }
+unsigned int Data::GetNumStrings()
+{
+    return m_pStats->GetNumStrings();
+}
 
-    return minMax;
+unsigned long Data::GetStringPointCount( unsigned int stringNo )
+{
+    return m_pStats->GetStringCount( stringNo );
+}
+
+void Data::RebuildStats()
+{
+    m_pStats->Build( data );
 }
 
 set<unsigned long> * Data::GetUniqueStringNumbers()
@@ -1328,139 +1570,342 @@ set<unsigned long> * Data::GetUniqueStringNumbers()
     return strings;
 }
 
-/* Everything below here is buggy/slow/useless */
 vector * Data::GetLine ( int lineNum, unsigned long & startAt )
 {
-    unsigned long lastNum = 0;
-    unsigned long lineCnt = 0;
-    bool    bFound = false;
-    iterator it;
-    vector * retVec = new vector();
+    std::vector<tStringSpan> spans;
+    std::vector<tStringSpan>::const_iterator it;
 
     if ( 0 == lineNum ) return NULL;
 
-    for ( it = data.begin(); it != data.end(); it++ )
-    {
-        if ( (*it)->stringNo == lineNum )
-        {
-            if ( !bFound ) startAt = lineCnt;
-            if ( bFound && lastNum != lineNum )
-            {
-/*#ifdef __WXMSW__
-                wxLogDebug("**Non continuous string found: %d!", lineNum);
-#endif*/
-            }
-            retVec->push_back(*it);
-            bFound = true;
-        }
-        lastNum = lineNum;
-        lineCnt++;
-    }
+    vector * retVec = new vector();
+
+    GetStringRuns( lineNum, spans );
+    if ( !spans.empty() ) startAt = spans[0].offset;
+
+    for ( it = spans.begin(); it != spans.end(); it++ )
+        retVec->insert( retVec->end(), it->points, it->points + it->count );
+
     return retVec;
 }
 
 bool Data::ReIDString( int stringNumber )
 {
-    unsigned long lastNum = 0;
-    bool    bFound = false;
-    iterator it;
+    std::vector<tStringSpan> spans;
+    std::vector<tStringSpan>::const_iterator it;
+    vector points;
+    iterator pIt;
+    unsigned long i;
 
     if ( 0 == stringNumber ) return false;
 
-/*#ifdef __WXMSW__
-    wxLogDebug("At start ReIDString, String %d: m_CurrentId = %d", stringNumber, m_CurrentId );
-#endif*/
+    GetStringRuns( stringNumber, spans );
 
-    for ( it = data.begin(); it != data.end(); it++ )
-    {
-        if ( (*it)->stringNo == stringNumber )
-        {
-            if ( bFound && lastNum != stringNumber )
-            {
-/*#ifdef __WXMSW__
-                wxLogDebug("**Non continuous string found: %d!", stringNumber);
-#endif*/
-            }
-/*#ifdef __WXMSW__
-            wxLogDebug("Updating ID %d => ID %d", (*it)->id, m_CurrentId );
-#endif*/
+    for ( it = spans.begin(); it != spans.end(); it++ )
+        for ( i = 0; i < it->count; i++ )
+            points.push_back( it->points[i] );
 
-            (*it)->id = m_CurrentId;
-            m_CurrentId += 1;
-            bFound = true;
-        }
-        lastNum = stringNumber;
+    // the plot code lists are sorted by id
+    IndexRemove( points );
+
+    for ( pIt = points.begin(); pIt != points.end(); pIt++ )
+    {
+        (*pIt)->id = m_CurrentId;
+        m_CurrentId += 1;
     }
+
+    IndexAdd( points );
     return true;
 }
 
-/*
+bool Data::GetString( unsigned int stringNo, tStringSpan & span )
+{
+    UpdateRuns();
+    return m_pRuns->GetFirst( stringNo, data, span );
+}
+
+void Data::GetStringRuns( unsigned int stringNo, std::vector<tStringSpan> & spans )
+{
+    UpdateRuns();
+    m_pRuns->GetAll( stringNo, data, spans );
+}
+
+void Data::GetStrings( std::vector<tStringSpan> & spans )
+{
+    UpdateRuns();
+    m_pRuns->GetAll( data, spans );
+}
+
+void Data::RebuildStringRuns()
+{
+    m_pRuns->Build( data );
+    m_bRunsValid = true;
+}
+
+void Data::UpdateRuns()
+{
+    if ( !m_bRunsValid ) RebuildStringRuns();
+}
+
+/* One record as sorted by MakeValidState() */
+struct tSortRec
+{
+    unsigned int    key[2];        // point number, then string number
+    Point            *p;
+};
+
+static const int cRADIX_BITS    = 8;
+static const int cRADIX_SIZE    = 1 << cRADIX_BITS;
+static const int cRADIX_PASSES    = 8;        // least significant byte of the point number first
 
-  This that this should fix:
-  1) Strings scattered across the file
-  2) State of feature & contour plot bits on strings
-  3)
+static inline unsigned int RadixDigit( const tSortRec & rec, int pass )
+{
+    return ( rec.key[pass >> 2] >> ( ( pass & 3 ) * cRADIX_BITS ) ) & ( cRADIX_SIZE - 1 );
+}
 
+/*
+ * A least significant digit radix sort on ( string number, point number ),
+ * which is stable and linear in the number of records. The digit counts for
+ * every pass are taken in one pass over the records, and a pass where every
+ * record has the same digit is skipped, so the high bytes of small numbers
+ * cost nothing. Only the order of the pointers changes, so the indexes other
+ * than the string runs are still correct afterwards.
  */
 bool Data::MakeValidState()
 {
-    iterator it;
-    set<unsigned long>::iterator it2;
-    iterator curPos;
-    set<unsigned long> * stringNos;
-    Point *s;
-    Point *copyPoint;
-    int curStringNo;
-    bool stringDone;
+    unsigned long n = data.size();
+    unsigned long i;
+    int pass, b;
 
-    for ( it = data.begin(); it != data.end(); it++ )
+    for ( i = 1; i < n; i++ )
     {
-        s = *it;
-        if ( s->pointNo < 0 || s->stringNo < 0 )    // invalid
-        {
-            // Delete(s); <-- FIX LATER
-            it--;
-        }
+        const Point *prev = data[i - 1], *cur = data[i];
+        if ( cur->stringNo < prev->stringNo ||
+             ( cur->stringNo == prev->stringNo && cur->pointNo < prev->pointNo ) )
+            break;
     }
 
-    stringNos = GetUniqueStringNumbers();
+    if ( i >= n )
+    {
+        // already in order
+        UpdateRuns();
+        return true;
+    }
 
-    curPos = data.begin();
+    std::vector<tSortRec> recs( n );
+    std::vector<tSortRec> temp( n );
+    std::vector<unsigned long> counts( cRADIX_PASSES * cRADIX_SIZE, 0 );
 
-    for ( it2 = stringNos->begin(); it2 != stringNos->end(); it2++ )
+    for ( i = 0; i < n; i++ )
     {
-        curStringNo = *it2;
-        stringDone = false;
-        for (it = curPos; it != data.end(); it++)
+        recs[i].key[0] = data[i]->pointNo;
+        recs[i].key[1] = data[i]->stringNo;
+        recs[i].p = data[i];
+
+        for ( pass = 0; pass < cRADIX_PASSES; pass++ )
+            counts[pass * cRADIX_SIZE + RadixDigit( recs[i], pass )]++;
+    }
+
+    tSortRec *from = &recs[0];
+    tSortRec *to = &temp[0];
+
+    for ( pass = 0; pass < cRADIX_PASSES; pass++ )
+    {
+        unsigned long *count = &counts[pass * cRADIX_SIZE];
+        unsigned long offset = 0;
+
+        if ( count[RadixDigit( from[0], pass )] == n ) continue;
+
+        for ( b = 0; b < cRADIX_SIZE; b++ )
         {
-            s = *it;
-            if ((s->stringNo != curStringNo && !stringDone)
-                    || (s->stringNo == curStringNo && stringDone))
-            {
-                if (!stringDone)
-                {
-                    stringDone = true;
-                    curPos = it;
-                }
-                else // move string as out of sequence
-                {
-                    copyPoint = *it;
-                    data.erase(it);
-                    it = data.insert(curPos, copyPoint);
-                    it++;
-                    curPos = it;
-                    //data.insert(curPos, *it);
-                    //it = data.erase(it);
-                    //it--;
-                }
-            }
+            unsigned long num = count[b];
+            count[b] = offset;
+            offset += num;
         }
+
+        for ( i = 0; i < n; i++ )
+            to[count[RadixDigit( from[i], pass )]++] = from[i];
+
+        std::swap( from, to );
     }
 
-    delete stringNos;
+    for ( i = 0; i < n; i++ )
+        data[i] = from[i].p;
+
+    RebuildStringRuns();
 
+    m_bHasChanged = true;
     return true;
 }
 
+void Data::IndexAdd( Point * s )
+{
+    if ( m_pIndex ) m_pIndex->Insert( s );
+    if ( m_pPlotCodes ) m_pPlotCodes->Insert( s );
+    if ( m_pStats ) m_pStats->Insert( s );
+}
+
+void Data::IndexRemove( Point * s )
+{
+    if ( m_pIndex ) m_pIndex->Remove( s );
+    if ( m_pPlotCodes ) m_pPlotCodes->Remove( s );
+    if ( m_pStats ) m_pStats->Remove( s );
+}
+
+void Data::IndexAdd( const vector & points )
+{
+    const_iterator it;
+
+    if ( m_pIndex )
+        for ( it = points.begin(); it != points.end(); it++ )
+            m_pIndex->Insert( *it );
+    if ( m_pPlotCodes ) m_pPlotCodes->Insert( points );
+    if ( m_pStats )
+        for ( it = points.begin(); it != points.end(); it++ )
+            m_pStats->Insert( *it );
+}
+
+void Data::IndexRemove( const vector & points )
+{
+    const_iterator it;
+
+    if ( m_pIndex )
+        for ( it = points.begin(); it != points.end(); it++ )
+            m_pIndex->Remove( *it );
+    if ( m_pPlotCodes ) m_pPlotCodes->Remove( points );
+    if ( m_pStats )
+        for ( it = points.begin(); it != points.end(); it++ )
+            m_pStats->Remove( *it );
+}
+
+void Data::EnableIndex( bool bEnable, int numWorkers )
+{
+    if ( bEnable )
+    {
+        if ( NULL == m_pIndex ) m_pIndex = new PointIndex();
+        m_pIndex->Build( data, numWorkers );
+    }
+    else
+    {
+        delete m_pIndex;
+        m_pIndex = NULL;
+    }
+}
+
+void Data::RebuildIndex( int numWorkers )
+{
+    if ( m_pIndex ) m_pIndex->Build( data, numWorkers );
+}
+
+/*
+ * Used to sort records by distance from a point when there is no index
+ */
+struct tDistanceLess
+{
+    double x, y;
+
+    bool operator()( const Point * a, const Point * b ) const
+    {
+        double da = ( a->x - x ) * ( a->x - x ) + ( a->y - y ) * ( a->y - y );
+        double db = ( b->x - x ) * ( b->x - x ) + ( b->y - y ) * ( b->y - y );
+        return da < db;
+    }
+};
+
+vector Data::FindNearest( double x, double y, int k )
+{
+    vector result;
+
+    if ( k <= 0 ) return result;
+
+    if ( m_pIndex )
+    {
+        if ( m_pIndex->NeedsRebuild() ) m_pIndex->Build( data );
+        m_pIndex->FindNearest( x, y, k, result );
+        return result;
+    }
+
+    tDistanceLess less;
+    less.x = x;
+    less.y = y;
+
+    result = data;
+    if ( (size_t)k < result.size() )
+    {
+        std::partial_sort( result.begin(), result.begin() + k, result.end(), less );
+        result.resize( k );
+    }
+    else
+    {
+        std::sort( result.begin(), result.end(), less );
+    }
+    return result;
+}
+
+vector Data::FindInRadius( double x, double y, double radius )
+{
+    vector result;
+    iterator it;
+
+    if ( m_pIndex )
+    {
+        m_pIndex->FindInRadius( x, y, radius, result );
+        return result;
+    }
+
+    for ( it = data.begin(); it != data.end(); it++ )
+    {
+        double dx = (*it)->x - x, dy = (*it)->y - y;
+        if ( dx * dx + dy * dy <= radius * radius )
+            result.push_back( *it );
+    }
+    return result;
+}
+
+vector Data::FindInRect( const km::RectD & rect )
+{
+    vector result;
+    iterator it;
+
+    double minX = rect.GetLeft(), maxX = rect.GetRight();
+    double minY = rect.GetBottom(), maxY = rect.GetTop();
+    if ( minX > maxX ) std::swap( minX, maxX );
+    if ( minY > maxY ) std::swap( minY, maxY );
+
+    if ( m_pIndex )
+    {
+        m_pIndex->FindInRect( minX, minY, maxX, maxY, result );
+        return result;
+    }
+
+    for ( it = data.begin(); it != data.end(); it++ )
+    {
+        if ( (*it)->x >= minX && (*it)->x <= maxX &&
+             (*it)->y >= minY && (*it)->y <= maxY )
+            result.push_back( *it );
+    }
+    return result;
+}
+
+vector Data::FindCoincident( double x, double y, double z, double tolerance )
+{
+    vector result;
+    vector candidates;
+    iterator it;
+
+    if ( m_pIndex )
+        m_pIndex->FindInRect( x - tolerance, y - tolerance, x + tolerance, y + tolerance, candidates );
+
+    vector &search = m_pIndex ? candidates : data;
+
+    for ( it = search.begin(); it != search.end(); it++ )
+    {
+        if ( fabs( (*it)->x - x ) <= tolerance &&
+             fabs( (*it)->y - y ) <= tolerance &&
+             fabs( (*it)->z - z ) <= tolerance )
+            result.push_back( *it );
+    }
+    return result;
+}
+
 } // namespace stringfile
 } // namespace keays
\ No newline at end of file
@@ -0,0 +1,109 @@
+/*
+ * Filename: EditBatch.cpp
+ * Date: October 2026
+ *
+ */
+
+// disable annoying STL name warning
+#pragma warning (disable: 4786)
+
+/* Includes */
+#include <stdlib.h>
+
+#include <EditBatch.h>        // definition of this class
+
+#include <LeakWatcher.h>
+
+#ifdef _DO_MEMORY_DEBUG
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+/* Namespace usage */
+using namespace std;
+
+namespace keays
+{
+namespace stringfile
+{
+
+EditBatch::EditBatch()
+{
+}
+
+EditBatch::~EditBatch()
+{
+    Clear();
+}
+
+void EditBatch::Insert( unsigned long line, Point * p, bool bFixId )
+{
+    tInsert ins;
+
+    ins.line = line;
+    ins.order = m_inserts.size();
+    ins.p = p;
+    ins.bFixId = bFixId;
+
+    m_inserts.push_back( ins );
+}
+
+void EditBatch::Insert( unsigned long line, const vector & points, bool bFixId )
+{
+    const_iterator it;
+
+    m_inserts.reserve( m_inserts.size() + points.size() );
+    for ( it = points.begin(); it != points.end(); it++ )
+        Insert( line, *it, bFixId );
+}
+
+void EditBatch::Delete( unsigned long line, unsigned long count )
+{
+    tDelete del;
+
+    if ( 0 == count ) return;
+
+    del.line = line;
+    del.count = count;
+
+    m_deletes.push_back( del );
+}
+
+void EditBatch::DeleteString( unsigned int stringNo )
+{
+    m_deleteStrings.push_back( stringNo );
+}
+
+void EditBatch::Replace( unsigned long line, const Point & p )
+{
+    tReplace rep;
+
+    rep.line = line;
+    rep.order = m_replaces.size();
+    rep.value = p;
+
+    m_replaces.push_back( rep );
+}
+
+bool EditBatch::IsEmpty() const
+{
+    return m_inserts.empty() && m_deletes.empty() &&
+           m_deleteStrings.empty() && m_replaces.empty();
+}
+
+void EditBatch::Clear()
+{
+    std::vector<tInsert>::iterator it;
+
+    for ( it = m_inserts.begin(); it != m_inserts.end(); it++ )
+        free( it->p );
+
+    m_inserts.clear();
+    m_deletes.clear();
+    m_deleteStrings.clear();
+    m_replaces.clear();
+}
+
+} // namespace stringfile
+} // namespace keays
@@ -0,0 +1,212 @@
+/*
+ * Filename: MappedFile.cpp
+ * Date: October 2026
+ *
+ */
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <MappedFile.h>
+
+#include <LeakWatcher.h>
+
+#ifdef _DO_MEMORY_DEBUG
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+namespace keays
+{
+namespace stringfile
+{
+
+MappedFile::MappedFile()
+{
+    m_pData = NULL;
+    m_size = 0;
+    m_bOpen = false;
+    m_bMapped = false;
+    m_pBuffer = NULL;
+#ifdef _WIN32
+    m_hFile = INVALID_HANDLE_VALUE;
+    m_hMapping = NULL;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open( const std::string & filename )
+{
+    Close();
+
+#ifdef _WIN32
+    HANDLE hFile = CreateFileA( filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                                OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+    if ( INVALID_HANDLE_VALUE == hFile ) return false;
+
+    DWORD sizeHigh = 0;
+    DWORD sizeLow = GetFileSize( hFile, &sizeHigh );
+    if ( sizeHigh != 0 && sizeof(size_t) <= 4 )
+    {
+        // too big to address in a 32 bit process
+        CloseHandle( hFile );
+        return false;
+    }
+    m_size = (size_t)sizeLow;
+#ifdef _WIN64
+    m_size |= ((size_t)sizeHigh) << 32;
+#endif
+
+    if ( 0 == m_size )
+    {
+        CloseHandle( hFile );
+        m_bOpen = true;
+        return true;
+    }
+
+    HANDLE hMapping = CreateFileMappingA( hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+    if ( NULL != hMapping )
+    {
+        m_pData = (const char *)MapViewOfFile( hMapping, FILE_MAP_READ, 0, 0, 0 );
+        if ( NULL != m_pData )
+        {
+            m_hFile = hFile;
+            m_hMapping = hMapping;
+            m_bMapped = true;
+            m_bOpen = true;
+            return true;
+        }
+        CloseHandle( hMapping );
+    }
+    CloseHandle( hFile );
+#else
+    int fd = open( filename.c_str(), O_RDONLY );
+    if ( fd < 0 ) return false;
+
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 )
+    {
+        close( fd );
+        return false;
+    }
+    m_size = (size_t)st.st_size;
+
+    if ( 0 == m_size )
+    {
+        close( fd );
+        m_bOpen = true;
+        return true;
+    }
+
+    void *p = mmap( NULL, m_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );    // the mapping holds its own reference to the file
+    if ( MAP_FAILED != p )
+    {
+#ifdef MADV_SEQUENTIAL
+        madvise( p, m_size, MADV_SEQUENTIAL );
+#endif
+        m_pData = (const char *)p;
+        m_bMapped = true;
+        m_bOpen = true;
+        return true;
+    }
+#endif
+
+    // couldn't map it (address space, network share etc), so copy it instead
+    m_size = 0;
+    return ReadBlocks( filename );
+}
+
+bool MappedFile::ReadBlocks( const std::string & filename )
+{
+    FILE *fp = fopen( filename.c_str(), "rb" );
+    if ( NULL == fp ) return false;
+
+    size_t capacity = cMAPPED_FILE_BLOCK_SIZE;
+    size_t used = 0;
+    size_t got;
+
+    m_pBuffer = (char *)malloc( capacity );
+    if ( NULL == m_pBuffer )
+    {
+        fclose( fp );
+        return false;
+    }
+
+    while ( ( got = fread( m_pBuffer + used, 1, capacity - used, fp ) ) > 0 )
+    {
+        used += got;
+        if ( used == capacity )
+        {
+            char *pGrown = (char *)realloc( m_pBuffer, capacity * 2 );
+            if ( NULL == pGrown )
+            {
+                fclose( fp );
+                free( m_pBuffer );
+                m_pBuffer = NULL;
+                return false;
+            }
+            m_pBuffer = pGrown;
+            capacity *= 2;
+        }
+    }
+
+    bool bOk = ( 0 == ferror( fp ) );
+    fclose( fp );
+
+    if ( !bOk )
+    {
+        free( m_pBuffer );
+        m_pBuffer = NULL;
+        return false;
+    }
+
+    m_pData = m_pBuffer;
+    m_size = used;
+    m_bOpen = true;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if ( m_bMapped )
+    {
+#ifdef _WIN32
+        UnmapViewOfFile( (LPCVOID)m_pData );
+        CloseHandle( (HANDLE)m_hMapping );
+        CloseHandle( (HANDLE)m_hFile );
+        m_hMapping = NULL;
+        m_hFile = INVALID_HANDLE_VALUE;
+#else
+        munmap( (void *)m_pData, m_size );
+#endif
+    }
+
+    if ( NULL != m_pBuffer )
+        free( m_pBuffer );
+
+    m_pData = NULL;
+    m_pBuffer = NULL;
+    m_size = 0;
+    m_bOpen = false;
+    m_bMapped = false;
+}
+
+} // namespace stringfile
+} // namespace keays
@@ -0,0 +1,299 @@
+/*
+ * Filename: PlotCodeIndex.cpp
+ * Date: October 2026
+ *
+ */
+
+// disable annoying STL name warning
+#pragma warning (disable: 4786)
+
+/* Includes */
+#include <algorithm>
+
+#include <PlotCodeIndex.h>        // definition of this class
+
+#include <LeakWatcher.h>
+
+#ifdef _DO_MEMORY_DEBUG
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+/* Namespace usage */
+using namespace std;
+
+namespace keays
+{
+namespace stringfile
+{
+
+/*
+ * Orders points by id
+ */
+struct tIdLess
+{
+    bool operator()( const Point * a, const Point * b ) const
+    {
+        return a->id < b->id;
+    }
+};
+
+/*
+ * True for the points in a list sorted by address
+ */
+struct tIsOneOf
+{
+    tIsOneOf( const vector & points ) : m_points( points ) {}
+
+    bool operator()( Point * p ) const
+    {
+        return std::binary_search( m_points.begin(), m_points.end(), p );
+    }
+
+    const vector & m_points;
+};
+
+PlotCodeIndex::PlotCodeIndex()
+{
+    m_numInUse = 0;
+}
+
+PlotCodeIndex::~PlotCodeIndex()
+{
+}
+
+tPlotKey PlotCodeIndex::MakeKey( const char code[cPLOT_CODE_LENGTH] )
+{
+    tPlotKey key = 0;
+
+    for ( int i = 0; i < cPLOT_CODE_LENGTH && code[i] != '\0'; i++ )
+        key |= (tPlotKey)(unsigned char)code[i] << ( 8 * i );
+
+    return key;
+}
+
+tPlotKey PlotCodeIndex::MakeKey( const std::string & code )
+{
+    char buffer[cPLOT_CODE_LENGTH] = { 0 };
+
+    code.copy( buffer, cPLOT_CODE_LENGTH );
+
+    return MakeKey( buffer );
+}
+
+std::string PlotCodeIndex::KeyToString( tPlotKey key )
+{
+    std::string code;
+
+    for ( int i = 0; i < cPLOT_CODE_LENGTH; i++ )
+    {
+        char c = (char)( ( key >> ( 8 * i ) ) & 0xff );
+        if ( '\0' == c ) break;
+        code += c;
+    }
+
+    return code;
+}
+
+void PlotCodeIndex::Build( const vector & points )
+{
+    const_iterator it;
+    std::vector<bool> sorted;
+    unsigned int i;
+
+    Clear();
+
+    for ( it = points.begin(); it != points.end(); it++ )
+    {
+        tPlotKey key = MakeKey( (*it)->plotCode );
+        std::map<tPlotKey, unsigned int>::iterator found = m_lookup.find( key );
+
+        if ( found == m_lookup.end() )
+        {
+            tCode code;
+            code.key = key;
+            found = m_lookup.insert( std::make_pair( key, (unsigned int)m_codes.size() ) ).first;
+            m_codes.push_back( code );
+            sorted.push_back( true );
+        }
+
+        vector &list = m_codes[found->second].points;
+        if ( !list.empty() && list.back()->id > (*it)->id ) sorted[found->second] = false;
+        list.push_back( *it );
+    }
+
+    // the ids are only out of order if the records have been edited
+    for ( i = 0; i < m_codes.size(); i++ )
+        if ( !sorted[i] )
+            std::sort( m_codes[i].points.begin(), m_codes[i].points.end(), tIdLess() );
+
+    m_numInUse = m_codes.size();
+}
+
+void PlotCodeIndex::Clear()
+{
+    m_codes.clear();
+    m_lookup.clear();
+    m_numInUse = 0;
+}
+
+void PlotCodeIndex::Insert( Point * p )
+{
+    tPlotKey key = MakeKey( p->plotCode );
+    std::map<tPlotKey, unsigned int>::iterator found = m_lookup.find( key );
+
+    if ( found == m_lookup.end() )
+    {
+        tCode code;
+        code.key = key;
+        found = m_lookup.insert( std::make_pair( key, (unsigned int)m_codes.size() ) ).first;
+        m_codes.push_back( code );
+    }
+
+    vector &list = m_codes[found->second].points;
+
+    if ( list.empty() ) m_numInUse++;
+
+    // new points get the highest id so usually go on the end
+    if ( list.empty() || list.back()->id < p->id )
+        list.push_back( p );
+    else
+        list.insert( std::lower_bound( list.begin(), list.end(), p, tIdLess() ), p );
+}
+
+bool PlotCodeIndex::Remove( Point * p )
+{
+    std::map<tPlotKey, unsigned int>::iterator found = m_lookup.find( MakeKey( p->plotCode ) );
+    iterator it;
+
+    if ( found == m_lookup.end() ) return false;
+
+    vector &list = m_codes[found->second].points;
+
+    for ( it = std::lower_bound( list.begin(), list.end(), p, tIdLess() );
+          it != list.end() && (*it)->id == p->id; it++ )
+    {
+        if ( *it == p )
+        {
+            list.erase( it );
+            if ( list.empty() ) m_numInUse--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void PlotCodeIndex::Insert( const vector & points )
+{
+    std::map<unsigned int, size_t> oldSize;        // position in m_codes to its size before
+    std::map<unsigned int, size_t>::const_iterator sizeIt;
+    const_iterator it;
+
+    for ( it = points.begin(); it != points.end(); it++ )
+    {
+        tPlotKey key = MakeKey( (*it)->plotCode );
+        std::map<tPlotKey, unsigned int>::iterator found = m_lookup.find( key );
+
+        if ( found == m_lookup.end() )
+        {
+            tCode code;
+            code.key = key;
+            found = m_lookup.insert( std::make_pair( key, (unsigned int)m_codes.size() ) ).first;
+            m_codes.push_back( code );
+        }
+
+        vector &list = m_codes[found->second].points;
+        if ( oldSize.find( found->second ) == oldSize.end() )
+            oldSize[found->second] = list.size();
+        list.push_back( *it );
+    }
+
+    // sort what went on the end of each list and merge it with what was there
+    for ( sizeIt = oldSize.begin(); sizeIt != oldSize.end(); sizeIt++ )
+    {
+        vector &list = m_codes[sizeIt->first].points;
+        iterator middle = list.begin() + sizeIt->second;
+
+        if ( 0 == sizeIt->second ) m_numInUse++;
+
+        std::sort( middle, list.end(), tIdLess() );
+        if ( middle != list.begin() && (*middle)->id < (*( middle - 1 ))->id )
+            std::inplace_merge( list.begin(), middle, list.end(), tIdLess() );
+    }
+}
+
+void PlotCodeIndex::Remove( const vector & points )
+{
+    std::map<unsigned int, vector> removed;        // position in m_codes to its points going
+    std::map<unsigned int, vector>::iterator removedIt;
+    const_iterator it;
+
+    for ( it = points.begin(); it != points.end(); it++ )
+    {
+        std::map<tPlotKey, unsigned int>::iterator found = m_lookup.find( MakeKey( (*it)->plotCode ) );
+        if ( found != m_lookup.end() ) removed[found->second].push_back( *it );
+    }
+
+    for ( removedIt = removed.begin(); removedIt != removed.end(); removedIt++ )
+    {
+        vector &list = m_codes[removedIt->first].points;
+
+        if ( list.empty() ) continue;
+
+        std::sort( removedIt->second.begin(), removedIt->second.end() );
+        list.erase( std::remove_if( list.begin(), list.end(), tIsOneOf( removedIt->second ) ), list.end() );
+        if ( list.empty() ) m_numInUse--;
+    }
+}
+
+void PlotCodeIndex::GetCodes( std::vector<std::string> & codes ) const
+{
+    std::vector<tCode>::const_iterator it;
+
+    codes.clear();
+    codes.reserve( m_numInUse );
+
+    for ( it = m_codes.begin(); it != m_codes.end(); it++ )
+        if ( !it->points.empty() )
+            codes.push_back( KeyToString( it->key ) );
+}
+
+unsigned long PlotCodeIndex::GetCount( tPlotKey key ) const
+{
+    std::map<tPlotKey, unsigned int>::const_iterator found = m_lookup.find( key );
+
+    if ( found == m_lookup.end() ) return 0;
+
+    return m_codes[found->second].points.size();
+}
+
+void PlotCodeIndex::Find( const std::vector<tPlotKey> & keys, vector & result ) const
+{
+    std::vector<tPlotKey> unique( keys );
+    std::vector<tPlotKey>::const_iterator it;
+    size_t numLists = 0;
+
+    result.clear();
+
+    // asking for a code twice shouldn't return its points twice
+    std::sort( unique.begin(), unique.end() );
+    unique.erase( std::unique( unique.begin(), unique.end() ), unique.end() );
+
+    for ( it = unique.begin(); it != unique.end(); it++ )
+    {
+        std::map<tPlotKey, unsigned int>::const_iterator found = m_lookup.find( *it );
+        if ( found == m_lookup.end() || m_codes[found->second].points.empty() ) continue;
+
+        const vector &list = m_codes[found->second].points;
+        size_t middle = result.size();
+
+        result.insert( result.end(), list.begin(), list.end() );
+        if ( numLists++ > 0 )
+            std::inplace_merge( result.begin(), result.begin() + middle, result.end(), tIdLess() );
+    }
+}
+
+} // namespace stringfile
+} // namespace keays
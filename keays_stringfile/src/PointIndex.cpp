@@ -0,0 +1,408 @@
+/*
+ * Filename: PointIndex.cpp
+ * Date: October 2026
+ *
+ */
+
+// disable annoying STL name warning
+#pragma warning (disable: 4786)
+
+/* Includes */
+#include <math.h>
+#include <algorithm>
+
+#include <PointIndex.h>        // definition of this class
+#include <WorkerThreads.h>    // keays::stringfile::RunWorkers
+
+#include <LeakWatcher.h>
+
+#ifdef _DO_MEMORY_DEBUG
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+/* Namespace usage */
+using namespace std;
+
+namespace keays
+{
+namespace stringfile
+{
+
+/* Constants */
+static const int        cINDEX_MAX_CELLS_PER_AXIS    = 1 << 15;
+static const double        cINDEX_MARGIN                = 0.125;    // fraction of the extents added to each side
+static const size_t        cINDEX_MIN_CHUNK            = 64 * 1024;
+
+/* One worker's share of a bulk build */
+struct tIndexChunk
+{
+    const vector    *points;
+    size_t            first;
+    size_t            count;
+
+    // pass 1 - extents of the chunk
+    double            minX, minY, maxX, maxY;
+
+    // pass 2 - the cell of each point, from a copy of the grid layout
+    double            gridX, gridY;
+    double            invCellSize;
+    int                numX, numY;
+    int                *cells;
+};
+
+static void ChunkExtents( void * pParam )
+{
+    tIndexChunk *chunk = (tIndexChunk *)pParam;
+    const vector &points = *chunk->points;
+
+    for ( size_t i = chunk->first; i < chunk->first + chunk->count; i++ )
+    {
+        const Point *p = points[i];
+        if ( p->x < chunk->minX ) chunk->minX = p->x;
+        if ( p->x > chunk->maxX ) chunk->maxX = p->x;
+        if ( p->y < chunk->minY ) chunk->minY = p->y;
+        if ( p->y > chunk->maxY ) chunk->maxY = p->y;
+    }
+}
+
+PointIndex::PointIndex()
+{
+    m_minX = m_minY = 0.0;
+    m_cellSize = m_invCellSize = 1.0;
+    m_numX = m_numY = 0;
+    m_numPoints = 0;
+    m_numOutside = 0;
+}
+
+PointIndex::~PointIndex()
+{
+}
+
+void PointIndex::Clear()
+{
+    m_cells.clear();
+    m_minX = m_minY = 0.0;
+    m_cellSize = m_invCellSize = 1.0;
+    m_numX = m_numY = 0;
+    m_numPoints = 0;
+    m_numOutside = 0;
+}
+
+int PointIndex::CellX( double x ) const
+{
+    double cx = floor( ( x - m_minX ) * m_invCellSize );
+    if ( cx < 0.0 ) return 0;
+    if ( cx >= m_numX ) return m_numX - 1;
+    return (int)cx;
+}
+
+int PointIndex::CellY( double y ) const
+{
+    double cy = floor( ( y - m_minY ) * m_invCellSize );
+    if ( cy < 0.0 ) return 0;
+    if ( cy >= m_numY ) return m_numY - 1;
+    return (int)cy;
+}
+
+bool PointIndex::IsInside( double x, double y ) const
+{
+    return x >= m_minX && x <= m_minX + m_numX * m_cellSize &&
+           y >= m_minY && y <= m_minY + m_numY * m_cellSize;
+}
+
+/*
+ * The cell lookups are the only real work in a build, so they are spread over
+ * the workers. Pushing the entries into their cells is then a single pass.
+ * This has to match CellX() and CellY().
+ */
+static void ChunkCells( void * pParam )
+{
+    tIndexChunk *chunk = (tIndexChunk *)pParam;
+    const vector &points = *chunk->points;
+
+    for ( size_t i = chunk->first; i < chunk->first + chunk->count; i++ )
+    {
+        double cx = floor( ( points[i]->x - chunk->gridX ) * chunk->invCellSize );
+        double cy = floor( ( points[i]->y - chunk->gridY ) * chunk->invCellSize );
+        int ix = cx < 0.0 ? 0 : ( cx >= chunk->numX ? chunk->numX - 1 : (int)cx );
+        int iy = cy < 0.0 ? 0 : ( cy >= chunk->numY ? chunk->numY - 1 : (int)cy );
+        chunk->cells[i] = iy * chunk->numX + ix;
+    }
+}
+
+void PointIndex::Build( const vector & points, int numWorkers )
+{
+    size_t n = points.size();
+    size_t i;
+    int w;
+
+    Clear();
+
+    if ( numWorkers <= 0 ) numWorkers = GetNumWorkers();
+    if ( (size_t)numWorkers > n / cINDEX_MIN_CHUNK ) numWorkers = (int)( n / cINDEX_MIN_CHUNK );
+    if ( numWorkers < 1 ) numWorkers = 1;
+
+    tIndexChunk chunks[cMAX_WORKER_THREADS];
+    void *params[cMAX_WORKER_THREADS];
+    size_t first = 0;
+
+    for ( w = 0; w < numWorkers; w++ )
+    {
+        size_t last = ( w == numWorkers - 1 ) ? n : ( n / numWorkers ) * ( w + 1 );
+        chunks[w].points = &points;
+        chunks[w].first = first;
+        chunks[w].count = last - first;
+        chunks[w].minX = chunks[w].minY = 1e300;
+        chunks[w].maxX = chunks[w].maxY = -1e300;
+        chunks[w].cells = NULL;
+        params[w] = &chunks[w];
+        first = last;
+    }
+
+    RunWorkers( ChunkExtents, params, numWorkers );
+
+    double minX = 0.0, minY = 0.0, maxX = 0.0, maxY = 0.0;
+    if ( n > 0 )
+    {
+        minX = minY = 1e300;
+        maxX = maxY = -1e300;
+        for ( w = 0; w < numWorkers; w++ )
+        {
+            if ( chunks[w].minX < minX ) minX = chunks[w].minX;
+            if ( chunks[w].minY < minY ) minY = chunks[w].minY;
+            if ( chunks[w].maxX > maxX ) maxX = chunks[w].maxX;
+            if ( chunks[w].maxY > maxY ) maxY = chunks[w].maxY;
+        }
+    }
+
+    // size the grid for a few points per cell, with a margin for later additions
+    double width = maxX - minX;
+    double height = maxY - minY;
+    double margin = ( width > height ? width : height ) * cINDEX_MARGIN;
+    if ( margin <= 0.0 ) margin = 1.0;
+    width += 2.0 * margin;
+    height += 2.0 * margin;
+
+    double numCells = (double)n / cINDEX_POINTS_PER_CELL;
+    if ( numCells < 1.0 ) numCells = 1.0;
+    m_cellSize = sqrt( width * height / numCells );
+    if ( m_cellSize * cINDEX_MAX_CELLS_PER_AXIS < width ) m_cellSize = width / cINDEX_MAX_CELLS_PER_AXIS;
+    if ( m_cellSize * cINDEX_MAX_CELLS_PER_AXIS < height ) m_cellSize = height / cINDEX_MAX_CELLS_PER_AXIS;
+
+    m_invCellSize = 1.0 / m_cellSize;
+    m_minX = minX - margin;
+    m_minY = minY - margin;
+    m_numX = (int)ceil( width * m_invCellSize );
+    m_numY = (int)ceil( height * m_invCellSize );
+    if ( m_numX < 1 ) m_numX = 1;
+    if ( m_numY < 1 ) m_numY = 1;
+
+    m_cells.resize( (size_t)m_numX * m_numY );
+
+    std::vector<int> cells( n );
+    for ( w = 0; w < numWorkers; w++ )
+    {
+        chunks[w].gridX = m_minX;
+        chunks[w].gridY = m_minY;
+        chunks[w].invCellSize = m_invCellSize;
+        chunks[w].numX = m_numX;
+        chunks[w].numY = m_numY;
+        chunks[w].cells = n ? &cells[0] : NULL;
+    }
+
+    RunWorkers( ChunkCells, params, numWorkers );
+
+    // count first so each cell is allocated once
+    std::vector<int> counts( m_cells.size(), 0 );
+    for ( i = 0; i < n; i++ ) counts[ cells[i] ]++;
+    for ( i = 0; i < m_cells.size(); i++ )
+        if ( counts[i] > 0 ) m_cells[i].reserve( counts[i] );
+
+    for ( i = 0; i < n; i++ )
+    {
+        tEntry e;
+        e.x = points[i]->x;
+        e.y = points[i]->y;
+        e.p = points[i];
+        m_cells[ cells[i] ].push_back( e );
+    }
+
+    m_numPoints = n;
+}
+
+void PointIndex::Insert( Point * p )
+{
+    if ( m_cells.empty() )
+    {
+        // never built, so build a grid around the first point
+        vector single;
+        single.push_back( p );
+        Build( single, 1 );
+        return;
+    }
+
+    tEntry e;
+    e.x = p->x;
+    e.y = p->y;
+    e.p = p;
+
+    m_cells[ CellY( e.y ) * m_numX + CellX( e.x ) ].push_back( e );
+    m_numPoints++;
+
+    if ( !IsInside( e.x, e.y ) ) m_numOutside++;
+}
+
+bool PointIndex::Remove( Point * p )
+{
+    size_t c, i;
+
+    if ( m_cells.empty() ) return false;
+
+    tCell *cell = &m_cells[ CellY( p->y ) * m_numX + CellX( p->x ) ];
+    for ( i = 0; i < cell->size(); i++ )
+        if ( (*cell)[i].p == p ) break;
+
+    // it was moved without telling us, so look everywhere
+    if ( i == cell->size() )
+    {
+        for ( c = 0; c < m_cells.size(); c++ )
+        {
+            cell = &m_cells[c];
+            for ( i = 0; i < cell->size(); i++ )
+                if ( (*cell)[i].p == p ) break;
+            if ( i < cell->size() ) break;
+        }
+        if ( c == m_cells.size() ) return false;
+    }
+
+    if ( !IsInside( (*cell)[i].x, (*cell)[i].y ) && m_numOutside > 0 ) m_numOutside--;
+
+    (*cell)[i] = cell->back();
+    cell->pop_back();
+    m_numPoints--;
+
+    return true;
+}
+
+void PointIndex::FindInRect( double minX, double minY, double maxX, double maxY,
+                             vector & result ) const
+{
+    result.clear();
+    if ( m_cells.empty() || minX > maxX || minY > maxY ) return;
+
+    int cx0 = CellX( minX ), cx1 = CellX( maxX );
+    int cy0 = CellY( minY ), cy1 = CellY( maxY );
+
+    for ( int cy = cy0; cy <= cy1; cy++ )
+    {
+        for ( int cx = cx0; cx <= cx1; cx++ )
+        {
+            const tCell &cell = m_cells[ cy * m_numX + cx ];
+            for ( size_t i = 0; i < cell.size(); i++ )
+            {
+                const tEntry &e = cell[i];
+                if ( e.x >= minX && e.x <= maxX && e.y >= minY && e.y <= maxY )
+                    result.push_back( e.p );
+            }
+        }
+    }
+}
+
+void PointIndex::FindInRadius( double x, double y, double radius, vector & result ) const
+{
+    result.clear();
+    if ( m_cells.empty() || radius < 0.0 ) return;
+
+    double r2 = radius * radius;
+    int cx0 = CellX( x - radius ), cx1 = CellX( x + radius );
+    int cy0 = CellY( y - radius ), cy1 = CellY( y + radius );
+
+    for ( int cy = cy0; cy <= cy1; cy++ )
+    {
+        for ( int cx = cx0; cx <= cx1; cx++ )
+        {
+            const tCell &cell = m_cells[ cy * m_numX + cx ];
+            for ( size_t i = 0; i < cell.size(); i++ )
+            {
+                const tEntry &e = cell[i];
+                double dx = e.x - x, dy = e.y - y;
+                if ( dx * dx + dy * dy <= r2 )
+                    result.push_back( e.p );
+            }
+        }
+    }
+}
+
+/*
+ * Search outwards from the cell nearest x, y a ring at a time. Every point in
+ * ring r+1 is at least r cells from x, y, so once the k'th best is closer
+ * than that the search is done.
+ */
+void PointIndex::FindNearest( double x, double y, int k, vector & result ) const
+{
+    typedef std::pair<double, Point *> tCandidate;
+    std::vector<tCandidate> best;    // max heap on distance squared
+
+    result.clear();
+    if ( m_cells.empty() || k <= 0 || 0 == m_numPoints ) return;
+
+    best.reserve( k + 1 );
+
+    int cx0 = CellX( x ), cy0 = CellY( y );
+    int maxRing = m_numX > m_numY ? m_numX : m_numY;
+
+    for ( int r = 0; r <= maxRing; r++ )
+    {
+        for ( int cy = cy0 - r; cy <= cy0 + r; cy++ )
+        {
+            if ( cy < 0 || cy >= m_numY ) continue;
+
+            // only the edges of the ring, the inside has already been searched
+            bool edgeRow = ( cy == cy0 - r || cy == cy0 + r );
+            int step = edgeRow ? 1 : 2 * r;
+            if ( step == 0 ) step = 1;
+
+            for ( int cx = cx0 - r; cx <= cx0 + r; cx += step )
+            {
+                if ( cx < 0 || cx >= m_numX ) continue;
+
+                const tCell &cell = m_cells[ cy * m_numX + cx ];
+                for ( size_t i = 0; i < cell.size(); i++ )
+                {
+                    const tEntry &e = cell[i];
+                    double dx = e.x - x, dy = e.y - y;
+                    double d2 = dx * dx + dy * dy;
+
+                    if ( (int)best.size() < k )
+                    {
+                        best.push_back( tCandidate( d2, e.p ) );
+                        std::push_heap( best.begin(), best.end() );
+                    }
+                    else if ( d2 < best.front().first )
+                    {
+                        std::pop_heap( best.begin(), best.end() );
+                        best.back() = tCandidate( d2, e.p );
+                        std::push_heap( best.begin(), best.end() );
+                    }
+                }
+            }
+        }
+
+        if ( (int)best.size() == k )
+        {
+            double reach = r * m_cellSize;
+            if ( reach * reach >= best.front().first ) break;
+        }
+    }
+
+    std::sort_heap( best.begin(), best.end() );
+
+    result.reserve( best.size() );
+    for ( size_t i = 0; i < best.size(); i++ )
+        result.push_back( best[i].second );
+}
+
+} // namespace stringfile
+} // namespace keays
@@ -0,0 +1,324 @@
+/*
+ * Filename: PointStats.cpp
+ * Date: October 2026
+ *
+ */
+
+// disable annoying STL name warning
+#pragma warning (disable: 4786)
+
+/* Includes */
+#include <PointStats.h>        // definition of this class
+#include <WorkerThreads.h>    // keays::stringfile::RunWorkers
+
+#include <LeakWatcher.h>
+
+#ifdef _DO_MEMORY_DEBUG
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+/* Namespace usage */
+using namespace std;
+
+namespace km = keays::math;
+
+namespace keays
+{
+namespace stringfile
+{
+
+/* Constants */
+static const size_t cSTATS_MIN_CHUNK = 64 * 1024;
+
+/* One worker's share of an extents scan */
+struct tStatsChunk
+{
+    const vector    *points;
+    size_t            first;
+    size_t            count;
+    double            minX, minY, minZ;
+    double            maxX, maxY, maxZ;
+};
+
+/*
+ * Written so the compiler can keep the six values in registers and use
+ * conditional moves rather than branches.
+ */
+static void ChunkExtents( void * pParam )
+{
+    tStatsChunk *chunk = (tStatsChunk *)pParam;
+    const vector &points = *chunk->points;
+    double minX = chunk->minX, minY = chunk->minY, minZ = chunk->minZ;
+    double maxX = chunk->maxX, maxY = chunk->maxY, maxZ = chunk->maxZ;
+    size_t last = chunk->first + chunk->count;
+
+    for ( size_t i = chunk->first; i < last; i++ )
+    {
+        const Point *p = points[i];
+        double x = p->x, y = p->y, z = p->z;
+
+        minX = x < minX ? x : minX;
+        maxX = x > maxX ? x : maxX;
+        minY = y < minY ? y : minY;
+        maxY = y > maxY ? y : maxY;
+        minZ = z < minZ ? z : minZ;
+        maxZ = z > maxZ ? z : maxZ;
+    }
+
+    chunk->minX = minX; chunk->minY = minY; chunk->minZ = minZ;
+    chunk->maxX = maxX; chunk->maxY = maxY; chunk->maxZ = maxZ;
+}
+
+void PointStats::tBounds::Reset()
+{
+    minX = minY = minZ = 1e300;
+    maxX = maxY = maxZ = -1e300;
+}
+
+void PointStats::tBounds::Include( const Point * p )
+{
+    if ( p->x < minX ) minX = p->x;
+    if ( p->x > maxX ) maxX = p->x;
+    if ( p->y < minY ) minY = p->y;
+    if ( p->y > maxY ) maxY = p->y;
+    if ( p->z < minZ ) minZ = p->z;
+    if ( p->z > maxZ ) maxZ = p->z;
+}
+
+bool PointStats::tBounds::OnEdge( const Point * p ) const
+{
+    return p->x <= minX || p->x >= maxX ||
+           p->y <= minY || p->y >= maxY ||
+           p->z <= minZ || p->z >= maxZ;
+}
+
+PointStats::PointStats()
+{
+    Clear();
+}
+
+PointStats::~PointStats()
+{
+}
+
+void PointStats::Clear()
+{
+    m_numPoints = 0;
+    m_bounds.Reset();
+    m_bDirty = false;
+    m_strings.clear();
+    m_numDirtyStrings = 0;
+}
+
+/*
+ * The overall extents are found by the workers. The string statistics need a
+ * map lookup per string rather than per point, as the points of a string are
+ * normally next to each other.
+ */
+void PointStats::Build( const vector & points, int numWorkers )
+{
+    size_t n = points.size();
+    int w;
+
+    Clear();
+    if ( 0 == n ) return;
+
+    if ( numWorkers <= 0 ) numWorkers = GetNumWorkers();
+    if ( (size_t)numWorkers > n / cSTATS_MIN_CHUNK ) numWorkers = (int)( n / cSTATS_MIN_CHUNK );
+    if ( numWorkers < 1 ) numWorkers = 1;
+
+    tStatsChunk chunks[cMAX_WORKER_THREADS];
+    void *params[cMAX_WORKER_THREADS];
+    size_t first = 0;
+
+    for ( w = 0; w < numWorkers; w++ )
+    {
+        size_t last = ( w == numWorkers - 1 ) ? n : ( n / numWorkers ) * ( w + 1 );
+        chunks[w].points = &points;
+        chunks[w].first = first;
+        chunks[w].count = last - first;
+        chunks[w].minX = chunks[w].minY = chunks[w].minZ = 1e300;
+        chunks[w].maxX = chunks[w].maxY = chunks[w].maxZ = -1e300;
+        params[w] = &chunks[w];
+        first = last;
+    }
+
+    RunWorkers( ChunkExtents, params, numWorkers );
+
+    for ( w = 0; w < numWorkers; w++ )
+    {
+        if ( chunks[w].minX < m_bounds.minX ) m_bounds.minX = chunks[w].minX;
+        if ( chunks[w].minY < m_bounds.minY ) m_bounds.minY = chunks[w].minY;
+        if ( chunks[w].minZ < m_bounds.minZ ) m_bounds.minZ = chunks[w].minZ;
+        if ( chunks[w].maxX > m_bounds.maxX ) m_bounds.maxX = chunks[w].maxX;
+        if ( chunks[w].maxY > m_bounds.maxY ) m_bounds.maxY = chunks[w].maxY;
+        if ( chunks[w].maxZ > m_bounds.maxZ ) m_bounds.maxZ = chunks[w].maxZ;
+    }
+
+    m_numPoints = n;
+
+    tString *pString = NULL;
+    unsigned int lastStringNo = 0;
+    const_iterator it;
+
+    for ( it = points.begin(); it != points.end(); it++ )
+    {
+        unsigned int stringNo = (*it)->stringNo;
+        if ( 0 == stringNo ) continue;
+
+        if ( NULL == pString || stringNo != lastStringNo )
+        {
+            tStringMap::iterator found = m_strings.find( stringNo );
+            if ( found == m_strings.end() )
+            {
+                tString empty;
+                empty.count = 0;
+                empty.bounds.Reset();
+                empty.bDirty = false;
+                found = m_strings.insert( std::make_pair( stringNo, empty ) ).first;
+            }
+            pString = &found->second;
+            lastStringNo = stringNo;
+        }
+
+        pString->count++;
+        pString->bounds.Include( *it );
+    }
+}
+
+void PointStats::Insert( const Point * p )
+{
+    m_numPoints++;
+    m_bounds.Include( p );
+
+    if ( 0 == p->stringNo ) return;
+
+    tStringMap::iterator found = m_strings.find( p->stringNo );
+    if ( found == m_strings.end() )
+    {
+        tString empty;
+        empty.count = 0;
+        empty.bounds.Reset();
+        empty.bDirty = false;
+        found = m_strings.insert( std::make_pair( p->stringNo, empty ) ).first;
+    }
+
+    found->second.count++;
+    found->second.bounds.Include( p );
+}
+
+void PointStats::Remove( const Point * p )
+{
+    if ( 0 == m_numPoints ) return;
+
+    m_numPoints--;
+    if ( !m_bDirty && m_bounds.OnEdge( p ) ) m_bDirty = true;
+
+    if ( 0 == p->stringNo ) return;
+
+    tStringMap::iterator found = m_strings.find( p->stringNo );
+    if ( found == m_strings.end() ) return;
+
+    tString &string = found->second;
+
+    if ( --string.count == 0 )
+    {
+        if ( string.bDirty ) m_numDirtyStrings--;
+        m_strings.erase( found );
+    }
+    else if ( !string.bDirty && string.bounds.OnEdge( p ) )
+    {
+        string.bDirty = true;
+        m_numDirtyStrings++;
+    }
+}
+
+unsigned long PointStats::GetStringCount( unsigned int stringNo ) const
+{
+    tStringMap::const_iterator found = m_strings.find( stringNo );
+
+    return ( found == m_strings.end() ) ? 0 : found->second.count;
+}
+
+/*
+ * Recalculate everything that is out of date in one pass over the points.
+ */
+void PointStats::Rescan( const vector & points )
+{
+    tStringMap::iterator sIt;
+    const_iterator it;
+
+    if ( m_bDirty )
+    {
+        tStatsChunk chunk;
+        chunk.points = &points;
+        chunk.first = 0;
+        chunk.count = points.size();
+        chunk.minX = chunk.minY = chunk.minZ = 1e300;
+        chunk.maxX = chunk.maxY = chunk.maxZ = -1e300;
+
+        ChunkExtents( &chunk );
+
+        m_bounds.minX = chunk.minX; m_bounds.minY = chunk.minY; m_bounds.minZ = chunk.minZ;
+        m_bounds.maxX = chunk.maxX; m_bounds.maxY = chunk.maxY; m_bounds.maxZ = chunk.maxZ;
+        m_bDirty = false;
+    }
+
+    if ( m_numDirtyStrings > 0 )
+    {
+        for ( sIt = m_strings.begin(); sIt != m_strings.end(); sIt++ )
+            if ( sIt->second.bDirty ) sIt->second.bounds.Reset();
+
+        tString *pString = NULL;
+        unsigned int lastStringNo = 0;
+
+        for ( it = points.begin(); it != points.end(); it++ )
+        {
+            unsigned int stringNo = (*it)->stringNo;
+            if ( 0 == stringNo ) continue;
+
+            if ( NULL == pString || stringNo != lastStringNo )
+            {
+                sIt = m_strings.find( stringNo );
+                pString = ( sIt == m_strings.end() ) ? NULL : &sIt->second;
+                lastStringNo = stringNo;
+                if ( NULL == pString ) continue;
+            }
+
+            if ( pString->bDirty ) pString->bounds.Include( *it );
+        }
+
+        for ( sIt = m_strings.begin(); sIt != m_strings.end(); sIt++ )
+            sIt->second.bDirty = false;
+        m_numDirtyStrings = 0;
+    }
+}
+
+bool PointStats::GetExtents( const vector & points, km::Cube & extents )
+{
+    if ( 0 == m_numPoints ) return false;
+
+    if ( m_bDirty ) Rescan( points );
+
+    extents = km::Cube( m_bounds.minX, m_bounds.maxX, m_bounds.maxY,
+                        m_bounds.minY, m_bounds.minZ, m_bounds.maxZ );
+    return true;
+}
+
+bool PointStats::GetStringExtents( unsigned int stringNo, const vector & points,
+                                   km::Cube & extents )
+{
+    tStringMap::iterator found = m_strings.find( stringNo );
+    if ( found == m_strings.end() ) return false;
+
+    if ( found->second.bDirty ) Rescan( points );
+
+    const tBounds &b = found->second.bounds;
+    extents = km::Cube( b.minX, b.maxX, b.maxY, b.minY, b.minZ, b.maxZ );
+    return true;
+}
+
+} // namespace stringfile
+} // namespace keays
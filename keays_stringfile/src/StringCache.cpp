@@ -0,0 +1,525 @@
+/*
+ * Filename: StringCache.cpp
+ * Date: October 2026
+ *
+ */
+
+// disable annoying STL name warning
+#pragma warning (disable: 4786)
+
+/* Includes */
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <map>
+#include <vector>
+
+#include <StringCache.h>    // definition of this class
+#include <TRFile.h>            // keays::stringfile::TRFile, the text fallback
+#include <MappedFile.h>        // keays::stringfile::MappedFile
+#include <WorkerThreads.h>    // keays::stringfile::RunWorkers
+
+#include <LeakWatcher.h>
+
+#ifdef _DO_MEMORY_DEBUG
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+/* Namespace usage */
+using namespace std;
+
+namespace keays
+{
+namespace stringfile
+{
+
+#ifdef _MSC_VER
+typedef __int64                tInt64;
+typedef unsigned __int64    tUInt64;
+#define KSC_UINT64(x)        x##ui64
+#else
+typedef long long            tInt64;
+typedef unsigned long long    tUInt64;
+#define KSC_UINT64(x)        x##ULL
+#endif
+typedef unsigned int        tUInt32;
+typedef unsigned short        tUInt16;
+
+/* Constants */
+static const char *        cCACHE_EXTENSION    = ".ksc";
+static const char        cCACHE_MAGIC[8]        = { 'K', 'S', 'C', 'A', 'C', 'H', 'E', '\0' };
+static const tUInt32    cCACHE_VERSION        = 1;
+static const tUInt32    cCACHE_BYTE_ORDER    = 0x01020304;
+static const size_t        cCACHE_HASH_BYTES    = 64 * 1024;    // hashed from each end of the source
+static const size_t        cCACHE_MIN_CHUNK    = 64 * 1024;    // records per worker worth starting a thread for
+
+enum
+{
+    eCOL_X,
+    eCOL_Y,
+    eCOL_Z,
+    eCOL_STRING_NO,
+    eCOL_POINT_NO,
+    eCOL_CODES,            // the dictionary, one packed 4 char code per entry
+    eCOL_CODE_INDEX,    // per record index into the dictionary, 16 or 32 bit
+    eCOL_FLAGS,            // contourPlot, contourString, featurePlot, featureString
+    eCOL_NOTES,
+    eCOL_TEXT,            // title then company
+    eCOL_COUNT
+};
+
+/*
+ * The start of every snapshot. All offsets are from the start of the file
+ * and are multiples of 8, so the columns can be used in place once mapped.
+ */
+struct tCacheHeader
+{
+    char        magic[8];
+    tUInt32        version;
+    tUInt32        byteOrder;
+    tUInt32        headerSize;            // sizeof(tCacheHeader), catches different packing
+    tUInt32        codeIndexSize;        // 2 or 4 bytes
+    tUInt64        fileSize;            // total size, catches a snapshot that wasn't finished
+    tUInt64        sourceSize;
+    tInt64        sourceTime;
+    tUInt64        sourceHash;
+    tUInt32        numRecords;
+    tUInt32        numCodes;
+    tUInt32        numStrings;
+    tUInt32        maxStringNum;
+    tUInt32        titleLength;
+    tUInt32        companyLength;
+    tUInt64        offsets[eCOL_COUNT];
+};
+
+/* The state of a source file a snapshot is valid for */
+struct tSourceKey
+{
+    tUInt64        size;
+    tInt64        time;
+    tUInt64        hash;
+};
+
+static tUInt64 HashBytes( tUInt64 hash, const char * p, size_t len )
+{
+    // FNV-1a
+    for ( size_t i = 0; i < len; i++ )
+    {
+        hash ^= (unsigned char)p[i];
+        hash *= KSC_UINT64(1099511628211);
+    }
+    return hash;
+}
+
+/*
+ * Size and time come from the file system. Hashing the whole of a large file
+ * would cost as much as parsing it, so only the two ends are hashed; together
+ * with the size and time that catches copies and edits of the file.
+ */
+static bool GetSourceKey( const std::string & filename, tSourceKey & key )
+{
+#ifdef _MSC_VER
+    struct _stati64 st;
+    if ( 0 != _stati64( filename.c_str(), &st ) ) return false;
+#else
+    struct stat st;
+    if ( 0 != stat( filename.c_str(), &st ) ) return false;
+#endif
+
+    key.size = (tUInt64)st.st_size;
+    key.time = (tInt64)st.st_mtime;
+    key.hash = KSC_UINT64(14695981039346656037);
+
+    // mapping only pages in the parts that are hashed
+    MappedFile file;
+    if ( !file.Open( filename ) ) return false;
+    if ( (tUInt64)file.GetSize() != key.size ) return false;
+
+    const char *p = file.GetData();
+    size_t len = file.GetSize();
+
+    if ( len <= 2 * cCACHE_HASH_BYTES )
+    {
+        key.hash = HashBytes( key.hash, p, len );
+    }
+    else
+    {
+        key.hash = HashBytes( key.hash, p, cCACHE_HASH_BYTES );
+        key.hash = HashBytes( key.hash, p + len - cCACHE_HASH_BYTES, cCACHE_HASH_BYTES );
+    }
+
+    return true;
+}
+
+static tUInt32 PackCode( const char * code )
+{
+    tUInt32 packed;
+    memcpy( &packed, code, sizeof(packed) );
+    return packed;
+}
+
+static tUInt32 PackFlags( const Point & point )
+{
+    char flags[4];
+    flags[0] = point.contourPlot;
+    flags[1] = point.contourString;
+    flags[2] = point.featurePlot;
+    flags[3] = point.featureString;
+    return PackCode( flags );
+}
+
+/* Pointers to the columns of a mapped snapshot */
+struct tCacheColumns
+{
+    const double    *x, *y, *z;
+    const tUInt32    *stringNo, *pointNo;
+    const tUInt32    *codes;
+    const void        *codeIndex;
+    tUInt32            codeIndexSize;
+    const tUInt32    *flags;
+    const char        *notes;
+};
+
+/* One worker's share of the records */
+struct tCacheChunk
+{
+    const tCacheColumns    *cols;
+    size_t                first;
+    size_t                count;
+    vector                points;
+};
+
+static void FillChunk( void * pParam )
+{
+    tCacheChunk *chunk = (tCacheChunk *)pParam;
+    const tCacheColumns &cols = *chunk->cols;
+
+    chunk->points.reserve( chunk->count );
+
+    for ( size_t i = chunk->first; i < chunk->first + chunk->count; i++ )
+    {
+        Point *tmp = GetPoint( NULL );
+        tUInt32 code;
+
+        memset( tmp, 0, sizeof(Point) );
+        tmp->stringNo = cols.stringNo[i];
+        tmp->pointNo = cols.pointNo[i];
+        tmp->x = cols.x[i];
+        tmp->y = cols.y[i];
+        tmp->z = cols.z[i];
+
+        if ( 2 == cols.codeIndexSize ) code = cols.codes[ ((const tUInt16 *)cols.codeIndex)[i] ];
+        else code = cols.codes[ ((const tUInt32 *)cols.codeIndex)[i] ];
+        memcpy( tmp->plotCode, &code, cPLOT_CODE_LENGTH );
+
+        memcpy( tmp->notes, cols.notes + i * cNOTE_LENGTH, cNOTE_LENGTH );
+
+        const char *flags = (const char *)&cols.flags[i];
+        tmp->contourPlot = flags[0];
+        tmp->contourString = flags[1];
+        tmp->featurePlot = flags[2];
+        tmp->featureString = flags[3];
+
+        chunk->points.push_back( tmp );
+    }
+}
+
+std::string StringCache::GetCacheFilename( const std::string & sourceFilename )
+{
+    return sourceFilename + cCACHE_EXTENSION;
+}
+
+/*
+ * Map the snapshot and check it is complete, consistent and matches the
+ * source. Fills header and cols on success.
+ */
+static bool OpenCache( const std::string & sourceFilename, MappedFile & cache,
+                       tCacheHeader & header, tCacheColumns & cols )
+{
+    tSourceKey key;
+
+    if ( !GetSourceKey( sourceFilename, key ) ) return false;
+    if ( !cache.Open( StringCache::GetCacheFilename( sourceFilename ) ) ) return false;
+    if ( cache.GetSize() < sizeof(tCacheHeader) ) return false;
+
+    memcpy( &header, cache.GetData(), sizeof(tCacheHeader) );
+
+    if ( 0 != memcmp( header.magic, cCACHE_MAGIC, sizeof(cCACHE_MAGIC) ) ||
+         header.version != cCACHE_VERSION ||
+         header.byteOrder != cCACHE_BYTE_ORDER ||
+         header.headerSize != sizeof(tCacheHeader) ||
+         header.fileSize != (tUInt64)cache.GetSize() ||
+         ( header.codeIndexSize != 2 && header.codeIndexSize != 4 ) )
+    {
+        return false;
+    }
+
+    if ( header.sourceSize != key.size ||
+         header.sourceTime != key.time ||
+         header.sourceHash != key.hash )
+    {
+        return false;    // stale
+    }
+
+    // every column must lie inside the file
+    tUInt64 n = header.numRecords;
+    tUInt64 lengths[eCOL_COUNT];
+    lengths[eCOL_X] = lengths[eCOL_Y] = lengths[eCOL_Z] = n * sizeof(double);
+    lengths[eCOL_STRING_NO] = lengths[eCOL_POINT_NO] = n * sizeof(tUInt32);
+    lengths[eCOL_CODES] = (tUInt64)header.numCodes * sizeof(tUInt32);
+    lengths[eCOL_CODE_INDEX] = n * header.codeIndexSize;
+    lengths[eCOL_FLAGS] = n * sizeof(tUInt32);
+    lengths[eCOL_NOTES] = n * cNOTE_LENGTH;
+    lengths[eCOL_TEXT] = (tUInt64)header.titleLength + header.companyLength;
+
+    for ( int c = 0; c < eCOL_COUNT; c++ )
+    {
+        if ( header.offsets[c] % 8 != 0 ||
+             header.offsets[c] > header.fileSize ||
+             lengths[c] > header.fileSize - header.offsets[c] )
+        {
+            return false;
+        }
+    }
+
+    const char *base = cache.GetData();
+    cols.x = (const double *)( base + header.offsets[eCOL_X] );
+    cols.y = (const double *)( base + header.offsets[eCOL_Y] );
+    cols.z = (const double *)( base + header.offsets[eCOL_Z] );
+    cols.stringNo = (const tUInt32 *)( base + header.offsets[eCOL_STRING_NO] );
+    cols.pointNo = (const tUInt32 *)( base + header.offsets[eCOL_POINT_NO] );
+    cols.codes = (const tUInt32 *)( base + header.offsets[eCOL_CODES] );
+    cols.codeIndex = base + header.offsets[eCOL_CODE_INDEX];
+    cols.codeIndexSize = header.codeIndexSize;
+    cols.flags = (const tUInt32 *)( base + header.offsets[eCOL_FLAGS] );
+    cols.notes = base + header.offsets[eCOL_NOTES];
+
+    // a dictionary index out of range would read past the codes
+    for ( tUInt64 i = 0; i < n; i++ )
+    {
+        tUInt32 code = ( 2 == cols.codeIndexSize ) ? ((const tUInt16 *)cols.codeIndex)[i]
+                                                   : ((const tUInt32 *)cols.codeIndex)[i];
+        if ( code >= header.numCodes ) return false;
+    }
+
+    return true;
+}
+
+bool StringCache::IsCurrent( const std::string & sourceFilename )
+{
+    MappedFile        cache;
+    tCacheHeader    header;
+    tCacheColumns    cols;
+
+    return OpenCache( sourceFilename, cache, header, cols );
+}
+
+bool StringCache::Load( const std::string & sourceFilename,
+                        keays::stringfile::Data * stringData )
+{
+    MappedFile        cache;
+    tCacheHeader    header;
+    tCacheColumns    cols;
+    int                i;
+
+    if ( NULL == stringData ) return false;
+    if ( !OpenCache( sourceFilename, cache, header, cols ) ) return false;
+
+    size_t numRecords = header.numRecords;
+    int numWorkers = GetNumWorkers();
+    if ( (size_t)numWorkers > numRecords / cCACHE_MIN_CHUNK )
+        numWorkers = (int)( numRecords / cCACHE_MIN_CHUNK );
+    if ( numWorkers < 1 ) numWorkers = 1;
+
+    tCacheChunk chunks[cMAX_WORKER_THREADS];
+    void *params[cMAX_WORKER_THREADS];
+    size_t first = 0;
+
+    for ( i = 0; i < numWorkers; i++ )
+    {
+        size_t last = ( numRecords / numWorkers ) * ( i + 1 );
+        if ( i == numWorkers - 1 ) last = numRecords;
+
+        chunks[i].cols = &cols;
+        chunks[i].first = first;
+        chunks[i].count = last - first;
+        params[i] = &chunks[i];
+        first = last;
+    }
+
+    RunWorkers( FillChunk, params, numWorkers );
+
+    for ( i = 0; i < numWorkers; i++ )
+        stringData->Append( chunks[i].points );
+
+    const char *text = cache.GetData() + header.offsets[eCOL_TEXT];
+    std::string title( text, header.titleLength );
+    std::string company( text + header.titleLength, header.companyLength );
+
+    stringData->SetMaxStringNum( header.maxStringNum );
+    stringData->SetTitle( title );
+    stringData->SetCompany( company );
+    stringData->SetChanged( false );
+
+    return true;
+}
+
+/* Write len bytes, after padding the file out to offset */
+static bool WriteColumn( FILE * fp, tUInt64 & pos, tUInt64 offset, const void * p, size_t len )
+{
+    static const char zeros[8] = { 0 };
+
+    if ( offset - pos > 0 && fwrite( zeros, 1, (size_t)( offset - pos ), fp ) != offset - pos )
+        return false;
+    if ( len > 0 && fwrite( p, 1, len, fp ) != len )
+        return false;
+
+    pos = offset + len;
+    return true;
+}
+
+bool StringCache::Save( const std::string & sourceFilename,
+                        keays::stringfile::Data * stringData )
+{
+    tSourceKey        key;
+    tCacheHeader    header;
+    iterator        it;
+    size_t            i, n;
+
+    if ( NULL == stringData ) return false;
+    if ( !GetSourceKey( sourceFilename, key ) ) return false;
+
+    n = stringData->GetRecordCount();
+
+    // split the records into columns, building the plot code dictionary as we go
+    std::vector<double>        xs( n ), ys( n ), zs( n );
+    std::vector<tUInt32>    stringNos( n ), pointNos( n ), flags( n ), codeIndex( n );
+    std::vector<tUInt32>    codes;
+    std::vector<char>        notes( n * cNOTE_LENGTH + 1 );
+    std::map<tUInt32, tUInt32>    codeMap;
+
+    for ( it = stringData->begin(), i = 0; it != stringData->end(); it++, i++ )
+    {
+        const Point *s = *it;
+
+        xs[i] = s->x;
+        ys[i] = s->y;
+        zs[i] = s->z;
+        stringNos[i] = s->stringNo;
+        pointNos[i] = s->pointNo;
+        flags[i] = PackFlags( *s );
+        memcpy( &notes[i * cNOTE_LENGTH], s->notes, cNOTE_LENGTH );
+
+        tUInt32 packed = PackCode( s->plotCode );
+        std::map<tUInt32, tUInt32>::iterator found = codeMap.find( packed );
+        if ( found == codeMap.end() )
+        {
+            found = codeMap.insert( std::make_pair( packed, (tUInt32)codes.size() ) ).first;
+            codes.push_back( packed );
+        }
+        codeIndex[i] = found->second;
+    }
+
+    // most files have a handful of codes, so 16 bit indices nearly always do
+    std::vector<tUInt16> codeIndex16;
+    bool bSmallIndex = codes.size() <= 0xFFFF;
+    if ( bSmallIndex )
+    {
+        codeIndex16.resize( n );
+        for ( i = 0; i < n; i++ ) codeIndex16[i] = (tUInt16)codeIndex[i];
+    }
+
+    std::string title = stringData->GetTitle();
+    std::string company = stringData->GetCompany();
+    std::string text = title + company;
+
+    memset( &header, 0, sizeof(header) );
+    memcpy( header.magic, cCACHE_MAGIC, sizeof(cCACHE_MAGIC) );
+    header.version = cCACHE_VERSION;
+    header.byteOrder = cCACHE_BYTE_ORDER;
+    header.headerSize = sizeof(tCacheHeader);
+    header.codeIndexSize = bSmallIndex ? 2 : 4;
+    header.sourceSize = key.size;
+    header.sourceTime = key.time;
+    header.sourceHash = key.hash;
+    header.numRecords = (tUInt32)n;
+    header.numCodes = (tUInt32)codes.size();
+    header.numStrings = stringData->GetNumStrings();
+    header.maxStringNum = (tUInt32)stringData->GetMaxStringNum();
+    header.titleLength = (tUInt32)title.size();
+    header.companyLength = (tUInt32)company.size();
+
+    const void *columns[eCOL_COUNT];
+    size_t lengths[eCOL_COUNT];
+    columns[eCOL_X] = n ? &xs[0] : NULL;                    lengths[eCOL_X] = n * sizeof(double);
+    columns[eCOL_Y] = n ? &ys[0] : NULL;                    lengths[eCOL_Y] = n * sizeof(double);
+    columns[eCOL_Z] = n ? &zs[0] : NULL;                    lengths[eCOL_Z] = n * sizeof(double);
+    columns[eCOL_STRING_NO] = n ? &stringNos[0] : NULL;        lengths[eCOL_STRING_NO] = n * sizeof(tUInt32);
+    columns[eCOL_POINT_NO] = n ? &pointNos[0] : NULL;        lengths[eCOL_POINT_NO] = n * sizeof(tUInt32);
+    columns[eCOL_CODES] = codes.empty() ? NULL : &codes[0];    lengths[eCOL_CODES] = codes.size() * sizeof(tUInt32);
+    columns[eCOL_FLAGS] = n ? &flags[0] : NULL;                lengths[eCOL_FLAGS] = n * sizeof(tUInt32);
+    columns[eCOL_NOTES] = &notes[0];                        lengths[eCOL_NOTES] = n * cNOTE_LENGTH;
+    columns[eCOL_TEXT] = text.data();                        lengths[eCOL_TEXT] = text.size();
+    if ( bSmallIndex )
+    {
+        columns[eCOL_CODE_INDEX] = n ? (const void *)&codeIndex16[0] : NULL;
+        lengths[eCOL_CODE_INDEX] = n * sizeof(tUInt16);
+    }
+    else
+    {
+        columns[eCOL_CODE_INDEX] = n ? (const void *)&codeIndex[0] : NULL;
+        lengths[eCOL_CODE_INDEX] = n * sizeof(tUInt32);
+    }
+
+    // lay the columns out one after another, each starting on an 8 byte boundary
+    tUInt64 offset = sizeof(tCacheHeader);
+    int c;
+    for ( c = 0; c < eCOL_COUNT; c++ )
+    {
+        offset = ( offset + 7 ) & ~(tUInt64)7;
+        header.offsets[c] = offset;
+        offset += lengths[c];
+    }
+    header.fileSize = offset;
+
+    std::string cacheFilename = GetCacheFilename( sourceFilename );
+    FILE *fp = fopen( cacheFilename.c_str(), "wb" );
+    if ( NULL == fp ) return false;
+
+    tUInt64 pos = 0;
+    bool bOk = WriteColumn( fp, pos, 0, &header, sizeof(header) );
+    for ( c = 0; c < eCOL_COUNT && bOk; c++ )
+        bOk = WriteColumn( fp, pos, header.offsets[c], columns[c], lengths[c] );
+
+    if ( 0 != fclose( fp ) ) bOk = false;
+
+    if ( !bOk )
+    {
+        remove( cacheFilename.c_str() );
+        return false;
+    }
+
+    return true;
+}
+
+bool StringCache::Read( const std::string & sourceFilename,
+                        keays::stringfile::Data * stringData,
+                        bool writeCache )
+{
+    if ( NULL == stringData ) return false;
+
+    if ( Load( sourceFilename, stringData ) ) return true;
+
+    if ( !TRFile::Read( sourceFilename, stringData, false, false ) ) return false;
+
+    if ( writeCache ) Save( sourceFilename, stringData );
+
+    return true;
+}
+
+} // namespace stringfile
+} // namespace keays
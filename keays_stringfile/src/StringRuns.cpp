@@ -0,0 +1,145 @@
+/*
+ * Filename: StringRuns.cpp
+ * Date: October 2026
+ *
+ */
+
+// disable annoying STL name warning
+#pragma warning (disable: 4786)
+
+/* Includes */
+#include <StringRuns.h>        // definition of this class
+
+#include <LeakWatcher.h>
+
+#ifdef _DO_MEMORY_DEBUG
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+/* Namespace usage */
+using namespace std;
+
+namespace keays
+{
+namespace stringfile
+{
+
+StringRuns::StringRuns()
+{
+}
+
+StringRuns::~StringRuns()
+{
+}
+
+void StringRuns::Clear()
+{
+    m_runs.clear();
+    m_chains.clear();
+}
+
+void StringRuns::AddRun( unsigned int stringNo, unsigned long offset )
+{
+    tRun run;
+    long index = (long)m_runs.size();
+
+    run.stringNo = stringNo;
+    run.offset = offset;
+    run.count = 1;
+    run.next = -1;
+    m_runs.push_back( run );
+
+    tChainMap::iterator found = m_chains.find( stringNo );
+    if ( found == m_chains.end() )
+    {
+        tChain chain;
+        chain.first = chain.last = index;
+        m_chains.insert( std::make_pair( stringNo, chain ) );
+    }
+    else
+    {
+        m_runs[found->second.last].next = index;
+        found->second.last = index;
+    }
+}
+
+void StringRuns::Build( const vector & points )
+{
+    unsigned long i;
+
+    Clear();
+
+    for ( i = 0; i < points.size(); i++ )
+        Append( points[i], i );
+}
+
+void StringRuns::Append( const Point * p, unsigned long index )
+{
+    if ( 0 == p->stringNo ) return;
+
+    if ( !m_runs.empty() )
+    {
+        tRun &last = m_runs.back();
+        if ( last.stringNo == p->stringNo && last.offset + last.count == index )
+        {
+            last.count++;
+            return;
+        }
+    }
+
+    AddRun( p->stringNo, index );
+}
+
+void StringRuns::MakeSpan( const tRun & run, vector & points, tStringSpan & span )
+{
+    span.stringNo = run.stringNo;
+    span.offset = run.offset;
+    span.count = run.count;
+    span.points = &points[run.offset];
+}
+
+bool StringRuns::GetFirst( unsigned int stringNo, vector & points, tStringSpan & span ) const
+{
+    tChainMap::const_iterator found = m_chains.find( stringNo );
+    if ( found == m_chains.end() ) return false;
+
+    MakeSpan( m_runs[found->second.first], points, span );
+    return true;
+}
+
+void StringRuns::GetAll( unsigned int stringNo, vector & points,
+                         std::vector<tStringSpan> & spans ) const
+{
+    tStringSpan span;
+
+    spans.clear();
+
+    tChainMap::const_iterator found = m_chains.find( stringNo );
+    if ( found == m_chains.end() ) return;
+
+    for ( long i = found->second.first; i >= 0; i = m_runs[i].next )
+    {
+        MakeSpan( m_runs[i], points, span );
+        spans.push_back( span );
+    }
+}
+
+void StringRuns::GetAll( vector & points, std::vector<tStringSpan> & spans ) const
+{
+    std::vector<tRun>::const_iterator it;
+    tStringSpan span;
+
+    spans.clear();
+    spans.reserve( m_runs.size() );
+
+    for ( it = m_runs.begin(); it != m_runs.end(); it++ )
+    {
+        MakeSpan( *it, points, span );
+        spans.push_back( span );
+    }
+}
+
+} // namespace stringfile
+} // namespace keays
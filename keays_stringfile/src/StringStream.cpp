@@ -0,0 +1,237 @@
+/*
+ * Filename: StringStream.cpp
+ * Date: October 2026
+ *
+ */
+
+// disable annoying STL name warning
+#pragma warning (disable: 4786)
+
+/* Includes */
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include <StringStream.h>    // definition of this class
+#include <TRFile.h>            // keays::stringfile::TRFile::ParseRecord
+
+#include <LeakWatcher.h>
+
+#ifdef _DO_MEMORY_DEBUG
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+/* Namespace usage */
+using namespace std;
+
+namespace keays
+{
+namespace stringfile
+{
+
+/* Constants */
+static const size_t cSTREAM_READ_SIZE = 1024 * 1024;
+
+eContourRole GetContourRole( const Point & point )
+{
+    if ( 0 == point.stringNo )
+        return ( cPlotPoint == point.contourPlot ) ? eCR_INCLUDED : eCR_EXCLUDED;
+
+    switch ( point.contourString )
+    {
+    case cSelectString:        return eCR_INCLUDED;
+    case cBoundaryString:    return eCR_BOUNDARY;
+    case cInternalPolygon:    return eCR_INTERNAL;
+    default:                return eCR_EXCLUDED;
+    }
+}
+
+bool IsFeature( const Point & point )
+{
+    if ( 0 == point.stringNo )
+        return cPlotPoint == point.featurePlot;
+
+    return cSelectString == point.featureString;
+}
+
+/*
+ * Collects the records into batches of single points and pieces of strings,
+ * passing them on to the sink as each fills up.
+ */
+class StreamBatcher
+{
+public:
+    StreamBatcher( StringSink & sink, size_t batchSize );
+
+    // both return false if the sink stopped the read
+    bool Add( const Point & point );
+    bool Finish();
+
+private:
+    bool FlushPoints();
+    bool FlushString( bool bLast );
+
+    StringSink            &m_sink;
+    size_t                m_batchSize;
+    std::vector<Point>    m_points;        // single points waiting to go
+    std::vector<Point>    m_string;        // the current piece of the current string
+    tStreamString        m_info;            // what is known about the current string
+};
+
+StreamBatcher::StreamBatcher( StringSink & sink, size_t batchSize )
+    : m_sink( sink )
+{
+    m_batchSize = batchSize < 2 ? 2 : batchSize;
+    m_points.reserve( m_batchSize );
+    m_string.reserve( m_batchSize );
+    memset( &m_info, 0, sizeof( m_info ) );
+}
+
+bool StreamBatcher::Add( const Point & point )
+{
+    if ( 0 == point.stringNo )
+    {
+        m_points.push_back( point );
+        return m_points.size() < m_batchSize || FlushPoints();
+    }
+
+    if ( !m_string.empty() && point.stringNo != m_info.stringNo )
+    {
+        if ( !FlushString( true ) ) return false;
+    }
+
+    if ( m_string.empty() )
+    {
+        m_info.stringNo = point.stringNo;
+        m_info.contour = GetContourRole( point );
+        m_info.feature = IsFeature( point );
+        m_info.bFirst = true;
+    }
+    else if ( m_string.size() >= m_batchSize )
+    {
+        // only pass a full piece on once the string is known to carry on
+        if ( !FlushString( false ) ) return false;
+    }
+
+    m_string.push_back( point );
+    return true;
+}
+
+bool StreamBatcher::Finish()
+{
+    return FlushString( true ) && FlushPoints();
+}
+
+bool StreamBatcher::FlushPoints()
+{
+    if ( m_points.empty() ) return true;
+
+    bool bContinue = m_sink.OnPoints( &m_points[0], m_points.size() );
+    m_points.clear();
+
+    return bContinue;
+}
+
+bool StreamBatcher::FlushString( bool bLast )
+{
+    if ( m_string.empty() ) return true;
+
+    m_info.points = &m_string[0];
+    m_info.count = m_string.size();
+    m_info.bLast = bLast;
+
+    bool bContinue = m_sink.OnString( m_info );
+
+    if ( bLast )
+    {
+        m_string.clear();
+    }
+    else
+    {
+        // the next piece carries on from the last point of this one
+        Point last = m_string.back();
+        m_string.clear();
+        m_string.push_back( last );
+        m_info.bFirst = false;
+    }
+
+    return bContinue;
+}
+
+bool StringStream::Read( const std::string & filename, StringSink & sink,
+                         size_t batchSize )
+{
+    FILE *pFile = fopen( filename.c_str(), "rb" );
+    if ( NULL == pFile ) return false;
+
+    std::vector<char> buffer( cSTREAM_READ_SIZE );
+    StreamBatcher batcher( sink, batchSize );
+    Point point;
+    size_t used = 0;
+    bool bHeader = true;        // the first line is the header
+    bool bSkipping = false;        // in the rest of a line too long for the buffer
+    bool bContinue = true;
+    bool bEof = false;
+
+    while ( bContinue && !bEof )
+    {
+        size_t wanted = buffer.size() - used;
+        size_t got = fread( &buffer[used], 1, wanted, pFile );
+        used += got;
+        bEof = got < wanted;
+
+        const char *pStart = &buffer[0];
+        const char *p = pStart;
+        const char *pEnd = pStart + used;
+
+        while ( bContinue && p < pEnd )
+        {
+            const char *pEol = (const char *)memchr( p, '\n', pEnd - p );
+            const char *pNext;
+            bool bPartial = false;
+
+            if ( NULL == pEol )
+            {
+                // keep a partial line for the next read, unless it fills the buffer
+                if ( !bEof && p != pStart ) break;
+                pEol = pEnd;
+                pNext = pEnd;
+                bPartial = !bEof;
+            }
+            else
+            {
+                pNext = pEol + 1;
+            }
+
+            int lineLen = (int)( pEol - p );
+            if ( lineLen > 0 && p[lineLen - 1] == '\r' ) lineLen--;
+
+            if ( !bHeader && !bSkipping && lineLen > 0 )
+            {
+                TRFile::ParseRecord( p, lineLen, point );
+                bContinue = batcher.Add( point );
+            }
+
+            // the rest of a line longer than the buffer is ignored
+            bHeader = false;
+            bSkipping = bPartial;
+
+            p = pNext;
+        }
+
+        used = pEnd - p;
+        if ( used > 0 ) memmove( &buffer[0], p, used );
+    }
+
+    bool bOk = !ferror( pFile );
+    fclose( pFile );
+
+    if ( bContinue ) bContinue = batcher.Finish();
+
+    return bOk && bContinue;
+}
+
+} // namespace stringfile
+} // namespace keays
@@ -1,4 +1,627 @@
 /*
- * Someone who cares about a none wxTRFile loader can implement one here!
+ * Filename: TRFile.cpp
+ * Date: October 2026
  *
- */
\ No newline at end of file
+ */
+
+// disable annoying STL name warning
+#pragma warning (disable: 4786)
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <TRFile.h>            // definition of this class
+#include <MappedFile.h>        // keays::stringfile::MappedFile
+#include <WorkerThreads.h>    // keays::stringfile::RunWorkers
+
+#include <LeakWatcher.h>
+
+#ifdef _DO_MEMORY_DEBUG
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+/* Namespace usage */
+using namespace std;
+
+namespace keays
+{
+namespace stringfile
+{
+
+/* Constants */
+static const char *    cTRFILE_KEAYS_ID        = "KEAYS";
+static const char *    cTRFILE_VERSION_2_2        = "Version 2.2 and over";
+static const char *    cTRFILE_HEADER_APP        = "TRFile Reader/Writer";
+static const char *    cTRFILE_EOL                = "\r\n";
+
+static const size_t    cTRFILE_MIN_CHUNK        = 1024 * 1024;    // don't bother with threads for less than this per worker
+static const size_t    cTRFILE_WRITE_BUF_SIZE    = 1024 * 1024;    // per worker, per round
+static const char *    cTRFILE_TEMP_EXT        = ".tmp";
+
+#ifdef _MSC_VER
+typedef __int64        tMantissa;
+#else
+typedef long long    tMantissa;
+#endif
+
+// 10^n for n = 0..22, all exactly representable as doubles
+static const double cPOW10[] =
+{
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/*
+ * Parse a whitespace padded integer field. Behaves like strtol, stopping at the
+ * first character that isn't part of the number.
+ */
+static long ParseLong( const char * p, int len )
+{
+    const char *pEnd = p + len;
+    bool neg = false;
+    long val = 0;
+
+    while ( p < pEnd && ( *p == ' ' || *p == '\t' ) ) p++;
+    if ( p < pEnd && ( *p == '-' || *p == '+' ) )
+    {
+        neg = ( *p == '-' );
+        p++;
+    }
+    while ( p < pEnd && *p >= '0' && *p <= '9' )
+    {
+        val = val * 10 + ( *p - '0' );
+        p++;
+    }
+
+    return neg ? -val : val;
+}
+
+/*
+ * Parse a whitespace padded decimal field. The fields are never more than 13
+ * characters, so the digits always fit in a 53 bit mantissa and a single
+ * division by an exact power of ten gives the correctly rounded result (the
+ * same value strtod gives). Anything unusual, like an exponent, goes to strtod.
+ */
+static double ParseDouble( const char * p, int len )
+{
+    const char *pStart = p;
+    const char *pEnd = p + len;
+    tMantissa mantissa = 0;
+    int numDigits = 0;
+    int fracDigits = 0;
+    bool neg = false;
+
+    while ( p < pEnd && ( *p == ' ' || *p == '\t' ) ) p++;
+    if ( p < pEnd && ( *p == '-' || *p == '+' ) )
+    {
+        neg = ( *p == '-' );
+        p++;
+    }
+    while ( p < pEnd && *p >= '0' && *p <= '9' )
+    {
+        mantissa = mantissa * 10 + ( *p - '0' );
+        numDigits++;
+        p++;
+    }
+    if ( p < pEnd && *p == '.' )
+    {
+        p++;
+        while ( p < pEnd && *p >= '0' && *p <= '9' )
+        {
+            mantissa = mantissa * 10 + ( *p - '0' );
+            numDigits++;
+            fracDigits++;
+            p++;
+        }
+    }
+
+    if ( numDigits > 15 || ( p < pEnd && ( *p == 'e' || *p == 'E' ) ) )
+    {
+        char tmp[64];
+        if ( len > (int)sizeof(tmp) - 1 ) len = sizeof(tmp) - 1;
+        memcpy( tmp, pStart, len );
+        tmp[len] = '\0';
+        return strtod( tmp, NULL );
+    }
+
+    double val = (double)mantissa;
+    if ( fracDigits > 0 ) val /= cPOW10[fracDigits];
+
+    return neg ? -val : val;
+}
+
+/*
+ * Copy a text field, with strncpy semantics: the rest of dest is zeroed if the
+ * record is short.
+ */
+static void CopyText( char * dest, const char * pLine, int lineLen, int offset, int len )
+{
+    int avail = lineLen - offset;
+
+    if ( avail < 0 ) avail = 0;
+    if ( avail > len ) avail = len;
+
+    memcpy( dest, pLine + offset, avail );
+    memset( dest + avail, 0, len - avail );
+
+    // strncpy stops at a NULL, do the same for files with embedded NULLs
+    for ( int i = 0; i < avail; i++ )
+        if ( '\0' == dest[i] )
+        {
+            memset( dest + i, 0, len - i );
+            break;
+        }
+}
+
+/* Field helper - clip offset/length to the record, as wxString::Mid does */
+static int FieldLen( int lineLen, int offset, int len )
+{
+    if ( offset >= lineLen ) return 0;
+    return ( offset + len > lineLen ) ? lineLen - offset : len;
+}
+
+void TRFile::ParseRecord( const char * pLine, int lineLen, Point & point )
+{
+    memset( &point, 0, sizeof(Point) );
+
+    // the same (pretty evil) numbers as the wx loader
+    point.stringNo = (unsigned int)ParseLong( pLine, FieldLen( lineLen, 0, 6 ) );
+    if ( lineLen > 6 ) point.pointNo = (unsigned int)ParseLong( pLine + 6, FieldLen( lineLen, 6, 6 ) );
+
+    if ( lineLen > 12 ) point.x = ParseDouble( pLine + 12, FieldLen( lineLen, 12, 13 ) );
+    if ( lineLen > 25 ) point.y = ParseDouble( pLine + 25, FieldLen( lineLen, 25, 13 ) );
+    if ( lineLen > 38 ) point.z = ParseDouble( pLine + 38, FieldLen( lineLen, 38, 10 ) );
+
+    CopyText( point.plotCode, pLine, lineLen, 49, cPLOT_CODE_LENGTH );
+    CopyText( point.notes, pLine, lineLen, 54, cNOTE_LENGTH );
+
+    if ( lineLen >= 70 )
+    {
+        point.contourPlot = pLine[66];
+        point.contourString = pLine[67];
+        point.featurePlot = pLine[68];
+        point.featureString = pLine[69];
+    }
+}
+
+const char * TRFile::SkipHeader( const char * pBuffer, const char * pEnd )
+{
+    const char *p = (const char *)memchr( pBuffer, '\n', pEnd - pBuffer );
+    return ( NULL == p ) ? pEnd : p + 1;
+}
+
+/*
+ * One worker's share of the file. Each worker parses the complete records
+ * between pStart and pEnd into its own vector, the vectors are appended to the
+ * Data object in order once everyone is done.
+ */
+struct tTRChunk
+{
+    const char        *pStart;
+    const char        *pEnd;
+    vector            points;
+};
+
+static void ParseChunk( void * pParam )
+{
+    tTRChunk *chunk = (tTRChunk *)pParam;
+    const char *p = chunk->pStart;
+    const char *pEnd = chunk->pEnd;
+
+    // a rough guess at the number of records saves most of the reallocation
+    chunk->points.reserve( ( pEnd - p ) / cTR_RECORD_LENGTH + 1 );
+
+    while ( p < pEnd )
+    {
+        const char *pEol = (const char *)memchr( p, '\n', pEnd - p );
+        const char *pNext;
+
+        if ( NULL == pEol )
+        {
+            pEol = pEnd;
+            pNext = pEnd;
+        }
+        else
+        {
+            pNext = pEol + 1;
+        }
+
+        int lineLen = (int)( pEol - p );
+        if ( lineLen > 0 && p[lineLen - 1] == '\r' ) lineLen--;
+
+        if ( lineLen > 0 )
+        {
+            Point *tmp = GetPoint( NULL );
+            TRFile::ParseRecord( p, lineLen, *tmp );
+            chunk->points.push_back( tmp );
+        }
+
+        p = pNext;
+    }
+}
+
+bool TRFile::ReadBuffer( const char * pBuffer, size_t length,
+                         keays::stringfile::Data * stringData, int numWorkers )
+{
+    unsigned long    maxStringNo = 0;        // maximum string number
+    int                i;
+
+    if ( NULL == stringData ) return false;
+    if ( NULL == pBuffer || 0 == length ) return true;
+
+    const char *pEnd = pBuffer + length;
+    const char *pRecords = SkipHeader( pBuffer, pEnd );
+    size_t recordBytes = pEnd - pRecords;
+
+    if ( numWorkers <= 0 ) numWorkers = GetNumWorkers();
+    if ( numWorkers > cMAX_WORKER_THREADS ) numWorkers = cMAX_WORKER_THREADS;
+    if ( (size_t)numWorkers > recordBytes / cTRFILE_MIN_CHUNK )
+        numWorkers = (int)( recordBytes / cTRFILE_MIN_CHUNK );
+    if ( numWorkers < 1 ) numWorkers = 1;
+
+    // split into roughly equal chunks, each ending just after a line end
+    tTRChunk chunks[cMAX_WORKER_THREADS];
+    void *params[cMAX_WORKER_THREADS];
+    const char *p = pRecords;
+
+    for ( i = 0; i < numWorkers; i++ )
+    {
+        const char *pSplit = pRecords + ( recordBytes / numWorkers ) * ( i + 1 );
+        if ( i == numWorkers - 1 || pSplit <= p )
+        {
+            pSplit = ( i == numWorkers - 1 ) ? pEnd : p;
+        }
+        else
+        {
+            const char *pEol = (const char *)memchr( pSplit, '\n', pEnd - pSplit );
+            pSplit = ( NULL == pEol ) ? pEnd : pEol + 1;
+        }
+
+        chunks[i].pStart = p;
+        chunks[i].pEnd = pSplit;
+        params[i] = &chunks[i];
+        p = pSplit;
+    }
+
+    RunWorkers( ParseChunk, params, numWorkers );
+
+    for ( i = 0; i < numWorkers; i++ )
+    {
+        const_iterator it;
+        for ( it = chunks[i].points.begin(); it != chunks[i].points.end(); it++ )
+            if ( (*it)->stringNo > maxStringNo ) maxStringNo = (*it)->stringNo;
+
+        stringData->Append( chunks[i].points );
+    }
+
+    stringData->SetMaxStringNum( maxStringNo );
+
+    return true;
+}
+
+bool TRFile::Read ( const std::string & filename,
+                    keays::stringfile::Data * stringData,
+                    bool progress, bool userAbort )
+{
+    MappedFile file;
+
+    userAbort = false;
+
+    if ( NULL == stringData ) return false;
+    if ( !file.Open( filename ) ) return false;
+
+    if ( !ReadBuffer( file.GetData(), file.GetSize(), stringData ) )
+        return false;
+
+    std::string title = filename.substr( 0, cTITLE_LENGTH );
+    std::string company = "Unknown - From Transfer File";
+
+    stringData->SetTitle( title );
+    stringData->SetCompany( company );
+    stringData->SetChanged( false );
+
+    return true;
+}
+
+/*
+ * Write a number right aligned in a field of width characters with 4 decimal
+ * places. If it is too wide the decimals are truncated, as long as the whole
+ * number part still fits. Returns the number of chars written or -1.
+ */
+static int FormatNumber( char * pOut, double val, int width )
+{
+    char tmp[64];
+    int n;
+
+    // anything this big can't fit in any of the fields, and this also catches NaN
+    if ( !( fabs( val ) < 1e18 ) ) return -1;
+
+    n = sprintf( tmp, "%*.4f", width, val );
+    if ( n > width )
+    {
+        const char *pDot = strrchr( tmp, '.' );
+        if ( NULL == pDot || pDot - tmp >= width + 1 ) return -1;
+        n = width;
+    }
+
+    memcpy( pOut, tmp, n );
+    return n;
+}
+
+static int FormatInt( char * pOut, unsigned int val, int width )
+{
+    char tmp[32];
+    int n = sprintf( tmp, "%*d", width, (int)val );
+
+    if ( n > width ) return -1;
+
+    memcpy( pOut, tmp, n );
+    return n;
+}
+
+/*
+ * Copy a text field up to the first NULL, padded with spaces to width.
+ * Returns the end of the field.
+ */
+static char * CopyField( char * pOut, const char * pField, int width )
+{
+    int k;
+
+    for ( k = 0; k < width && pField[k] != '\0'; k++ )
+        pOut[k] = ( pField[k] == '\n' ) ? ' ' : pField[k];
+    for ( ; k < width; k++ )
+        pOut[k] = ' ';
+
+    return pOut + width;
+}
+
+int TRFile::PointToString( const Point & point, char * pBuffer )
+{
+    char *p = pBuffer;
+    int n;
+
+    if ( ( n = FormatInt( p, point.stringNo, 6 ) ) < 0 ) return -1;
+    p += n;
+    if ( ( n = FormatInt( p, point.pointNo, 6 ) ) < 0 ) return -1;
+    p += n;
+    if ( ( n = FormatNumber( p, point.x, 13 ) ) < 0 ) return -1;
+    p += n;
+    if ( ( n = FormatNumber( p, point.y, 13 ) ) < 0 ) return -1;
+    p += n;
+    if ( ( n = FormatNumber( p, point.z, 10 ) ) < 0 ) return -1;
+    p += n;
+
+    // the same as " %-4.4s %-12.12s%c%c%c%c\r\n" but without the cost of
+    // sprintf. Newlines are stripped out, otherwise they will break the file
+    *p++ = ' ';
+    p = CopyField( p, point.plotCode, cPLOT_CODE_LENGTH );
+    *p++ = ' ';
+    p = CopyField( p, point.notes, cNOTE_LENGTH );
+    *p++ = point.contourPlot;
+    *p++ = point.contourString;
+    *p++ = point.featurePlot;
+    *p++ = point.featureString;
+    *p++ = '\r';
+    *p++ = '\n';
+
+    return (int)( p - pBuffer );
+}
+
+/*
+ * One job in a round of saving. A format job turns a slice of the records
+ * into text in its own buffer. The write job writes out the buffers filled in
+ * the round before, so the disk is kept busy while the next round is formatted.
+ */
+struct tTRSaveJob
+{
+    bool            bWrite;
+    bool            bOk;
+
+    // format jobs
+    const vector    *points;
+    size_t            first;
+    size_t            count;
+    char            *pBuf;
+    size_t            used;
+
+    // the write job
+    FILE            *fp;
+    tTRSaveJob        *pFormatted;
+    int                numFormatted;
+};
+
+static void SaveJob( void * pParam )
+{
+    tTRSaveJob *job = (tTRSaveJob *)pParam;
+    size_t i;
+
+    if ( job->bWrite )
+    {
+        for ( int j = 0; j < job->numFormatted && job->bOk; j++ )
+        {
+            const tTRSaveJob &f = job->pFormatted[j];
+            job->bOk = ( fwrite( f.pBuf, 1, f.used, job->fp ) == f.used );
+        }
+        return;
+    }
+
+    const vector &points = *job->points;
+    size_t last = job->first + job->count;
+
+    job->used = 0;
+    for ( i = job->first; i < last; i++ )
+    {
+        int n = TRFile::PointToString( *points[i], job->pBuf + job->used );
+        if ( n < 0 )
+        {
+            job->bOk = false;
+            return;
+        }
+        job->used += n;
+    }
+}
+
+/*
+ * Make sure everything written to fp is on the disk, not just in a cache.
+ */
+static bool CommitFile( FILE * fp )
+{
+    if ( 0 != fflush( fp ) ) return false;
+
+#ifdef _WIN32
+    return 0 == _commit( _fileno( fp ) );
+#else
+    return 0 == fsync( fileno( fp ) );
+#endif
+}
+
+/*
+ * Rename from to to, replacing to if it exists.
+ */
+static bool RenameOver( const std::string & from, const std::string & to )
+{
+#ifdef _WIN32
+    return 0 != MoveFileExA( from.c_str(), to.c_str(),
+                             MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH );
+#else
+    return 0 == rename( from.c_str(), to.c_str() );
+#endif
+}
+
+bool TRFile::Write ( const std::string & filename,
+                     keays::stringfile::Data * stringData,
+                     bool bAtomic, int numWorkers )
+{
+    FILE        *fp;
+    char        header[128];
+    size_t        used;
+    bool        bOk = true;
+    int            i, w;
+
+    if ( NULL == stringData ) return false;
+
+    const vector &points = *stringData->GetDataRef();
+    size_t n = points.size();
+    size_t perJob = cTRFILE_WRITE_BUF_SIZE / cTR_MAX_RECORD_LENGTH;
+    size_t next = 0;
+
+    // one thread is kept for the write job
+    if ( numWorkers <= 0 ) numWorkers = GetNumWorkers();
+    if ( numWorkers > cMAX_WORKER_THREADS - 1 ) numWorkers = cMAX_WORKER_THREADS - 1;
+    if ( (size_t)numWorkers > ( n + perJob - 1 ) / perJob ) numWorkers = (int)( ( n + perJob - 1 ) / perJob );
+    if ( numWorkers < 1 ) numWorkers = 1;
+
+    std::string path = bAtomic ? filename + cTRFILE_TEMP_EXT : filename;
+
+    fp = fopen( path.c_str(), "wb" );
+    if ( NULL == fp ) return false;
+
+    // two sets of format jobs, one being written while the other is filled
+    tTRSaveJob jobs[2][cMAX_WORKER_THREADS];
+    tTRSaveJob writeJob;
+    void *params[cMAX_WORKER_THREADS];
+
+    for ( i = 0; i < 2; i++ )
+    {
+        for ( w = 0; w < numWorkers; w++ )
+        {
+            jobs[i][w].bWrite = false;
+            jobs[i][w].points = &points;
+            jobs[i][w].pBuf = (char *)malloc( cTRFILE_WRITE_BUF_SIZE );
+            if ( NULL == jobs[i][w].pBuf ) bOk = false;
+        }
+    }
+
+    writeJob.bWrite = true;
+    writeJob.bOk = true;
+    writeJob.fp = fp;
+    writeJob.numFormatted = 0;
+
+    // First write out the header line
+    used = sprintf( header, "%s\t%s\t%s%s", cTRFILE_KEAYS_ID, cTRFILE_VERSION_2_2,
+                    cTRFILE_HEADER_APP, cTRFILE_EOL );
+    if ( bOk ) bOk = ( fwrite( header, 1, used, fp ) == used );
+
+    for ( int cur = 0; bOk && ( next < n || writeJob.numFormatted > 0 ); cur = 1 - cur )
+    {
+        int numJobs = 0;
+
+        for ( w = 0; w < numWorkers && next < n; w++ )
+        {
+            tTRSaveJob &job = jobs[cur][w];
+
+            job.bOk = true;
+            job.first = next;
+            job.count = ( n - next < perJob ) ? n - next : perJob;
+            next += job.count;
+            params[numJobs++] = &job;
+        }
+
+        int numFormatted = numJobs;
+
+        // the write job goes last so it runs on this thread
+        if ( writeJob.numFormatted > 0 )
+        {
+            writeJob.pFormatted = jobs[1 - cur];
+            params[numJobs++] = &writeJob;
+        }
+
+        RunWorkers( SaveJob, params, numJobs );
+
+        for ( i = 0; i < numFormatted; i++ )
+            if ( !jobs[cur][i].bOk ) bOk = false;
+        if ( !writeJob.bOk ) bOk = false;
+
+        writeJob.numFormatted = numFormatted;
+    }
+
+    for ( i = 0; i < 2; i++ )
+        for ( w = 0; w < numWorkers; w++ )
+            free( jobs[i][w].pBuf );
+
+    if ( bOk && bAtomic ) bOk = CommitFile( fp );
+    if ( 0 != fclose( fp ) ) bOk = false;
+    if ( bOk && bAtomic ) bOk = RenameOver( path, filename );
+
+    if ( !bOk )
+    {
+        remove( path.c_str() );
+        return false;
+    }
+
+    stringData->SetChanged( false );
+
+    return true;
+}
+
+bool TRFile::Save ( const std::string & filename,
+                    keays::stringfile::Data * stringData,
+                    bool progress, bool userAbort )
+{
+    userAbort = false;
+
+    return Write( filename, stringData );
+}
+
+bool TRFile::CanLoadExt( const std::string & extension )
+{
+    if ( extension.substr( 0, 2 ) == "tr" ) return true;
+    else if ( extension.substr( 0, 2 ) == "tm" ) return true;
+
+    return false;
+}
+
+} // namespace stringfile
+} // namespace keays
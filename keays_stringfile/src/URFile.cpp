@@ -38,8 +38,6 @@ bool URFile::Read ( bool progress )
     char real_buf [REC_LENGTH];
     char tmpBuf[20];
     void *buffer = &real_buf;
-    int    lastStringNo = -1;
-    int numStrings = 0;
     int numRecs;
     FILE *            file;        // file pointer
 
@@ -96,11 +94,6 @@ bool URFile::Read ( bool progress )
         memcpy((void *)(tmp->notes), &( ((char *)buffer)[36]), NOTE_LEN);
 
         if ( tmp != NULL ) {
-            if (tmp->stringNo != lastStringNo && tmp->stringNo != 0)
-            {
-                numStrings++;
-                lastStringNo = tmp->stringNo;
-            }
             m_StringData->Append(tmp);
         } else {
 
@@ -108,7 +101,6 @@ bool URFile::Read ( bool progress )
 
     }
 
-    m_StringData->SetNumStrings( numStrings );
     m_StringData->SetChanged( false );
     fclose( file );
 
@@ -0,0 +1,120 @@
+/*
+ * Filename: WorkerThreads.cpp
+ * Date: October 2026
+ *
+ */
+
+/* Includes */
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include <WorkerThreads.h>
+
+#include <LeakWatcher.h>
+
+#ifdef _DO_MEMORY_DEBUG
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+namespace keays
+{
+namespace stringfile
+{
+
+namespace
+{
+    struct tWorkerStart
+    {
+        tWorkerFunc    func;
+        void        *pParam;
+    };
+
+#ifdef _WIN32
+    DWORD WINAPI WorkerProc( LPVOID pStart )
+    {
+        tWorkerStart *s = (tWorkerStart *)pStart;
+        s->func( s->pParam );
+        return 0;
+    }
+#else
+    void * WorkerProc( void * pStart )
+    {
+        tWorkerStart *s = (tWorkerStart *)pStart;
+        s->func( s->pParam );
+        return NULL;
+    }
+#endif
+}
+
+int GetNumWorkers()
+{
+    int numCPUs;
+
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo( &info );
+    numCPUs = (int)info.dwNumberOfProcessors;
+#else
+    numCPUs = (int)sysconf( _SC_NPROCESSORS_ONLN );
+#endif
+
+    if ( numCPUs < 1 ) numCPUs = 1;
+    if ( numCPUs > cMAX_WORKER_THREADS ) numCPUs = cMAX_WORKER_THREADS;
+
+    return numCPUs;
+}
+
+void RunWorkers( tWorkerFunc func, void ** ppParams, int numParams )
+{
+    tWorkerStart    starts[cMAX_WORKER_THREADS];
+    bool            started[cMAX_WORKER_THREADS];
+#ifdef _WIN32
+    HANDLE            threads[cMAX_WORKER_THREADS];
+#else
+    pthread_t        threads[cMAX_WORKER_THREADS];
+#endif
+    int i, numThreads;
+
+    if ( numParams <= 0 ) return;
+
+    // anything past the thread limit is simply run here after the others are started
+    numThreads = numParams - 1;
+    if ( numThreads > cMAX_WORKER_THREADS ) numThreads = cMAX_WORKER_THREADS;
+
+    for ( i = 0; i < numThreads; i++ )
+    {
+        starts[i].func = func;
+        starts[i].pParam = ppParams[i];
+#ifdef _WIN32
+        DWORD id;
+        threads[i] = CreateThread( NULL, 0, WorkerProc, (LPVOID)&starts[i], 0, &id );
+        started[i] = ( NULL != threads[i] );
+#else
+        started[i] = ( 0 == pthread_create( &threads[i], NULL, WorkerProc, &starts[i] ) );
+#endif
+        if ( !started[i] ) func( ppParams[i] );
+    }
+
+    for ( i = numThreads; i < numParams; i++ )
+        func( ppParams[i] );
+
+    for ( i = 0; i < numThreads; i++ )
+    {
+        if ( !started[i] ) continue;
+#ifdef _WIN32
+        WaitForSingleObject( threads[i], INFINITE );
+        CloseHandle( threads[i] );
+#else
+        pthread_join( threads[i], NULL );
+#endif
+    }
+}
+
+} // namespace stringfile
+} // namespace keays
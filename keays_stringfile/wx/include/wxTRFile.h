@@ -44,14 +44,6 @@ public:
 
     static bool PointToString( const keays::stringfile::Point & point,
                                  wxString & result );
-private:
-
-    /*
-     * Read a line (until the next \n) from the current position in file,
-     * putting the read data in buffer, up to a maximum size of bufSize.
-     * Return the number of bytes read or -1 on failure.
-     */
-    static int ReadLine( wxFile & file, char * buffer, int bufSize );
 };
 
 } // namespace wx
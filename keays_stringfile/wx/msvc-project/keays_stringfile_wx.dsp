@@ -139,6 +139,46 @@ SOURCE=..\..\src\Data.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\src\EditBatch.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\MappedFile.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\PlotCodeIndex.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\PointIndex.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\PointStats.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\StringCache.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\StringRuns.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\StringStream.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\TRFile.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\WorkerThreads.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\wxBSPFile.cpp
 # End Source File
 # Begin Source File
@@ -159,6 +199,10 @@ SOURCE=..\..\include\Data.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\include\EditBatch.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\include\File.h
 # End Source File
 # Begin Source File
@@ -167,6 +211,42 @@ SOURCE=..\..\include\keays_stringfile.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\include\MappedFile.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\include\PlotCodeIndex.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\include\PointIndex.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\include\PointStats.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\include\StringCache.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\include\StringRuns.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\include\StringStream.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\include\TRFile.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\include\WorkerThreads.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\include\wxBSPFile.h
 # End Source File
 # Begin Source File
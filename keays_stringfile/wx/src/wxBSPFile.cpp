@@ -40,7 +40,6 @@ bool BSPFile::Read ( const std::string & filename,
     unsigned long    maxStringNo = 0;                // maximum string number
     unsigned long    lastStringNo = 0;                // last string number seen
     unsigned long    lastPointNo = 0;                // last point number seen
-    unsigned long    numStrings = 0;                    // total number of strings
     wxFile            file;                            // file object
     int                i = 0;                            // counter
 
@@ -188,7 +187,6 @@ bool BSPFile::Read ( const std::string & filename,
 
     // Fix up meta data for string file
     stringData->SetMaxStringNum( lastStringNo );
-    stringData->SetNumStrings( lastStringNo );
 
     stringData->SetTitle( std::string(filename.c_str()).substr( 0, cTITLE_LENGTH ) );
     stringData->SetCompany( std::string("Unknown - From BSP File") );
@@ -10,9 +10,12 @@
 #include <wx/msgdlg.h>        // wxMessageBox
 #include <wx/intl.h>        // text internationalization _("")
 #include <wx/log.h>            // wxLog
+#include <wx/utils.h>        // wxBusyCursor
 
 /* My Includes */
 #include <wxTRFile.h>        // definition of this class
+#include <TRFile.h>            // keays::stringfile::TRFile, the toolkit independent parser
+#include <MappedFile.h>        // keays::stringfile::MappedFile
 
 #include <LeakWatcher.h>
 
@@ -37,53 +40,17 @@ const char * cTRFILE_KEAYS_ID        = "KEAYS";
 const char * cTRFILE_VERSION_2_2    = "Version 2.2 and over";
 const char * cTRFILE_HEADER_APP        = "wxTRFile Reader/Writer";
 const char * cTRFILE_EOL            = "\r\n";
-const int     cTRFILE_BUF_SIZE        = 1000;
-
-/*
- * The implementation of this function is rather inefficient. Therefore
- * it should not be called on a regular basis (i.e inside a loop).
- */
-int TRFile::ReadLine( wxFile & file, char * buffer, int bufSize )
-{
-    char c = '0';
-    int curIndex = 0;
-
-    memset( buffer, 0, bufSize );
-    while ( curIndex < bufSize && c != '\n' )
-    {
-        if ( wxInvalidOffset == file.Read( &c, 1 ) )
-        {
-            memset( buffer, 0, bufSize );
-            return -1;
-        }
-
-        buffer[curIndex] = c;
-        curIndex++;
-    }
-
-    return curIndex;
-}
 
 bool TRFile::Read ( const std::string & filename,
                     keays::stringfile::Data * stringData,
                     bool progress, bool userAbort )
 {
-    unsigned long    maxStringNo = 0;                // maximum string number
-    unsigned long    lastStringNo = 0;                // last string number seen
-    unsigned long    numStrings = 0;                    // total number of strings
-    wxFile            file;                            // file object
-    int                i = 0,                            // counter
-                    readSize = 0,                    // how much of the file we have read
-                    lineLen;                        // length of current line of text
-    wxString        curLine,                        // current line
-                    curChunk;                        // current part of line
-    char            recBuffer[cTRFILE_BUF_SIZE];    // tempory char buffer
+    MappedFile        file;                            // whole file in memory
 
     userAbort = false;
 
     // Check that we can open and read the file. Fail if we can't.
-    file.Open ( filename.c_str(), wxFile::read );
-    if ( !file.IsOpened() )
+    if ( !file.Open( filename ) )
     {
         ::wxMessageBox( _("Unable to open the selected file for reading. Please check that "
                           "it not in use "
@@ -92,120 +59,17 @@ bool TRFile::Read ( const std::string & filename,
         return false;
     }
 
-    lineLen = ReadLine( file, (char *)&recBuffer, cTRFILE_BUF_SIZE );
-    curLine = recBuffer;
-
-    // Check version
     /*
-     * At Johns request I have removed this check. If you attempt to open
-     * _anything_ that is renamed tr the code will probably happily proceed
-     * to crash..
+     * The version check was removed at Johns request. If you attempt to open
+     * _anything_ that is renamed tr the code will happily load garbage.
+     *
+     * Parsing is done by the toolkit independent loader, which splits the file
+     * over all the processors. It is fast enough that there is no progress
+     * dialog any more.
      */
-#if 0
-    if ( -1 == curLine.Find( cTRFILE_VERSION_2_2 ) )
-    {
-        if ( ::wxMessageBox( _("This does not appear to be a valid Keays Transfer (TR) text file.\n"
-                          "Click on Yes to continue loading, at the risk of causing program \n"
-                          "instability, or click No to abort loading the file." ),
-                          _("Not A Valid Text Transfer File"), wxYES_NO ) == wxNO )
-        {
-            return false;
-        }
-    }
-#endif
-
-    // Show progress dialog
-    wxProgressDialog pDlg ("Loading String Text File...", "Loading String Text File", file.Length(),
-                            NULL, wxPD_AUTO_HIDE | wxPD_APP_MODAL | wxPD_CAN_ABORT);
-    pDlg.SetSize(cPROGRESS_DIALOG_WIDTH, cPROGRESS_DIALOG_HEIGHT);
-
-    int tmpSize;
-    // Loop until the end of the file, reading in the data
-    while ( !file.Eof() )
-    {
-        /* Adaptive read length algorithm -
-         *
-         * Assume that the inital lineLen is correct. After each read check that
-         * the character is \n. If not then rewind the file & do a scan of the
-         * line. Set the line length to be the correct value.
-         */
-        tmpSize = file.Read( (char *)&recBuffer, lineLen );
-        curLine = recBuffer;
-
-        if ( curLine.Length() == 0 ) continue;                // sanity check
-
-        if ( curLine.GetChar( curLine.Length() - 1 ) != '\n' )
-        {
-            file.Seek( -1 * lineLen, wxFromCurrent );
-            lineLen = ReadLine( file, (char *)&recBuffer, cTRFILE_BUF_SIZE );
-            curLine = recBuffer;
-            wxLogMessage("WARNING: wxTRFile::Read() - Length of record has changed");
-            tmpSize = lineLen;
-        }
-
-        readSize += tmpSize;
-
-        Point *tmp = GetPoint( NULL );
-
-        if ( tmp != NULL )
-        {
-        } else {
-            ::wxMessageBox ( _("The file cannot be loaded as the system cannot allocate anymore\n"
-                                "memory. The program will now terminate"), _("Out Of Memory"), wxOK );
-            exit(1);
-        }
-
-        // numbers here are pretty evil
-        curChunk = curLine.Mid( 0, 6 );
-        curChunk.ToLong( (long *)(&(tmp->stringNo)) );
-        curChunk = curLine.Mid( 6, 6 );
-        curChunk.ToLong( (long *)(&(tmp->pointNo)) );
-
-        curChunk = curLine.Mid( 12, 13 );
-        curChunk.ToDouble( &(tmp->x) );
-        curChunk = curLine.Mid( 25, 13 );
-        curChunk.ToDouble( &(tmp->y) );
-        curChunk = curLine.Mid( 38, 10 );
-        curChunk.ToDouble( &(tmp->z) );
-
-        curChunk = curLine.Mid( 49, 4 );
-        strncpy( tmp->plotCode, curChunk.c_str(), 4 );
-
-        curChunk = curLine.Mid( 54, 12 );
-        strncpy( tmp->notes, curChunk.c_str(), 12 );
-
-        curChunk = curLine.Mid( 66, 4 );
-        if ( curChunk.Length() >= 4 )
-        {
-            tmp->contourPlot = curChunk[0];
-            tmp->contourString = curChunk[1];
-            tmp->featurePlot = curChunk[2];
-            tmp->featureString = curChunk[3];
-        }
-
-        if (tmp->stringNo != lastStringNo && tmp->stringNo != 0)
-        {
-            numStrings++;
-            lastStringNo = tmp->stringNo;
-        }
-        stringData->Append(tmp);
-
-        if ( tmp->stringNo > maxStringNo ) maxStringNo = tmp->stringNo;
-
-        if (pDlg.Update( readSize ) == FALSE)
-
-        {
-            userAbort = TRUE;
-            stringData->Clear();
-            file.Close();
-            return false;
-        }
-
-        i++;
-    }
-
-    stringData->SetMaxStringNum( maxStringNo );
-    stringData->SetNumStrings( numStrings );
+    wxBusyCursor wait;
+    if ( !keays::stringfile::TRFile::ReadBuffer( file.GetData(), file.GetSize(), stringData ) )
+        return false;
 
     stringData->SetTitle( std::string(filename.c_str()).substr( 0, cTITLE_LENGTH ) );
     stringData->SetCompany( std::string("Unknown - From Transfer File") );
@@ -43,9 +43,7 @@ bool URFile::Read ( const std::string & filename,
     char real_buf [cRECORD_LENGTH];
     char tmpBuf[21];
     void *buffer = &real_buf;
-    unsigned long lastStringNo = 0;
     unsigned long numRecs = 0;
-    unsigned long numStrings = 0;
     unsigned long maxStringNum = 0;
     wxFile            file;    // file object
 
@@ -129,12 +127,6 @@ bool URFile::Read ( const std::string & filename,
             exit(1);
         }
 
-        if (tmp->stringNo != lastStringNo && tmp->stringNo != 0)
-        {
-            numStrings++;
-            lastStringNo = tmp->stringNo;
-        }
-
         stringData->Append(tmp);
         if ( tmp->stringNo > maxStringNum ) maxStringNum = tmp->stringNo;
 
@@ -148,7 +140,6 @@ bool URFile::Read ( const std::string & filename,
     }
 
     stringData->SetMaxStringNum( maxStringNum );
-    stringData->SetNumStrings( numStrings );
     stringData->SetChanged( false );
     file.Close();
 
@@ -254,6 +254,23 @@ private:
     //#endregion
 };
 
+/*!
+    \brief The tie-in of one station of a run to the surface, see Triangles::TieIn().
+ */
+struct KEAYS_TRIANGLE_API TieInResult
+{    //#region
+    TieInResult();
+
+    UTPoint                    batterPoint;    //!< where the batter meets the surface, or stops at the max width
+    keays::types::VectorD2    profile;        //!< the batter as offset and height change from the start
+    double                    groundHeight;    //!< the surface height under the start point
+    int                        triangleID;        //!< the triangle under the start point, -1 if it is off the surface
+    int                        status;            //!< S_SUCCESS, E_PERP_SECTION or E_CALC_BATTER
+    //#endregion
+};
+
+typedef std::vector<TieInResult> TieInResultList;
+
 /*!
     \brief Keays Triangles class (handler for combined points and triangles records).
  */
@@ -473,6 +490,25 @@ public:
     int GenerateBatterString(const keays::types::Polyline3D &polyline,
                               keays::types::Polyline3D *pResult, const CBatterFlags &flags) const;
 
+    /*!
+        \brief Tie a run of stations, such as the outside bottom of a kerb, into the surface.
+        Each station is sectioned out to the max width in its direction and the batter point
+        found with CalcBatterPoint().  The stations are split between threads in runs, each run
+        starting the search for a station from the triangle found for the one before it.  The
+        side in the flags is not used, the directions give it.
+
+        \param     starts [In]  - the points the batters start from.
+        \param directions [In]  - the horizontal direction to batter in from each start, need not be unit length.
+        \param      flags [In]  - the max width and the cut and fill grades.
+        \param   pResults [Out] - receives one TieInResult per station.
+        \param numThreads [In]  - the number of threads to use, 0 for one per processor.
+
+        \return S_SUCCESS if every station was tied in, E_FAILED if some were not (see their
+                status), or the reason nothing could be done.
+     */
+    int TieIn(const keays::types::Polyline3D &starts, const keays::types::Polyline3D &directions,
+               const CBatterFlags &flags, TieInResultList *pResults, const int numThreads = 0) const;
+
     // modify an individual triangle
     void Activate(const unsigned long triangleID)
     {
@@ -552,6 +588,32 @@ private:
                                           UTPoint *pFaceNormals,
                                           std::set<int> *pVisitedTris);
 
+    /*
+        Walk from the startSeed triangle to the one containing pPoint, without touching the
+        shared seed, so that any number of threads may do it at once.
+     */
+    bool LocateFrom(const UTPoint *pPoint, int &triIndex, const int startSeed) const;
+
+    /*
+        The height of pt in the located triangle triIndex, as HeightAtPoint()
+     */
+    bool HeightInTriangle(const keays::types::VectorD2 &pt, const int triIndex, double *pHeight, bool allowInactive) const;
+
+    /*
+        Section() with the start located from *pSeed, which receives the start triangle, rather
+        than the shared seed.  pSeed may be NULL to use the shared seed.
+     */
+    const CutSectionList *SectionFrom(const UTPoint &pt0, const UTPoint &pt1,
+                                       CutSectionList *pCutList, double *pStartDistance,
+                                       bool genEndPoint, bool breaklinesOnly, int *pSeed) const;
+
+    /*
+        Tie in stations [first, last) for TieIn(), carrying the located triangle along
+     */
+    void TieInStations(const keays::types::Polyline3D &starts, const keays::types::Polyline3D &directions,
+                        const CBatterFlags &flags, TieInResult *pResults, size_t first, size_t last) const;
+    static DWORD WINAPI TieInThread(LPVOID pParam);
+
     // --- member variables ---
     unsigned int m_NumberTriangles;
     unsigned int m_NumberVisibleTriangles;
@@ -10,6 +10,7 @@
 #include <set>        //std::set
 
 #include <keays_types.h>    // keays::types
+#include <keays_float.h>    // inline Float comparisons
 #include <keays_math.h>        // keays::math
 #ifdef _DEBUG
 //#include <string>
@@ -66,7 +67,8 @@ void WriteDebugLog(LPCTSTR fmt, ...)
     if (!(*g_pLogFile))
         return;
 
-    static TCHAR buf[1024];
+    // local, as the tie in workers log from several threads at once
+    TCHAR buf[1024];
     buf[1023] = 0;
     va_list argsList;
     va_start(argsList, fmt);
@@ -720,6 +722,28 @@ AreaP(const UTPoint *ap, const UTPoint *bp, const UTPoint *cp)
 }
 
 bool Triangles::Locate(const UTPoint *pPoint, int &seedTriangleIndex, bool allowInactive /*= false*/, const int startSeed /*= -1*/) const
+{
+    TriangleID t;
+    if (!LocateFrom(pPoint, t, startSeed))
+    {
+        seedTriangleIndex = -1;
+        return false;
+    }
+
+    seedTriangleIndex = m_seedTriangleIndex = t;
+    // check visibility
+    if (!allowInactive)
+    {
+        if (!((m_pTriangles[m_seedTriangleIndex]).tflags & eUT_TF_ACTIVE))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Triangles::LocateFrom(const UTPoint *pPoint, int &triIndex, const int startSeed) const
 {
     UTTriangle    *triangles    = m_pTriangles;
     UTPoint        *points        = m_pPoints;
@@ -740,45 +764,45 @@ bool Triangles::Locate(const UTPoint *pPoint, int &seedTriangleIndex, bool allow
 doagain:
     sp = &points[tp->vertices[i]];
     // scan anti-clockwise
-    while (Float::Less(AreaP(pPoint, &points[tp->vertices[(i+2) % 3]], sp), 0.0, 0.00001))
+    while (Float::Fast::Less(AreaP(pPoint, &points[tp->vertices[(i+2) % 3]], sp), 0.0, 0.00001))
     {
         i = (i+1) % 3;
         t = tp->links[i];
         if (t < 0)
         {
-            seedTriangleIndex = -1;
+            triIndex = -1;
             return false;
         }
         i = (tp->back[i]+1) % 3;
         tp = &triangles[t];
     }
     // scan clockwise
-    while (Float::Less(AreaP(pPoint, sp, &points[tp->vertices[(i+1) % 3]]), 0.0, 0.00001))
+    while (Float::Fast::Less(AreaP(pPoint, sp, &points[tp->vertices[(i+1) % 3]]), 0.0, 0.00001))
     {
         i = (i+2) % 3;
         t = tp->links[i];
         if (t < 0)
         {
-            seedTriangleIndex = -1;
+            triIndex = -1;
             return false;
         }
         i = (tp->back[i]+2) % 3;
         tp = &triangles[t];
     }
-    while (Float::Less(AreaP(pPoint, &points[tp->vertices[(i+1) % 3]], &points[tp->vertices[(i+2) % 3]]), 0.0, 0.00001))
+    while (Float::Fast::Less(AreaP(pPoint, &points[tp->vertices[(i+1) % 3]], &points[tp->vertices[(i+2) % 3]]), 0.0, 0.00001))
     {
         t = tp->links[i];
         if (t < 0)
         {
-            seedTriangleIndex = -1;
+            triIndex = -1;
             return false;
         }
         i = tp->back[i];
         tp = &triangles[t];
         a = AreaP(pPoint, &points[tp->vertices[i]], sp);
-        if (Float::EqualTo(a, 0.0, 0.00001))
+        if (Float::Fast::EqualTo(a, 0.0, 0.00001))
             goto doagain; // AAAAUGH! A GOTO! KILL IT! KILL IT! ;)
-        if (Float::Greater(a, 0.0, 0.00001))
+        if (Float::Fast::Greater(a, 0.0, 0.00001))
         {
             // point is left of line
             i = (i+1) % 3;
@@ -789,16 +813,7 @@ doagain:
         }
     }
 
-    seedTriangleIndex = m_seedTriangleIndex = t;
-    // check visibility
-    if (!allowInactive)
-    {
-        if (!((triangles[m_seedTriangleIndex]).tflags & eUT_TF_ACTIVE))
-        {
-            return false;
-        }
-    }
-
+    triIndex = t;
     return true;
 }
 
@@ -903,23 +918,7 @@ bool Triangles::HeightAtPoint(const keays::types::VectorD2 &pt, double *pHeight,
             if (pTriIndex)
                 *pTriIndex = seed;
 
-            if (allowInactive && !(m_pTriangles[seed].tflags & eUT_TF_ACTIVE))
-            {
-                *pHeight = m_extents.GetBase();
-                return true;
-            }
-
-            const keays::types::VectorD3 &a = m_pPoints[m_pTriangles[seed].vertices[0]];
-            const keays::types::VectorD3 &b = m_pPoints[m_pTriangles[seed].vertices[1]];
-            const keays::types::VectorD3 &c = m_pPoints[m_pTriangles[seed].vertices[2]];
-
-            if (keays::math::PointHeightOnPlaneTri(a, b, c, pt, result))
-            {
-                *pHeight = result;
-                return true;
-            }
-
-            return false;
+            return HeightInTriangle(pt, seed, pHeight, allowInactive);
 
         } else
         {
@@ -931,10 +930,40 @@ bool Triangles::HeightAtPoint(const keays::types::VectorD2 &pt, double *pHeight,
     }
 }
 
+bool Triangles::HeightInTriangle(const keays::types::VectorD2 &pt, const int triIndex, double *pHeight, bool allowInactive) const
+{
+    double result = 0.0;
+
+    if (allowInactive && !(m_pTriangles[triIndex].tflags & eUT_TF_ACTIVE))
+    {
+        *pHeight = m_extents.GetBase();
+        return true;
+    }
+
+    const keays::types::VectorD3 &a = m_pPoints[m_pTriangles[triIndex].vertices[0]];
+    const keays::types::VectorD3 &b = m_pPoints[m_pTriangles[triIndex].vertices[1]];
+    const keays::types::VectorD3 &c = m_pPoints[m_pTriangles[triIndex].vertices[2]];
+
+    if (keays::math::PointHeightOnPlaneTri(a, b, c, pt, result))
+    {
+        *pHeight = result;
+        return true;
+    }
+
+    return false;
+}
+
 const CutSectionList *Triangles::Section(const UTPoint &pt0, const UTPoint &pt1,
                                           CutSectionList *pCutList, double *pStartDistance,
                                           bool genEndPoint /*= true*/, bool breaklinesOnly /*= false*/,
                                           int *pNumCutRet /*= NULL*/, int *pMaxCut /*= NULL*/) const
+{
+    return SectionFrom(pt0, pt1, pCutList, pStartDistance, genEndPoint, breaklinesOnly, NULL);
+}
+
+const CutSectionList *Triangles::SectionFrom(const UTPoint &pt0, const UTPoint &pt1,
+                                              CutSectionList *pCutList, double *pStartDistance,
+                                              bool genEndPoint, bool breaklinesOnly, int *pSeed) const
 {
     using namespace keays::types;
     using namespace keays::math;
@@ -973,7 +1002,18 @@ const CutSectionList *Triangles::Section(const UTPoint &pt0, const UTPoint &pt1,
 #endif
 
     // locate the start
-    if (!HeightAtPoint(start.XY(), &height, &triIndex, true))
+    bool located;
+    if (pSeed)
+    {
+        located = LocateFrom(&start, triIndex, *pSeed) && (triIndex >= 0) &&
+                  HeightInTriangle(start.XY(), triIndex, &height, true);
+        if (triIndex >= 0)
+            *pSeed = triIndex;
+    } else
+    {
+        located = HeightAtPoint(start.XY(), &height, &triIndex, true);
+    }
+    if (!located)
     {
         WriteDebugLog(_T("TRIANGLE: %5d: Triangles::Section(...): Could not locate start point\n\n"), __LINE__);
         return NULL;
@@ -1280,5 +1320,170 @@ int Triangles::GenerateBatterString(const keays::types::Polyline3D &polyline,
 }
 //#endregion
 
+//#region -- Tie ins --
+static const int MAX_TIE_IN_THREADS = 32;
+static const size_t MIN_TIE_IN_STATIONS = 64;    // sections are slow enough to share out small runs
+
+TieInResult::TieInResult()
+{
+    groundHeight    = 0.0;
+    triangleID        = -1;
+    status            = E_FAILED;
+}
+
+/*
+    One thread's share of a TieIn(), stations [first, last)
+ */
+struct tTieInJob
+{
+    const Triangles                    *pSurface;
+    const keays::types::Polyline3D    *pStarts;
+    const keays::types::Polyline3D    *pDirections;
+    const CBatterFlags                *pFlags;
+    TieInResult                        *pResults;
+    size_t                            first;
+    size_t                            last;
+};
+
+void Triangles::TieInStations(const keays::types::Polyline3D &starts, const keays::types::Polyline3D &directions,
+                              const CBatterFlags &flags, TieInResult *pResults, size_t first, size_t last) const
+{
+    using namespace keays::types;
+
+    CutSectionList csList;
+    double start;
+    int seed = -1;    // the shared seed for the first station, then the last one found
+
+    for (size_t i = first; i < last; i++)
+    {
+        const VectorD3 &pt = starts[i];
+        const VectorD3 &dir = directions[i];
+        TieInResult &result = pResults[i];
+
+        result.batterPoint = pt;
+        result.profile = VectorD2(0, 0);
+        result.groundHeight = 0.0;
+        result.triangleID = -1;
+        result.status = E_PERP_SECTION;
+
+        double length = sqrt(dir.x * dir.x + dir.y * dir.y);
+        if (Float::EqualTo(length, 0.0))
+            continue;
+
+        const double scale = flags.MaxWidth() / length;
+        const VectorD3 exPt(pt.x + dir.x * scale, pt.y + dir.y * scale, pt.z);
+
+        csList.clear();
+        start = 0.0;
+        if (!SectionFrom(pt, exPt, &csList, &start, true, false, &seed) || csList.empty())
+        {
+            WriteDebugLog(_T("TRIANGLE: %5d: (%d) Tie in Section(...) FAILED. [E_PERP_SECTION]\n"), __LINE__, (int)i);
+            continue;
+        }
+
+        const CutSectionNode &startNode = csList.front();
+        result.groundHeight = startNode.z;
+        result.triangleID = startNode.triangleID;
+
+        if (!CalcBatterPoint(csList, pt.z, flags.MaxWidth(), flags.CutGrade(), flags.FillGrade(),
+                             &result.batterPoint, &result.profile))
+        {
+            WriteDebugLog(_T("TRIANGLE: %5d: (%d) Tie in CalcBatterPoint(...) FAILED. [E_CALC_BATTER]\n"), __LINE__, (int)i);
+            result.status = E_CALC_BATTER;
+            continue;
+        }
+
+        result.status = S_SUCCESS;
+    }
+}
+
+DWORD WINAPI Triangles::TieInThread(LPVOID pParam)
+{
+    const tTieInJob &job = *(const tTieInJob *)pParam;
+    job.pSurface->TieInStations(*job.pStarts, *job.pDirections, *job.pFlags, job.pResults, job.first, job.last);
+    return 0;
+}
+
+int Triangles::TieIn(const keays::types::Polyline3D &starts, const keays::types::Polyline3D &directions,
+                      const CBatterFlags &flags, TieInResultList *pResults, const int numThreads /*= 0*/) const
+{
+    assert(pResults != NULL);
+    pResults->clear();
+
+    if (starts.size() < 1)
+        return E_TOO_FEW_POINTS;
+    if (directions.size() != starts.size())
+        return E_PERP_INEQUALITY;
+    if (flags.MaxWidth() <= 0.0)
+        return E_INVALID_DISTANCE;
+    if (!m_pPoints || (m_NumberPoints < 3))
+        return E_NO_TRI_POINTS;
+    if (!m_pTriangles || (m_NumberTriangles < 1))
+        return E_NO_TRIANGLES;
+
+    size_t numStations = starts.size();
+    pResults->resize(numStations);
+
+    int threads = numThreads;
+    if (threads <= 0)
+    {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        threads = (int)info.dwNumberOfProcessors;
+    }
+    if (threads > MAX_TIE_IN_THREADS)
+        threads = MAX_TIE_IN_THREADS;
+    if ((size_t)threads > numStations / MIN_TIE_IN_STATIONS)
+        threads = (int)(numStations / MIN_TIE_IN_STATIONS);
+    if (threads < 1)
+        threads = 1;
+
+    tTieInJob jobs[MAX_TIE_IN_THREADS];
+    HANDLE handles[MAX_TIE_IN_THREADS];
+    int numHandles = 0;
+    int t;
+
+    // consecutive stations go to the same thread, so each can start from the last one's triangle
+    for (t = 0; t < threads; t++)
+    {
+        jobs[t].pSurface = this;
+        jobs[t].pStarts = &starts;
+        jobs[t].pDirections = &directions;
+        jobs[t].pFlags = &flags;
+        jobs[t].pResults = &(*pResults)[0];
+        jobs[t].first = (numStations * t) / threads;
+        jobs[t].last = (numStations * (t + 1)) / threads;
+    }
+
+    // the last share is done on this thread, as is any share a thread can't be started for
+    for (t = 0; t < threads - 1; t++)
+    {
+        HANDLE hThread = CreateThread(NULL, 0, TieInThread, &jobs[t], 0, NULL);
+        if (hThread)
+            handles[numHandles++] = hThread;
+        else
+            TieInThread(&jobs[t]);
+    }
+
+    TieInThread(&jobs[threads - 1]);
+
+    if (numHandles > 0)
+    {
+        WaitForMultipleObjects(numHandles, handles, TRUE, INFINITE);
+        for (t = 0; t < numHandles; t++)
+            CloseHandle(handles[t]);
+    }
+
+    TieInResultList::const_iterator itr;
+    for (itr = pResults->begin(); itr != pResults->end(); itr++)
+    {
+        if (itr->status != S_SUCCESS)
+            return E_FAILED;
+    }
+
+    return S_SUCCESS;
+}
+//#endregion
+
 };
 };
@@ -0,0 +1,279 @@
+/*
+ * Filename: keays_float.h
+ * Date: October 2026
+ *
+ * Header only versions of the keays::types::Float comparisons.
+ *
+ * The functions in keays_types.h are exported from the dll and take their
+ * arguments by reference, so they can never be inlined into the caller.  The
+ * versions here are all inline, with the tolerance model chosen at compile time
+ * by a policy class, and have SSE2 mask versions for code that works on pairs
+ * of values at a time.
+ *
+ * Part of the keays::types namespace
+ */
+
+#ifndef _KEAYS_FLOAT_H_
+#define _KEAYS_FLOAT_H_
+
+#pragma once
+
+#include <math.h>
+#include <string.h>
+#include "keays_types.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+    #define KEAYS_FLOAT_SSE2
+    #include <emmintrin.h>
+#endif
+
+namespace keays
+{
+namespace types
+{
+namespace Float
+{
+
+#ifdef _MSC_VER
+    typedef __int64 tInt64;
+    typedef unsigned __int64 tUInt64;
+#else
+    typedef long long tInt64;
+    typedef unsigned long long tUInt64;
+#endif
+
+//-----------------------------------------------------------------------------
+/*!
+    \brief Tolerance policy: values are equal if they differ by no more than tol.
+    This matches the exported Float functions exactly.
+ */
+struct AbsoluteTolerance
+{
+    static double DefaultTolerance() { return TOLERANCE; }
+
+    static bool Equal(const double lhs, const double rhs, const double tol)
+    {
+        return (lhs >= rhs - tol) && (lhs <= rhs + tol);
+    }
+};
+
+/*!
+    \brief Tolerance policy: tol is scaled by the larger magnitude of the two values.
+    The scale never drops below 1.0, so values near zero fall back to an absolute test.
+ */
+struct RelativeTolerance
+{
+    static double DefaultTolerance() { return 1e-9; }
+
+    static bool Equal(const double lhs, const double rhs, const double tol)
+    {
+        double l = fabs(lhs), r = fabs(rhs);
+        double scale = l > r ? l : r;
+        if (scale < 1.0)
+            scale = 1.0;
+        return fabs(lhs - rhs) <= tol * scale;
+    }
+};
+
+/*!
+    \brief Tolerance policy: values are equal if they are within tol representable doubles of each other.
+    NaN is never equal to anything.
+ */
+struct UlpTolerance
+{
+    static double DefaultTolerance() { return 4.0; }
+
+    //! Map a double onto an integer line where adjacent doubles differ by one.
+    static tInt64 Ordered(const double val)
+    {
+        tInt64 bits;
+        memcpy(&bits, &val, sizeof(bits));
+        const tInt64 signBit = (tInt64)((tUInt64)1 << 63);
+        return bits < 0 ? signBit - bits : bits;
+    }
+
+    static bool Equal(const double lhs, const double rhs, const double tol)
+    {
+        if (lhs != lhs || rhs != rhs)
+            return false;
+        if (tol < 0.0)
+            return false;
+        // the distance is counted in whole ulps, so it must be taken in integers: a double
+        // cannot hold the ordered values exactly
+        tInt64 hi = Ordered(lhs), lo = Ordered(rhs);
+        if (hi < lo)
+        {
+            tInt64 t = hi;
+            hi = lo;
+            lo = t;
+        }
+        const tInt64 maxInt64 = (tInt64)(((tUInt64)1 << 63) - 1);
+        if (tol >= (double)maxInt64)
+            return true;
+        // values of opposite sign can be further apart than a tInt64 holds
+        if (lo < 0 && hi - maxInt64 > lo)
+            return false;
+        return hi - lo <= (tInt64)tol;
+    }
+};
+
+//-----------------------------------------------------------------------------
+/*!
+    \brief Inline comparisons using the tolerance policy P.
+    Each comparison is the plain operator with the "equal" band taken out (or added in), so
+    Less() is true only if the values are ordered and not equal under the policy.
+ */
+template <class P>
+struct Compare
+{
+    static bool EqualTo(const double lhs, const double rhs, const double tol) { return P::Equal(lhs, rhs, tol); }
+    static bool EqualTo(const double lhs, const double rhs) { return P::Equal(lhs, rhs, P::DefaultTolerance()); }
+
+    static bool NotEqual(const double lhs, const double rhs, const double tol) { return !P::Equal(lhs, rhs, tol); }
+    static bool NotEqual(const double lhs, const double rhs) { return !EqualTo(lhs, rhs); }
+
+    static bool Less(const double lhs, const double rhs, const double tol) { return lhs < rhs && !P::Equal(lhs, rhs, tol); }
+    static bool Less(const double lhs, const double rhs) { return Less(lhs, rhs, P::DefaultTolerance()); }
+
+    static bool LessOrEqual(const double lhs, const double rhs, const double tol) { return lhs <= rhs || P::Equal(lhs, rhs, tol); }
+    static bool LessOrEqual(const double lhs, const double rhs) { return LessOrEqual(lhs, rhs, P::DefaultTolerance()); }
+
+    static bool Greater(const double lhs, const double rhs, const double tol) { return lhs > rhs && !P::Equal(lhs, rhs, tol); }
+    static bool Greater(const double lhs, const double rhs) { return Greater(lhs, rhs, P::DefaultTolerance()); }
+
+    static bool GreaterOrEqual(const double lhs, const double rhs, const double tol) { return lhs >= rhs || P::Equal(lhs, rhs, tol); }
+    static bool GreaterOrEqual(const double lhs, const double rhs) { return GreaterOrEqual(lhs, rhs, P::DefaultTolerance()); }
+};
+
+/*!
+    \brief Inline drop in replacements for the exported absolute tolerance functions.
+    Float::Fast::Less(a, b, tol) gives the same answer as Float::Less(a, b, tol).
+ */
+namespace Fast
+{
+    inline bool Less(const double lhs, const double rhs, const double tol = TOLERANCE) { return lhs < rhs - tol; }
+    inline bool LessOrEqual(const double lhs, const double rhs, const double tol = TOLERANCE) { return lhs <= rhs + tol; }
+    inline bool EqualTo(const double lhs, const double rhs, const double tol = TOLERANCE) { return (lhs >= rhs - tol) && (lhs <= rhs + tol); }
+    inline bool NotEqual(const double lhs, const double rhs, const double tol = TOLERANCE) { return !EqualTo(lhs, rhs, tol); }
+    inline bool Greater(const double lhs, const double rhs, const double tol = TOLERANCE) { return lhs > rhs + tol; }
+    inline bool GreaterOrEqual(const double lhs, const double rhs, const double tol = TOLERANCE) { return lhs >= rhs - tol; }
+}    // namespace Fast
+
+#ifdef KEAYS_FLOAT_SSE2
+//-----------------------------------------------------------------------------
+/*!
+    \brief SSE2 mask versions of the absolute tolerance comparisons.
+    Each returns a lane mask (all bits set for true), combine them with _mm_and_pd/_mm_or_pd and
+    read the result with _mm_movemask_pd.
+ */
+namespace Simd
+{
+    inline __m128d Less(const __m128d lhs, const __m128d rhs, const __m128d tol) { return _mm_cmplt_pd(lhs, _mm_sub_pd(rhs, tol)); }
+    inline __m128d LessOrEqual(const __m128d lhs, const __m128d rhs, const __m128d tol) { return _mm_cmple_pd(lhs, _mm_add_pd(rhs, tol)); }
+    inline __m128d Greater(const __m128d lhs, const __m128d rhs, const __m128d tol) { return _mm_cmpgt_pd(lhs, _mm_add_pd(rhs, tol)); }
+    inline __m128d GreaterOrEqual(const __m128d lhs, const __m128d rhs, const __m128d tol) { return _mm_cmpge_pd(lhs, _mm_sub_pd(rhs, tol)); }
+    inline __m128d EqualTo(const __m128d lhs, const __m128d rhs, const __m128d tol)
+    {
+        return _mm_and_pd(_mm_cmpge_pd(lhs, _mm_sub_pd(rhs, tol)), _mm_cmple_pd(lhs, _mm_add_pd(rhs, tol)));
+    }
+    inline __m128d NotEqual(const __m128d lhs, const __m128d rhs, const __m128d tol)
+    {
+        return _mm_or_pd(_mm_cmplt_pd(lhs, _mm_sub_pd(rhs, tol)), _mm_cmpgt_pd(lhs, _mm_add_pd(rhs, tol)));
+    }
+}    // namespace Simd
+#endif
+
+//-----------------------------------------------------------------------------
+/*!
+    \brief Compare an array of values against a single value with the absolute tolerance.
+    pMask[i] is set to 1 if pValues[i] < rhs (within tolerance) and 0 otherwise.
+
+    \return The number of values that passed.
+ */
+inline int LessMask(const double *pValues, const int numValues, const double rhs, unsigned char *pMask,
+                    const double tol = TOLERANCE)
+{
+    int i = 0, numSet = 0;
+    const double limit = rhs - tol;
+#ifdef KEAYS_FLOAT_SSE2
+    const __m128d vLimit = _mm_set1_pd(limit);
+    for (; i + 1 < numValues; i += 2)
+    {
+        int bits = _mm_movemask_pd(_mm_cmplt_pd(_mm_loadu_pd(pValues + i), vLimit));
+        pMask[i] = (unsigned char)(bits & 1);
+        pMask[i + 1] = (unsigned char)(bits >> 1);
+        numSet += pMask[i] + pMask[i + 1];
+    }
+#endif
+    for (; i < numValues; i++)
+    {
+        pMask[i] = (unsigned char)(pValues[i] < limit ? 1 : 0);
+        numSet += pMask[i];
+    }
+    return numSet;
+}
+
+/*!
+    \brief Compare an array of values against a single value with the absolute tolerance.
+    pMask[i] is set to 1 if pValues[i] is within tol of rhs and 0 otherwise.
+
+    \return The number of values that passed.
+ */
+inline int EqualMask(const double *pValues, const int numValues, const double rhs, unsigned char *pMask,
+                     const double tol = TOLERANCE)
+{
+    int i = 0, numSet = 0;
+    const double lo = rhs - tol, hi = rhs + tol;
+#ifdef KEAYS_FLOAT_SSE2
+    const __m128d vLo = _mm_set1_pd(lo), vHi = _mm_set1_pd(hi);
+    for (; i + 1 < numValues; i += 2)
+    {
+        __m128d v = _mm_loadu_pd(pValues + i);
+        int bits = _mm_movemask_pd(_mm_and_pd(_mm_cmpge_pd(v, vLo), _mm_cmple_pd(v, vHi)));
+        pMask[i] = (unsigned char)(bits & 1);
+        pMask[i + 1] = (unsigned char)(bits >> 1);
+        numSet += pMask[i] + pMask[i + 1];
+    }
+#endif
+    for (; i < numValues; i++)
+    {
+        pMask[i] = (unsigned char)((pValues[i] >= lo && pValues[i] <= hi) ? 1 : 0);
+        numSet += pMask[i];
+    }
+    return numSet;
+}
+
+/*!
+    \brief Compare an array of values against a single value with the absolute tolerance.
+    pMask[i] is set to 1 if pValues[i] > rhs (within tolerance) and 0 otherwise.
+
+    \return The number of values that passed.
+ */
+inline int GreaterMask(const double *pValues, const int numValues, const double rhs, unsigned char *pMask,
+                       const double tol = TOLERANCE)
+{
+    int i = 0, numSet = 0;
+    const double limit = rhs + tol;
+#ifdef KEAYS_FLOAT_SSE2
+    const __m128d vLimit = _mm_set1_pd(limit);
+    for (; i + 1 < numValues; i += 2)
+    {
+        int bits = _mm_movemask_pd(_mm_cmpgt_pd(_mm_loadu_pd(pValues + i), vLimit));
+        pMask[i] = (unsigned char)(bits & 1);
+        pMask[i + 1] = (unsigned char)(bits >> 1);
+        numSet += pMask[i] + pMask[i + 1];
+    }
+#endif
+    for (; i < numValues; i++)
+    {
+        pMask[i] = (unsigned char)(pValues[i] > limit ? 1 : 0);
+        numSet += pMask[i];
+    }
+    return numSet;
+}
+
+}    // namespace Float
+}    // namespace types
+}    // namespace keays
+
+#endif //_KEAYS_FLOAT_H_
@@ -0,0 +1,212 @@
+/*
+ * Filename: keays_vectors.h
+ * Date: October 2026
+ *
+ * Templated 2D and 3D vectors with inline operators, the float instantiations
+ * (VectorF2, VectorF3) and bulk conversion between double world coordinates and
+ * float local coordinates.
+ *
+ * Part of the keays::types namespace
+ */
+
+#ifndef _KEAYS_VECTORS_H_
+#define _KEAYS_VECTORS_H_
+
+#pragma once
+
+#include <math.h>
+#include "keays_types.h"
+
+namespace keays
+{
+namespace types
+{
+
+//-----------------------------------------------------------------------------
+/*!
+    \brief A 2D vector of any arithmetic type.
+    Unlike VectorD2 every operator is inline so hot loops over float data can be
+    optimised by the compiler.  The layout is exactly two T's.
+ */
+template <class T>
+struct Vector2
+{
+    T x, y;
+
+    Vector2() : x(0), y(0) {}
+    Vector2(const T &xPos, const T &yPos) : x(xPos), y(yPos) {}
+
+    //! Convert from a vector of another precision.
+    template <class U>
+    explicit Vector2(const Vector2<U> &rhs) : x((T)rhs.x), y((T)rhs.y) {}
+
+    const Vector2 operator+(const Vector2 &rhs) const { return Vector2(x + rhs.x, y + rhs.y); }
+    const Vector2 operator-(const Vector2 &rhs) const { return Vector2(x - rhs.x, y - rhs.y); }
+    const Vector2 operator-() const { return Vector2(-x, -y); }
+    const Vector2 operator*(const T &s) const { return Vector2(x * s, y * s); }
+    const Vector2 operator/(const T &s) const { return s == 0 ? Vector2() : Vector2(x / s, y / s); }
+
+    Vector2 &operator+=(const Vector2 &rhs) { x += rhs.x; y += rhs.y; return *this; }
+    Vector2 &operator-=(const Vector2 &rhs) { x -= rhs.x; y -= rhs.y; return *this; }
+    Vector2 &operator*=(const T &s) { x *= s; y *= s; return *this; }
+
+    //! Exact comparison, use the Float namespace functions when a tolerance is needed.
+    bool operator==(const Vector2 &rhs) const { return x == rhs.x && y == rhs.y; }
+    bool operator!=(const Vector2 &rhs) const { return !(*this == rhs); }
+
+    T Dot(const Vector2 &rhs) const { return x * rhs.x + y * rhs.y; }
+    //! The z component of the 3D cross product, +ve if rhs is CCW from this.
+    T Cross(const Vector2 &rhs) const { return x * rhs.y - y * rhs.x; }
+    T LengthSq() const { return x * x + y * y; }
+    T Length() const { return (T)sqrt((double)LengthSq()); }
+
+    const Vector2 Normal() const { return *this / Length(); }
+
+    operator const T *() const { return &x; }
+    operator T *() { return &x; }
+};
+
+//-----------------------------------------------------------------------------
+/*!
+    \brief A 3D vector of any arithmetic type.
+    The layout is exactly three T's so arrays can be handed directly to rendering code.
+ */
+template <class T>
+struct Vector3
+{
+    T x, y, z;
+
+    Vector3() : x(0), y(0), z(0) {}
+    Vector3(const T &xPos, const T &yPos, const T &zPos) : x(xPos), y(yPos), z(zPos) {}
+
+    //! Convert from a vector of another precision.
+    template <class U>
+    explicit Vector3(const Vector3<U> &rhs) : x((T)rhs.x), y((T)rhs.y), z((T)rhs.z) {}
+
+    const Vector3 operator+(const Vector3 &rhs) const { return Vector3(x + rhs.x, y + rhs.y, z + rhs.z); }
+    const Vector3 operator-(const Vector3 &rhs) const { return Vector3(x - rhs.x, y - rhs.y, z - rhs.z); }
+    const Vector3 operator-() const { return Vector3(-x, -y, -z); }
+    const Vector3 operator*(const T &s) const { return Vector3(x * s, y * s, z * s); }
+    const Vector3 operator/(const T &s) const { return s == 0 ? Vector3() : Vector3(x / s, y / s, z / s); }
+
+    Vector3 &operator+=(const Vector3 &rhs) { x += rhs.x; y += rhs.y; z += rhs.z; return *this; }
+    Vector3 &operator-=(const Vector3 &rhs) { x -= rhs.x; y -= rhs.y; z -= rhs.z; return *this; }
+    Vector3 &operator*=(const T &s) { x *= s; y *= s; z *= s; return *this; }
+
+    //! Exact comparison, use the Float namespace functions when a tolerance is needed.
+    bool operator==(const Vector3 &rhs) const { return x == rhs.x && y == rhs.y && z == rhs.z; }
+    bool operator!=(const Vector3 &rhs) const { return !(*this == rhs); }
+
+    T Dot(const Vector3 &rhs) const { return x * rhs.x + y * rhs.y + z * rhs.z; }
+    const Vector3 Cross(const Vector3 &rhs) const
+    {
+        return Vector3(y * rhs.z - z * rhs.y, z * rhs.x - x * rhs.z, x * rhs.y - y * rhs.x);
+    }
+    T LengthSq() const { return x * x + y * y + z * z; }
+    T Length() const { return (T)sqrt((double)LengthSq()); }
+
+    const Vector3 Normal() const { return *this / Length(); }
+    const Vector2<T> XY() const { return Vector2<T>(x, y); }
+
+    operator const T *() const { return &x; }
+    operator T *() { return &x; }
+};
+
+template <class T>
+inline const Vector2<T> operator*(const T &s, const Vector2<T> &v) { return v * s; }
+
+template <class T>
+inline const Vector3<T> operator*(const T &s, const Vector3<T> &v) { return v * s; }
+
+//-----------------------------------------------------------------------------
+typedef Vector2<float> VectorF2;    //!< Single precision 2D vector.
+typedef Vector3<float> VectorF3;    //!< Single precision 3D vector.
+
+typedef std::vector<VectorF2> PolylineF2;
+typedef std::vector<VectorF3> PolylineF3;
+
+/*!
+    \name World/Local conversion
+    Survey coordinates are typically in the hundreds of thousands (or millions) of metres, which
+    leaves a float with only centimetre resolution or worse.  Subtracting a local origin in double
+    precision first keeps millimetre accuracy over several kilometres while halving the storage.
+    @{
+ */
+
+//! Convert a single world point to float local coordinates.
+inline const VectorF3 ToLocal(const VectorD3 &pt, const VectorD3 &origin)
+{
+    return VectorF3((float)(pt.x - origin.x), (float)(pt.y - origin.y), (float)(pt.z - origin.z));
+}
+
+//! Convert a single float local point back to world coordinates.
+inline const VectorD3 ToWorld(const VectorF3 &pt, const VectorD3 &origin)
+{
+    return VectorD3(origin.x + pt.x, origin.y + pt.y, origin.z + pt.z);
+}
+
+//! \overload
+inline const VectorF2 ToLocal(const VectorD2 &pt, const VectorD2 &origin)
+{
+    return VectorF2((float)(pt.x - origin.x), (float)(pt.y - origin.y));
+}
+
+//! \overload
+inline const VectorD2 ToWorld(const VectorF2 &pt, const VectorD2 &origin)
+{
+    return VectorD2(origin.x + pt.x, origin.y + pt.y);
+}
+
+/*!
+    \brief Find a local origin for a set of points, the center of their extents.
+
+    \param      pPts [In] - A constant pointer to an array of VectorD3 points.
+    \param numPoints [In] - An <b>int</b> specifying the number of points.
+
+    \return The center of the points extents, or the zero vector if there are no points.
+ */
+KEAYS_TYPES_EXPORTS_API const VectorD3 CalcLocalOrigin(const VectorD3 *pPts, const int numPoints);
+
+/*!
+    \brief Convert an array of world points to float local coordinates.
+
+    \param      pSrc [In]  - A constant pointer to an array of VectorD3 world points.
+    \param numPoints [In]  - An <b>int</b> specifying the number of points.
+    \param    origin [In]  - A constant reference to a VectorD3 specifying the local origin.
+    \param      pDst [Out] - A pointer to an array of at least numPoints VectorF3 to receive the local points.
+ */
+KEAYS_TYPES_EXPORTS_API void ToLocal(const VectorD3 *pSrc, const int numPoints, const VectorD3 &origin, VectorF3 *pDst);
+
+//! \overload
+KEAYS_TYPES_EXPORTS_API void ToLocal(const VectorD2 *pSrc, const int numPoints, const VectorD2 &origin, VectorF2 *pDst);
+
+/*!
+    \overload
+    \param    src [In]  - A constant reference to the Polyline3D of world points.
+    \param origin [In]  - A constant reference to a VectorD3 specifying the local origin.
+    \param    dst [Out] - A reference to a PolylineF3, resized to match src.
+ */
+KEAYS_TYPES_EXPORTS_API void ToLocal(const Polyline3D &src, const VectorD3 &origin, PolylineF3 &dst);
+
+/*!
+    \brief Convert an array of float local points back to world coordinates.
+
+    \param      pSrc [In]  - A constant pointer to an array of VectorF3 local points.
+    \param numPoints [In]  - An <b>int</b> specifying the number of points.
+    \param    origin [In]  - A constant reference to a VectorD3 specifying the local origin.
+    \param      pDst [Out] - A pointer to an array of at least numPoints VectorD3 to receive the world points.
+ */
+KEAYS_TYPES_EXPORTS_API void ToWorld(const VectorF3 *pSrc, const int numPoints, const VectorD3 &origin, VectorD3 *pDst);
+
+//! \overload
+KEAYS_TYPES_EXPORTS_API void ToWorld(const VectorF2 *pSrc, const int numPoints, const VectorD2 &origin, VectorD2 *pDst);
+
+//! \overload
+KEAYS_TYPES_EXPORTS_API void ToWorld(const PolylineF3 &src, const VectorD3 &origin, Polyline3D &dst);
+
+/*! @}*/
+
+}    // namespace types
+}    // namespace keays
+
+#endif //_KEAYS_VECTORS_H_
@@ -50,7 +50,7 @@ KEAYS_TYPES_EXPORTS_API bool GreaterOrEqual(const double &lhs, const double &rhs
 
 KEAYS_TYPES_EXPORTS_API bool NotEqual(const double &lhs, const double &rhs, const double &tol /*= TOLERANCE*/)
 {
-    return !EqualTo(lhs, rhs);
+    return !EqualTo(lhs, rhs, tol);
 }
 
 KEAYS_TYPES_EXPORTS_API const double SafeFloatToDouble(float fl, const double &tol /*= TOLERANCE*/)
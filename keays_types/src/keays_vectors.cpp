@@ -0,0 +1,122 @@
+#include "..\include\keays_vectors.h"
+
+#include <LeakWatcher.h>
+
+#ifdef _DO_MEMORY_DEBUG
+#define new DEBUG_NEW
+#undef THIS_FILE
+static char THIS_FILE[] = __FILE__;
+#endif
+
+#pragma warning(disable : 4786) // ignore the long name warning associated with stl stuff
+
+namespace keays
+{
+namespace types
+{
+
+//-----------------------------------------------------------------------------
+// World/Local conversion
+//-----------------------------------------------------------------------------
+KEAYS_TYPES_EXPORTS_API const VectorD3 CalcLocalOrigin(const VectorD3 *pPts, const int numPoints)
+{
+    if (!pPts || numPoints <= 0)
+        return VectorD3();
+
+    VectorD3 min = pPts[0], max = pPts[0];
+    for (int i = 1; i < numPoints; i++)
+    {
+        const VectorD3 &pt = pPts[i];
+        if (pt.x < min.x) min.x = pt.x;
+        if (pt.x > max.x) max.x = pt.x;
+        if (pt.y < min.y) min.y = pt.y;
+        if (pt.y > max.y) max.y = pt.y;
+        if (pt.z < min.z) min.z = pt.z;
+        if (pt.z > max.z) max.z = pt.z;
+    }
+
+    return VectorD3((min.x + max.x) * 0.5, (min.y + max.y) * 0.5, (min.z + max.z) * 0.5);
+}
+
+//-----------------------------------------------------------------------------
+// The loops below work on plain doubles/floats rather than the vector operators so the
+// compiler is free to vectorise the subtract and convert.
+KEAYS_TYPES_EXPORTS_API void ToLocal(const VectorD3 *pSrc, const int numPoints, const VectorD3 &origin, VectorF3 *pDst)
+{
+    if (!pSrc || !pDst)
+        return;
+
+    const double ox = origin.x, oy = origin.y, oz = origin.z;
+    for (int i = 0; i < numPoints; i++)
+    {
+        pDst[i].x = (float)(pSrc[i].x - ox);
+        pDst[i].y = (float)(pSrc[i].y - oy);
+        pDst[i].z = (float)(pSrc[i].z - oz);
+    }
+}
+
+//-----------------------------------------------------------------------------
+KEAYS_TYPES_EXPORTS_API void ToLocal(const VectorD2 *pSrc, const int numPoints, const VectorD2 &origin, VectorF2 *pDst)
+{
+    if (!pSrc || !pDst)
+        return;
+
+    const double ox = origin.x, oy = origin.y;
+    for (int i = 0; i < numPoints; i++)
+    {
+        pDst[i].x = (float)(pSrc[i].x - ox);
+        pDst[i].y = (float)(pSrc[i].y - oy);
+    }
+}
+
+//-----------------------------------------------------------------------------
+KEAYS_TYPES_EXPORTS_API void ToLocal(const Polyline3D &src, const VectorD3 &origin, PolylineF3 &dst)
+{
+    dst.resize(src.size());
+    if (src.empty())
+        return;
+
+    ToLocal(&(src[0]), (int)src.size(), origin, &(dst[0]));
+}
+
+//-----------------------------------------------------------------------------
+KEAYS_TYPES_EXPORTS_API void ToWorld(const VectorF3 *pSrc, const int numPoints, const VectorD3 &origin, VectorD3 *pDst)
+{
+    if (!pSrc || !pDst)
+        return;
+
+    const double ox = origin.x, oy = origin.y, oz = origin.z;
+    for (int i = 0; i < numPoints; i++)
+    {
+        pDst[i].x = ox + pSrc[i].x;
+        pDst[i].y = oy + pSrc[i].y;
+        pDst[i].z = oz + pSrc[i].z;
+    }
+}
+
+//-----------------------------------------------------------------------------
+KEAYS_TYPES_EXPORTS_API void ToWorld(const VectorF2 *pSrc, const int numPoints, const VectorD2 &origin, VectorD2 *pDst)
+{
+    if (!pSrc || !pDst)
+        return;
+
+    const double ox = origin.x, oy = origin.y;
+    for (int i = 0; i < numPoints; i++)
+    {
+        pDst[i].x = ox + pSrc[i].x;
+        pDst[i].y = oy + pSrc[i].y;
+    }
+}
+
+//-----------------------------------------------------------------------------
+KEAYS_TYPES_EXPORTS_API void ToWorld(const PolylineF3 &src, const VectorD3 &origin, Polyline3D &dst)
+{
+    dst.resize(src.size());
+    if (src.empty())
+        return;
+
+    ToWorld(&(src[0]), (int)src.size(), origin, &(dst[0]));
+}
+
+}    // namespace types
+}    // namespace keays